@@ -6,9 +6,11 @@
 #include <addrman.h>
 #include <addrman_impl.h>
 
+#include <crypto/common.h>
 #include <hash.h>
 #include <logging.h>
 #include <logging/timer.h>
+#include <memusage.h>
 #include <netaddress.h>
 #include <protocol.h>
 #include <random.h>
@@ -43,6 +45,16 @@ static constexpr size_t ADDRMAN_SET_TRIED_COLLISION_SIZE{10};
 /** The maximum time we'll spend trying to resolve a tried table collision, in seconds */
 static constexpr int64_t ADDRMAN_TEST_WINDOW{40*60}; // 40 minutes
 
+static_assert(ADDRMAN_BUCKET_SIZE == 64, "bucket occupancy bitmaps hold one bit per position in a uint64_t");
+
+/** The first occupied position of a bucket at or after pos, looping around. The bucket must not be empty. */
+static int NextOccupiedPosition(uint64_t occupied, int pos)
+{
+    const uint64_t rotated{pos == 0 ? occupied : (occupied >> pos) | (occupied << (ADDRMAN_BUCKET_SIZE - pos))};
+    // Isolate the lowest set bit; its index is one less than the bit length.
+    return (pos + CountBits(rotated & ~(rotated - 1)) - 1) % ADDRMAN_BUCKET_SIZE;
+}
+
 int AddrInfo::GetTriedBucket(const uint256& nKey, const std::vector<bool>& asmap) const
 {
     uint64_t hash1 = (CHashWriter(SER_GETHASH, 0) << nKey << GetKey()).GetCheapHash();
@@ -99,6 +111,35 @@ double AddrInfo::GetChance(int64_t nNow) const
     return fChance;
 }
 
+int AddrInfoTable::Insert(AddrInfo&& info)
+{
+    if (m_free_ids.empty()) {
+        m_slots.push_back(std::move(info));
+        m_in_use.push_back(true);
+        return m_slots.size() - 1;
+    }
+    const int id{m_free_ids.back()};
+    m_free_ids.pop_back();
+    m_slots[id] = std::move(info);
+    m_in_use[id] = true;
+    return id;
+}
+
+void AddrInfoTable::Erase(int id)
+{
+    assert(Contains(id));
+    // Release any memory held by the address right away.
+    m_slots[id] = AddrInfo{};
+    m_in_use[id] = false;
+    m_free_ids.push_back(id);
+}
+
+size_t AddrInfoTable::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(m_slots) + memusage::MallocUsage((m_in_use.capacity() + 7) / 8) +
+           memusage::DynamicUsage(m_free_ids);
+}
+
 AddrManImpl::AddrManImpl(std::vector<bool>&& asmap, bool deterministic, int32_t consistency_check_ratio)
     : insecure_rand{deterministic}
     , nKey{deterministic ? uint256{1} : insecure_rand.rand256()}
@@ -155,7 +196,7 @@ void AddrManImpl::Serialize(Stream& s_) const
      * as incompatible. This is necessary because it did not check the version number on
      * deserialization.
      *
-     * vvNew, vvTried, mapInfo, mapAddr and vRandom are never encoded explicitly;
+     * vvNew, vvTried, m_infos, mapAddr and vRandom are never encoded explicitly;
      * they are instead reconstructed from the other information.
      *
      * This format is more complex, but significantly smaller (at most 1.5 MiB), and supports
@@ -182,26 +223,25 @@ void AddrManImpl::Serialize(Stream& s_) const
 
     int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
     s << nUBuckets;
-    std::unordered_map<int, int> mapUnkIds;
+    // Index of each new entry in the serialized "all new addresses", by id.
+    std::vector<int> new_indexes(m_infos.SlotCount(), -1);
     int nIds = 0;
-    for (const auto& entry : mapInfo) {
-        mapUnkIds[entry.first] = nIds;
-        const AddrInfo& info = entry.second;
+    m_infos.ForEach([&](int id, const AddrInfo& info) EXCLUSIVE_LOCKS_REQUIRED(cs) {
         if (info.nRefCount) {
             assert(nIds != nNew); // this means nNew was wrong, oh ow
+            new_indexes[id] = nIds;
             s << info;
             nIds++;
         }
-    }
+    });
     nIds = 0;
-    for (const auto& entry : mapInfo) {
-        const AddrInfo& info = entry.second;
+    m_infos.ForEach([&](int, const AddrInfo& info) EXCLUSIVE_LOCKS_REQUIRED(cs) {
         if (info.fInTried) {
             assert(nIds != nTried); // this means nTried was wrong, oh ow
             s << info;
             nIds++;
         }
-    }
+    });
     for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
         int nSize = 0;
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
@@ -211,7 +251,7 @@ void AddrManImpl::Serialize(Stream& s_) const
         s << nSize;
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
             if (vvNew[bucket][i] != -1) {
-                int nIndex = mapUnkIds[vvNew[bucket][i]];
+                int nIndex = new_indexes[vvNew[bucket][i]];
                 s << nIndex;
             }
         }
@@ -277,15 +317,16 @@ void AddrManImpl::Unserialize(Stream& s_)
                     ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE));
     }
 
-    // Deserialize entries from the new table.
+    // Deserialize entries from the new table. The table is empty, so they get
+    // the ids 0 to nNew - 1, which the new bucket entries below refer to.
     for (int n = 0; n < nNew; n++) {
-        AddrInfo& info = mapInfo[n];
+        AddrInfo info;
         s >> info;
-        mapAddr[info] = n;
         info.nRandomPos = vRandom.size();
-        vRandom.push_back(n);
+        const int id{m_infos.Insert(std::move(info))};
+        mapAddr[m_infos[id]] = id;
+        vRandom.push_back(id);
     }
-    nIdCount = nNew;
 
     // Deserialize entries from the tried table.
     int nLost = 0;
@@ -298,11 +339,10 @@ void AddrManImpl::Unserialize(Stream& s_)
                 && vvTried[nKBucket][nKBucketPos] == -1) {
             info.nRandomPos = vRandom.size();
             info.fInTried = true;
-            vRandom.push_back(nIdCount);
-            mapInfo[nIdCount] = info;
-            mapAddr[info] = nIdCount;
-            vvTried[nKBucket][nKBucketPos] = nIdCount;
-            nIdCount++;
+            const int id{m_infos.Insert(std::move(info))};
+            vRandom.push_back(id);
+            mapAddr[m_infos[id]] = id;
+            SetTried(nKBucket, nKBucketPos, id);
         } else {
             nLost++;
         }
@@ -347,7 +387,7 @@ void AddrManImpl::Unserialize(Stream& s_)
     for (auto bucket_entry : bucket_entries) {
         int bucket{bucket_entry.first};
         const int entry_index{bucket_entry.second};
-        AddrInfo& info = mapInfo[entry_index];
+        AddrInfo& info = m_infos[entry_index];
 
         // Don't store the entry in the new bucket if it's not a valid address for our addrman
         if (!info.IsValid()) continue;
@@ -360,7 +400,7 @@ void AddrManImpl::Unserialize(Stream& s_)
         int bucket_position = info.GetBucketPosition(nKey, true, bucket);
         if (restore_bucketing && vvNew[bucket][bucket_position] == -1) {
             // Bucketing has not changed, using existing bucket positions for the new table
-            vvNew[bucket][bucket_position] = entry_index;
+            SetNew(bucket, bucket_position, entry_index);
             ++info.nRefCount;
         } else {
             // In case the new table data cannot be used (bucket count wrong or new asmap),
@@ -368,7 +408,7 @@ void AddrManImpl::Unserialize(Stream& s_)
             bucket = info.GetNewBucket(nKey, m_asmap);
             bucket_position = info.GetBucketPosition(nKey, true, bucket);
             if (vvNew[bucket][bucket_position] == -1) {
-                vvNew[bucket][bucket_position] = entry_index;
+                SetNew(bucket, bucket_position, entry_index);
                 ++info.nRefCount;
             }
         }
@@ -376,13 +416,10 @@ void AddrManImpl::Unserialize(Stream& s_)
 
     // Prune new entries with refcount 0 (as a result of collisions or invalid address).
     int nLostUnk = 0;
-    for (auto it = mapInfo.cbegin(); it != mapInfo.cend(); ) {
-        if (it->second.fInTried == false && it->second.nRefCount == 0) {
-            const auto itCopy = it++;
-            Delete(itCopy->first);
+    for (int id = 0; id < m_infos.SlotCount(); ++id) {
+        if (m_infos.Contains(id) && m_infos[id].fInTried == false && m_infos[id].nRefCount == 0) {
+            Delete(id);
             ++nLostUnk;
-        } else {
-            ++it;
         }
     }
     if (nLost + nLostUnk > 0) {
@@ -406,9 +443,8 @@ AddrInfo* AddrManImpl::Find(const CService& addr, int* pnId)
         return nullptr;
     if (pnId)
         *pnId = (*it).second;
-    const auto it2 = mapInfo.find((*it).second);
-    if (it2 != mapInfo.end())
-        return &(*it2).second;
+    if (m_infos.Contains((*it).second))
+        return &m_infos[(*it).second];
     return nullptr;
 }
 
@@ -416,14 +452,14 @@ AddrInfo* AddrManImpl::Create(const CAddress& addr, const CNetAddr& addrSource,
 {
     AssertLockHeld(cs);
 
-    int nId = nIdCount++;
-    mapInfo[nId] = AddrInfo(addr, addrSource);
+    AddrInfo info(addr, addrSource);
+    info.nRandomPos = vRandom.size();
+    int nId = m_infos.Insert(std::move(info));
     mapAddr[addr] = nId;
-    mapInfo[nId].nRandomPos = vRandom.size();
     vRandom.push_back(nId);
     if (pnId)
         *pnId = nId;
-    return &mapInfo[nId];
+    return &m_infos[nId];
 }
 
 void AddrManImpl::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2) const
@@ -438,13 +474,8 @@ void AddrManImpl::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2) const
     int nId1 = vRandom[nRndPos1];
     int nId2 = vRandom[nRndPos2];
 
-    const auto it_1{mapInfo.find(nId1)};
-    const auto it_2{mapInfo.find(nId2)};
-    assert(it_1 != mapInfo.end());
-    assert(it_2 != mapInfo.end());
-
-    it_1->second.nRandomPos = nRndPos2;
-    it_2->second.nRandomPos = nRndPos1;
+    m_infos[nId1].nRandomPos = nRndPos2;
+    m_infos[nId2].nRandomPos = nRndPos1;
 
     vRandom[nRndPos1] = nId2;
     vRandom[nRndPos2] = nId1;
@@ -454,18 +485,43 @@ void AddrManImpl::Delete(int nId)
 {
     AssertLockHeld(cs);
 
-    assert(mapInfo.count(nId) != 0);
-    AddrInfo& info = mapInfo[nId];
+    AddrInfo& info = m_infos[nId];
     assert(!info.fInTried);
     assert(info.nRefCount == 0);
 
     SwapRandom(info.nRandomPos, vRandom.size() - 1);
     vRandom.pop_back();
     mapAddr.erase(info);
-    mapInfo.erase(nId);
+    m_infos.Erase(nId);
+    // The id will be reused; don't let a pending collision refer to its next entry.
+    m_tried_collisions.erase(nId);
     nNew--;
 }
 
+void AddrManImpl::SetNew(int bucket, int pos, int id)
+{
+    AssertLockHeld(cs);
+
+    vvNew[bucket][pos] = id;
+    if (id == -1) {
+        m_new_occupied[bucket] &= ~(uint64_t{1} << pos);
+    } else {
+        m_new_occupied[bucket] |= uint64_t{1} << pos;
+    }
+}
+
+void AddrManImpl::SetTried(int bucket, int pos, int id)
+{
+    AssertLockHeld(cs);
+
+    vvTried[bucket][pos] = id;
+    if (id == -1) {
+        m_tried_occupied[bucket] &= ~(uint64_t{1} << pos);
+    } else {
+        m_tried_occupied[bucket] |= uint64_t{1} << pos;
+    }
+}
+
 void AddrManImpl::ClearNew(int nUBucket, int nUBucketPos)
 {
     AssertLockHeld(cs);
@@ -473,10 +529,10 @@ void AddrManImpl::ClearNew(int nUBucket, int nUBucketPos)
     // if there is an entry in the specified bucket, delete it.
     if (vvNew[nUBucket][nUBucketPos] != -1) {
         int nIdDelete = vvNew[nUBucket][nUBucketPos];
-        AddrInfo& infoDelete = mapInfo[nIdDelete];
+        AddrInfo& infoDelete = m_infos[nIdDelete];
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
-        vvNew[nUBucket][nUBucketPos] = -1;
+        SetNew(nUBucket, nUBucketPos, -1);
         LogPrint(BCLog::ADDRMAN, "Removed %s from new[%i][%i]\n", infoDelete.ToString(), nUBucket, nUBucketPos);
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
@@ -494,7 +550,7 @@ void AddrManImpl::MakeTried(AddrInfo& info, int nId)
         const int bucket{(start_bucket + n) % ADDRMAN_NEW_BUCKET_COUNT};
         const int pos{info.GetBucketPosition(nKey, true, bucket)};
         if (vvNew[bucket][pos] == nId) {
-            vvNew[bucket][pos] = -1;
+            SetNew(bucket, pos, -1);
             info.nRefCount--;
             if (info.nRefCount == 0) break;
         }
@@ -511,12 +567,11 @@ void AddrManImpl::MakeTried(AddrInfo& info, int nId)
     if (vvTried[nKBucket][nKBucketPos] != -1) {
         // find an item to evict
         int nIdEvict = vvTried[nKBucket][nKBucketPos];
-        assert(mapInfo.count(nIdEvict) == 1);
-        AddrInfo& infoOld = mapInfo[nIdEvict];
+        AddrInfo& infoOld = m_infos[nIdEvict];
 
         // Remove the to-be-evicted item from the tried set.
         infoOld.fInTried = false;
-        vvTried[nKBucket][nKBucketPos] = -1;
+        SetTried(nKBucket, nKBucketPos, -1);
         nTried--;
 
         // find which new bucket it belongs to
@@ -527,14 +582,14 @@ void AddrManImpl::MakeTried(AddrInfo& info, int nId)
 
         // Enter it into the new set again.
         infoOld.nRefCount = 1;
-        vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        SetNew(nUBucket, nUBucketPos, nIdEvict);
         nNew++;
         LogPrint(BCLog::ADDRMAN, "Moved %s from tried[%i][%i] to new[%i][%i] to make space\n",
                  infoOld.ToString(), nKBucket, nKBucketPos, nUBucket, nUBucketPos);
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
 
-    vvTried[nKBucket][nKBucketPos] = nId;
+    SetTried(nKBucket, nKBucketPos, nId);
     nTried++;
     info.fInTried = true;
 }
@@ -593,7 +648,7 @@ bool AddrManImpl::AddSingle(const CAddress& addr, const CNetAddr& source, int64_
     bool fInsert = vvNew[nUBucket][nUBucketPos] == -1;
     if (vvNew[nUBucket][nUBucketPos] != nId) {
         if (!fInsert) {
-            AddrInfo& infoExisting = mapInfo[vvNew[nUBucket][nUBucketPos]];
+            AddrInfo& infoExisting = m_infos[vvNew[nUBucket][nUBucketPos]];
             if (infoExisting.IsTerrible() || (infoExisting.nRefCount > 1 && pinfo->nRefCount == 0)) {
                 // Overwrite the existing new table entry.
                 fInsert = true;
@@ -602,7 +657,7 @@ bool AddrManImpl::AddSingle(const CAddress& addr, const CNetAddr& source, int64_
         if (fInsert) {
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
-            vvNew[nUBucket][nUBucketPos] = nId;
+            SetNew(nUBucket, nUBucketPos, nId);
             LogPrint(BCLog::ADDRMAN, "Added %s mapped to AS%i to new[%i][%i]\n",
                      addr.ToString(), addr.GetMappedAS(m_asmap), nUBucket, nUBucketPos);
         } else {
@@ -656,9 +711,8 @@ void AddrManImpl::Good_(const CService& addr, bool test_before_evict, int64_t nT
             m_tried_collisions.insert(nId);
         }
         // Output the entry we'd be colliding with, for debugging purposes
-        auto colliding_entry = mapInfo.find(vvTried[tried_bucket][tried_bucket_pos]);
         LogPrint(BCLog::ADDRMAN, "Collision with %s while attempting to move %s to tried table. Collisions=%d\n",
-                 colliding_entry != mapInfo.end() ? colliding_entry->second.ToString() : "",
+                 m_infos[vvTried[tried_bucket][tried_bucket_pos]].ToString(),
                  addr.ToString(),
                  m_tried_collisions.size());
     } else {
@@ -718,19 +772,13 @@ std::pair<CAddress, int64_t> AddrManImpl::Select_(bool newOnly) const
             // Pick a tried bucket, and an initial position in that bucket.
             int nKBucket = insecure_rand.randrange(ADDRMAN_TRIED_BUCKET_COUNT);
             int nKBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
-            // Iterate over the positions of that bucket, starting at the initial one,
-            // and looping around.
-            int i;
-            for (i = 0; i < ADDRMAN_BUCKET_SIZE; ++i) {
-                if (vvTried[nKBucket][(nKBucketPos + i) % ADDRMAN_BUCKET_SIZE] != -1) break;
-            }
             // If the bucket is entirely empty, start over with a (likely) different one.
-            if (i == ADDRMAN_BUCKET_SIZE) continue;
-            // Find the entry to return.
-            int nId = vvTried[nKBucket][(nKBucketPos + i) % ADDRMAN_BUCKET_SIZE];
-            const auto it_found{mapInfo.find(nId)};
-            assert(it_found != mapInfo.end());
-            const AddrInfo& info{it_found->second};
+            const uint64_t occupied{m_tried_occupied[nKBucket]};
+            if (occupied == 0) continue;
+            // Find the entry to return: the first one in that bucket, starting at the
+            // initial position and looping around.
+            int nId = vvTried[nKBucket][NextOccupiedPosition(occupied, nKBucketPos)];
+            const AddrInfo& info{m_infos[nId]};
             // With probability GetChance() * fChanceFactor, return the entry.
             if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30)) {
                 LogPrint(BCLog::ADDRMAN, "Selected %s from tried\n", info.ToString());
@@ -746,19 +794,13 @@ std::pair<CAddress, int64_t> AddrManImpl::Select_(bool newOnly) const
             // Pick a new bucket, and an initial position in that bucket.
             int nUBucket = insecure_rand.randrange(ADDRMAN_NEW_BUCKET_COUNT);
             int nUBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
-            // Iterate over the positions of that bucket, starting at the initial one,
-            // and looping around.
-            int i;
-            for (i = 0; i < ADDRMAN_BUCKET_SIZE; ++i) {
-                if (vvNew[nUBucket][(nUBucketPos + i) % ADDRMAN_BUCKET_SIZE] != -1) break;
-            }
             // If the bucket is entirely empty, start over with a (likely) different one.
-            if (i == ADDRMAN_BUCKET_SIZE) continue;
-            // Find the entry to return.
-            int nId = vvNew[nUBucket][(nUBucketPos + i) % ADDRMAN_BUCKET_SIZE];
-            const auto it_found{mapInfo.find(nId)};
-            assert(it_found != mapInfo.end());
-            const AddrInfo& info{it_found->second};
+            const uint64_t occupied{m_new_occupied[nUBucket]};
+            if (occupied == 0) continue;
+            // Find the entry to return: the first one in that bucket, starting at the
+            // initial position and looping around.
+            int nId = vvNew[nUBucket][NextOccupiedPosition(occupied, nUBucketPos)];
+            const AddrInfo& info{m_infos[nId]};
             // With probability GetChance() * fChanceFactor, return the entry.
             if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30)) {
                 LogPrint(BCLog::ADDRMAN, "Selected %s from new\n", info.ToString());
@@ -791,10 +833,7 @@ std::vector<CAddress> AddrManImpl::GetAddr_(size_t max_addresses, size_t max_pct
 
         int nRndPos = insecure_rand.randrange(vRandom.size() - n) + n;
         SwapRandom(n, nRndPos);
-        const auto it{mapInfo.find(vRandom[n])};
-        assert(it != mapInfo.end());
-
-        const AddrInfo& ai{it->second};
+        const AddrInfo& ai{m_infos[vRandom[n]]};
 
         // Filter by network (optional)
         if (network != std::nullopt && ai.GetNetClass() != network) continue;
@@ -851,11 +890,11 @@ void AddrManImpl::ResolveCollisions_()
 
         bool erase_collision = false;
 
-        // If id_new not found in mapInfo remove it from m_tried_collisions
-        if (mapInfo.count(id_new) != 1) {
+        // If id_new not found in m_infos remove it from m_tried_collisions
+        if (!m_infos.Contains(id_new)) {
             erase_collision = true;
         } else {
-            AddrInfo& info_new = mapInfo[id_new];
+            AddrInfo& info_new = m_infos[id_new];
 
             // Which tried bucket to move the entry to.
             int tried_bucket = info_new.GetTriedBucket(nKey, m_asmap);
@@ -866,7 +905,7 @@ void AddrManImpl::ResolveCollisions_()
 
                 // Get the to-be-evicted address that is being tested
                 int id_old = vvTried[tried_bucket][tried_bucket_pos];
-                AddrInfo& info_old = mapInfo[id_old];
+                AddrInfo& info_old = m_infos[id_old];
 
                 // Has successfully connected in last X hours
                 if (GetAdjustedTime() - info_old.nLastSuccess < ADDRMAN_REPLACEMENT_HOURS*(60*60)) {
@@ -915,19 +954,22 @@ std::pair<CAddress, int64_t> AddrManImpl::SelectTriedCollision_()
     std::advance(it, insecure_rand.randrange(m_tried_collisions.size()));
     int id_new = *it;
 
-    // If id_new not found in mapInfo remove it from m_tried_collisions
-    if (mapInfo.count(id_new) != 1) {
+    // If id_new not found in m_infos remove it from m_tried_collisions
+    if (!m_infos.Contains(id_new)) {
         m_tried_collisions.erase(it);
         return {};
     }
 
-    const AddrInfo& newInfo = mapInfo[id_new];
+    const AddrInfo& newInfo = m_infos[id_new];
 
     // which tried bucket to move the entry to
     int tried_bucket = newInfo.GetTriedBucket(nKey, m_asmap);
     int tried_bucket_pos = newInfo.GetBucketPosition(nKey, false, tried_bucket);
 
-    const AddrInfo& info_old = mapInfo[vvTried[tried_bucket][tried_bucket_pos]];
+    // The entry it collided with may have left the tried table since.
+    if (vvTried[tried_bucket][tried_bucket_pos] == -1) return {};
+
+    const AddrInfo& info_old = m_infos[vvTried[tried_bucket][tried_bucket_pos]];
     return {info_old, info_old.nLastTry};
 }
 
@@ -959,9 +1001,9 @@ int AddrManImpl::CheckAddrman() const
     if (vRandom.size() != (size_t)(nTried + nNew))
         return -7;
 
-    for (const auto& entry : mapInfo) {
-        int n = entry.first;
-        const AddrInfo& info = entry.second;
+    for (int n = 0; n < m_infos.SlotCount(); n++) {
+        if (!m_infos.Contains(n)) continue;
+        const AddrInfo& info = m_infos[n];
         if (info.fInTried) {
             if (!info.nLastSuccess)
                 return -1;
@@ -994,14 +1036,15 @@ int AddrManImpl::CheckAddrman() const
 
     for (int n = 0; n < ADDRMAN_TRIED_BUCKET_COUNT; n++) {
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+            if (((m_tried_occupied[n] >> i) & 1) != (vvTried[n][i] != -1))
+                return -20;
             if (vvTried[n][i] != -1) {
                 if (!setTried.count(vvTried[n][i]))
                     return -11;
-                const auto it{mapInfo.find(vvTried[n][i])};
-                if (it == mapInfo.end() || it->second.GetTriedBucket(nKey, m_asmap) != n) {
+                if (!m_infos.Contains(vvTried[n][i]) || m_infos[vvTried[n][i]].GetTriedBucket(nKey, m_asmap) != n) {
                     return -17;
                 }
-                if (it->second.GetBucketPosition(nKey, false, n) != i) {
+                if (m_infos[vvTried[n][i]].GetBucketPosition(nKey, false, n) != i) {
                     return -18;
                 }
                 setTried.erase(vvTried[n][i]);
@@ -1011,11 +1054,12 @@ int AddrManImpl::CheckAddrman() const
 
     for (int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT; n++) {
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+            if (((m_new_occupied[n] >> i) & 1) != (vvNew[n][i] != -1))
+                return -20;
             if (vvNew[n][i] != -1) {
                 if (!mapNew.count(vvNew[n][i]))
                     return -12;
-                const auto it{mapInfo.find(vvNew[n][i])};
-                if (it == mapInfo.end() || it->second.GetBucketPosition(nKey, true, n) != i) {
+                if (!m_infos.Contains(vvNew[n][i]) || m_infos[vvNew[n][i]].GetBucketPosition(nKey, true, n) != i) {
                     return -19;
                 }
                 if (--mapNew[vvNew[n][i]] == 0)
@@ -1040,6 +1084,13 @@ size_t AddrManImpl::size() const
     return vRandom.size();
 }
 
+size_t AddrManImpl::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return m_infos.DynamicMemoryUsage() + memusage::DynamicUsage(mapAddr) + memusage::DynamicUsage(vRandom) +
+           memusage::DynamicUsage(m_tried_collisions);
+}
+
 bool AddrManImpl::Add(const std::vector<CAddress>& vAddr, const CNetAddr& source, int64_t nTimePenalty)
 {
     LOCK(cs);
@@ -1152,6 +1203,11 @@ size_t AddrMan::size() const
     return m_impl->size();
 }
 
+size_t AddrMan::DynamicMemoryUsage() const
+{
+    return m_impl->DynamicMemoryUsage();
+}
+
 bool AddrMan::Add(const std::vector<CAddress>& vAddr, const CNetAddr& source, int64_t nTimePenalty)
 {
     return m_impl->Add(vAddr, source, nTimePenalty);
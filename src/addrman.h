@@ -70,6 +70,9 @@ public:
     //! Return the number of (unique) addresses in all tables.
     size_t size() const;
 
+    //! Approximate memory used by the address tables, in bytes.
+    size_t DynamicMemoryUsage() const;
+
     /**
      * Attempt to add one or more addresses to addrman's new table.
      *
@@ -13,6 +13,7 @@
 #include <sync.h>
 #include <uint256.h>
 
+#include <cassert>
 #include <cstdint>
 #include <optional>
 #include <set>
@@ -97,6 +98,61 @@ public:
     double GetChance(int64_t nNow = GetAdjustedTime()) const;
 };
 
+/**
+ * The AddrInfo entries of an address manager, indexed by their id.
+ *
+ * Entries are stored in one contiguous array, so going from an id in a bucket
+ * or in vRandom to its entry is an index rather than a hash table lookup. The
+ * ids of deleted entries are handed out again by later insertions, so the
+ * array doesn't grow beyond the largest number of entries held at once.
+ */
+class AddrInfoTable
+{
+public:
+    //! Number of entries in use.
+    size_t size() const { return m_slots.size() - m_free_ids.size(); }
+
+    //! Number of slots, used or free. All ids are below this.
+    int SlotCount() const { return m_slots.size(); }
+
+    bool Contains(int id) const { return id >= 0 && id < SlotCount() && m_in_use[id]; }
+
+    //! Access an entry in use. The reference is invalidated by Insert().
+    AddrInfo& operator[](int id)
+    {
+        assert(Contains(id));
+        return m_slots[id];
+    }
+    const AddrInfo& operator[](int id) const
+    {
+        assert(Contains(id));
+        return m_slots[id];
+    }
+
+    //! Store an entry, in the most recently freed slot if there is one, and return its id.
+    int Insert(AddrInfo&& info);
+
+    //! Delete an entry. Its id may be returned by a later Insert().
+    void Erase(int id);
+
+    //! Call fn(id, info) for every entry in use, in order of id.
+    template <typename Fn>
+    void ForEach(Fn&& fn) const
+    {
+        for (int id = 0; id < SlotCount(); ++id) {
+            if (m_in_use[id]) fn(id, m_slots[id]);
+        }
+    }
+
+    size_t DynamicMemoryUsage() const;
+
+private:
+    std::vector<AddrInfo> m_slots;
+    std::vector<bool> m_in_use;
+    //! Ids of the free slots, the most recently freed one last
+    std::vector<int> m_free_ids;
+};
+
 class AddrManImpl
 {
 public:
@@ -112,6 +168,8 @@ public:
 
     size_t size() const EXCLUSIVE_LOCKS_REQUIRED(!cs);
 
+    size_t DynamicMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(!cs);
+
     bool Add(const std::vector<CAddress>& vAddr, const CNetAddr& source, int64_t nTimePenalty)
         EXCLUSIVE_LOCKS_REQUIRED(!cs);
 
@@ -175,11 +233,8 @@ private:
     //! @note Don't increment this. Increment `lowest_compatible` in `Serialize()` instead.
     static constexpr uint8_t INCOMPATIBILITY_BASE = 32;
 
-    //! last used nId
-    int nIdCount GUARDED_BY(cs){0};
-
     //! table with information about all nIds
-    std::unordered_map<int, AddrInfo> mapInfo GUARDED_BY(cs);
+    AddrInfoTable m_infos GUARDED_BY(cs);
 
     //! find an nId based on its network address and port.
     std::unordered_map<CService, int, CServiceHash> mapAddr GUARDED_BY(cs);
@@ -195,12 +250,18 @@ private:
     //! list of "tried" buckets
     int vvTried[ADDRMAN_TRIED_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE] GUARDED_BY(cs);
 
+    //! occupied positions of each "tried" bucket, one bit per position
+    uint64_t m_tried_occupied[ADDRMAN_TRIED_BUCKET_COUNT] GUARDED_BY(cs){};
+
     //! number of (unique) "new" entries
     int nNew GUARDED_BY(cs){0};
 
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE] GUARDED_BY(cs);
 
+    //! occupied positions of each "new" bucket, one bit per position
+    uint64_t m_new_occupied[ADDRMAN_NEW_BUCKET_COUNT] GUARDED_BY(cs){};
+
     //! last time Good was called (memory only). Initially set to 1 so that "never" is strictly worse.
     int64_t nLastGood GUARDED_BY(cs){1};
 
@@ -229,7 +290,7 @@ private:
     //! Find an entry.
     AddrInfo* Find(const CService& addr, int* pnId = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
-    //! Create a new entry and add it to the internal data structures mapInfo, mapAddr and vRandom.
+    //! Create a new entry and add it to the internal data structures m_infos, mapAddr and vRandom.
     AddrInfo* Create(const CAddress& addr, const CNetAddr& addrSource, int* pnId = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     //! Swap two elements in vRandom.
@@ -238,6 +299,12 @@ private:
     //! Delete an entry. It must not be in tried, and have refcount 0.
     void Delete(int nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    //! Store an id in a position of a "new" bucket, or clear it with -1, keeping m_new_occupied up to date.
+    void SetNew(int bucket, int pos, int id) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Store an id in a position of a "tried" bucket, or clear it with -1, keeping m_tried_occupied up to date.
+    void SetTried(int bucket, int pos, int id) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     //! Clear a position in a "new" table. This is the only place where entries are actually deleted.
     void ClearNew(int nUBucket, int nUBucketPos) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
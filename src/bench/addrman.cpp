@@ -5,6 +5,7 @@
 #include <addrman.h>
 #include <bench/bench.h>
 #include <random.h>
+#include <tinyformat.h>
 #include <util/check.h>
 #include <util/time.h>
 
@@ -91,6 +92,21 @@ static void AddrManSelect(benchmark::Bench& bench)
     });
 }
 
+/* Selection when the tables are almost empty, so that most buckets tried have nothing in them. */
+static void AddrManSelectFromAlmostEmpty(benchmark::Bench& bench)
+{
+    AddrMan addrman(/* asmap */ std::vector<bool>(), /* deterministic */ false, /* consistency_check_ratio */ 0);
+
+    CreateAddresses();
+    addrman.Add({g_addresses[0].begin(), g_addresses[0].begin() + 4}, g_sources[0]);
+    addrman.Good(g_addresses[0][0]);
+
+    bench.run([&] {
+        const auto& address = addrman.Select();
+        assert(address.first.GetPort() > 0);
+    });
+}
+
 static void AddrManGetAddr(benchmark::Bench& bench)
 {
     AddrMan addrman(/* asmap */ std::vector<bool>(), /* deterministic */ false, /* consistency_check_ratio */ 0);
@@ -129,7 +145,27 @@ static void AddrManAddThenGood(benchmark::Bench& bench)
     });
 }
 
+static void AddrManMemory(benchmark::Bench& bench)
+{
+    CreateAddresses();
+
+    {
+        AddrMan addrman{/* asmap */ std::vector<bool>(), /* deterministic */ false, /* consistency_check_ratio */ 0};
+        AddAddressesToAddrMan(addrman);
+        // The time taken is per address added; the memory used per address is reported in the name.
+        bench.name(strprintf("AddrManMemory (%u bytes per address)", addrman.DynamicMemoryUsage() / addrman.size()));
+        bench.batch(addrman.size()).unit("address");
+    }
+
+    bench.run([&] {
+        AddrMan addrman{/* asmap */ std::vector<bool>(), /* deterministic */ false, /* consistency_check_ratio */ 0};
+        AddAddressesToAddrMan(addrman);
+    });
+}
+
 BENCHMARK(AddrManAdd);
+BENCHMARK(AddrManMemory);
 BENCHMARK(AddrManSelect);
+BENCHMARK(AddrManSelectFromAlmostEmpty);
 BENCHMARK(AddrManGetAddr);
 BENCHMARK(AddrManAddThenGood);
@@ -0,0 +1,64 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <auxpow.h>
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <pow.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <validation.h>
+
+#include <cassert>
+#include <vector>
+
+//! As many headers as a peer sends in one headers message.
+static constexpr size_t HEADERS_PER_MESSAGE{2000};
+static constexpr size_t HEADERS_MESSAGES{20};
+
+/**
+ * Accept a chain of merge-mined headers the way header sync does, one full
+ * headers message per iteration. The chain is recorded up front, so every
+ * iteration extends the block index with headers it hasn't seen yet.
+ */
+static void ProcessAuxpowHeaders(benchmark::Bench& bench)
+{
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    ChainstateManager& chainman{*testing_setup->m_node.chainman};
+    const CChainParams& params{Params()};
+
+    FastRandomContext rng{/*fDeterministic=*/true};
+    std::vector<std::vector<CBlockHeader>> messages(HEADERS_MESSAGES);
+    CBlockHeader prev{params.GenesisBlock().GetBlockHeader()};
+    for (std::vector<CBlockHeader>& headers : messages) {
+        for (size_t i = 0; i < HEADERS_PER_MESSAGE; ++i) {
+            CBlockHeader header;
+            header.SetBaseVersion(4, params.GetConsensus().nAuxpowChainId);
+            header.hashPrevBlock = prev.GetHash();
+            header.hashMerkleRoot = rng.rand256();
+            header.nTime = prev.nTime + 1;
+            header.nBits = prev.nBits;
+            auto& parent = CAuxPow::initAuxPow(header);
+            while (!CheckProofOfWork(parent.GetHash(), header.nBits, params.GetConsensus())) {
+                ++parent.nNonce;
+            }
+            headers.push_back(header);
+            prev = header;
+        }
+    }
+
+    size_t next{0};
+    bench.epochs(HEADERS_MESSAGES).epochIterations(1).batch(HEADERS_PER_MESSAGE).unit("header").run([&] {
+        assert(next < messages.size());
+        BlockValidationState state;
+        const CBlockIndex* tip{nullptr};
+        bool accepted = chainman.ProcessNewBlockHeaders(messages[next], state, params, &tip);
+        assert(accepted);
+        assert(tip->GetBlockHash() == messages[next].back().GetHash());
+        ++next;
+    });
+}
+
+BENCHMARK(ProcessAuxpowHeaders);
@@ -0,0 +1,38 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/data.h>
+
+#include <node/blockstorage.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <version.h>
+
+// Serving a block without witness data to a peer, or through RPC, REST or
+// ZMQ with -rpcserialversion=0, starting from its serialization on disk.
+
+static void ReserializeBlockNoWitness(benchmark::Bench& bench)
+{
+    bench.unit("block").run([&] {
+        CBlock block;
+        CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
+        stream >> block;
+        CDataStream stripped(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+        stripped << block;
+        assert(stripped.size() == benchmark::data::block413567.size());
+    });
+}
+
+static void StripRawBlockWitnessTest(benchmark::Bench& bench)
+{
+    std::vector<uint8_t> stripped;
+    bench.unit("block").run([&] {
+        const bool ok{StripRawBlockWitness(benchmark::data::block413567, stripped)};
+        assert(ok && stripped.size() == benchmark::data::block413567.size());
+    });
+}
+
+BENCHMARK(ReserializeBlockNoWitness);
+BENCHMARK(StripRawBlockWitnessTest);
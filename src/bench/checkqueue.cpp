@@ -1,4 +1,4 @@
-// Copyright (c) 2015-2020 The Bitcoin Core developers
+// Copyright (c) 2015-2022 The Bitcoin Core developers
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
@@ -20,7 +20,9 @@ static const unsigned int QUEUE_BATCH_SIZE = 128;
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::Bench& bench)
+// A threads_num of -1 uses one worker per core besides the main thread.
+template <template <typename> class Queue>
+static void CheckQueueSpeedPrevectorJob(benchmark::Bench& bench, int threads_num)
 {
     // We shouldn't ever be running with the checkqueue on a single core machine.
     if (GetNumCores() <= 1) return;
@@ -41,10 +43,10 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::Bench& bench)
         }
         void swap(PrevectorJob& x){p.swap(x.p);};
     };
-    CCheckQueue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
+    Queue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
     // The main thread should be counted to prevent thread oversubscription, and
     // to decrease the variance of benchmark results.
-    queue.StartWorkerThreads(GetNumCores() - 1);
+    queue.StartWorkerThreads(threads_num < 0 ? GetNumCores() - 1 : threads_num);
 
     // create all the data once, then submit copies in the benchmark.
     FastRandomContext insecure_rand(true);
@@ -57,7 +59,7 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::Bench& bench)
 
     bench.minEpochIterations(10).batch(BATCH_SIZE * BATCHES).unit("job").run([&] {
         // Make insecure_rand here so that each iteration is identical.
-        CCheckQueueControl<PrevectorJob> control(&queue);
+        CCheckQueueControl<PrevectorJob, Queue<PrevectorJob>> control(&queue);
         for (auto vChecks : vBatches) {
             control.Add(vChecks);
         }
@@ -68,4 +70,23 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::Bench& bench)
     queue.StopWorkerThreads();
     ECC_Stop();
 }
+
+static void CCheckQueueSpeedPrevectorJob(benchmark::Bench& bench) { CheckQueueSpeedPrevectorJob<CCheckQueue>(bench, -1); }
+static void CWorkStealingCheckQueueSpeedPrevectorJob(benchmark::Bench& bench) { CheckQueueSpeedPrevectorJob<CWorkStealingCheckQueue>(bench, -1); }
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+BENCHMARK(CWorkStealingCheckQueueSpeedPrevectorJob);
+
+// Scaling curves over a fixed number of worker threads, independent of the
+// number of cores of the machine running the benchmark.
+#define CHECKQUEUE_SCALING_BENCH(threads) \
+    static void CCheckQueueScaling##threads(benchmark::Bench& bench) { CheckQueueSpeedPrevectorJob<CCheckQueue>(bench, threads); } \
+    static void CWorkStealingCheckQueueScaling##threads(benchmark::Bench& bench) { CheckQueueSpeedPrevectorJob<CWorkStealingCheckQueue>(bench, threads); } \
+    BENCHMARK(CCheckQueueScaling##threads); \
+    BENCHMARK(CWorkStealingCheckQueueScaling##threads);
+
+CHECKQUEUE_SCALING_BENCH(1)
+CHECKQUEUE_SCALING_BENCH(2)
+CHECKQUEUE_SCALING_BENCH(4)
+CHECKQUEUE_SCALING_BENCH(8)
+CHECKQUEUE_SCALING_BENCH(16)
+CHECKQUEUE_SCALING_BENCH(32)
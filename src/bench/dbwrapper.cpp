@@ -0,0 +1,79 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <dbwrapper.h>
+#include <random.h>
+#include <uint256.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+static constexpr size_t DB_BENCH_RECORDS{2000};
+
+/** Key and value shaped like a chainstate coin (txid, vout; compressed txout). */
+static std::pair<std::pair<uint8_t, uint256>, std::vector<unsigned char>> CoinRecord(FastRandomContext& rng)
+{
+    return {{'C', rng.rand256()}, rng.randbytes(40)};
+}
+
+/** Key and value shaped like a name entry holding a DOI JSON payload. */
+static std::pair<std::pair<uint8_t, std::string>, std::string> NameRecord(FastRandomContext& rng)
+{
+    const std::string hash{rng.rand256().GetHex()};
+    const std::string value{"{\"signature\":\"" + rng.rand256().GetHex() + rng.rand256().GetHex() +
+                            "\",\"from\":\"" + hash.substr(0, 34) +
+                            "\",\"doiSignature\":\"\",\"status\":\"pending\",\"meta\":{\"ver\":1,\"type\":\"email\"}}"};
+    return {{'n', "e/" + hash}, value};
+}
+
+template <typename MakeRecord>
+static void DBWriteRead(benchmark::Bench& bench, const DBOptions& options, MakeRecord make_record)
+{
+    FastRandomContext rng{/*fDeterministic=*/true};
+    std::vector<decltype(make_record(rng))> records;
+    for (size_t i = 0; i < DB_BENCH_RECORDS; ++i) records.push_back(make_record(rng));
+
+    // In-memory databases only use the path as a name, so nothing touches the disk.
+    const fs::path path{"dbwrapper_bench"};
+    bench.batch(DB_BENCH_RECORDS).unit("record").run([&] {
+        CDBWrapper db(path, 8 << 20, /*fMemory=*/true, /*fWipe=*/false, /*obfuscate=*/true, options);
+        CDBBatch batch(db);
+        for (const auto& [key, value] : records) batch.Write(key, value);
+        db.WriteBatch(batch);
+        db.CompactRange(records.front().first, records.back().first);
+
+        decltype(records.front().second) value;
+        for (const auto& record : records) {
+            bool found{db.Read(record.first, value)};
+            assert(found);
+        }
+    });
+}
+
+static DBOptions CompressedOptions()
+{
+    DBOptions options;
+    options.compression = true;
+    return options;
+}
+
+static void DBCoinsDefault(benchmark::Bench& bench) { DBWriteRead(bench, {}, CoinRecord); }
+static void DBCoinsCompressed(benchmark::Bench& bench) { DBWriteRead(bench, CompressedOptions(), CoinRecord); }
+static void DBNamesDefault(benchmark::Bench& bench) { DBWriteRead(bench, {}, NameRecord); }
+static void DBNamesCompressed(benchmark::Bench& bench) { DBWriteRead(bench, CompressedOptions(), NameRecord); }
+
+static void DBNamesLargeBlocks(benchmark::Bench& bench)
+{
+    DBOptions options{CompressedOptions()};
+    options.block_size = 64 << 10;
+    DBWriteRead(bench, options, NameRecord);
+}
+
+BENCHMARK(DBCoinsDefault);
+BENCHMARK(DBCoinsCompressed);
+BENCHMARK(DBNamesDefault);
+BENCHMARK(DBNamesCompressed);
+BENCHMARK(DBNamesLargeBlocks);
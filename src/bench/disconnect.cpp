@@ -0,0 +1,82 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <names/common.h>
+#include <names/main.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/names.h>
+#include <test/util/setup_common.h>
+#include <txdb.h>
+#include <undo.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr size_t NAME_BLOCKS{200};
+static constexpr size_t NAME_OPS_PER_BLOCK{100};
+static constexpr size_t NAME_COUNT{4000};
+
+/**
+ * Disconnect a run of blocks that only update names, as a deep reorg through
+ * DOI-heavy blocks would.  The undo data is built by applying synthetic name
+ * updates to an on-disk name database, and each iteration restores the
+ * names block by block, tip first, on a fresh cache.
+ */
+static void DisconnectNameBlocks(benchmark::Bench& bench, bool prefetch)
+{
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+
+    FastRandomContext rng{/*fDeterministic=*/true};
+    std::vector<valtype> names;
+    for (size_t i = 0; i < NAME_COUNT; ++i) {
+        const std::string name{"e/" + rng.rand256().GetHex()};
+        names.emplace_back(name.begin(), name.end());
+    }
+    const CScript addr = CScript() << OP_TRUE;
+
+    // A small database cache, so that restores actually have to read.
+    CCoinsViewDB db(testing_setup->m_path_root / "bench_names", 1 << 20, /*fMemory=*/false, /*fWipe=*/true);
+    std::vector<CBlockUndo> undos(NAME_BLOCKS);
+    for (size_t h = 0; h < NAME_BLOCKS; ++h) {
+        CCoinsViewCache cache(&db);
+        for (size_t i = 0; i < NAME_OPS_PER_BLOCK; ++i) {
+            const std::string value{"{\"signature\":\"" + rng.rand256().GetHex() + "\",\"status\":\"pending\"}"};
+            CMutableTransaction mtx;
+            mtx.SetDoichain();
+            mtx.vout.emplace_back(COIN, CNameScript::buildNameUpdate(addr, names[rng.randrange(names.size())], valtype(value.begin(), value.end())));
+            ApplyNameTransaction(CTransaction(mtx), h + 1, cache, undos[h]);
+        }
+        cache.SetBestBlock(rng.rand256());
+        bool flushed = cache.Flush();
+        assert(flushed);
+    }
+
+    bench.batch(NAME_BLOCKS).unit("block").run([&] {
+        // Run ahead of the restore like the disconnect readahead does.
+        std::thread prefetcher;
+        if (prefetch) {
+            prefetcher = std::thread([&] {
+                for (auto it = undos.rbegin(); it != undos.rend(); ++it) PrefetchNameUndo(*it, db);
+            });
+        }
+
+        CCoinsViewCache view(&db);
+        for (auto it = undos.rbegin(); it != undos.rend(); ++it) {
+            for (auto nameUndo = it->vnameundo.rbegin(); nameUndo != it->vnameundo.rend(); ++nameUndo) {
+                nameUndo->apply(view);
+            }
+        }
+        if (prefetcher.joinable()) prefetcher.join();
+    });
+}
+
+static void DisconnectNameBlocksCold(benchmark::Bench& bench) { DisconnectNameBlocks(bench, /*prefetch=*/false); }
+static void DisconnectNameBlocksPrefetch(benchmark::Bench& bench) { DisconnectNameBlocks(bench, /*prefetch=*/true); }
+
+BENCHMARK(DisconnectNameBlocksCold);
+BENCHMARK(DisconnectNameBlocksPrefetch);
@@ -4,9 +4,13 @@
 
 #include <bench/bench.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <test/util/setup_common.h>
 #include <txmempool.h>
 
+#include <utility>
+#include <vector>
+
 
 static void AddTx(const CTransactionRef& tx, const CAmount& nFee, CTxMemPool& pool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
 {
@@ -132,4 +136,41 @@ static void MempoolEviction(benchmark::Bench& bench)
     });
 }
 
+// Eviction from a mempool of many chains, as left by name updates and DOI
+// batches: each chain is one cluster, and every eviction takes the worst last
+// chunk of any of them.
+static void MempoolEvictionChains(benchmark::Bench& bench)
+{
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+
+    constexpr int CHAINS{400};
+    constexpr int CHAIN_LENGTH{25};
+    FastRandomContext det_rand{true};
+    std::vector<std::pair<CTransactionRef, CAmount>> txs;
+    for (int c = 0; c < CHAINS; ++c) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << c;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        for (int i = 0; i < CHAIN_LENGTH; ++i) {
+            txs.emplace_back(MakeTransactionRef(tx), 1000 + det_rand.randrange(10000));
+            tx.vin[0].prevout = COutPoint(txs.back().first->GetHash(), 0);
+            tx.vin[0].scriptSig = CScript() << OP_1;
+        }
+    }
+
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    bench.run([&]() NO_THREAD_SAFETY_ANALYSIS {
+        for (const auto& [tx, fee] : txs) {
+            AddTx(tx, fee, pool);
+        }
+        pool.TrimToSize(pool.DynamicMemoryUsage() / 2);
+        pool.TrimToSize(0);
+    });
+}
+
 BENCHMARK(MempoolEviction);
+BENCHMARK(MempoolEvictionChains);
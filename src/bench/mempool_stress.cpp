@@ -115,5 +115,23 @@ static void MempoolCheck(benchmark::Bench& bench)
     });
 }
 
+static void MempoolClusterLinearize(benchmark::Bench& bench)
+{
+    FastRandomContext det_rand{true};
+    const int childTxs = bench.complexityN() > 1 ? static_cast<int>(bench.complexityN()) : 2000;
+    const std::vector<CTransactionRef> ordered_coins = CreateOrderedCoins(det_rand, childTxs, /* min_ancestors */ 1);
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>(CBaseChainParams::MAIN);
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    for (auto& tx : ordered_coins) AddTx(tx, pool);
+
+    bench.run([&]() NO_THREAD_SAFETY_ANALYSIS {
+        // A fee change has the cluster of the transaction linearized again.
+        pool.PrioritiseTransaction(ordered_coins[det_rand.randrange(ordered_coins.size())]->GetHash(), 1);
+        assert(!pool.GetClusters().empty());
+    });
+}
+
 BENCHMARK(ComplexMemPool);
 BENCHMARK(MempoolCheck);
+BENCHMARK(MempoolClusterLinearize);
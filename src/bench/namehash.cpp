@@ -0,0 +1,112 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <hash.h>
+#include <index/namehash.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/names.h>
+#include <test/util/setup_common.h>
+#include <util/strencodings.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+static constexpr size_t NAME_COUNT{1000000};
+static constexpr size_t NAMES_PER_BLOCK{10000};
+static constexpr size_t HOT_NAMES{1000};
+static constexpr size_t BATCH_SIZE{100};
+
+namespace {
+
+/** Name-hash index that can be filled without a chain. */
+class BenchNameHashIndex : public NameHashIndex
+{
+public:
+    using NameHashIndex::NameHashIndex;
+
+    void AddBlock(const CBlock& block)
+    {
+        const auto data{PrepareBlock(block, nullptr)};
+        assert(WritePreparedBlock(*data, nullptr));
+    }
+};
+
+/** Build an in-memory index of NAME_COUNT names, and return their hashes. */
+std::unique_ptr<BenchNameHashIndex> BuildIndex(size_t preimage_cache_size, std::vector<uint256>& hashes)
+{
+    auto index{std::make_unique<BenchNameHashIndex>(64 << 20, /*memory=*/true, /*wipe=*/true, preimage_cache_size)};
+
+    const CScript addr{CScript() << OP_TRUE};
+    const valtype rand(20, 'x');
+    const valtype value{'v'};
+    hashes.clear();
+    for (size_t i = 0; i < NAME_COUNT; i += NAMES_PER_BLOCK) {
+        CMutableTransaction mtx;
+        mtx.SetDoichain();
+        for (size_t j = i; j < i + NAMES_PER_BLOCK; ++j) {
+            const std::string str{strprintf("d/name-%08u", j)};
+            const valtype name(str.begin(), str.end());
+            mtx.vout.emplace_back(COIN, CNameScript::buildNameFirstupdate(addr, name, value, rand));
+            hashes.push_back(Hash(name));
+        }
+        CBlock block;
+        block.vtx.push_back(MakeTransactionRef(std::move(mtx)));
+        index->AddBlock(block);
+    }
+    return index;
+}
+
+/**
+ * Look up names by hash, as a client that only ever reveals hashes does.
+ * With hot set, the lookups go to the same few names over and over.
+ */
+void NameHashLookup(benchmark::Bench& bench, size_t preimage_cache_size, bool hot_set)
+{
+    const auto testing_setup{MakeNoLogFileContext<const BasicTestingSetup>()};
+    std::vector<uint256> hashes;
+    const auto index{BuildIndex(preimage_cache_size, hashes)};
+
+    FastRandomContext rng{/*fDeterministic=*/true};
+    const size_t range{hot_set ? HOT_NAMES : NAME_COUNT};
+    valtype name;
+    bench.run([&] {
+        assert(index->FindNamePreimage(hashes[rng.randrange(range)], name));
+    });
+}
+
+void NameHashLookupBatch(benchmark::Bench& bench, bool hot_set)
+{
+    const auto testing_setup{MakeNoLogFileContext<const BasicTestingSetup>()};
+    std::vector<uint256> hashes;
+    const auto index{BuildIndex(DEFAULT_NAMEHASH_PREIMAGE_CACHE << 20, hashes)};
+
+    FastRandomContext rng{/*fDeterministic=*/true};
+    const size_t range{hot_set ? HOT_NAMES : NAME_COUNT};
+    std::vector<uint256> batch(BATCH_SIZE);
+    std::vector<std::optional<valtype>> names;
+    bench.batch(BATCH_SIZE).unit("name").run([&] {
+        for (auto& hash : batch) hash = hashes[rng.randrange(range)];
+        index->FindNamePreimages(batch, names);
+        assert(names.size() == BATCH_SIZE && names.back());
+    });
+}
+
+} // namespace
+
+static void NameHashLookupUncached(benchmark::Bench& bench) { NameHashLookup(bench, 0, /*hot_set=*/false); }
+static void NameHashLookupCachedRandom(benchmark::Bench& bench) { NameHashLookup(bench, DEFAULT_NAMEHASH_PREIMAGE_CACHE << 20, /*hot_set=*/false); }
+static void NameHashLookupCachedHot(benchmark::Bench& bench) { NameHashLookup(bench, DEFAULT_NAMEHASH_PREIMAGE_CACHE << 20, /*hot_set=*/true); }
+static void NameHashLookupBatchRandom(benchmark::Bench& bench) { NameHashLookupBatch(bench, /*hot_set=*/false); }
+static void NameHashLookupBatchHot(benchmark::Bench& bench) { NameHashLookupBatch(bench, /*hot_set=*/true); }
+
+BENCHMARK(NameHashLookupUncached);
+BENCHMARK(NameHashLookupCachedRandom);
+BENCHMARK(NameHashLookupCachedHot);
+BENCHMARK(NameHashLookupBatchRandom);
+BENCHMARK(NameHashLookupBatchHot);
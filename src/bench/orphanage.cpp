@@ -0,0 +1,71 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <net_processing.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/names.h>
+#include <test/util/setup_common.h>
+#include <tinyformat.h>
+#include <txorphanage.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+static constexpr int PEERS{16};
+static constexpr int ORPHANS_PER_PEER{200};
+static constexpr int CHILDREN_PER_PARENT{10};
+
+/**
+ * Flood the orphanage with DOI registrations whose parents we don't have, as
+ * peers racing ahead of a burst of name_doi transactions do, keeping it within
+ * the default limits after each one. Then accept the parents in one batch and
+ * disconnect the peers.
+ */
+static void OrphanageDoiFlood(benchmark::Bench& bench)
+{
+    const auto testing_setup{MakeNoLogFileContext<const BasicTestingSetup>()};
+    FastRandomContext det_rand{true};
+
+    const CScript addr{CScript() << OP_TRUE};
+    const valtype value(400, '{');
+    std::vector<CTransactionRef> parents;
+    std::vector<std::pair<CTransactionRef, NodeId>> orphans;
+    for (int i = 0; i < PEERS * ORPHANS_PER_PEER; ++i) {
+        if (i % CHILDREN_PER_PARENT == 0) {
+            CMutableTransaction parent;
+            parent.vin.emplace_back(COutPoint(det_rand.rand256(), 0));
+            parent.vout.resize(CHILDREN_PER_PARENT, CTxOut(COIN, addr));
+            parents.push_back(MakeTransactionRef(parent));
+        }
+        const std::string str{strprintf("e/doi-%08u", i)};
+        const valtype name(str.begin(), str.end());
+        CMutableTransaction child;
+        child.SetDoichain();
+        child.vin.emplace_back(COutPoint(parents.back()->GetHash(), i % CHILDREN_PER_PARENT));
+        child.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30);
+        child.vout.emplace_back(COIN / 100, CNameScript::buildNameDOI(addr, name, value));
+        orphans.emplace_back(MakeTransactionRef(child), i % PEERS);
+    }
+
+    TxOrphanage orphanage;
+    bench.run([&] {
+        LOCK(g_cs_orphans);
+        for (const auto& [tx, peer] : orphans) {
+            orphanage.AddTx(tx, peer);
+            orphanage.LimitOrphans(DEFAULT_MAX_ORPHAN_TRANSACTIONS, DEFAULT_MAX_ORPHAN_MEMORY * 1000000);
+        }
+        std::set<uint256> work_set;
+        orphanage.AddChildrenToWorkSet(parents, work_set);
+        assert(!work_set.empty());
+        for (NodeId peer = 0; peer < PEERS; ++peer) {
+            orphanage.EraseForPeer(peer);
+        }
+    });
+    assert(orphanage.Size() == 0);
+}
+
+BENCHMARK(OrphanageDoiFlood);
@@ -0,0 +1,148 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/data.h>
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <hash.h>
+#include <net.h>
+#include <primitives/block.h>
+#include <protocol.h>
+#include <streams.h>
+#include <util/system.h>
+#include <version.h>
+
+#include <array>
+
+namespace {
+struct CapturedMessage {
+    std::string type;
+    std::vector<uint8_t> payload;
+};
+
+/** Write messages the way -capturemessages records them. */
+std::vector<uint8_t> WriteCapture(const std::vector<CapturedMessage>& messages)
+{
+    std::vector<uint8_t> capture;
+    CVectorWriter writer{SER_DISK, CLIENT_VERSION, capture, 0};
+    int64_t time{1'600'000'000'000'000};
+    for (const CapturedMessage& msg : messages) {
+        char type[CMessageHeader::COMMAND_SIZE]{};
+        std::copy(msg.type.begin(), msg.type.end(), type);
+        writer << time++;
+        writer.write(type, sizeof(type));
+        writer << uint32_t(msg.payload.size());
+        writer.write((const char*)msg.payload.data(), msg.payload.size());
+    }
+    return capture;
+}
+
+/** Turn a capture back into the bytes a peer would have sent. */
+std::vector<uint8_t> CaptureToWire(const CChainParams& params, Span<const uint8_t> capture)
+{
+    std::vector<uint8_t> wire;
+    SpanReader reader{SER_DISK, CLIENT_VERSION, capture};
+    while (!reader.empty()) {
+        int64_t time;
+        char type[CMessageHeader::COMMAND_SIZE + 1]{};
+        uint32_t size;
+        reader >> time;
+        reader.read(type, CMessageHeader::COMMAND_SIZE);
+        reader >> size;
+        std::vector<uint8_t> payload(size);
+        reader.read((char*)payload.data(), payload.size());
+
+        CMessageHeader hdr{params.MessageStart(), type, size};
+        const uint256 hash{Hash(payload)};
+        memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+        CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, wire, wire.size(), hdr};
+        wire.insert(wire.end(), payload.begin(), payload.end());
+    }
+    return wire;
+}
+
+/** A capture with a block, a full headers message, and the transactions and invs around them. */
+std::vector<uint8_t> SampleCapture()
+{
+    CBlock block;
+    CDataStream{benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION} >> block;
+
+    std::vector<CapturedMessage> messages;
+    std::vector<CInv> invs;
+    for (size_t i = 0; i < 200 && i < block.vtx.size(); ++i) {
+        CapturedMessage tx{NetMsgType::TX, {}};
+        CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, tx.payload, 0, block.vtx[i]};
+        messages.push_back(std::move(tx));
+        invs.emplace_back(MSG_WTX, block.vtx[i]->GetWitnessHash());
+        if (invs.size() == 20) {
+            CapturedMessage inv{NetMsgType::INV, {}};
+            CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, inv.payload, 0, invs};
+            messages.push_back(std::move(inv));
+            invs.clear();
+        }
+    }
+    CapturedMessage headers{NetMsgType::HEADERS, {}};
+    CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, headers.payload, 0, std::vector<CBlockHeader>(2000, block.GetBlockHeader())};
+    messages.push_back(std::move(headers));
+    messages.push_back({NetMsgType::BLOCK, benchmark::data::block413567});
+    return WriteCapture(messages);
+}
+
+/** Receive the wire bytes the way the socket handler does, in reads of at most 64 KiB. */
+uint64_t Receive(const CChainParams& params, Span<const uint8_t> wire, std::shared_ptr<RecvBufferPool> pool)
+{
+    V1TransportDeserializer deserializer{params, /*node_id=*/0, SER_NETWORK, INIT_PROTO_VERSION, pool};
+    std::array<uint8_t, 0x10000> socket_buffer;
+    uint64_t bytes_copied{0};
+    while (!wire.empty()) {
+        Span<uint8_t> buffer{pool ? deserializer.GetDirectReadBuffer() : Span<uint8_t>{}};
+        if (buffer.empty()) buffer = socket_buffer;
+        // Stands in for recv(), which copies from the kernel either way.
+        const size_t read{std::min(buffer.size(), wire.size())};
+        std::copy_n(wire.begin(), read, buffer.begin());
+        wire = wire.subspan(read);
+
+        Span<const uint8_t> received{buffer.first(read)};
+        while (!received.empty()) {
+            const int handled{deserializer.Read(received)};
+            assert(handled >= 0);
+            if (deserializer.Complete()) {
+                bool reject{false};
+                const CNetMessage msg{deserializer.GetMessage(std::chrono::microseconds{0}, reject)};
+                assert(!reject);
+                bytes_copied += msg.m_bytes_copied;
+            }
+        }
+    }
+    return bytes_copied;
+}
+} // namespace
+
+static void P2PReceiveCopied(benchmark::Bench& bench)
+{
+    const auto params{CreateChainParams(ArgsManager{}, CBaseChainParams::MAIN)};
+    const std::vector<uint8_t> wire{CaptureToWire(*params, SampleCapture())};
+    bench.unit("capture").run([&] {
+        Receive(*params, wire, /*pool=*/nullptr);
+    });
+}
+
+static void P2PReceivePooled(benchmark::Bench& bench)
+{
+    const auto params{CreateChainParams(ArgsManager{}, CBaseChainParams::MAIN)};
+    const std::vector<uint8_t> wire{CaptureToWire(*params, SampleCapture())};
+    const auto pool{std::make_shared<RecvBufferPool>()};
+    const uint64_t copied_without_pool{Receive(*params, wire, nullptr)};
+    bench.unit("capture").run([&] {
+        const uint64_t copied{Receive(*params, wire, pool)};
+        assert(copied < copied_without_pool);
+    });
+    // Once warmed up, every message reuses a buffer.
+    assert(pool->GetStats().allocations < pool->GetStats().reuses);
+}
+
+BENCHMARK(P2PReceiveCopied);
+BENCHMARK(P2PReceivePooled);
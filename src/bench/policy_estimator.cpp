@@ -0,0 +1,69 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <policy/fees.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+/** A month of blocks at one every ten minutes */
+static constexpr int MONTH_BLOCKS{30 * 24 * 6};
+static constexpr int TXS_PER_BLOCK{200};
+
+/**
+ * Replay a month of blocks through the fee estimator: transactions enter the
+ * mempool at random feerates, and are mined the sooner the higher their fee,
+ * with a few leaving the mempool unconfirmed. A node estimates a fee after
+ * each block, as a wallet would.
+ */
+static void PolicyEstimatorReplayMonth(benchmark::Bench& bench)
+{
+    const auto testing_setup{MakeNoLogFileContext<const BasicTestingSetup>()};
+    FastRandomContext rng{/*fDeterministic=*/true};
+
+    std::vector<std::unique_ptr<CTxMemPoolEntry>> entries;
+    // Transactions entering the mempool before each block, and those mined in it
+    std::vector<std::vector<const CTxMemPoolEntry*>> added(MONTH_BLOCKS + 1);
+    std::vector<std::vector<const CTxMemPoolEntry*>> mined(MONTH_BLOCKS + 1);
+    std::vector<std::vector<const CTxMemPoolEntry*>> evicted(MONTH_BLOCKS + 1);
+    LockPoints lp;
+    for (int height = 1; height <= MONTH_BLOCKS; ++height) {
+        for (int i = 0; i < TXS_PER_BLOCK; ++i) {
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout.n = entries.size();
+            tx.vout.resize(1);
+            tx.vout[0].scriptPubKey = CScript() << OP_1;
+            const CAmount fee = 200 + rng.randrange(50000);
+            entries.push_back(std::make_unique<CTxMemPoolEntry>(MakeTransactionRef(tx), fee, /*time=*/0, /*entry_height=*/height - 1, /*spends_coinbase=*/false, /*sigops_cost=*/4, lp));
+            added[height].push_back(entries.back().get());
+
+            const int confirm_height = height + rng.randrange(std::max<CAmount>(1, 100000 / fee));
+            if (confirm_height > MONTH_BLOCKS) continue;
+            (rng.randrange(50) ? mined : evicted)[confirm_height].push_back(entries.back().get());
+        }
+    }
+
+    bench.epochs(1).epochIterations(1).run([&] {
+        CBlockPolicyEstimator estimator;
+        FeeCalculation fee_calc;
+        for (int height = 1; height <= MONTH_BLOCKS; ++height) {
+            for (const CTxMemPoolEntry* entry : added[height]) {
+                estimator.processTransaction(*entry, /*validFeeEstimate=*/true);
+            }
+            for (const CTxMemPoolEntry* entry : evicted[height]) {
+                estimator.removeTx(entry->GetTx().GetHash(), /*inBlock=*/false);
+            }
+            estimator.processBlock(height, mined[height]);
+            estimator.estimateSmartFee(/*confTarget=*/6, &fee_calc, /*conservative=*/false);
+        }
+    });
+}
+
+BENCHMARK(PolicyEstimatorReplayMonth);
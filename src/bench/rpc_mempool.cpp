@@ -15,12 +15,10 @@ static void AddTx(const CTransactionRef& tx, const CAmount& fee, CTxMemPool& poo
     pool.addUnchecked(CTxMemPoolEntry(tx, fee, /*time=*/0, /*entry_height=*/1, /*spends_coinbase=*/false, /*sigops_cost=*/4, lp));
 }
 
-static void RpcMempool(benchmark::Bench& bench)
+static void FillPool(CTxMemPool& pool, int count)
 {
-    CTxMemPool pool;
     LOCK2(cs_main, pool.cs);
-
-    for (int i = 0; i < 1000; ++i) {
+    for (int i = 0; i < count; ++i) {
         CMutableTransaction tx = CMutableTransaction();
         tx.vin.resize(1);
         tx.vin[0].scriptSig = CScript() << OP_1;
@@ -31,10 +29,60 @@ static void RpcMempool(benchmark::Bench& bench)
         const CTransactionRef tx_r{MakeTransactionRef(tx)};
         AddTx(tx_r, /* fee */ i, pool);
     }
+}
+
+static void RpcMempool(benchmark::Bench& bench)
+{
+    CTxMemPool pool;
+    FillPool(pool, 1000);
+
+    bench.run([&] {
+        (void)MempoolToJSON(pool, /*verbose*/ true);
+    });
+}
+
+/** A verbose dump of a large mempool, as getrawmempool and the REST interface do. */
+static void RpcMempoolLarge(benchmark::Bench& bench)
+{
+    CTxMemPool pool;
+    FillPool(pool, 100000);
 
     bench.run([&] {
         (void)MempoolToJSON(pool, /*verbose*/ true);
     });
 }
 
+/**
+ * Take a snapshot of a large mempool that just changed. This is all the work
+ * done under the mempool lock for a dump; the JSON is built without it.
+ */
+static void MempoolSnapshotLarge(benchmark::Bench& bench)
+{
+    CTxMemPool pool;
+    FillPool(pool, 100000);
+    const uint256 txid{pool.GetSnapshot()->entries.front().tx->GetHash()};
+
+    bench.run([&] {
+        // Any change invalidates the previous snapshot.
+        pool.PrioritiseTransaction(txid, 0);
+        (void)pool.GetSnapshot();
+    });
+}
+
+/** A txid-only dump of a large mempool that changed since the last snapshot. */
+static void RpcMempoolTxidsLarge(benchmark::Bench& bench)
+{
+    CTxMemPool pool;
+    FillPool(pool, 100000);
+    const uint256 txid{pool.GetSnapshot()->entries.front().tx->GetHash()};
+
+    bench.run([&] {
+        pool.PrioritiseTransaction(txid, 0);
+        (void)MempoolToJSON(pool, /*verbose*/ false);
+    });
+}
+
 BENCHMARK(RpcMempool);
+BENCHMARK(RpcMempoolLarge);
+BENCHMARK(MempoolSnapshotLarge);
+BENCHMARK(RpcMempoolTxidsLarge);
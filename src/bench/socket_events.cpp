@@ -0,0 +1,156 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <compat.h>
+#include <random.h>
+#include <util/sock.h>
+#include <util/system.h>
+
+#ifdef USE_EPOLL
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/** Size of a message header, the smallest message a peer sends. */
+static constexpr size_t MESSAGE_SIZE{24};
+
+/**
+ * Connected socket pairs standing in for loopback peers. The node reads from
+ * `ours`, the benchmark writes one message at a time to `theirs`.
+ */
+class SimulatedPeers
+{
+public:
+    explicit SimulatedPeers(size_t count)
+    {
+        // Two descriptors per peer, plus some headroom.
+        if (RaiseFileDescriptorLimit(2 * count + 64) < int(2 * count + 64)) return;
+        for (size_t i = 0; i < count; ++i) {
+            int s[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, s) != 0) return;
+            ours.emplace_back(s[0]);
+            theirs.emplace_back(s[1]);
+        }
+        ok = true;
+    }
+
+    std::vector<Sock> ours;
+    std::vector<Sock> theirs;
+    bool ok{false};
+};
+
+/** Read a message that is known to be there. */
+static void ReadMessage(const Sock& sock)
+{
+    std::array<uint8_t, 0x10000> buf;
+    const ssize_t n{sock.Recv(buf.data(), buf.size(), MSG_DONTWAIT)};
+    assert(n == MESSAGE_SIZE);
+}
+
+/**
+ * One message arrives from a random peer per iteration; measure what it costs
+ * to find and read it, with all peers waiting for input like in CConnman.
+ */
+template <typename Handler>
+static void SocketEventsPerMessage(benchmark::Bench& bench, size_t peers, Handler handler)
+{
+    SimulatedPeers sim{peers};
+    if (!sim.ok) return;
+
+    FastRandomContext rng{/*fDeterministic=*/true};
+    const std::array<uint8_t, MESSAGE_SIZE> msg{};
+    bench.unit("message").run([&] {
+        const size_t sender = rng.randrange(peers);
+        const ssize_t n{sim.theirs[sender].Send(msg.data(), msg.size(), 0)};
+        assert(n == MESSAGE_SIZE);
+        const size_t found{handler(sim)};
+        assert(found == 1);
+    });
+}
+
+/** The poll() backend: rebuild the socket set and scan every peer each round. */
+static void SocketEventsPoll(benchmark::Bench& bench, size_t peers)
+{
+    SocketEventsPerMessage(bench, peers, [](const SimulatedPeers& sim) {
+        std::set<SOCKET> recv_select_set;
+        for (const Sock& sock : sim.ours) recv_select_set.insert(sock.Get());
+
+        std::unordered_map<SOCKET, pollfd> pollfds;
+        for (SOCKET socket_id : recv_select_set) {
+            pollfds[socket_id].fd = socket_id;
+            pollfds[socket_id].events |= POLLIN;
+        }
+        std::vector<pollfd> vpollfds;
+        vpollfds.reserve(pollfds.size());
+        for (const auto& it : pollfds) vpollfds.push_back(it.second);
+        int ret = poll(vpollfds.data(), vpollfds.size(), 50);
+        assert(ret > 0);
+
+        std::set<SOCKET> recv_set;
+        for (const pollfd& entry : vpollfds) {
+            if (entry.revents & POLLIN) recv_set.insert(entry.fd);
+        }
+        size_t found{0};
+        for (const Sock& sock : sim.ours) {
+            if (recv_set.count(sock.Get()) > 0) {
+                ReadMessage(sock);
+                ++found;
+            }
+        }
+        return found;
+    });
+}
+
+/** The epoll backend: registrations persist, only ready peers are touched. */
+static void SocketEventsEpoll(benchmark::Bench& bench, size_t peers)
+{
+    EpollEvents epoll;
+    assert(epoll.IsValid());
+    std::vector<EpollEvents::Event> events;
+    bool registered{false};
+    SocketEventsPerMessage(bench, peers, [&](const SimulatedPeers& sim) {
+        if (!registered) {
+            for (size_t i = 0; i < sim.ours.size(); ++i) {
+                bool added = epoll.Add(sim.ours[i].Get(), i, Sock::RECV | Sock::SEND, /*edge_triggered=*/true);
+                assert(added);
+            }
+            registered = true;
+        }
+        size_t found{0};
+        while (found == 0) {
+            bool waited = epoll.Wait(std::chrono::milliseconds{50}, events);
+            assert(waited);
+            for (const EpollEvents::Event& event : events) {
+                if (!event.recv) continue;
+                ReadMessage(sim.ours[event.tag]);
+                ++found;
+            }
+        }
+        return found;
+    });
+}
+
+static void SocketEventsPoll100(benchmark::Bench& bench) { SocketEventsPoll(bench, 100); }
+static void SocketEventsPoll500(benchmark::Bench& bench) { SocketEventsPoll(bench, 500); }
+static void SocketEventsPoll1000(benchmark::Bench& bench) { SocketEventsPoll(bench, 1000); }
+static void SocketEventsEpoll100(benchmark::Bench& bench) { SocketEventsEpoll(bench, 100); }
+static void SocketEventsEpoll500(benchmark::Bench& bench) { SocketEventsEpoll(bench, 500); }
+static void SocketEventsEpoll1000(benchmark::Bench& bench) { SocketEventsEpoll(bench, 1000); }
+
+BENCHMARK(SocketEventsPoll100);
+BENCHMARK(SocketEventsPoll500);
+BENCHMARK(SocketEventsPoll1000);
+BENCHMARK(SocketEventsEpoll100);
+BENCHMARK(SocketEventsEpoll500);
+BENCHMARK(SocketEventsEpoll1000);
+
+#endif // USE_EPOLL
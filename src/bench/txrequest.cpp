@@ -0,0 +1,63 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <random.h>
+#include <txrequest.h>
+#include <uint256.h>
+
+#include <cassert>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+/** Number of peers announcing every transaction, the first few of them through preferred connections. */
+static constexpr int NUM_PEERS{100};
+static constexpr int NUM_PREFERRED_PEERS{8};
+/** Number of transactions announced per round. */
+static constexpr int NUM_TXS{250};
+
+/**
+ * Replays what a well-connected node sees when transactions propagate: each
+ * transaction is announced by all peers, one of them is asked for it, and once
+ * it arrives all the announcements for it are dropped.
+ */
+static void TxRequestHighFanout(benchmark::Bench& bench)
+{
+    FastRandomContext rng{/*fDeterministic=*/true};
+    std::vector<uint256> txhashes;
+    for (int i = 0; i < NUM_TXS; ++i) txhashes.push_back(rng.rand256());
+
+    TxRequestTracker tracker{/*deterministic=*/true};
+    std::chrono::microseconds now{1s};
+
+    bench.batch(NUM_PEERS * NUM_TXS).unit("announcement").run([&] {
+        for (const uint256& txhash : txhashes) {
+            for (NodeId peer = 0; peer < NUM_PEERS; ++peer) {
+                const bool preferred{peer < NUM_PREFERRED_PEERS};
+                tracker.ReceivedInv(peer, GenTxid::Wtxid(txhash), preferred, preferred ? now : now + 2s);
+            }
+            now += 1ms;
+        }
+        now += 2s;
+
+        std::vector<std::pair<NodeId, uint256>> requested;
+        for (NodeId peer = 0; peer < NUM_PEERS; ++peer) {
+            for (const GenTxid& gtxid : tracker.GetRequestable(peer, now)) {
+                tracker.RequestedTx(peer, gtxid.GetHash(), now + 60s);
+                requested.emplace_back(peer, gtxid.GetHash());
+            }
+        }
+        assert(requested.size() == NUM_TXS);
+        for (const auto& [peer, txhash] : requested) {
+            tracker.ReceivedResponse(peer, txhash);
+            tracker.ForgetTxHash(txhash);
+        }
+        assert(tracker.Size() == 0);
+    });
+}
+
+BENCHMARK(TxRequestHighFanout);
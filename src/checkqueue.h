@@ -11,11 +11,12 @@
 #include <util/threadnames.h>
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
-template <typename T>
-class CCheckQueueControl;
-
 /**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -139,8 +140,8 @@ public:
     {
     }
 
-    //! Create a pool of new worker threads.
-    void StartWorkerThreads(const int threads_num)
+    //! Create a pool of new worker threads, named after the given prefix.
+    void StartWorkerThreads(const int threads_num, const std::string& thread_name = "scriptch")
     {
         {
             LOCK(m_mutex);
@@ -150,8 +151,8 @@ public:
         }
         assert(m_worker_threads.empty());
         for (int n = 0; n < threads_num; ++n) {
-            m_worker_threads.emplace_back([this, n]() {
-                util::ThreadRename(strprintf("scriptch.%i", n));
+            m_worker_threads.emplace_back([this, n, thread_name]() {
+                util::ThreadRename(strprintf("%s.%i", thread_name, n));
                 SetSyscallSandboxPolicy(SyscallSandboxPolicy::VALIDATION_SCRIPT_CHECK);
                 Loop(false /* worker thread */);
             });
@@ -207,21 +208,257 @@ public:
 };
 
 /**
- * RAII-style controller object for a CCheckQueue that guarantees the passed
- * queue is finished before continuing.
+ * Variant of CCheckQueue that distributes the verifications over per-thread
+ * queues instead of one shared one.
+ *
+ * Add() spreads each batch over the worker queues, and every thread (the
+ * master included, once it waits) takes work from its own queue and steals
+ * from the others when that runs dry.  Batches shrink as the remaining work
+ * does, so that all threads finish at about the same time.  Progress is
+ * tracked with atomics; the per-queue locks are only contended when stealing.
+ * Threads that run out of work spin for a little while before parking, which
+ * avoids a sleep/wakeup round trip between the many small batches of a block.
  */
 template <typename T>
+class CWorkStealingCheckQueue
+{
+private:
+    //! Number of rounds an idle thread polls for work before parking, if
+    //! there is a core for every thread
+    static constexpr int SPIN_ROUNDS{2048};
+    //! Rounds after which a spinning thread starts yielding its time slice
+    static constexpr int SPIN_YIELD_AFTER{64};
+
+    struct alignas(64) Slot {
+        Mutex m_mutex;
+        std::vector<T> m_checks GUARDED_BY(m_mutex);
+    };
+
+    //! Per-thread queues; slot 0 belongs to the master, slot n + 1 to worker n
+    std::vector<std::unique_ptr<Slot>> m_slots;
+
+    //! Verifications added but not taken from a slot yet
+    std::atomic<size_t> m_queued{0};
+
+    //! Verifications that haven't completed (and been destroyed) yet
+    std::atomic<size_t> m_todo{0};
+
+    //! The temporary evaluation result
+    std::atomic<bool> m_all_ok{true};
+
+    std::atomic<bool> m_request_stop{false};
+
+    //! Threads park on these when out of work (see Park())
+    Mutex m_park_mutex;
+    std::condition_variable m_worker_cv;
+    std::condition_variable m_master_cv;
+    std::atomic<int> m_parked{0};
+
+    //! The maximum number of elements to be processed in one batch
+    const unsigned int nBatchSize;
+
+    //! Slot the next Add() starts filling (only used by the master)
+    size_t m_next_slot{0};
+
+    //! Spin rounds before parking (0 if the threads outnumber the cores)
+    int m_spin_rounds{0};
+
+    std::vector<std::thread> m_worker_threads;
+
+    /**
+     * Take a batch of verifications, from slot `self` if possible and stolen
+     * from the other slots otherwise (at most half of what a slot holds).
+     */
+    bool Take(size_t self, std::vector<T>& batch)
+    {
+        const size_t queued{m_queued.load()};
+        if (queued == 0) return false;
+        const size_t want{std::max<size_t>(1, std::min<size_t>(nBatchSize, queued / (2 * m_slots.size())))};
+        for (size_t i = 0; i < m_slots.size(); ++i) {
+            Slot& slot = *m_slots[(self + i) % m_slots.size()];
+            LOCK(slot.m_mutex);
+            if (slot.m_checks.empty()) continue;
+            const size_t available{i == 0 ? slot.m_checks.size() : (slot.m_checks.size() + 1) / 2};
+            const size_t count{std::min(want, available)};
+            for (size_t n = 0; n < count; ++n) {
+                batch.emplace_back();
+                batch.back().swap(slot.m_checks.back());
+                slot.m_checks.pop_back();
+            }
+            m_queued -= count;
+            return true;
+        }
+        return false;
+    }
+
+    /** Wake up to `count` parked threads after the state they wait for has changed. */
+    void Notify(std::condition_variable& cv, size_t count)
+    {
+        const size_t parked = m_parked.load();
+        if (parked == 0) return;
+        // Synchronize with a thread that is about to park, so it either sees
+        // the new state or gets the notification.
+        { LOCK(m_park_mutex); }
+        if (count >= parked) {
+            cv.notify_all();
+        } else {
+            while (count--) cv.notify_one();
+        }
+    }
+
+    /** Spin, then park on cv, until ready() or a stop is requested. */
+    template <typename Ready>
+    void Park(std::condition_variable& cv, Ready ready)
+    {
+        for (int spin = 0; spin < m_spin_rounds; ++spin) {
+            if (ready() || m_request_stop.load(std::memory_order_relaxed)) return;
+            if (spin >= SPIN_YIELD_AFTER) std::this_thread::yield();
+        }
+        WAIT_LOCK(m_park_mutex, lock);
+        ++m_parked;
+        cv.wait(lock, [&] { return ready() || m_request_stop.load(); });
+        --m_parked;
+    }
+
+    /** Run a batch and account for it; returns whether it drained m_todo. */
+    bool Run(std::vector<T>& batch)
+    {
+        bool ok{m_all_ok.load(std::memory_order_relaxed)};
+        for (T& check : batch) {
+            if (ok) ok = check();
+        }
+        if (!ok) m_all_ok.store(false, std::memory_order_relaxed);
+        const size_t count{batch.size()};
+        // Destroy the checks before reporting them done.
+        batch.clear();
+        return m_todo.fetch_sub(count) == count;
+    }
+
+    void WorkerLoop(size_t self)
+    {
+        std::vector<T> batch;
+        batch.reserve(nBatchSize);
+        while (!m_request_stop.load(std::memory_order_relaxed)) {
+            if (Take(self, batch)) {
+                if (Run(batch)) Notify(m_master_cv, 1);
+            } else {
+                Park(m_worker_cv, [this] { return m_queued.load() > 0; });
+            }
+        }
+    }
+
+public:
+    //! Mutex to ensure only one concurrent CCheckQueueControl
+    Mutex m_control_mutex;
+
+    //! Create a new check queue
+    explicit CWorkStealingCheckQueue(unsigned int nBatchSizeIn)
+        : nBatchSize(nBatchSizeIn)
+    {
+        m_slots.push_back(std::make_unique<Slot>());
+    }
+
+    //! Create a pool of new worker threads, named after the given prefix.
+    void StartWorkerThreads(const int threads_num, const std::string& thread_name = "scriptch")
+    {
+        assert(m_worker_threads.empty() && m_todo == 0);
+        m_all_ok = true;
+        m_slots.clear();
+        for (int n = 0; n < threads_num + 1; ++n) {
+            m_slots.push_back(std::make_unique<Slot>());
+        }
+        m_next_slot = 0;
+        m_spin_rounds = int(std::thread::hardware_concurrency()) > threads_num ? SPIN_ROUNDS : 0;
+        for (int n = 0; n < threads_num; ++n) {
+            m_worker_threads.emplace_back([this, n, thread_name]() {
+                util::ThreadRename(strprintf("%s.%i", thread_name, n));
+                SetSyscallSandboxPolicy(SyscallSandboxPolicy::VALIDATION_SCRIPT_CHECK);
+                WorkerLoop(n + 1);
+            });
+        }
+    }
+
+    //! Wait until execution finishes, and return whether all evaluations were successful.
+    bool Wait()
+    {
+        std::vector<T> batch;
+        batch.reserve(nBatchSize);
+        while (m_todo.load() > 0) {
+            if (m_request_stop.load(std::memory_order_relaxed)) return false;
+            if (Take(0, batch)) {
+                Run(batch);
+            } else {
+                Park(m_master_cv, [this] { return m_todo.load() == 0 || m_queued.load() > 0; });
+            }
+        }
+        // reset the status for new work later
+        return m_all_ok.exchange(true);
+    }
+
+    //! Add a batch of checks to the queue
+    void Add(std::vector<T>& vChecks)
+    {
+        if (vChecks.empty()) {
+            return;
+        }
+
+        m_todo += vChecks.size();
+        // Count the checks as queued before they are, so that a thread taking
+        // them early can't make the counter wrap around.
+        m_queued += vChecks.size();
+        // Spread the batch over the worker slots (the master's own slot only
+        // gets work if there are no workers).
+        const size_t first{m_slots.size() > 1 ? 1U : 0U};
+        const size_t slots{m_slots.size() - first};
+        const size_t chunk{std::max<size_t>(1, (vChecks.size() + slots - 1) / slots)};
+        for (size_t begin = 0; begin < vChecks.size(); begin += chunk) {
+            Slot& slot = *m_slots[first + m_next_slot++ % slots];
+            LOCK(slot.m_mutex);
+            for (size_t i = begin; i < std::min(begin + chunk, vChecks.size()); ++i) {
+                slot.m_checks.emplace_back();
+                vChecks[i].swap(slot.m_checks.back());
+            }
+        }
+
+        Notify(m_worker_cv, vChecks.size());
+    }
+
+    //! Stop all of the worker threads.
+    void StopWorkerThreads()
+    {
+        m_request_stop = true;
+        { LOCK(m_park_mutex); }
+        m_worker_cv.notify_all();
+        m_master_cv.notify_all();
+        for (std::thread& t : m_worker_threads) {
+            t.join();
+        }
+        m_worker_threads.clear();
+        m_request_stop = false;
+    }
+
+    ~CWorkStealingCheckQueue()
+    {
+        assert(m_worker_threads.empty());
+    }
+};
+
+/**
+ * RAII-style controller object for a CCheckQueue (or CWorkStealingCheckQueue)
+ * that guarantees the passed queue is finished before continuing.
+ */
+template <typename T, typename Queue = CCheckQueue<T>>
 class CCheckQueueControl
 {
 private:
-    CCheckQueue<T> * const pqueue;
+    Queue * const pqueue;
     bool fDone;
 
 public:
     CCheckQueueControl() = delete;
     CCheckQueueControl(const CCheckQueueControl&) = delete;
     CCheckQueueControl& operator=(const CCheckQueueControl&) = delete;
-    explicit CCheckQueueControl(CCheckQueue<T> * const pqueueIn) : pqueue(pqueueIn), fDone(false)
+    explicit CCheckQueueControl(Queue * const pqueueIn) : pqueue(pqueueIn), fDone(false)
     {
         // passed queue is supposed to be unused, or nullptr
         if (pqueue != nullptr) {
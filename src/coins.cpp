@@ -14,7 +14,6 @@ bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return f
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
 bool CCoinsView::GetName(const valtype &name, CNameData &data) const { return false; }
-bool CCoinsView::GetNameHistory(const valtype &name, CNameHistory &data) const { return false; }
 bool CCoinsView::GetNamesForHeight(unsigned nHeight, std::set<valtype>& names) const { return false; }
 CNameIterator* CCoinsView::IterateNames() const { assert (false); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) { return false; }
@@ -33,7 +32,6 @@ bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 bool CCoinsViewBacked::GetName(const valtype &name, CNameData &data) const { return base->GetName(name, data); }
-bool CCoinsViewBacked::GetNameHistory(const valtype &name, CNameHistory &data) const { return base->GetNameHistory(name, data); }
 bool CCoinsViewBacked::GetNamesForHeight(unsigned nHeight, std::set<valtype>& names) const { return base->GetNamesForHeight(nHeight, names); }
 CNameIterator* CCoinsViewBacked::IterateNames() const { return base->IterateNames(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
@@ -198,16 +196,6 @@ bool CCoinsViewCache::GetName(const valtype &name, CNameData& data) const {
     return base->GetName(name, data);
 }
 
-bool CCoinsViewCache::GetNameHistory(const valtype &name, CNameHistory& data) const {
-    if (cacheNames.getHistory(name, data))
-        return true;
-
-    /* Note: This does not attempt to cache backend queries.  The cache
-       only keeps track of changes!  */
-
-    return base->GetNameHistory(name, data);
-}
-
 bool CCoinsViewCache::GetNamesForHeight(unsigned nHeight, std::set<valtype>& names) const {
     /* Query the base view first, and then apply the cached changes (if
        there are any).  */
@@ -225,38 +213,12 @@ CNameIterator* CCoinsViewCache::IterateNames() const {
 
 /* undo is set if the change is due to disconnecting blocks / going back in
    time.  The ordinary case (!undo) means that we update the name normally,
-   going forward in time.  This is important for keeping track of the
-   name history.  */
+   going forward in time.  When undoing, the name must already exist.  */
 void CCoinsViewCache::SetName(const valtype &name, const CNameData& data, bool undo) {
     CNameData oldData;
     if (GetName(name, oldData))
-    {
         cacheNames.removeExpireIndex(name, oldData.getHeight());
-
-        /* Update the name history.  If we are undoing, we expect that
-           the top history item matches the data being set now.  If we
-           are not undoing, push the overwritten data onto the history stack.
-           Note that we only have to do this if the name already existed
-           in the database.  Otherwise, no special action is required
-           for the name history.  */
-        if (fNameHistory)
-        {
-            CNameHistory history;
-            if (!GetNameHistory(name, history))
-            {
-                /* Ensure that the history stack is indeed (still) empty
-                   and was not modified by the failing GetNameHistory call.  */
-                assert(history.empty());
-            }
-
-            if (undo)
-                history.pop(data);
-            else
-                history.push(oldData);
-
-            cacheNames.setHistory(name, history);
-        }
-    } else
+    else
         assert (!undo);
 
     cacheNames.set(name, data);
@@ -270,13 +232,6 @@ void CCoinsViewCache::DeleteName(const valtype &name) {
     else
         assert(false);
 
-    if (fNameHistory)
-    {
-        /* When deleting a name, the history should already be clean.  */
-        CNameHistory history;
-        assert (!GetNameHistory(name, history) || history.empty());
-    }
-
     cacheNames.remove(name);
 }
 
@@ -181,8 +181,6 @@ public:
     // Get a name (if it exists)
     virtual bool GetName(const valtype& name, CNameData& data) const;
 
-    // Get a name's history (if it exists)
-    virtual bool GetNameHistory(const valtype& name, CNameHistory& data) const;
 
     // Query for names that were updated at the given height
     virtual bool GetNamesForHeight(unsigned nHeight, std::set<valtype>& names) const;
@@ -221,7 +219,6 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool GetName(const valtype& name, CNameData& data) const override;
-    bool GetNameHistory(const valtype& name, CNameHistory& data) const override;
     bool GetNamesForHeight(unsigned nHeight, std::set<valtype>& names) const override;
     CNameIterator* IterateNames() const override;
     void SetBackend(CCoinsView &viewIn);
@@ -264,7 +261,6 @@ public:
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
     bool GetName(const valtype &name, CNameData &data) const override;
-    bool GetNameHistory(const valtype &name, CNameHistory &data) const override;
     bool GetNamesForHeight(unsigned nHeight, std::set<valtype>& names) const override;
     CNameIterator* IterateNames() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) override;
@@ -2,10 +2,16 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <dbwrapper.h>
 
 #include <memory>
 #include <random.h>
+#include <tinyformat.h>
+#include <util/string.h>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -97,13 +103,125 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+#ifdef USE_SNAPPY
+static constexpr bool HAVE_SNAPPY_SUPPORT{true};
+#else
+static constexpr bool HAVE_SNAPPY_SUPPORT{false};
+#endif
+
+static constexpr uint32_t MIN_DB_BLOCK_SIZE{1024};
+static constexpr uint32_t MAX_DB_BLOCK_SIZE{4 << 20};
+static constexpr uint32_t MAX_DB_BLOOM_BITS{64};
+static constexpr uint64_t MIN_DB_WRITE_BUFFER_SIZE{64 << 10};
+
+bool DBOptions::IsDefault() const
+{
+    return *this == DBOptions{};
+}
+
+std::string DBOptions::ToString() const
+{
+    return strprintf("compression=%d, blocksize=%u, bloombits=%u, writebuffer=%u",
+                     compression, block_size, bloom_bits, write_buffer_size);
+}
+
+const std::vector<std::string>& DBTuningNames()
+{
+    static const std::vector<std::string> names{
+        "chainstate", "blockindex", "txindex", "namehash", "namehistory", "blockfilter", "coinstats", "addressindex"};
+    return names;
+}
+
+static bool ApplyDBTuningSetting(const std::string& setting, DBOptions& options, std::string& error)
+{
+    const auto eq = setting.find('=');
+    const std::string key = setting.substr(0, eq);
+    std::optional<uint64_t> value;
+    if (eq != std::string::npos) value = ToIntegral<uint64_t>(setting.substr(eq + 1));
+    if (!value) {
+        error = strprintf("expected <option>=<number>, got \"%s\"", setting);
+        return false;
+    }
+
+    if (key == "compression") {
+        if (*value > 1) {
+            error = "compression must be 0 or 1";
+            return false;
+        }
+        if (*value && !HAVE_SNAPPY_SUPPORT) {
+            error = "compression requires a build with snappy support (--with-snappy)";
+            return false;
+        }
+        options.compression = *value;
+    } else if (key == "blocksize") {
+        if (*value < MIN_DB_BLOCK_SIZE || *value > MAX_DB_BLOCK_SIZE) {
+            error = strprintf("blocksize must be between %u and %u", MIN_DB_BLOCK_SIZE, MAX_DB_BLOCK_SIZE);
+            return false;
+        }
+        options.block_size = *value;
+    } else if (key == "bloombits") {
+        if (*value > MAX_DB_BLOOM_BITS) {
+            error = strprintf("bloombits must be at most %u", MAX_DB_BLOOM_BITS);
+            return false;
+        }
+        options.bloom_bits = *value;
+    } else if (key == "writebuffer") {
+        if (*value != 0 && *value < MIN_DB_WRITE_BUFFER_SIZE) {
+            error = strprintf("writebuffer must be 0 or at least %u", MIN_DB_WRITE_BUFFER_SIZE);
+            return false;
+        }
+        options.write_buffer_size = *value;
+    } else {
+        error = strprintf("unknown option \"%s\"", key);
+        return false;
+    }
+    return true;
+}
+
+bool ApplyDBTuning(const ArgsManager& args, const std::string& db_name, DBOptions& options, std::string& error)
+{
+    std::vector<std::string> general, specific;
+    for (const std::string& arg : args.GetArgs("-dbtuning")) {
+        const auto colon = arg.find(':');
+        if (colon == std::string::npos) {
+            general.push_back(arg);
+            continue;
+        }
+        const std::string name = arg.substr(0, colon);
+        if (std::find(DBTuningNames().begin(), DBTuningNames().end(), name) == DBTuningNames().end()) {
+            error = strprintf("unknown database \"%s\" (expected one of %s)", name, Join(DBTuningNames(), ", "));
+            return false;
+        }
+        if (name == db_name) specific.push_back(arg.substr(colon + 1));
+    }
+    for (const auto* settings : {&general, &specific}) {
+        for (const std::string& setting : *settings) {
+            if (!ApplyDBTuningSetting(setting, options, error)) return false;
+        }
+    }
+    return true;
+}
+
+DBOptions DBOptionsFromArgs(const std::string& db_name)
+{
+    DBOptions options;
+    std::string error;
+    if (!ApplyDBTuning(gArgs, db_name, options, error)) {
+        LogPrintf("Ignoring invalid -dbtuning for %s: %s\n", db_name, error);
+        return DBOptions{};
+    }
+    return options;
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const DBOptions& db_options)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    // up to two write buffers may be held in memory simultaneously
+    options.write_buffer_size = db_options.write_buffer_size ? db_options.write_buffer_size : nCacheSize / 4;
+    options.block_size = db_options.block_size;
+    options.filter_policy = db_options.bloom_bits ? leveldb::NewBloomFilterPolicy(db_options.bloom_bits) : nullptr;
+    options.compression = db_options.compression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -114,15 +232,19 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
-    : m_name{fs::PathToString(path.stem())}
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const DBOptions& db_options)
+    : m_name{fs::PathToString(path.stem())}, m_db_options{db_options}
 {
     penv = nullptr;
+    if (m_db_options.compression && !HAVE_SNAPPY_SUPPORT) {
+        LogPrintf("Snappy support not compiled in, not compressing %s\n", fs::PathToString(path));
+        m_db_options.compression = false;
+    }
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, m_db_options);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -168,6 +290,40 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", fs::PathToString(path), HexStr(obfuscate_key));
+
+    CheckDBOptions(path);
+}
+
+void CDBWrapper::CheckDBOptions(const fs::path& path)
+{
+    // Databases without a record were written with the default options.
+    const DBOptions recorded{dbwrapper_private::GetRecordedDBOptions(*this)};
+
+    if (recorded.compression && !HAVE_SNAPPY_SUPPORT) {
+        throw dbwrapper_error(strprintf("Database %s contains snappy-compressed data, but this build lacks snappy support",
+                                        fs::PathToString(path)));
+    }
+
+    // Once written, compressed tables may linger until they are compacted
+    // away, so keep remembering that the database may contain them.
+    DBOptions to_record{m_db_options};
+    to_record.compression |= recorded.compression;
+
+    if (recorded != to_record) {
+        // LevelDB records compression, block size and filter policy per table,
+        // so existing tables stay readable and only pick up the new settings
+        // when they are rewritten by compaction (see -forcecompactdb).
+        LogPrintf("LevelDB options for %s changed from (%s) to (%s); existing tables keep their settings until compacted\n",
+                  fs::PathToString(path), recorded.ToString(), m_db_options.ToString());
+        if (to_record.IsDefault()) {
+            Erase(DB_OPTIONS_KEY);
+        } else {
+            Write(DB_OPTIONS_KEY, to_record);
+        }
+    }
+    if (!m_db_options.IsDefault()) {
+        LogPrintf("Using LevelDB options for %s: %s\n", fs::PathToString(path), m_db_options.ToString());
+    }
 }
 
 CDBWrapper::~CDBWrapper()
@@ -220,6 +376,10 @@ const std::string CDBWrapper::OBFUSCATE_KEY_KEY("\000obfuscate_key", 14);
 
 const unsigned int CDBWrapper::OBFUSCATE_KEY_NUM_BYTES = 8;
 
+// Only written when the options differ from the defaults, so that databases
+// opened with default options are byte-for-byte unchanged.
+const std::string CDBWrapper::DB_OPTIONS_KEY("\000db_options", 11);
+
 /**
  * Returns a string (consisting of 8 random bytes) suitable for use as an
  * obfuscating XOR key.
@@ -260,4 +420,11 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w)
     return w.obfuscate_key;
 }
 
+DBOptions GetRecordedDBOptions(const CDBWrapper &w)
+{
+    DBOptions recorded;
+    w.Read(CDBWrapper::DB_OPTIONS_KEY, recorded);
+    return recorded;
+}
+
 } // namespace dbwrapper_private
@@ -25,8 +25,52 @@ public:
     explicit dbwrapper_error(const std::string& msg) : std::runtime_error(msg) {}
 };
 
+class ArgsManager;
 class CDBWrapper;
 
+/**
+ * LevelDB tuning knobs that can be set per database (see -dbtuning). Settings
+ * that differ from the defaults are recorded in the database itself, so that
+ * a later open with different settings can be detected.
+ */
+struct DBOptions {
+    //! Compress table blocks with snappy (requires a build with snappy support)
+    bool compression{false};
+    //! Approximate amount of uncompressed user data per table block, in bytes
+    uint32_t block_size{4096};
+    //! Bits per key of the bloom filter attached to each table (0 disables it)
+    uint32_t bloom_bits{10};
+    //! Size of the in-memory write buffer in bytes (0 uses a quarter of the cache size)
+    uint64_t write_buffer_size{0};
+
+    SERIALIZE_METHODS(DBOptions, obj) { READWRITE(obj.compression, obj.block_size, obj.bloom_bits, obj.write_buffer_size); }
+
+    bool IsDefault() const;
+    std::string ToString() const;
+
+    friend bool operator==(const DBOptions& a, const DBOptions& b)
+    {
+        return a.compression == b.compression && a.block_size == b.block_size &&
+               a.bloom_bits == b.bloom_bits && a.write_buffer_size == b.write_buffer_size;
+    }
+    friend bool operator!=(const DBOptions& a, const DBOptions& b) { return !(a == b); }
+};
+
+/** Names of the databases that can be tuned with -dbtuning. */
+const std::vector<std::string>& DBTuningNames();
+
+/**
+ * Apply the -dbtuning settings that concern the database @p db_name on top of
+ * @p options. Unprefixed settings apply to every database and are applied
+ * first, so that "<db>:" prefixed ones override them.
+ *
+ * @returns false and sets @p error if one of the settings is malformed.
+ */
+bool ApplyDBTuning(const ArgsManager& args, const std::string& db_name, DBOptions& options, std::string& error);
+
+/** Return the options for @p db_name from gArgs (validated during init). */
+DBOptions DBOptionsFromArgs(const std::string& db_name);
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -41,6 +85,10 @@ void HandleError(const leveldb::Status& status);
  */
 const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
+/** Read the DBOptions recorded in the database (defaults if there is no record).
+ */
+DBOptions GetRecordedDBOptions(const CDBWrapper &w);
+
 };
 
 /** Batch of changes queued to be written to a CDBWrapper */
@@ -187,11 +235,17 @@ public:
         return piter->value().size();
     }
 
+    /** The value as stored (still obfuscated); only valid until the iterator moves. */
+    Span<const unsigned char> GetRawValue() const {
+        return MakeUCharSpan(piter->value());
+    }
+
 };
 
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend DBOptions dbwrapper_private::GetRecordedDBOptions(const CDBWrapper &w);
 private:
     //! custom environment this database is using (may be nullptr in case of default environment)
     leveldb::Env* penv;
@@ -226,8 +280,17 @@ private:
     //! the length of the obfuscate key in number of bytes
     static const unsigned int OBFUSCATE_KEY_NUM_BYTES;
 
+    //! the key under which non-default DBOptions are recorded
+    static const std::string DB_OPTIONS_KEY;
+
+    //! tuning this database was opened with
+    DBOptions m_db_options;
+
     std::vector<unsigned char> CreateObfuscateKey() const;
 
+    //! compare the requested tuning with the recorded one and update the record
+    void CheckDBOptions(const fs::path& path);
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
@@ -236,8 +299,10 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] db_options  LevelDB tuning (compression, block size, bloom filter, write buffer).
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false,
+               const DBOptions& db_options = {});
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper&) = delete;
@@ -309,6 +374,8 @@ public:
     // Get an estimate of LevelDB memory usage (in bytes).
     size_t DynamicMemoryUsage() const;
 
+    const DBOptions& GetDBOptions() const { return m_db_options; }
+
     CDBIterator *NewIterator()
     {
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
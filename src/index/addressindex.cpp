@@ -0,0 +1,260 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/addressindex.h>
+
+#include <chainparams.h>
+#include <crypto/sha256.h>
+#include <node/blockstorage.h>
+#include <script/names.h>
+#include <serialize.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+constexpr uint8_t DB_ADDRESS{'a'};
+
+std::unique_ptr<AddressIndex> g_address_index;
+
+namespace {
+
+/**
+ * Entries are ordered by script, then height, so that the history of a
+ * script over a range of heights is one sequential scan.
+ */
+struct DBKey {
+    uint256 script_hash;
+    int height{0};
+    uint256 txid;
+    bool spending{false};
+    uint32_t index{0};
+
+    DBKey() = default;
+    DBKey(const uint256& script_hash_in, int height_in, const uint256& txid_in = uint256(), bool spending_in = false, uint32_t index_in = 0)
+        : script_hash{script_hash_in}, height{height_in}, txid{txid_in}, spending{spending_in}, index{index_in} {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDRESS);
+        s << script_hash;
+        ser_writedata32be(s, height);
+        s << txid;
+        ser_writedata8(s, spending);
+        ser_writedata32be(s, index);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        const uint8_t prefix{ser_readdata8(s)};
+        if (prefix != DB_ADDRESS) {
+            throw std::ios_base::failure("Invalid format for addressindex DB key");
+        }
+        s >> script_hash;
+        height = ser_readdata32be(s);
+        s >> txid;
+        spending = ser_readdata8(s);
+        index = ser_readdata32be(s);
+    }
+};
+
+struct DBValue {
+    CAmount amount{0};
+    COutPoint prevout;
+    valtype name;
+
+    SERIALIZE_METHODS(DBValue, obj) { READWRITE(obj.amount, obj.prevout, obj.name); }
+};
+
+/** Hash a script for the index, and extract the name it updates, if any. */
+uint256 ParseScript(const CScript& script, valtype* name = nullptr)
+{
+    const CNameScript name_op(script);
+    const CScript& address{name_op.isNameOp() ? name_op.getAddress() : script};
+    if (name && name_op.isNameOp() && name_op.isAnyUpdate()) {
+        *name = name_op.getOpName();
+    }
+    uint256 hash;
+    CSHA256().Write(address.data(), address.size()).Finalize(hash.begin());
+    return hash;
+}
+
+/** Call fn with the key and value of every index entry of a block. */
+template <typename Fn>
+bool ForEachEntry(const CBlock& block, const CBlockUndo& block_undo, int height, Fn&& fn)
+{
+    if (block_undo.vtxundo.size() + 1 != block.vtx.size()) return false;
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx{*block.vtx[i]};
+        for (uint32_t n = 0; n < tx.vout.size(); ++n) {
+            const CTxOut& out{tx.vout[n]};
+            if (out.scriptPubKey.IsUnspendable()) continue;
+            DBValue value;
+            value.amount = out.nValue;
+            const uint256 script_hash{ParseScript(out.scriptPubKey, &value.name)};
+            fn(DBKey{script_hash, height, tx.GetHash(), /*spending=*/false, n}, value);
+        }
+        if (i == 0) continue;
+
+        const CTxUndo& tx_undo{block_undo.vtxundo[i - 1]};
+        if (tx_undo.vprevout.size() != tx.vin.size()) return false;
+        for (uint32_t n = 0; n < tx.vin.size(); ++n) {
+            const CTxOut& spent{tx_undo.vprevout[n].out};
+            DBValue value;
+            value.amount = spent.nValue;
+            value.prevout = tx.vin[n].prevout;
+            const uint256 script_hash{ParseScript(spent.scriptPubKey, &value.name)};
+            fn(DBKey{script_hash, height, tx.GetHash(), /*spending=*/true, n}, value);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+/** Access to the address index database (indexes/addressindex/) */
+class AddressIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(gArgs.GetDataDirNet() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe,
+                  /*f_obfuscate=*/false, DBOptionsFromArgs("addressindex"))
+{}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(std::make_unique<AddressIndex::DB>(n_cache_size, f_memory, f_wipe)), m_batch(*m_db)
+{}
+
+AddressIndex::~AddressIndex() {}
+
+uint256 AddressIndex::GetScriptHash(const CScript& script)
+{
+    return ParseScript(script);
+}
+
+bool AddressIndex::FlushBatch()
+{
+    if (m_batch.SizeEstimate() == 0) return true;
+    if (!m_db->WriteBatch(m_batch)) return false;
+    m_batch.Clear();
+    return true;
+}
+
+namespace {
+struct AddressEntries : public BaseIndex::BlockData {
+    //! Whether the undo data of the block could be read and matched the block
+    bool undo_ok{false};
+    std::vector<std::pair<DBKey, DBValue>> entries;
+};
+} // namespace
+
+std::unique_ptr<BaseIndex::BlockData> AddressIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const
+{
+    auto data{std::make_unique<AddressEntries>()};
+    // Exclude genesis block transactions because outputs are not spendable.
+    if (pindex->nHeight == 0) {
+        data->undo_ok = true;
+        return data;
+    }
+
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        return data;
+    }
+    data->undo_ok = ForEachEntry(block, block_undo, pindex->nHeight, [&](const DBKey& key, const DBValue& value) {
+        data->entries.emplace_back(key, value);
+    });
+    if (!data->undo_ok) {
+        error("%s: Undo data of block %s does not match the block", __func__, pindex->GetBlockHash().ToString());
+    }
+    return data;
+}
+
+bool AddressIndex::WritePreparedBlock(const BlockData& data, const CBlockIndex* pindex)
+{
+    const AddressEntries& prepared{static_cast<const AddressEntries&>(data)};
+    if (!prepared.undo_ok) return false;
+
+    LOCK(m_batch_mutex);
+    for (const auto& [key, value] : prepared.entries) {
+        m_batch.Write(key, value);
+    }
+    // Once in sync, make each block visible to lookups right away.
+    if (IsSynced() || m_batch.SizeEstimate() >= ADDRESS_INDEX_BATCH_SIZE) {
+        return FlushBatch();
+    }
+    return true;
+}
+
+bool AddressIndex::CommitInternal(CDBBatch& batch)
+{
+    // The entries must be on disk before the locator that covers them.
+    {
+        LOCK(m_batch_mutex);
+        if (!FlushBatch()) return false;
+    }
+    return BaseIndex::CommitInternal(batch);
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    {
+        LOCK(m_batch_mutex);
+        if (!FlushBatch()) return false;
+    }
+
+    CDBBatch batch(*m_db);
+    const auto& consensus_params{Params().GetConsensus()};
+    for (const CBlockIndex* pindex{current_tip}; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        CBlockUndo block_undo;
+        if (!ReadBlockFromDisk(block, pindex, consensus_params) || !UndoReadFromDisk(block_undo, pindex)) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!ForEachEntry(block, block_undo, pindex->nHeight, [&](const DBKey& key, const DBValue&) { batch.Erase(key); })) {
+            return error("%s: Undo data of block %s does not match the block", __func__, pindex->GetBlockHash().ToString());
+        }
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::FindScriptHistory(const CScript& script, int start_height, int end_height, size_t limit,
+                                     std::vector<AddressIndexEntry>& entries) const
+{
+    // The limit is checked against the last entry found, so there has to be one.
+    if (limit == 0) return error("%s: limit must be positive", __func__);
+
+    const uint256 script_hash{GetScriptHash(script)};
+    std::unique_ptr<CDBIterator> it{m_db->NewIterator()};
+    const size_t old_size{entries.size()};
+    for (it->Seek(DBKey{script_hash, std::max(start_height, 0)}); it->Valid(); it->Next()) {
+        DBKey key;
+        if (!it->GetKey(key) || key.script_hash != script_hash || key.height > end_height) break;
+        if (entries.size() - old_size >= limit && key.height != entries.back().height) break;
+        DBValue value;
+        if (!it->GetValue(value)) {
+            return error("%s: Cannot read entry of script %s", __func__, script_hash.ToString());
+        }
+        AddressIndexEntry& entry{entries.emplace_back()};
+        entry.height = key.height;
+        entry.txid = key.txid;
+        entry.index = key.index;
+        entry.spending = key.spending;
+        entry.amount = value.amount;
+        entry.prevout = value.prevout;
+        entry.name = std::move(value.name);
+    }
+    return true;
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include <consensus/amount.h>
+#include <dbwrapper.h>
+#include <index/base.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <memory>
+#include <vector>
+
+static constexpr bool DEFAULT_ADDRESSINDEX{false};
+
+/** Maximum size of the DB cache for the address index, in MiB. */
+static constexpr int64_t MAX_ADDRESS_INDEX_CACHE{1024};
+
+/**
+ * Size of the index entries buffered while the index catches up with the
+ * chain, before they are written to the database in one batch.
+ */
+static constexpr size_t ADDRESS_INDEX_BATCH_SIZE{16 << 20};
+
+/** One output paid to, or one input spending from, an indexed script. */
+struct AddressIndexEntry {
+    int height{0};
+    uint256 txid;
+    //! Output index for funding entries, input index for spending entries
+    uint32_t index{0};
+    bool spending{false};
+    CAmount amount{0};
+    //! The spent output, for spending entries
+    COutPoint prevout;
+    //! The name, if the output is a name update (including first updates)
+    valtype name;
+};
+
+/**
+ * AddressIndex maps scripts to the outputs paying to them and the inputs
+ * spending those outputs, ordered by block height.
+ *
+ * Scripts are keyed by their SHA256 hash, with the name prefix of name
+ * operations stripped, so that the history of an address includes the names
+ * it holds. Spent outputs are looked up in the block undo data.
+ *
+ * While catching up with the chain, entries are collected in one database
+ * batch of at most ADDRESS_INDEX_BATCH_SIZE bytes instead of being written
+ * block by block. Once in sync, every block is written as it is connected.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    Mutex m_batch_mutex;
+    //! Entries of the blocks not written to the database yet
+    CDBBatch m_batch GUARDED_BY(m_batch_mutex);
+
+    [[nodiscard]] bool FlushBatch() EXCLUSIVE_LOCKS_REQUIRED(m_batch_mutex);
+
+protected:
+    std::unique_ptr<BlockData> PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const override;
+
+    bool WritePreparedBlock(const BlockData& data, const CBlockIndex* pindex) override;
+
+    bool CommitInternal(CDBBatch& batch) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddressIndex() override;
+
+    /// The key a script is indexed under.
+    static uint256 GetScriptHash(const CScript& script);
+
+    /// Look up the history of a script between two block heights (inclusive),
+    /// in height order. Heights are never returned partially, so the lookup
+    /// stops after the height at which the limit is reached, and a caller can
+    /// resume from the next one.
+    ///
+    /// @param[in]   script  The script, with or without a name prefix.
+    /// @param[in]   start_height  The first height to look up.
+    /// @param[in]   end_height  The last height to look up.
+    /// @param[in]   limit  The number of entries after which to stop; must be positive.
+    /// @param[out]  entries  The entries found.
+    /// @return  false if the limit is zero or the database could not be read
+    bool FindScriptHistory(const CScript& script, int start_height, int end_height, size_t limit,
+                           std::vector<AddressIndexEntry>& entries) const;
+};
+
+/// The global address index. May be null.
+extern std::unique_ptr<AddressIndex> g_address_index;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
@@ -7,17 +7,27 @@
 #include <node/blockstorage.h>
 #include <node/ui_interface.h>
 #include <shutdown.h>
+#include <sync.h>
 #include <tinyformat.h>
 #include <util/syscall_sandbox.h>
 #include <util/thread.h>
+#include <util/threadnames.h>
+#include <util/time.h>
 #include <util/translation.h>
 #include <validation.h> // For g_chainman
 #include <warnings.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
 constexpr uint8_t DB_BEST_BLOCK{'B'};
 
 constexpr int64_t SYNC_LOG_INTERVAL = 30; // seconds
 constexpr int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+//! Blocks queued for the sync thread per thread reading them
+constexpr size_t SYNC_QUEUE_BLOCKS_PER_THREAD{4};
 
 template <typename... Args>
 static void FatalError(const char* fmt, const Args&... args)
@@ -29,8 +39,9 @@ static void FatalError(const char* fmt, const Args&... args)
     StartShutdown();
 }
 
-BaseIndex::DB::DB(const fs::path& path, size_t n_cache_size, bool f_memory, bool f_wipe, bool f_obfuscate) :
-    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate)
+BaseIndex::DB::DB(const fs::path& path, size_t n_cache_size, bool f_memory, bool f_wipe, bool f_obfuscate,
+                  const DBOptions& db_options) :
+    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate, db_options)
 {}
 
 bool BaseIndex::DB::ReadBestBlock(CBlockLocator& locator) const
@@ -106,6 +117,122 @@ bool BaseIndex::Init()
     return true;
 }
 
+/**
+ * The blocks the sync thread is about to write, in chain order. Worker
+ * threads read them from disk and prepare them, in the order they were
+ * queued. When the sync thread needs a block no worker has picked up yet,
+ * it reads and prepares it itself, so that this also works without workers.
+ */
+class BaseIndex::SyncQueue
+{
+public:
+    struct Job {
+        const CBlockIndex* const pindex;
+        //! The block, unless it was prepared
+        std::unique_ptr<CBlock> block;
+        std::unique_ptr<BlockData> data;
+        bool read_ok{false};
+        bool done{false};
+
+        explicit Job(const CBlockIndex* pindex_in) : pindex{pindex_in} {}
+    };
+
+private:
+    const BaseIndex& m_index;
+    const Consensus::Params& m_consensus_params;
+
+    Mutex m_mutex;
+    //! Signalled when jobs are queued, or on shutdown
+    std::condition_variable m_work_cv;
+    //! Signalled when a job is done
+    std::condition_variable m_done_cv;
+    std::deque<std::shared_ptr<Job>> m_jobs GUARDED_BY(m_mutex);
+    //! Number of jobs at the front of m_jobs picked up by a thread
+    size_t m_claimed GUARDED_BY(m_mutex){0};
+    bool m_stop GUARDED_BY(m_mutex){false};
+
+    std::vector<std::thread> m_workers;
+
+    void Run(Job& job) const
+    {
+        job.block = std::make_unique<CBlock>();
+        job.read_ok = ReadBlockFromDisk(*job.block, job.pindex, m_consensus_params);
+        if (!job.read_ok) return;
+        job.data = m_index.PrepareBlock(*job.block, job.pindex);
+        if (job.data) job.block.reset();
+    }
+
+    void Loop()
+    {
+        SetSyscallSandboxPolicy(SyscallSandboxPolicy::TX_INDEX);
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            m_work_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || m_claimed < m_jobs.size(); });
+            if (m_stop) return;
+            const std::shared_ptr<Job> job{m_jobs[m_claimed++]};
+            {
+                REVERSE_LOCK(lock);
+                Run(*job);
+            }
+            job->done = true;
+            m_done_cv.notify_all();
+        }
+    }
+
+public:
+    SyncQueue(const BaseIndex& index, int worker_threads)
+        : m_index{index}, m_consensus_params{Params().GetConsensus()}
+    {
+        for (int i = 0; i < worker_threads; ++i) {
+            m_workers.emplace_back([this, name = strprintf("%s.%i", index.GetName(), i)]() {
+                util::ThreadRename(std::string{name});
+                Loop();
+            });
+        }
+    }
+
+    ~SyncQueue()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_work_cv.notify_all();
+        for (std::thread& worker : m_workers) worker.join();
+    }
+
+    size_t Size() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) { return WITH_LOCK(m_mutex, return m_jobs.size()); }
+
+    const CBlockIndex* Back() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        return m_jobs.empty() ? nullptr : m_jobs.back()->pindex;
+    }
+
+    void Push(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        WITH_LOCK(m_mutex, m_jobs.push_back(std::make_shared<Job>(pindex)));
+        m_work_cv.notify_one();
+    }
+
+    /** Remove the first queued block, once it has been read and prepared. */
+    std::shared_ptr<Job> Pop() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        assert(!m_jobs.empty());
+        const std::shared_ptr<Job> job{m_jobs.front()};
+        if (m_claimed == 0) {
+            ++m_claimed;
+            {
+                REVERSE_LOCK(lock);
+                Run(*job);
+            }
+            job->done = true;
+        }
+        m_done_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return job->done; });
+        m_jobs.pop_front();
+        --m_claimed;
+        return job;
+    }
+};
+
 static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindex_prev, CChain& chain) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
@@ -127,7 +254,9 @@ void BaseIndex::ThreadSync()
     SetSyscallSandboxPolicy(SyscallSandboxPolicy::TX_INDEX);
     const CBlockIndex* pindex = m_best_block_index.load();
     if (!m_synced) {
-        auto& consensus_params = Params().GetConsensus();
+        m_sync_start_time = GetTimeMicros();
+        SyncQueue queue(*this, m_sync_worker_threads);
+        const size_t max_queued{SYNC_QUEUE_BLOCKS_PER_THREAD * (m_sync_worker_threads + 1)};
 
         int64_t last_log_time = 0;
         int64_t last_locator_write_time = 0;
@@ -143,22 +272,50 @@ void BaseIndex::ThreadSync()
 
             {
                 LOCK(cs_main);
-                const CBlockIndex* pindex_next = NextSyncBlock(pindex, m_chainstate->m_chain);
-                if (!pindex_next) {
+                // Keep the queue filled with the blocks following the last
+                // queued block, as long as they extend it.
+                while (queue.Size() < max_queued) {
+                    const CBlockIndex* pindex_last = queue.Size() > 0 ? queue.Back() : pindex;
+                    const CBlockIndex* pindex_next = NextSyncBlock(pindex_last, m_chainstate->m_chain);
+                    if (!pindex_next) break;
+                    if (pindex_next->pprev != pindex_last) {
+                        // The chain was reorganized. Write the queued blocks
+                        // first, then rewind.
+                        if (queue.Size() > 0) break;
+                        m_best_block_index = pindex;
+                        if (!Rewind(pindex, pindex_next->pprev)) {
+                            FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                                       __func__, GetName());
+                            return;
+                        }
+                        pindex = pindex_next->pprev;
+                    }
+                    queue.Push(pindex_next);
+                }
+                if (queue.Size() == 0) {
                     m_best_block_index = pindex;
+                    m_sync_end_time = GetTimeMicros();
                     m_synced = true;
                     // No need to handle errors in Commit. See rationale above.
                     Commit();
                     break;
                 }
-                if (pindex_next->pprev != pindex && !Rewind(pindex, pindex_next->pprev)) {
-                    FatalError("%s: Failed to rewind index %s to a previous chain tip",
-                               __func__, GetName());
-                    return;
-                }
-                pindex = pindex_next;
             }
 
+            const std::shared_ptr<SyncQueue::Job> job{queue.Pop()};
+            if (!job->read_ok) {
+                FatalError("%s: Failed to read block %s from disk",
+                           __func__, job->pindex->GetBlockHash().ToString());
+                return;
+            }
+            if (!(job->data ? WritePreparedBlock(*job->data, job->pindex) : WriteBlock(*job->block, job->pindex))) {
+                FatalError("%s: Failed to write block %s to index database",
+                           __func__, job->pindex->GetBlockHash().ToString());
+                return;
+            }
+            pindex = job->pindex;
+            ++m_sync_blocks;
+
             int64_t current_time = GetTime();
             if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
                 LogPrintf("Syncing %s with block chain from height %d\n",
@@ -172,18 +329,6 @@ void BaseIndex::ThreadSync()
                 // No need to handle errors in Commit. See rationale above.
                 Commit();
             }
-
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
-                FatalError("%s: Failed to read block %s from disk",
-                           __func__, pindex->GetBlockHash().ToString());
-                return;
-            }
-            if (!WriteBlock(block, pindex)) {
-                FatalError("%s: Failed to write block %s to index database",
-                           __func__, pindex->GetBlockHash().ToString());
-                return;
-            }
         }
     }
 
@@ -192,6 +337,10 @@ void BaseIndex::ThreadSync()
     } else {
         LogPrintf("%s is enabled\n", GetName());
     }
+    if (m_sync_blocks > 0) {
+        LogPrintf("%s indexed %d blocks at %.1f blocks/s using %d threads\n", GetName(), m_sync_blocks.load(),
+                  GetSummary().blocks_per_second, m_sync_worker_threads + 1);
+    }
 }
 
 bool BaseIndex::Commit()
@@ -210,6 +359,12 @@ bool BaseIndex::CommitInternal(CDBBatch& batch)
     return true;
 }
 
+bool BaseIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    const std::unique_ptr<BlockData> data{PrepareBlock(block, pindex)};
+    return !data || WritePreparedBlock(*data, pindex);
+}
+
 bool BaseIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
 {
     assert(current_tip == m_best_block_index);
@@ -340,9 +495,10 @@ void BaseIndex::Interrupt()
     m_interrupt();
 }
 
-bool BaseIndex::Start(CChainState& active_chainstate)
+bool BaseIndex::Start(CChainState& active_chainstate, int sync_worker_threads)
 {
     m_chainstate = &active_chainstate;
+    m_sync_worker_threads = std::clamp(sync_worker_threads, 0, MAX_INDEX_SYNC_THREADS - 1);
     // Need to register this ValidationInterface before running Init(), so that
     // callbacks are not missed if Init sets m_synced to true.
     RegisterValidationInterface(this);
@@ -369,5 +525,9 @@ IndexSummary BaseIndex::GetSummary() const
     summary.name = GetName();
     summary.synced = m_synced;
     summary.best_block_height = m_best_block_index ? m_best_block_index.load()->nHeight : 0;
+    const int64_t sync_time{(m_synced ? m_sync_end_time.load() : GetTimeMicros()) - m_sync_start_time};
+    if (m_sync_blocks > 0 && sync_time > 0) {
+        summary.blocks_per_second = m_sync_blocks * 1e6 / sync_time;
+    }
     return summary;
 }
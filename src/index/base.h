@@ -9,6 +9,9 @@
 #include <threadinterrupt.h>
 #include <validationinterface.h>
 
+#include <atomic>
+#include <memory>
+
 class CBlock;
 class CBlockIndex;
 class CChainState;
@@ -17,8 +20,15 @@ struct IndexSummary {
     std::string name;
     bool synced{false};
     int best_block_height{0};
+    //! Average number of blocks indexed per second by the initial sync
+    double blocks_per_second{0};
 };
 
+/** Maximum number of threads reading and preparing blocks for one index during its initial sync. */
+static constexpr int MAX_INDEX_SYNC_THREADS{16};
+/** -indexsyncthreads default (0 = auto) */
+static constexpr int DEFAULT_INDEX_SYNC_THREADS{0};
+
 /**
  * Base class for indices of blockchain data. This implements
  * CValidationInterface and ensures blocks are indexed sequentially according
@@ -38,7 +48,8 @@ protected:
     {
     public:
         DB(const fs::path& path, size_t n_cache_size,
-           bool f_memory = false, bool f_wipe = false, bool f_obfuscate = false);
+           bool f_memory = false, bool f_wipe = false, bool f_obfuscate = false,
+           const DBOptions& db_options = {});
 
         /// Read block locator of the chain that the txindex is in sync with.
         bool ReadBestBlock(CBlockLocator& locator) const;
@@ -47,7 +58,18 @@ protected:
         void WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator);
     };
 
+public:
+    /**
+     * The index data derived from a block by PrepareBlock, before it is
+     * written to the index by WritePreparedBlock.
+     */
+    struct BlockData {
+        virtual ~BlockData() = default;
+    };
+
 private:
+    class SyncQueue;
+
     /// Whether the index is in sync with the main chain. The flag is flipped
     /// from false to true once, after which point this starts processing
     /// ValidationInterface notifications to stay in sync.
@@ -59,11 +81,24 @@ private:
     std::thread m_thread_sync;
     CThreadInterrupt m_interrupt;
 
+    /// Number of threads reading and preparing blocks for the sync thread.
+    int m_sync_worker_threads{0};
+
+    /// When the sync thread started and caught up (in microseconds), and how
+    /// many blocks it indexed.
+    std::atomic<int64_t> m_sync_start_time{0};
+    std::atomic<int64_t> m_sync_end_time{0};
+    std::atomic<int64_t> m_sync_blocks{0};
+
     /// Sync the index with the block index starting from the current best block.
     /// Intended to be run in its own thread, m_thread_sync, and can be
     /// interrupted with m_interrupt. Once the index gets in sync, the m_synced
     /// flag is set and the BlockConnected ValidationInterface callback takes
     /// over and the sync thread exits.
+    ///
+    /// Blocks are read from disk and passed to PrepareBlock ahead of time by
+    /// m_sync_worker_threads threads, while this thread writes them to the
+    /// index in chain order.
     void ThreadSync();
 
     /// Write the current index state (eg. chain block locator and subclass-specific items) to disk.
@@ -84,11 +119,27 @@ protected:
 
     const CBlockIndex* CurrentIndex() { return m_best_block_index.load(); };
 
+    /// Whether the initial sync is over, and blocks are indexed as they are connected.
+    bool IsSynced() const { return m_synced; }
+
     /// Initialize internal state from the database and block index.
     [[nodiscard]] virtual bool Init();
 
-    /// Write update index entries for a newly connected block.
-    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
+    /// Write update index entries for a newly connected block. By default
+    /// this writes the data returned by PrepareBlock, if any.
+    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex);
+
+    /// Derive the index data of a block without writing it. Indexes that do
+    /// their per-block work here rather than in WriteBlock let the initial
+    /// sync run it on several threads, ahead of the writes. As such, this
+    /// must not depend on the state of the index, nor on blocks preceding
+    /// this one having been written. Returns nullptr if the index doesn't
+    /// prepare blocks, in which case WriteBlock gets the block instead.
+    virtual std::unique_ptr<BlockData> PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const { return nullptr; }
+
+    /// Write the data prepared for a block to the index. Blocks are written
+    /// in chain order, as with WriteBlock.
+    virtual bool WritePreparedBlock(const BlockData& data, const CBlockIndex* pindex) { return true; }
 
     /// Virtual method called internally by Commit that can be overridden to atomically
     /// commit more index state.
@@ -118,7 +169,9 @@ public:
 
     /// Start initializes the sync state and registers the instance as a
     /// ValidationInterface so that it stays in sync with blockchain updates.
-    [[nodiscard]] bool Start(CChainState& active_chainstate);
+    /// If the index has to catch up with the chain, sync_worker_threads
+    /// threads read and prepare blocks for the sync thread.
+    [[nodiscard]] bool Start(CChainState& active_chainstate, int sync_worker_threads = 0);
 
     /// Stops the instance from staying in sync with blockchain updates.
     void Stop();
@@ -102,7 +102,8 @@ BlockFilterIndex::BlockFilterIndex(BlockFilterType filter_type,
     fs::create_directories(path);
 
     m_name = filter_name + " block filter index";
-    m_db = std::make_unique<BaseIndex::DB>(path / "db", n_cache_size, f_memory, f_wipe);
+    m_db = std::make_unique<BaseIndex::DB>(path / "db", n_cache_size, f_memory, f_wipe,
+                                          /*f_obfuscate=*/false, DBOptionsFromArgs("blockfilter"));
     m_filter_fileseq = std::make_unique<FlatFileSeq>(std::move(path), "fltr", FLTR_FILE_CHUNK_SIZE);
 }
 
@@ -207,16 +208,34 @@ size_t BlockFilterIndex::WriteFilterToDisk(FlatFilePos& pos, const BlockFilter&
     return data_size;
 }
 
-bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+namespace {
+struct PreparedFilter : public BaseIndex::BlockData {
+    //! Whether the undo data of the block could be read
+    bool undo_ok{false};
+    BlockFilter filter;
+};
+} // namespace
+
+std::unique_ptr<BaseIndex::BlockData> BlockFilterIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const
 {
+    auto data{std::make_unique<PreparedFilter>()};
     CBlockUndo block_undo;
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+        return data;
+    }
+    data->undo_ok = true;
+    data->filter = BlockFilter(m_filter_type, block, block_undo);
+    return data;
+}
+
+bool BlockFilterIndex::WritePreparedBlock(const BlockData& data, const CBlockIndex* pindex)
+{
+    const PreparedFilter& prepared{static_cast<const PreparedFilter&>(data)};
+    if (!prepared.undo_ok) return false;
+
     uint256 prev_header;
 
     if (pindex->nHeight > 0) {
-        if (!UndoReadFromDisk(block_undo, pindex)) {
-            return false;
-        }
-
         std::pair<uint256, DBVal> read_out;
         if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
             return false;
@@ -231,15 +250,13 @@ bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex
         prev_header = read_out.second.header;
     }
 
-    BlockFilter filter(m_filter_type, block, block_undo);
-
-    size_t bytes_written = WriteFilterToDisk(m_next_filter_pos, filter);
+    size_t bytes_written = WriteFilterToDisk(m_next_filter_pos, prepared.filter);
     if (bytes_written == 0) return false;
 
     std::pair<uint256, DBVal> value;
     value.first = pindex->GetBlockHash();
-    value.second.hash = filter.GetHash();
-    value.second.header = filter.ComputeHeader(prev_header);
+    value.second.hash = prepared.filter.GetHash();
+    value.second.header = prepared.filter.ComputeHeader(prev_header);
     value.second.pos = m_next_filter_pos;
 
     if (!m_db->Write(DBHeightKey(pindex->nHeight), value)) {
@@ -5,9 +5,11 @@
 #include <index/namehash.h>
 
 #include <hash.h>
+#include <memusage.h>
 #include <primitives/block.h>
 #include <script/names.h>
 
+#include <algorithm>
 #include <utility>
 #include <vector>
 
@@ -21,7 +23,8 @@ public:
 
   explicit DB (const size_t cache_size, const bool memory, const bool wipe)
     : BaseIndex::DB (gArgs.GetDataDirNet () / "indexes" / "namehash",
-                     cache_size, memory, wipe)
+                     cache_size, memory, wipe, false,
+                     DBOptionsFromArgs ("namehash"))
   {}
 
   bool
@@ -46,16 +49,29 @@ NameHashIndex::DB::WritePreimages (
 }
 
 NameHashIndex::NameHashIndex (const size_t cache_size, const bool memory,
-                              const bool wipe)
-  : db(std::make_unique<NameHashIndex::DB> (cache_size, memory, wipe))
+                              const bool wipe, const size_t preimage_cache_size)
+  : db(std::make_unique<NameHashIndex::DB> (cache_size, memory, wipe)),
+    maxCacheUsage(preimage_cache_size)
 {}
 
 NameHashIndex::~NameHashIndex () = default;
 
-bool
-NameHashIndex::WriteBlock (const CBlock& block, const CBlockIndex* pindex)
+namespace
+{
+
+/** The preimages of the names registered in a block.  */
+struct NamePreimages : public BaseIndex::BlockData
 {
   std::vector<std::pair<uint256, valtype>> data;
+};
+
+} // anonymous namespace
+
+std::unique_ptr<BaseIndex::BlockData>
+NameHashIndex::PrepareBlock (const CBlock& block,
+                             const CBlockIndex* pindex) const
+{
+  auto res = std::make_unique<NamePreimages> ();
   for (const auto& tx : block.vtx)
     for (const auto& out : tx->vout)
       {
@@ -65,10 +81,21 @@ NameHashIndex::WriteBlock (const CBlock& block, const CBlockIndex* pindex)
 
         const valtype& name = nameOp.getOpName ();
         const uint256 hash = Hash (name);
-        data.emplace_back (hash, name);
+        res->data.emplace_back (hash, name);
       }
 
-  return db->WritePreimages (data);
+  return res;
+}
+
+bool
+NameHashIndex::WritePreparedBlock (const BlockData& data,
+                                   const CBlockIndex* pindex)
+{
+  const auto& preimages = static_cast<const NamePreimages&> (data).data;
+  if (preimages.empty ())
+    return true;
+
+  return db->WritePreimages (preimages);
 }
 
 BaseIndex::DB&
@@ -77,10 +104,146 @@ NameHashIndex::GetDB () const
   return *db;
 }
 
+namespace
+{
+
+/**
+ * Estimates the memory used by one entry of the preimage cache, i.e. its
+ * list node, its node in the hash map and the name itself.
+ */
+template <typename List, typename Map>
+  size_t
+  CacheEntryUsage (const valtype& name)
+{
+  return memusage::MallocUsage (sizeof (typename List::value_type)
+                                  + 2 * sizeof (void*))
+          + memusage::MallocUsage (
+              sizeof (memusage::unordered_node<typename Map::value_type>))
+          + sizeof (void*)
+          + memusage::MallocUsage (name.capacity ());
+}
+
+} // anonymous namespace
+
+bool
+NameHashIndex::LookupCached (const uint256& hash, valtype& name) const
+{
+  AssertLockHeld (cacheMutex);
+
+  const auto mit = cacheIndex.find (hash);
+  if (mit == cacheIndex.end ())
+    {
+      ++cacheMisses;
+      return false;
+    }
+
+  ++cacheHits;
+  cacheEntries.splice (cacheEntries.begin (), cacheEntries, mit->second);
+  name = mit->second->name;
+  return true;
+}
+
+void
+NameHashIndex::AddCached (const uint256& hash, const valtype& name) const
+{
+  AssertLockHeld (cacheMutex);
+
+  const size_t usage
+      = CacheEntryUsage<CacheList, decltype (cacheIndex)> (name);
+  if (usage > maxCacheUsage || cacheIndex.count (hash) > 0)
+    return;
+
+  while (cacheUsage + usage > maxCacheUsage)
+    {
+      const CacheEntry& oldest = cacheEntries.back ();
+      cacheUsage -= CacheEntryUsage<CacheList, decltype (cacheIndex)> (
+                        oldest.name);
+      cacheIndex.erase (oldest.hash);
+      cacheEntries.pop_back ();
+    }
+
+  cacheEntries.push_front (CacheEntry {hash, name});
+  cacheIndex.emplace (hash, cacheEntries.begin ());
+  cacheUsage += usage;
+}
+
 bool
 NameHashIndex::FindNamePreimage (const uint256& hash, valtype& name) const
 {
-  return db->ReadPreimage (hash, name);
+  {
+    LOCK (cacheMutex);
+    if (LookupCached (hash, name))
+      return true;
+  }
+
+  if (!db->ReadPreimage (hash, name))
+    return false;
+
+  LOCK (cacheMutex);
+  AddCached (hash, name);
+  return true;
+}
+
+void
+NameHashIndex::FindNamePreimages (
+    const std::vector<uint256>& hashes,
+    std::vector<std::optional<valtype>>& names) const
+{
+  names.assign (hashes.size (), std::nullopt);
+
+  std::vector<size_t> missing;
+  {
+    LOCK (cacheMutex);
+    for (size_t i = 0; i < hashes.size (); ++i)
+      {
+        valtype name;
+        if (LookupCached (hashes[i], name))
+          names[i] = std::move (name);
+        else
+          missing.push_back (i);
+      }
+  }
+
+  if (missing.empty ())
+    return;
+
+  /* Read the remaining ones in key order, which keeps the reads local
+     to the blocks LevelDB has already loaded.  */
+  std::sort (missing.begin (), missing.end (),
+             [&hashes] (const size_t a, const size_t b)
+               {
+                 return hashes[a] < hashes[b];
+               });
+
+  std::vector<size_t> found;
+  for (const size_t i : missing)
+    {
+      valtype name;
+      if (db->ReadPreimage (hashes[i], name))
+        {
+          names[i] = std::move (name);
+          found.push_back (i);
+        }
+    }
+
+  LOCK (cacheMutex);
+  for (const size_t i : found)
+    AddCached (hashes[i], *names[i]);
+}
+
+NameHashIndex::CacheStats
+NameHashIndex::GetCacheStats () const
+{
+  LOCK (cacheMutex);
+
+  CacheStats res;
+  res.hits = cacheHits;
+  res.misses = cacheMisses;
+  res.entries = cacheEntries.size ();
+  res.usage = cacheUsage;
+  res.maxUsage = maxCacheUsage;
+
+  return res;
 }
 
 std::unique_ptr<NameHashIndex> g_name_hash_index;
@@ -7,9 +7,16 @@
 
 #include <index/base.h>
 #include <script/script.h>
+#include <sync.h>
 #include <uint256.h>
+#include <util/hasher.h>
 
+#include <list>
 #include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 /** Default value for the -namehashindex argument.  */
 static constexpr bool DEFAULT_NAMEHASHINDEX = false;
@@ -17,6 +24,9 @@ static constexpr bool DEFAULT_NAMEHASHINDEX = false;
 /** Maximum size of the DB cache for the name-hash index.  */
 static constexpr int64_t MAX_NAMEHASH_CACHE = 1024;
 
+/** Default for -namehashcachesize, in MiB (0 = off).  */
+static constexpr int64_t DEFAULT_NAMEHASH_PREIMAGE_CACHE = 16;
+
 /**
  * This keeps an index of SHA-256d hashes of names to the corresponding preimage
  * (the names themselves).  This allows "unhashing" known names, so that we
@@ -28,6 +38,12 @@ static constexpr int64_t MAX_NAMEHASH_CACHE = 1024;
  * Note that this is "append only".  When rewinding a block that first
  * mentions a name, we do not attempt to remove that name again from the index.
  * There's not really a point in doing so.
+ *
+ * Lookups by hash are the hot path for clients that never reveal the names
+ * they are interested in, and those tend to ask for the same few names over
+ * and over.  Hence the preimages found are kept in a memory-bounded cache
+ * of the least recently used entries in front of the database.  Since the
+ * index is append-only, cached entries never go stale.
  */
 class NameHashIndex : public BaseIndex
 {
@@ -38,9 +54,56 @@ private:
 
   const std::unique_ptr<DB> db;
 
+  /** An entry in the preimage cache.  */
+  struct CacheEntry
+  {
+    uint256 hash;
+    valtype name;
+  };
+
+  using CacheList = std::list<CacheEntry>;
+
+  /** Maximum memory usage of the preimage cache.  */
+  const size_t maxCacheUsage;
+
+  mutable Mutex cacheMutex;
+
+  /** Cached preimages, most recently used first.  */
+  mutable CacheList cacheEntries GUARDED_BY (cacheMutex);
+
+  /** The cached preimages by hash.  */
+  mutable std::unordered_map<uint256, CacheList::iterator, SaltedTxidHasher>
+      cacheIndex GUARDED_BY (cacheMutex);
+
+  /** Current memory usage of the cache.  */
+  mutable size_t cacheUsage GUARDED_BY (cacheMutex) = 0;
+
+  /** Statistics about cache lookups.  */
+  mutable uint64_t cacheHits GUARDED_BY (cacheMutex) = 0;
+  mutable uint64_t cacheMisses GUARDED_BY (cacheMutex) = 0;
+
+  /**
+   * Looks up a preimage in the cache, marking it as recently used if
+   * it is there.
+   */
+  bool LookupCached (const uint256& hash, valtype& name) const
+      EXCLUSIVE_LOCKS_REQUIRED (cacheMutex);
+
+  /**
+   * Adds a preimage read from the database to the cache, evicting the least
+   * recently used entries as needed.
+   */
+  void AddCached (const uint256& hash, const valtype& name) const
+      EXCLUSIVE_LOCKS_REQUIRED (cacheMutex);
+
 protected:
 
-    bool WriteBlock (const CBlock& block, const CBlockIndex* pindex) override;
+    std::unique_ptr<BlockData> PrepareBlock (const CBlock& block,
+                                             const CBlockIndex* pindex)
+        const override;
+
+    bool WritePreparedBlock (const BlockData& data,
+                             const CBlockIndex* pindex) override;
 
     BaseIndex::DB& GetDB () const override;
 
@@ -54,8 +117,11 @@ public:
 
     /**
      * Constructs the index, which becomes available to be queried.
+     * preimage_cache_size is the memory used to cache preimages in bytes.
      */
-    explicit NameHashIndex (size_t cache_size, bool memory, bool wipe);
+    explicit NameHashIndex (size_t cache_size, bool memory, bool wipe,
+                            size_t preimage_cache_size
+                              = DEFAULT_NAMEHASH_PREIMAGE_CACHE << 20);
 
     ~NameHashIndex ();
 
@@ -63,7 +129,30 @@ public:
      * Looks up a name by hash.  Returns false if the preimage cannot
      * be found (because the name has not been indexed yet).
      */
-    bool FindNamePreimage (const uint256& hash, valtype& name) const;
+    bool FindNamePreimage (const uint256& hash, valtype& name) const
+        EXCLUSIVE_LOCKS_REQUIRED (!cacheMutex);
+
+    /**
+     * Looks up the preimages of many hashes at once.  names is set to
+     * one entry per hash, which is empty if the preimage cannot be found.
+     * The cache is consulted for all of them first, and the remaining
+     * ones are read from the database in key order.
+     */
+    void FindNamePreimages (const std::vector<uint256>& hashes,
+                            std::vector<std::optional<valtype>>& names) const
+        EXCLUSIVE_LOCKS_REQUIRED (!cacheMutex);
+
+    /** Statistics about the preimage cache.  */
+    struct CacheStats
+    {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      size_t entries = 0;
+      size_t usage = 0;
+      size_t maxUsage = 0;
+    };
+
+    CacheStats GetCacheStats () const EXCLUSIVE_LOCKS_REQUIRED (!cacheMutex);
 
 };
 
@@ -0,0 +1,197 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/namehistory.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <names/common.h>
+#include <names/encoding.h>
+#include <node/blockstorage.h>
+#include <primitives/block.h>
+#include <script/names.h>
+#include <serialize.h>
+#include <util/system.h>
+
+#include <utility>
+
+/** Database "key prefix" for the history entries.  */
+constexpr uint8_t DB_NAME_UPDATE = 'u';
+
+namespace
+{
+
+/**
+ * Key of one name update.  All updates of a name share the name as prefix,
+ * and are ordered by height and position in the block after that, so that
+ * the history of a name is one sequential scan.
+ */
+struct DBKey
+{
+
+  valtype name;
+  uint32_t height = 0;
+  uint32_t txPos = 0;
+
+  DBKey () = default;
+
+  explicit DBKey (const valtype& n, const uint32_t h = 0, const uint32_t p = 0)
+    : name(n), height(h), txPos(p)
+  {}
+
+  template <typename Stream>
+    void
+    Serialize (Stream& s) const
+  {
+    ser_writedata8 (s, DB_NAME_UPDATE);
+    s << name;
+    ser_writedata32be (s, height);
+    ser_writedata32be (s, txPos);
+  }
+
+  template <typename Stream>
+    void
+    Unserialize (Stream& s)
+  {
+    if (ser_readdata8 (s) != DB_NAME_UPDATE)
+      throw std::ios_base::failure ("Invalid format for namehistory DB key");
+    s >> name;
+    height = ser_readdata32be (s);
+    txPos = ser_readdata32be (s);
+  }
+
+};
+
+/** The name updates in a block, as they are written to the database.  */
+struct NameUpdates : public BaseIndex::BlockData
+{
+  std::vector<std::pair<DBKey, CNameData>> updates;
+};
+
+/**
+ * Collects the name updates in a block.  This matches the updates that
+ * ApplyNameTransaction makes to the name database.
+ */
+NameUpdates
+GetNameUpdates (const CBlock& block, const CBlockIndex* pindex)
+{
+  NameUpdates res;
+  for (uint32_t i = 0; i < block.vtx.size (); ++i)
+    {
+      const CTransaction& tx = *block.vtx[i];
+      for (uint32_t n = 0; n < tx.vout.size (); ++n)
+        {
+          const CNameScript op(tx.vout[n].scriptPubKey);
+          if (!op.isNameOp () || !op.isAnyUpdate ())
+            continue;
+
+          CNameData data;
+          data.fromScript (pindex->nHeight, COutPoint (tx.GetHash (), n), op);
+          res.updates.emplace_back (DBKey (op.getOpName (), pindex->nHeight, i),
+                                    std::move (data));
+        }
+    }
+
+  return res;
+}
+
+} // anonymous namespace
+
+class NameHistoryIndex::DB : public BaseIndex::DB
+{
+
+public:
+
+  explicit DB (const size_t cache_size, const bool memory, const bool wipe)
+    : BaseIndex::DB (gArgs.GetDataDirNet () / "indexes" / "namehistory",
+                     cache_size, memory, wipe, false,
+                     DBOptionsFromArgs ("namehistory"))
+  {}
+
+};
+
+NameHistoryIndex::NameHistoryIndex (const size_t cache_size, const bool memory,
+                                    const bool wipe)
+  : db(std::make_unique<NameHistoryIndex::DB> (cache_size, memory, wipe))
+{}
+
+NameHistoryIndex::~NameHistoryIndex () = default;
+
+std::unique_ptr<BaseIndex::BlockData>
+NameHistoryIndex::PrepareBlock (const CBlock& block,
+                                const CBlockIndex* pindex) const
+{
+  return std::make_unique<NameUpdates> (GetNameUpdates (block, pindex));
+}
+
+bool
+NameHistoryIndex::WritePreparedBlock (const BlockData& data,
+                                      const CBlockIndex* pindex)
+{
+  const auto& updates = static_cast<const NameUpdates&> (data).updates;
+  if (updates.empty ())
+    return true;
+
+  CDBBatch batch(*db);
+  for (const auto& entry : updates)
+    batch.Write (entry.first, entry.second);
+
+  return db->WriteBatch (batch);
+}
+
+bool
+NameHistoryIndex::Rewind (const CBlockIndex* current_tip,
+                          const CBlockIndex* new_tip)
+{
+  assert (current_tip->GetAncestor (new_tip->nHeight) == new_tip);
+
+  CDBBatch batch(*db);
+  const auto& consensusParams = Params ().GetConsensus ();
+  for (const CBlockIndex* pindex = current_tip; pindex != new_tip;
+       pindex = pindex->pprev)
+    {
+      CBlock block;
+      if (!ReadBlockFromDisk (block, pindex, consensusParams))
+        return error ("%s: Failed to read block %s from disk",
+                      __func__, pindex->GetBlockHash ().ToString ());
+
+      for (const auto& entry : GetNameUpdates (block, pindex).updates)
+        batch.Erase (entry.first);
+    }
+  if (!db->WriteBatch (batch))
+    return false;
+
+  return BaseIndex::Rewind (current_tip, new_tip);
+}
+
+BaseIndex::DB&
+NameHistoryIndex::GetDB () const
+{
+  return *db;
+}
+
+bool
+NameHistoryIndex::FindNameHistory (const valtype& name,
+                                   std::vector<CNameData>& history) const
+{
+  history.clear ();
+
+  std::unique_ptr<CDBIterator> it(db->NewIterator ());
+  for (it->Seek (DBKey (name)); it->Valid (); it->Next ())
+    {
+      DBKey key;
+      if (!it->GetKey (key) || key.name != name)
+        break;
+
+      CNameData data;
+      if (!it->GetValue (data))
+        return error ("%s: failed to read history of name %s",
+                      __func__, EncodeNameForMessage (name));
+      history.push_back (std::move (data));
+    }
+
+  return true;
+}
+
+std::unique_ptr<NameHistoryIndex> g_name_history_index;
@@ -0,0 +1,81 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_NAMEHISTORY_H
+#define BITCOIN_INDEX_NAMEHISTORY_H
+
+#include <index/base.h>
+#include <script/script.h>
+
+#include <memory>
+#include <vector>
+
+class CNameData;
+
+/** Default value for the -namehistory argument.  */
+static constexpr bool DEFAULT_NAMEHISTORY = false;
+
+/** Maximum size of the DB cache for the name-history index.  */
+static constexpr int64_t MAX_NAMEHISTORY_CACHE = 1024;
+
+/**
+ * This keeps the full history of every name:  the data of all name updates
+ * (including the first update) in the order they happened in the chain.
+ * The last entry is the name's current data.
+ *
+ * The index is built from the name operations in blocks, so that it can
+ * be enabled or dropped at any time without touching the chainstate, and
+ * keeping it up-to-date does not slow down block connection.
+ */
+class NameHistoryIndex : public BaseIndex
+{
+
+private:
+
+  class DB;
+
+  const std::unique_ptr<DB> db;
+
+protected:
+
+  std::unique_ptr<BlockData> PrepareBlock (const CBlock& block,
+                                           const CBlockIndex* pindex)
+      const override;
+
+  bool WritePreparedBlock (const BlockData& data,
+                           const CBlockIndex* pindex) override;
+
+  bool Rewind (const CBlockIndex* current_tip,
+               const CBlockIndex* new_tip) override;
+
+  BaseIndex::DB& GetDB () const override;
+
+  const char*
+  GetName () const override
+  {
+    return "namehistory";
+  }
+
+public:
+
+  /**
+   * Constructs the index, which becomes available to be queried.
+   */
+  explicit NameHistoryIndex (size_t cache_size, bool memory, bool wipe);
+
+  ~NameHistoryIndex ();
+
+  /**
+   * Looks up all updates of a name, oldest first.  Returns false if the
+   * database could not be read.
+   */
+  bool FindNameHistory (const valtype& name,
+                        std::vector<CNameData>& history) const;
+
+};
+
+/** The global name-history index.  May be null.  */
+extern std::unique_ptr<NameHistoryIndex> g_name_history_index;
+
+#endif // BITCOIN_INDEX_NAMEHISTORY_H
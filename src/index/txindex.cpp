@@ -29,7 +29,8 @@ public:
 };
 
 TxIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
-    BaseIndex::DB(gArgs.GetDataDirNet() / "indexes" / "txindex", n_cache_size, f_memory, f_wipe)
+    BaseIndex::DB(gArgs.GetDataDirNet() / "indexes" / "txindex", n_cache_size, f_memory, f_wipe,
+                  /*f_obfuscate=*/false, DBOptionsFromArgs("txindex"))
 {}
 
 bool TxIndex::DB::ReadTxPos(const uint256 &txid, CDiskTxPos& pos) const
@@ -52,19 +53,32 @@ TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
 
 TxIndex::~TxIndex() {}
 
-bool TxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+namespace {
+struct TxPositions : public BaseIndex::BlockData {
+    std::vector<std::pair<uint256, CDiskTxPos>> v_pos;
+};
+} // namespace
+
+std::unique_ptr<BaseIndex::BlockData> TxIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const
 {
+    auto data{std::make_unique<TxPositions>()};
     // Exclude genesis block transaction because outputs are not spendable.
-    if (pindex->nHeight == 0) return true;
+    if (pindex->nHeight == 0) return data;
 
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
-    vPos.reserve(block.vtx.size());
+    data->v_pos.reserve(block.vtx.size());
     for (const auto& tx : block.vtx) {
-        vPos.emplace_back(tx->GetHash(), pos);
+        data->v_pos.emplace_back(tx->GetHash(), pos);
         pos.nTxOffset += ::GetSerializeSize(*tx, CLIENT_VERSION);
     }
-    return m_db->WriteTxs(vPos);
+    return data;
+}
+
+bool TxIndex::WritePreparedBlock(const BlockData& data, const CBlockIndex* pindex)
+{
+    const auto& v_pos{static_cast<const TxPositions&>(data).v_pos};
+    if (v_pos.empty()) return true;
+    return m_db->WriteTxs(v_pos);
 }
 
 BaseIndex::DB& TxIndex::GetDB() const { return *m_db; }
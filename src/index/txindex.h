@@ -21,7 +21,9 @@ private:
     const std::unique_ptr<DB> m_db;
 
 protected:
-    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+    std::unique_ptr<BlockData> PrepareBlock(const CBlock& block, const CBlockIndex* pindex) const override;
+
+    bool WritePreparedBlock(const BlockData& data, const CBlockIndex* pindex) override;
 
     BaseIndex::DB& GetDB() const override;
 
@@ -16,14 +16,17 @@
 #include <chainparams.h>
 #include <compat/sanity.h>
 #include <consensus/amount.h>
+#include <dbwrapper.h>
 #include <deploymentstatus.h>
 #include <fs.h>
 #include <hash.h>
 #include <httprpc.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
 #include <index/blockfilterindex.h>
 #include <index/coinstatsindex.h>
 #include <index/namehash.h>
+#include <index/namehistory.h>
 #include <index/txindex.h>
 #include <init/common.h>
 #include <interfaces/chain.h>
@@ -36,11 +39,14 @@
 #include <net_permissions.h>
 #include <net_processing.h>
 #include <netbase.h>
+#include <node/blockservecache.h>
 #include <node/blockstorage.h>
 #include <node/caches.h>
 #include <node/chainstate.h>
 #include <node/context.h>
 #include <node/miner.h>
+#include <node/txprevalidation.h>
+#include <node/txreconciliation.h>
 #include <node/ui_interface.h>
 #include <policy/feerate.h>
 #include <policy/fees.h>
@@ -179,10 +185,16 @@ void Interrupt(NodeContext& node)
     if (g_name_hash_index) {
         g_name_hash_index->Interrupt();
     }
+    if (g_name_history_index) {
+        g_name_history_index->Interrupt();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
     if (g_coin_stats_index) {
         g_coin_stats_index->Interrupt();
     }
+    if (g_address_index) {
+        g_address_index->Interrupt();
+    }
 }
 
 void Shutdown(NodeContext& node)
@@ -230,7 +242,7 @@ void Shutdown(NodeContext& node)
     node.addrman.reset();
 
     if (node.mempool && node.mempool->IsLoaded() && node.args->GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
-        DumpMempool(*node.mempool);
+        DumpMempool(*node.mempool, node.chainman->ActiveChainstate());
     }
 
     // Drop transactions we were still watching, and record fee estimations.
@@ -263,6 +275,14 @@ void Shutdown(NodeContext& node)
         g_name_hash_index->Stop();
         g_name_hash_index.reset();
     }
+    if (g_name_history_index) {
+        g_name_history_index->Stop();
+        g_name_history_index.reset();
+    }
+    if (g_address_index) {
+        g_address_index->Stop();
+        g_address_index.reset();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
     DestroyAllBlockFilterIndexes();
 
@@ -397,25 +417,36 @@ void SetupServerArgs(ArgsManager& argsman)
 #endif
     argsman.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blocksonly", strprintf("Whether to reject transactions from network peers. Automatic broadcast and rebroadcast of any transactions from inbound peers is disabled, unless the peer has the 'forcerelay' permission. RPC transactions are not affected. (default: %u)", DEFAULT_BLOCKSONLY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockservecachesize=<n>", strprintf("Size in MiB of the cache of serialized blocks served to peers (0 = off, default: %d)", DEFAULT_BLOCK_SERVE_CACHE_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-coinstatsindex", strprintf("Maintain coinstats index used by the gettxoutsetinfo RPC (default: %u)", DEFAULT_COINSTATSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-conf=<file>", strprintf("Specify path to read-only configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-dbtuning=[<db>:]<option>=<n>", strprintf("Tune LevelDB for database <db> (%s), or for all databases if <db> is omitted. <option> is compression (0 or 1, requires snappy support), blocksize (bytes, default: 4096), bloombits (bits per key, 0 to disable, default: 10) or writebuffer (bytes, default: a quarter of the database cache). Can be specified multiple times.", Join(DBTuningNames(), ", ")), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-loadblock=<file>", "Imports blocks from external file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-maxorphanmemory=<n>", strprintf("Keep unconnectable transactions in memory below <n> megabytes (default: %u)", DEFAULT_MAX_ORPHAN_MEMORY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex(), signetChainParams->GetConsensus().nMinimumChainWork.GetHex()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-parworkstealing", strprintf("Give every script verification thread its own queue and let idle threads take work from the others (default: %u)", DEFAULT_SCRIPTCHECK_WORK_STEALING), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-persistmempoolv1",
+                   strprintf("Whether a mempool.dat file created by -persistmempool or the savemempool RPC will be written in the legacy format "
+                             "(version 1, without validation metadata or checksums) or the current format (version 2). This temporary option "
+                             "will be removed in the future. (default: %u)",
+                             DEFAULT_PERSIST_V1_DAT),
+                   ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -coinstatsindex. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-reindexthreads=<n>", strprintf("Number of threads reading and pre-checking block files during -reindex (1 to %d, 0 = one less than the number of cores, default: %d)", MAX_REINDEX_THREADS, DEFAULT_REINDEX_THREADS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-settings=<file>", strprintf("Specify path to dynamic settings data file. Can be disabled with -nosettings. File is written at runtime and not meant to be edited by users (use %s instead for custom settings). Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME, BITCOIN_SETTINGS_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #if HAVE_SYSTEM
@@ -431,8 +462,11 @@ void SetupServerArgs(ArgsManager& argsman)
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-namehistory", strprintf("Keep track of the full name history (default: %u)", 0), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-namehistory", strprintf("Maintain an index of the full history of names, used by the name_history rpc call (default: %u)", DEFAULT_NAMEHISTORY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-namehashindex", strprintf("Maintain an index of name hashes to preimages (default: %u)", DEFAULT_NAMEHASHINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-namehashcachesize=<n>", strprintf("Size in MiB of the cache of name preimages found by hash in the name-hash index (0 = off, default: %d)", DEFAULT_NAMEHASH_PREIMAGE_CACHE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-indexsyncthreads=<n>", strprintf("Set the number of threads used by each index to read and prepare blocks while it catches up with the chain (up to %d, 0 = auto, <0 = leave that many cores free, default: %d)", MAX_INDEX_SYNC_THREADS, DEFAULT_INDEX_SYNC_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-addressindex", strprintf("Maintain an index of the outputs paying to and the inputs spending from each address or script, including name outputs, used by the getaddresshistory rpc call (default: %u)", DEFAULT_ADDRESSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 
     argsman.AddArg("-addnode=<ip>", strprintf("Add a node to connect to and attempt to keep the connection open (see the addnode RPC help for more info). This option can be specified multiple times to add multiple nodes; connections are limited to %u at a time and are counted separately from the -maxconnections limit.", MAX_ADDNODE_CONNECTIONS), ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::CONNECTION);
     argsman.AddArg("-asmap=<file>", strprintf("Specify asn mapping used for bucketing of the peers (default: %s). Relative paths will be prefixed by the net-specific datadir location.", DEFAULT_ASMAP_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -467,6 +501,9 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-networkactive", "Enable all P2P network activity (default: 1). Can be changed by the setnetworkactive RPC command", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-timeout=<n>", strprintf("Specify socket connection timeout in milliseconds. If an initial attempt to connect is unsuccessful after this amount of time, drop it (minimum: 1, default: %d)", DEFAULT_CONNECT_TIMEOUT), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-peertimeout=<n>", strprintf("Specify a p2p connection timeout delay in seconds. After connecting to a peer, wait this amount of time before considering disconnection based on inactivity (minimum: 1, default: %d)", DEFAULT_PEER_CONNECT_TIMEOUT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::CONNECTION);
+    argsman.AddArg("-txprevalidationthreads=<n>", strprintf("Number of threads that deserialize and verify the scripts of transactions from peers ahead of mempool acceptance (0 = off, maximum: %d, default: %d)", MAX_TXPREVALIDATION_THREADS, DEFAULT_TXPREVALIDATION_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    argsman.AddArg("-packagerelay", strprintf("Relay unconfirmed transactions with their unconfirmed ancestors, as one package, to and from peers that support it (default: %u)", DEFAULT_PACKAGE_RELAY), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    argsman.AddArg("-txreconciliation", strprintf("Enable transaction reconciliations per BIP 330 (default: %d)", DEFAULT_TXRECONCILIATION_ENABLE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::CONNECTION);
     argsman.AddArg("-torcontrol=<ip>:<port>", strprintf("Tor control port to use if onion listening enabled (default: %s)", DEFAULT_TOR_CONTROL), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-torpassword=<pass>", "Tor control port password (default: empty)", ArgsManager::ALLOW_ANY | ArgsManager::SENSITIVE, OptionsCategory::CONNECTION);
 #ifdef USE_UPNP
@@ -869,6 +906,15 @@ bool AppInitParameterInteraction(const ArgsManager& args)
         nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
     }
 
+    // validate LevelDB tuning for every database it could apply to
+    for (const std::string& db_name : DBTuningNames()) {
+        DBOptions db_options;
+        std::string error;
+        if (!ApplyDBTuning(args, db_name, db_options, error)) {
+            return InitError(strprintf(Untranslated("Invalid -dbtuning: %s"), error));
+        }
+    }
+
     // if using block pruning, then disallow txindex and coinstatsindex
     if (args.GetIntArg("-prune", 0)) {
         if (args.GetBoolArg("-txindex", DEFAULT_TXINDEX))
@@ -877,6 +923,10 @@ bool AppInitParameterInteraction(const ArgsManager& args)
             return InitError(_("Prune mode is incompatible with -coinstatsindex."));
         if (gArgs.GetBoolArg("-namehashindex", DEFAULT_NAMEHASHINDEX))
             return InitError(_("Prune mode is incompatible with -namehashindex."));
+        if (args.GetBoolArg("-namehistory", DEFAULT_NAMEHISTORY))
+            return InitError(_("Prune mode is incompatible with -namehistory."));
+        if (args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex."));
     }
 
     // If -forcednsseed is set to true, ensure -dnsseed has not been set to false
@@ -1178,7 +1228,7 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     LogPrintf("Script verification uses %d additional threads\n", script_threads);
     if (script_threads >= 1) {
         g_parallel_script_checks = true;
-        StartScriptCheckWorkerThreads(script_threads);
+        StartScriptCheckWorkerThreads(script_threads, args.GetBoolArg("-parworkstealing", DEFAULT_SCRIPTCHECK_WORK_STEALING));
     }
 
     assert(!node.scheduler);
@@ -1418,6 +1468,12 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     if (gArgs.GetBoolArg("-namehashindex", DEFAULT_NAMEHASHINDEX)) {
         LogPrintf("* Using %.1f MiB for name hash database\n", cache_sizes.name_hash_index * (1.0 / 1024 / 1024));
     }
+    if (args.GetBoolArg("-namehistory", DEFAULT_NAMEHISTORY)) {
+        LogPrintf("* Using %.1f MiB for name history database\n", cache_sizes.name_history_index * (1.0 / 1024 / 1024));
+    }
+    if (args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        LogPrintf("* Using %.1f MiB for address index database\n", cache_sizes.address_index * (1.0 / 1024 / 1024));
+    }
     for (BlockFilterType filter_type : g_enabled_filter_types) {
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   cache_sizes.filter_index * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
@@ -1438,7 +1494,6 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
                                 chainman,
                                 Assert(node.mempool.get()),
                                 fPruneMode,
-                                gArgs.GetBoolArg("-namehistory", false),
                                 chainparams.GetConsensus(),
                                 fReindexChainState,
                                 cache_sizes.block_tree_db,
@@ -1468,9 +1523,6 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
             case ChainstateLoadingError::ERROR_PRUNED_NEEDS_REINDEX:
                 strLoadError = _("You need to rebuild the database using -reindex to go back to unpruned mode.  This will redownload the entire blockchain");
                 break;
-            case ChainstateLoadingError::ERROR_NAME_HISTORY_NEEDS_REINDEX:
-                strLoadError = _("You need to rebuild the database using -reindex to change -namehistory");
-                break;
             case ChainstateLoadingError::ERROR_LOAD_GENESIS_BLOCK_FAILED:
                 strLoadError = _("Error initializing block database");
                 break;
@@ -1562,34 +1614,56 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     }
 
     // ********************************************************* Step 8: start indexers
+    int index_threads = args.GetIntArg("-indexsyncthreads", DEFAULT_INDEX_SYNC_THREADS);
+    if (index_threads <= 0) {
+        index_threads += GetNumCores();
+    }
+    // Subtract 1 because the index sync thread also reads and prepares blocks
+    const int index_worker_threads = std::clamp(index_threads, 1, MAX_INDEX_SYNC_THREADS) - 1;
+
     if (args.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         if (const auto error{CheckLegacyTxindex(*Assert(chainman.m_blockman.m_block_tree_db))}) {
             return InitError(*error);
         }
 
         g_txindex = std::make_unique<TxIndex>(cache_sizes.tx_index, false, fReindex);
-        if (!g_txindex->Start(chainman.ActiveChainstate())) {
+        if (!g_txindex->Start(chainman.ActiveChainstate(), index_worker_threads)) {
             return false;
         }
     }
 
     if (gArgs.GetBoolArg("-namehashindex", DEFAULT_NAMEHASHINDEX)) {
-        g_name_hash_index = std::make_unique<NameHashIndex>(cache_sizes.name_hash_index, false, fReindex);
-        if (!g_name_hash_index->Start(chainman.ActiveChainstate())) {
+        const int64_t preimage_cache_size{std::max<int64_t>(0, args.GetIntArg("-namehashcachesize", DEFAULT_NAMEHASH_PREIMAGE_CACHE))};
+        g_name_hash_index = std::make_unique<NameHashIndex>(cache_sizes.name_hash_index, false, fReindex, size_t(preimage_cache_size) << 20);
+        if (!g_name_hash_index->Start(chainman.ActiveChainstate(), index_worker_threads)) {
+            return false;
+        }
+    }
+
+    if (args.GetBoolArg("-namehistory", DEFAULT_NAMEHISTORY)) {
+        g_name_history_index = std::make_unique<NameHistoryIndex>(cache_sizes.name_history_index, false, fReindex);
+        if (!g_name_history_index->Start(chainman.ActiveChainstate(), index_worker_threads)) {
             return false;
         }
     }
 
     for (const auto& filter_type : g_enabled_filter_types) {
         InitBlockFilterIndex(filter_type, cache_sizes.filter_index, false, fReindex);
-        if (!GetBlockFilterIndex(filter_type)->Start(chainman.ActiveChainstate())) {
+        if (!GetBlockFilterIndex(filter_type)->Start(chainman.ActiveChainstate(), index_worker_threads)) {
             return false;
         }
     }
 
     if (args.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
         g_coin_stats_index = std::make_unique<CoinStatsIndex>(/* cache size */ 0, false, fReindex);
-        if (!g_coin_stats_index->Start(chainman.ActiveChainstate())) {
+        if (!g_coin_stats_index->Start(chainman.ActiveChainstate(), index_worker_threads)) {
+            return false;
+        }
+    }
+
+    if (args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        g_address_index = std::make_unique<AddressIndex>(cache_sizes.address_index, false, fReindex);
+        if (!g_address_index->Start(chainman.ActiveChainstate(), index_worker_threads)) {
             return false;
         }
     }
@@ -6,8 +6,6 @@
 
 #include <script/names.h>
 
-bool fNameHistory = false;
-
 /* ************************************************************************** */
 /* CNameData.  */
 
@@ -207,31 +205,6 @@ CNameCache::iterateNames (CNameIterator* base) const
   return new CCacheNameIterator (*this, base);
 }
 
-bool
-CNameCache::getHistory (const valtype& name, CNameHistory& res) const
-{
-  assert (fNameHistory);
-
-  const std::map<valtype, CNameHistory>::const_iterator i = history.find (name);
-  if (i == history.end ())
-    return false;
-
-  res = i->second;
-  return true;
-}
-
-void
-CNameCache::setHistory (const valtype& name, const CNameHistory& data)
-{
-  assert (fNameHistory);
-
-  const std::map<valtype, CNameHistory>::iterator ei = history.find (name);
-  if (ei != history.end ())
-    ei->second = data;
-  else
-    history.insert (std::make_pair (name, data));
-}
-
 void
 CNameCache::updateNamesForHeight (unsigned nHeight,
                                   std::set<valtype>& names) const
@@ -281,10 +254,6 @@ CNameCache::apply (const CNameCache& cache)
        i != cache.deleted.end (); ++i)
     remove (*i);
 
-  for (std::map<valtype, CNameHistory>::const_iterator i
-        = cache.history.begin (); i != cache.history.end (); ++i)
-    setHistory (i->first, i->second);
-
   for (std::map<ExpireEntry, bool>::const_iterator i
         = cache.expireIndex.begin (); i != cache.expireIndex.end (); ++i)
     expireIndex[i->first] = i->second;
@@ -16,9 +16,6 @@
 class CNameScript;
 class CDBBatch;
 
-/** Whether or not name history is enabled.  */
-extern bool fNameHistory;
-
 /* ************************************************************************** */
 /* CNameData.  */
 
@@ -122,76 +119,6 @@ public:
 
 };
 
-/* ************************************************************************** */
-/* CNameHistory.  */
-
-/**
- * Keep track of a name's history.  This is a stack of old CNameData
- * objects that have been obsoleted.
- */
-class CNameHistory
-{
-
-private:
-
-  /** The actual data.  */
-  std::vector<CNameData> data;
-
-public:
-
-  SERIALIZE_METHODS (CNameHistory, obj)
-  {
-    READWRITE (obj.data);
-  }
-
-  /**
-   * Check if the stack is empty.  This is used to decide when to fully
-   * delete an entry in the database.
-   * @return True iff the data stack is empty.
-   */
-  inline bool
-  empty () const
-  {
-    return data.empty ();
-  }
-
-  /**
-   * Access the data in a read-only way.
-   * @return The data stack.
-   */
-  inline const std::vector<CNameData>&
-  getData () const
-  {
-    return data;
-  }
-
-  /**
-   * Push a new entry onto the data stack.  The new entry's height should
-   * be at least as high as the stack top entry's.  If not, fail.
-   * @param entry The new entry to push onto the stack.
-   */
-  inline void
-  push (const CNameData& entry)
-  {
-    assert (data.empty () || data.back ().getHeight () <= entry.getHeight ());
-    data.push_back (entry);
-  }
-
-  /**
-   * Pop the top entry off the stack.  This is used when undoing name
-   * changes.  The name's new value is passed as argument and should
-   * match the removed entry.  If not, fail.
-   * @param entry The name's value after undoing.
-   */
-  inline void
-  pop (const CNameData& entry)
-  {
-    assert (!data.empty () && data.back () == entry);
-    data.pop_back ();
-  }
-
-};
-
 /* ************************************************************************** */
 /* CNameIterator.  */
 
@@ -336,12 +263,6 @@ private:
   /** Deleted names.  */
   std::set<valtype> deleted;
 
-  /**
-   * New or updated history stacks.  If they are empty, the corresponding
-   * database entry is deleted instead.
-   */
-  std::map<valtype, CNameHistory> history;
-
   /**
    * Changes to be performed to the expire index.  The entry is mapped
    * to either "true" (meaning to add it) or "false" (delete).
@@ -357,7 +278,6 @@ public:
   {
     entries.clear ();
     deleted.clear ();
-    history.clear ();
     expireIndex.clear ();
   }
 
@@ -372,7 +292,7 @@ public:
   {
     if (entries.empty () && deleted.empty ())
       {
-        assert (history.empty () && expireIndex.empty ());
+        assert (expireIndex.empty ());
         return true;
       }
 
@@ -402,21 +322,6 @@ public:
      ownership of.  */
   CNameIterator* iterateNames (CNameIterator* base) const;
 
-  /**
-   * Query for an history entry.
-   * @param name The name to look up.
-   * @param res Put the resulting history entry here.
-   * @return True iff the name was found in the cache.
-   */
-  bool getHistory (const valtype& name, CNameHistory& res) const;
-
-  /**
-   * Set a name history entry.
-   * @param name The name to modify.
-   * @param data The new history entry.
-   */
-  void setHistory (const valtype& name, const CNameHistory& data);
-
   /* Query the cached changes to the expire index.  In particular,
      for a given height and a given set of names that were indexed to
      this update height, apply possible changes to the set that
@@ -536,6 +536,29 @@ UnexpireNames (unsigned nHeight, CBlockUndo& undo, CCoinsViewCache& view,
   return true;
 }
 
+unsigned
+PrefetchNameUndo (const CBlockUndo& undo, const CCoinsView& view)
+{
+  std::set<valtype> names;
+  for (const auto& nameUndo : undo.vnameundo)
+    names.insert (nameUndo.getName ());
+  for (const auto& coin : undo.vexpired)
+    {
+      const CNameScript nameOp(coin.out.scriptPubKey);
+      if (nameOp.isNameOp () && nameOp.isAnyUpdate ())
+        names.insert (nameOp.getOpName ());
+    }
+
+  for (const auto& name : names)
+    {
+      CNameData data;
+      if (view.GetName (name, data))
+        view.HaveCoin (data.getUpdateOutpoint ());
+    }
+
+  return names.size ();
+}
+
 void
 CheckNameDB (CChainState& chainState, bool disconnect)
 {
@@ -73,6 +73,12 @@ public:
    */
   void apply (CCoinsViewCache& view) const;
 
+  inline const valtype&
+  getName () const
+  {
+    return name;
+  }
+
 };
 
 /* ************************************************************************** */
@@ -126,6 +132,18 @@ bool ExpireNames (unsigned nHeight, CCoinsViewCache& view, CBlockUndo& undo,
 bool UnexpireNames (unsigned nHeight, CBlockUndo& undo,
                     CCoinsViewCache& view, std::set<valtype>& names);
 
+/**
+ * Look up everything that disconnecting a block will read from the name
+ * database:  the names in vnameundo and vexpired (each once and in key
+ * order), their history if enabled, and the coins of expired names.
+ * This only reads from the view, so it can run on the disconnect readahead
+ * thread to warm the database cache before DisconnectBlock needs it.
+ * @param undo The undo data of the block that will be disconnected.
+ * @param view The view to query, usually the chainstate database.
+ * @return The number of distinct names looked up.
+ */
+unsigned PrefetchNameUndo (const CBlockUndo& undo, const CCoinsView& view);
+
 /**
  * Check the name database consistency.  This calls CCoinsView::ValidateNameDB,
  * but only if applicable depending on the -checknamedb setting.  If it fails,
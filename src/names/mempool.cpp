@@ -445,3 +445,54 @@ CNameMemPool::checkTx (const CTransaction& tx) const
 
   return true;
 }
+
+bool
+CNameMemPool::checkPackage (const std::vector<CTransactionRef>& txns,
+                            size_t& failed) const
+{
+  AssertLockHeld (pool.cs);
+
+  /* Registrations and name_new hashes of the transactions before the one
+     being checked.  Updates need no tracking here for the same reason as
+     in checkTx.  */
+  std::set<valtype> registered;
+  std::map<valtype, uint256> newHashes;
+
+  for (failed = 0; failed < txns.size (); ++failed)
+    {
+      const CTransaction& tx = *txns[failed];
+      if (!checkTx (tx))
+        return false;
+      if (!tx.IsDoichain ())
+        continue;
+
+      for (const auto& txout : tx.vout)
+        {
+          const CNameScript nameOp(txout.scriptPubKey);
+          if (!nameOp.isNameOp ())
+            continue;
+
+          switch (nameOp.getNameOp ())
+            {
+            case OP_NAME_NEW:
+              {
+                const auto ins = newHashes.emplace (nameOp.getOpHash (),
+                                                    tx.GetHash ());
+                if (!ins.second && ins.first->second != tx.GetHash ())
+                  return false;
+                break;
+              }
+
+            case OP_NAME_FIRSTUPDATE:
+              if (!registered.insert (nameOp.getOpName ()).second)
+                return false;
+              break;
+
+            default:
+              break;
+            }
+        }
+    }
+
+  return true;
+}
@@ -12,6 +12,7 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <vector>
 
 class CCoinsViewCache;
 class CTxMemPool;
@@ -194,6 +195,17 @@ public:
    */
   bool checkTx (const CTransaction& tx) const;
 
+  /**
+   * Checks if a package of transactions can be added together (based on
+   * name criteria).  This is checkTx for each of them, plus the conflicts
+   * between the transactions of the package themselves, in a single pass.
+   * @param txns The package, parents before children.
+   * @param failed Set to the index of the first conflicting tx.
+   * @return True if none of them conflicts.
+   */
+  bool checkPackage (const std::vector<CTransactionRef>& txns,
+                     size_t& failed) const;
+
 };
 
 #endif // H_BITCOIN_NAMES_MEMPOOL
@@ -102,6 +102,13 @@ enum BindFlags {
 // The sleep time needs to be small to avoid new sockets stalling
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 
+#ifdef USE_EPOLL
+/** How often the epoll socket handler runs inactivity checks over all nodes. */
+static constexpr std::chrono::seconds SOCKET_SWEEP_INTERVAL{1};
+/** Epoll tags of listening sockets (their index is added); node ids never get this high. */
+static constexpr uint64_t LISTEN_SOCKET_TAG{uint64_t{1} << 63};
+#endif
+
 const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -116,6 +123,8 @@ RecursiveMutex cs_mapLocalHost;
 std::map<CNetAddr, LocalServiceInfo> mapLocalHost GUARDED_BY(cs_mapLocalHost);
 static bool vfLimited[NET_MAX] GUARDED_BY(cs_mapLocalHost) = {};
 std::string strSubVersion;
+/** Buffers for received messages, shared by all peers */
+static const std::shared_ptr<RecvBufferPool> g_recv_buffer_pool{std::make_shared<RecvBufferPool>()};
 
 void CConnman::AddAddrFetch(const std::string& strDest)
 {
@@ -674,6 +683,61 @@ bool CNode::ReceiveMsgBytes(Span<const uint8_t> msg_bytes, bool& complete)
     return true;
 }
 
+int RecvBufferPool::SizeClass(size_t size)
+{
+    int size_class{MIN_CLASS};
+    while (size_class < MAX_CLASS && (size_t{1} << size_class) < size) ++size_class;
+    return size_class;
+}
+
+SerializeData RecvBufferPool::Acquire(size_t size, size_t preferred_size)
+{
+    const int size_class{SizeClass(size)};
+    {
+        LOCK(m_mutex);
+        for (const int c : {SizeClass(preferred_size), size_class}) {
+            auto& free{m_free[c - MIN_CLASS]};
+            if (c < size_class || free.empty()) continue;
+            SerializeData buffer{std::move(free.back())};
+            free.pop_back();
+            m_stats.pooled_bytes -= buffer.capacity();
+            ++m_stats.reuses;
+            return buffer;
+        }
+        ++m_stats.allocations;
+    }
+    SerializeData buffer;
+    buffer.reserve(std::max(size, size_t{1} << size_class));
+    return buffer;
+}
+
+void RecvBufferPool::Release(SerializeData&& buffer)
+{
+    const size_t capacity{buffer.capacity()};
+    if (capacity < RECV_BUFFER_MIN_SIZE) return;
+    // The largest class the buffer can serve
+    int size_class{SizeClass(capacity)};
+    if ((size_t{1} << size_class) > capacity) --size_class;
+
+    LOCK(m_mutex);
+    // Otherwise the buffer is freed by the caller, outside the lock.
+    if (m_stats.pooled_bytes + capacity > m_max_pooled_bytes) return;
+    buffer.clear();
+    m_free[size_class - MIN_CLASS].push_back(std::move(buffer));
+    m_stats.pooled_bytes += capacity;
+}
+
+RecvBufferPoolStats RecvBufferPool::GetStats() const
+{
+    LOCK(m_mutex);
+    return m_stats;
+}
+
+CNetMessage::~CNetMessage()
+{
+    if (m_pool) m_pool->Release(m_recv.TakeBuffer());
+}
+
 int V1TransportDeserializer::readHeader(Span<const uint8_t> msg_bytes)
 {
     // copy data to temporary parsing buffer
@@ -721,16 +785,46 @@ int V1TransportDeserializer::readData(Span<const uint8_t> msg_bytes)
 
     if (vRecv.size() < nDataPos + nCopy) {
         // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+        GrowRecvBuffer(std::min(hdr.nMessageSize, nDataPos + nCopy + RECV_ALLOC_AHEAD));
     }
 
     hasher.Write(msg_bytes.first(nCopy));
-    memcpy(&vRecv[nDataPos], msg_bytes.data(), nCopy);
+    // Bytes received through GetDirectReadBuffer() are in place already.
+    if (msg_bytes.data() != vRecv.data() + nDataPos) {
+        memcpy(&vRecv[nDataPos], msg_bytes.data(), nCopy);
+        m_bytes_copied += nCopy;
+    }
     nDataPos += nCopy;
 
     return nCopy;
 }
 
+void V1TransportDeserializer::GrowRecvBuffer(unsigned int size)
+{
+    if (size > vRecv.capacity()) {
+        // What was received so far moves to the larger buffer.
+        m_bytes_copied += nDataPos;
+        if (m_pool) {
+            SerializeData buffer{m_pool->Acquire(size, hdr.nMessageSize)};
+            buffer.assign(vRecv.begin(), vRecv.begin() + nDataPos);
+            std::swap(buffer, vRecv);
+            m_pool->Release(std::move(buffer));
+        }
+    }
+    vRecv.resize(size);
+}
+
+Span<uint8_t> V1TransportDeserializer::GetDirectReadBuffer()
+{
+    if (!in_data) return {};
+    const unsigned int remaining{hdr.nMessageSize - nDataPos};
+    if (remaining < DIRECT_READ_MIN_SIZE) return {};
+    if (vRecv.size() <= nDataPos) {
+        GrowRecvBuffer(std::min(hdr.nMessageSize, nDataPos + RECV_ALLOC_AHEAD));
+    }
+    return Span{vRecv}.subspan(nDataPos, std::min<size_t>(remaining, vRecv.size() - nDataPos));
+}
+
 const uint256& V1TransportDeserializer::GetMessageHash() const
 {
     assert(Complete());
@@ -744,7 +838,8 @@ CNetMessage V1TransportDeserializer::GetMessage(const std::chrono::microseconds
     // Initialize out parameter
     reject_message = false;
     // decompose a single CNetMessage from the TransportDeserializer
-    CNetMessage msg(std::move(vRecv));
+    CNetMessage msg(CDataStream{std::move(vRecv), m_recv_type, m_recv_version}, m_pool);
+    msg.m_bytes_copied = m_bytes_copied;
 
     // store command string, time, and sizes
     msg.m_command = hdr.GetCommand();
@@ -778,10 +873,10 @@ CNetMessage V1TransportDeserializer::GetMessage(const std::chrono::microseconds
 
 void V1TransportSerializer::prepareForTransport(CSerializedNetMsg& msg, std::vector<unsigned char>& header) {
     // create dbl-sha256 checksum
-    uint256 hash = Hash(msg.data);
+    const uint256 hash = msg.m_shared_payload ? msg.m_shared_payload->hash : Hash(msg.data);
 
     // create header
-    CMessageHeader hdr(Params().MessageStart(), msg.m_type.c_str(), msg.data.size());
+    CMessageHeader hdr(Params().MessageStart(), msg.m_type.c_str(), msg.Payload().size());
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
     // serialize header
@@ -795,7 +890,7 @@ size_t CConnman::SocketSendData(CNode& node) const
     size_t nSentSize = 0;
 
     while (it != node.vSendMsg.end()) {
-        const auto& data = *it;
+        const auto data = it->Data();
         assert(data.size() > node.nSendOffset);
         int nBytes = 0;
         {
@@ -1213,6 +1308,9 @@ void CConnman::CreateNodeFromAcceptedSocket(SOCKET hSocket,
     {
         LOCK(m_nodes_mutex);
         m_nodes.push_back(pnode);
+#ifdef USE_EPOLL
+        if (m_epoll) m_nodes_unregistered.push_back(pnode);
+#endif
     }
 
     // We received a new connection, harvest entropy from the time (and our peer count)
@@ -1276,6 +1374,9 @@ void CConnman::DisconnectNodes()
             {
                 // remove from m_nodes
                 m_nodes.erase(remove(m_nodes.begin(), m_nodes.end(), pnode), m_nodes.end());
+#ifdef USE_EPOLL
+                UnregisterNodeSocket(pnode);
+#endif
 
                 // release outbound grant (if any)
                 pnode->grantOutbound.Release();
@@ -1527,6 +1628,13 @@ void CConnman::SocketEvents(const std::vector<CNode*>& nodes,
 
 void CConnman::SocketHandler()
 {
+#ifdef USE_EPOLL
+    if (m_epoll) {
+        SocketHandlerEpoll();
+        return;
+    }
+#endif
+
     std::set<SOCKET> recv_set;
     std::set<SOCKET> send_set;
     std::set<SOCKET> error_set;
@@ -1573,59 +1681,7 @@ void CConnman::SocketHandlerConnected(const std::vector<CNode*>& nodes,
         }
         if (recvSet || errorSet)
         {
-            // typical socket buffer is 8K-64K
-            uint8_t pchBuf[0x10000];
-            int nBytes = 0;
-            {
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                nBytes = recv(pnode->hSocket, (char*)pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-            }
-            if (nBytes > 0)
-            {
-                bool notify = false;
-                if (!pnode->ReceiveMsgBytes({pchBuf, (size_t)nBytes}, notify)) {
-                    pnode->CloseSocketDisconnect();
-                }
-                RecordBytesRecv(nBytes);
-                if (notify) {
-                    size_t nSizeAdded = 0;
-                    auto it(pnode->vRecvMsg.begin());
-                    for (; it != pnode->vRecvMsg.end(); ++it) {
-                        // vRecvMsg contains only completed CNetMessage
-                        // the single possible partially deserialized message are held by TransportDeserializer
-                        nSizeAdded += it->m_raw_message_size;
-                    }
-                    {
-                        LOCK(pnode->cs_vProcessMsg);
-                        pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
-                        pnode->nProcessQueueSize += nSizeAdded;
-                        pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
-                    }
-                    WakeMessageHandler();
-                }
-            }
-            else if (nBytes == 0)
-            {
-                // socket closed gracefully
-                if (!pnode->fDisconnect) {
-                    LogPrint(BCLog::NET, "socket closed for peer=%d\n", pnode->GetId());
-                }
-                pnode->CloseSocketDisconnect();
-            }
-            else if (nBytes < 0)
-            {
-                // error
-                int nErr = WSAGetLastError();
-                if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                {
-                    if (!pnode->fDisconnect) {
-                        LogPrint(BCLog::NET, "socket recv error for peer=%d: %s\n", pnode->GetId(), NetworkErrorString(nErr));
-                    }
-                    pnode->CloseSocketDisconnect();
-                }
-            }
+            SocketRecvData(*pnode);
         }
 
         if (sendSet) {
@@ -1638,6 +1694,165 @@ void CConnman::SocketHandlerConnected(const std::vector<CNode*>& nodes,
     }
 }
 
+bool CConnman::SocketRecvData(CNode& node)
+{
+    // typical socket buffer is 8K-64K
+    uint8_t pchBuf[0x10000];
+    // The bulk of large messages is received straight into their buffer.
+    Span<uint8_t> buffer{WITH_LOCK(node.cs_vRecv, return node.m_deserializer->GetDirectReadBuffer())};
+    if (buffer.empty()) buffer = pchBuf;
+    int nBytes = 0;
+    {
+        LOCK(node.cs_hSocket);
+        if (node.hSocket == INVALID_SOCKET)
+            return false;
+        nBytes = recv(node.hSocket, (char*)buffer.data(), buffer.size(), MSG_DONTWAIT);
+    }
+    if (nBytes > 0)
+    {
+        bool notify = false;
+        if (!node.ReceiveMsgBytes(buffer.first(nBytes), notify)) {
+            node.CloseSocketDisconnect();
+        }
+        RecordBytesRecv(nBytes);
+        if (notify) {
+            size_t nSizeAdded = 0;
+            auto it(node.vRecvMsg.begin());
+            for (; it != node.vRecvMsg.end(); ++it) {
+                // vRecvMsg contains only completed CNetMessage
+                // the single possible partially deserialized message are held by TransportDeserializer
+                nSizeAdded += it->m_raw_message_size;
+            }
+            {
+                LOCK(node.cs_vProcessMsg);
+                node.vProcessMsg.splice(node.vProcessMsg.end(), node.vRecvMsg, node.vRecvMsg.begin(), it);
+                node.nProcessQueueSize += nSizeAdded;
+                node.fPauseRecv = node.nProcessQueueSize > nReceiveFloodSize;
+            }
+            WakeMessageHandler();
+        }
+        return size_t(nBytes) == buffer.size();
+    }
+    else if (nBytes == 0)
+    {
+        // socket closed gracefully
+        if (!node.fDisconnect) {
+            LogPrint(BCLog::NET, "socket closed for peer=%d\n", node.GetId());
+        }
+        node.CloseSocketDisconnect();
+    }
+    else if (nBytes < 0)
+    {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+        {
+            if (!node.fDisconnect) {
+                LogPrint(BCLog::NET, "socket recv error for peer=%d: %s\n", node.GetId(), NetworkErrorString(nErr));
+            }
+            node.CloseSocketDisconnect();
+        }
+    }
+    return false;
+}
+
+#ifdef USE_EPOLL
+void CConnman::SocketHandlerEpoll()
+{
+    // Register the sockets of the nodes added since the last round. Readiness
+    // the sockets already have is reported by the next wait.
+    std::vector<CNode*> added;
+    WITH_LOCK(m_nodes_mutex, added.swap(m_nodes_unregistered));
+    for (CNode* pnode : added) {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET) continue;
+        if (!m_epoll->Add(pnode->hSocket, pnode->GetId(), Sock::RECV | Sock::SEND, /*edge_triggered=*/true)) {
+            LogPrintf("Failed to watch socket of peer=%d: %s\n", pnode->GetId(), NetworkErrorString(WSAGetLastError()));
+            pnode->fDisconnect = true;
+            continue;
+        }
+        m_epoll_nodes.emplace(pnode->GetId(), pnode);
+    }
+
+    // Don't wait if a node still has buffered input we can read right away.
+    const bool busy{std::any_of(m_epoll_ready.begin(), m_epoll_ready.end(), [](const CNode* pnode) {
+        return pnode->m_sock_error || (pnode->m_sock_recv_ready && !pnode->fPauseRecv);
+    })};
+
+    std::vector<EpollEvents::Event> events;
+    if (!m_epoll->Wait(busy ? 0ms : std::chrono::milliseconds{SELECT_TIMEOUT_MILLISECONDS}, events)) {
+        LogPrintf("socket epoll error %s\n", NetworkErrorString(WSAGetLastError()));
+        interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return;
+    }
+    if (interruptNet) return;
+
+    std::vector<size_t> listen_ready;
+    std::vector<CNode*> send_ready;
+    for (const EpollEvents::Event& event : events) {
+        if (event.tag >= LISTEN_SOCKET_TAG) {
+            listen_ready.push_back(event.tag - LISTEN_SOCKET_TAG);
+            continue;
+        }
+        const auto it{m_epoll_nodes.find(event.tag)};
+        if (it == m_epoll_nodes.end()) continue;
+        CNode* pnode{it->second};
+        if (event.recv || event.error) {
+            pnode->m_sock_recv_ready = true;
+            pnode->m_sock_error |= event.error;
+            m_epoll_ready.insert(pnode);
+        }
+        if (event.send) send_ready.push_back(pnode);
+    }
+
+    const auto now{GetTime<std::chrono::seconds>()};
+    if (now >= m_next_socket_sweep) {
+        m_next_socket_sweep = now + SOCKET_SWEEP_INTERVAL;
+        for (const auto& [id, pnode] : m_epoll_nodes) {
+            if (InactivityCheck(*pnode)) pnode->fDisconnect = true;
+            // A send that fell short is normally followed by a write event;
+            // retry here as well rather than rely on that alone.
+            if (WITH_LOCK(pnode->cs_vSend, return !pnode->vSendMsg.empty())) {
+                send_ready.push_back(pnode);
+            }
+        }
+    }
+
+    // Service (send/receive) the nodes that are ready. Edge-triggered events
+    // are only reported once, so nodes stay in m_epoll_ready until a receive
+    // comes up short.
+    for (auto it = m_epoll_ready.begin(); it != m_epoll_ready.end();) {
+        if (interruptNet) return;
+        CNode* pnode{*it};
+        if (pnode->m_sock_error || !pnode->fPauseRecv) {
+            pnode->m_sock_recv_ready = SocketRecvData(*pnode);
+            pnode->m_sock_error = false;
+        }
+        it = pnode->m_sock_recv_ready ? std::next(it) : m_epoll_ready.erase(it);
+    }
+    for (CNode* pnode : send_ready) {
+        if (interruptNet) return;
+        size_t bytes_sent = WITH_LOCK(pnode->cs_vSend, return SocketSendData(*pnode));
+        if (bytes_sent) RecordBytesSent(bytes_sent);
+    }
+
+    // Accept new connections from listening sockets.
+    for (const size_t index : listen_ready) {
+        if (interruptNet) return;
+        AcceptConnection(vhListenSocket[index]);
+    }
+}
+
+void CConnman::UnregisterNodeSocket(CNode* pnode)
+{
+    if (!m_epoll) return;
+    m_nodes_unregistered.erase(std::remove(m_nodes_unregistered.begin(), m_nodes_unregistered.end(), pnode), m_nodes_unregistered.end());
+    m_epoll_nodes.erase(pnode->GetId());
+    m_epoll_ready.erase(pnode);
+    // Closing the socket removes it from the epoll set.
+}
+#endif
+
 void CConnman::SocketHandlerListening(const std::set<SOCKET>& recv_set)
 {
     for (const ListenSocket& listen_socket : vhListenSocket) {
@@ -1661,6 +1876,13 @@ void CConnman::ThreadSocketHandler()
     }
 }
 
+void CConnman::WakeSocketHandler()
+{
+#ifdef USE_EPOLL
+    if (m_epoll) m_epoll->Wake();
+#endif
+}
+
 void CConnman::WakeMessageHandler()
 {
     {
@@ -2255,7 +2477,11 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     {
         LOCK(m_nodes_mutex);
         m_nodes.push_back(pnode);
+#ifdef USE_EPOLL
+        if (m_epoll) m_nodes_unregistered.push_back(pnode);
+#endif
     }
+    WakeSocketHandler();
 }
 
 void CConnman::ThreadMessageHandler()
@@ -2585,6 +2811,18 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         fMsgProcWake = false;
     }
 
+#ifdef USE_EPOLL
+    m_epoll = std::make_unique<EpollEvents>();
+    bool epoll_ok{m_epoll->IsValid()};
+    for (size_t i = 0; epoll_ok && i < vhListenSocket.size(); ++i) {
+        epoll_ok = m_epoll->Add(vhListenSocket[i].socket, LISTEN_SOCKET_TAG + i, Sock::RECV, /*edge_triggered=*/false);
+    }
+    if (!epoll_ok) {
+        LogPrintf("Failed to set up epoll (%s), falling back to poll\n", NetworkErrorString(WSAGetLastError()));
+        m_epoll.reset();
+    }
+#endif
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&util::TraceThread, "net", [this] { ThreadSocketHandler(); });
 
@@ -2648,6 +2886,7 @@ void CConnman::Interrupt()
     condMsgProc.notify_all();
 
     interruptNet();
+    WakeSocketHandler();
     InterruptSocks5(true);
 
     if (semOutbound) {
@@ -2717,6 +2956,12 @@ void CConnman::StopNodes()
         DeleteNode(pnode);
     }
     m_nodes_disconnected.clear();
+#ifdef USE_EPOLL
+    WITH_LOCK(m_nodes_mutex, m_nodes_unregistered.clear());
+    m_epoll_nodes.clear();
+    m_epoll_ready.clear();
+    m_epoll.reset();
+#endif
     vhListenSocket.clear();
     semOutbound.reset();
     semAddnode.reset();
@@ -3002,7 +3247,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, SOCKET hSocketIn, const
         LogPrint(BCLog::NET, "Added connection peer=%d\n", id);
     }
 
-    m_deserializer = std::make_unique<V1TransportDeserializer>(V1TransportDeserializer(Params(), id, SER_NETWORK, INIT_PROTO_VERSION));
+    m_deserializer = std::make_unique<V1TransportDeserializer>(V1TransportDeserializer(Params(), id, SER_NETWORK, INIT_PROTO_VERSION, g_recv_buffer_pool));
     m_serializer = std::make_unique<V1TransportSerializer>(V1TransportSerializer());
 }
 
@@ -3018,10 +3263,11 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
 
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 {
-    size_t nMessageSize = msg.data.size();
+    const Span<const unsigned char> payload{msg.Payload()};
+    size_t nMessageSize = payload.size();
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n", msg.m_type, nMessageSize, pnode->GetId());
     if (gArgs.GetBoolArg("-capturemessages", false)) {
-        CaptureMessage(pnode->addr, msg.m_type, msg.data, /*is_incoming=*/false);
+        CaptureMessage(pnode->addr, msg.m_type, payload, /*is_incoming=*/false);
     }
 
     TRACE6(net, outbound_message,
@@ -3029,8 +3275,8 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         pnode->m_addr_name.c_str(),
         pnode->ConnectionTypeAsString().c_str(),
         msg.m_type.c_str(),
-        msg.data.size(),
-        msg.data.data()
+        payload.size(),
+        payload.data()
     );
 
     // make sure we use the appropriate network transport format
@@ -3048,8 +3294,14 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         pnode->nSendSize += nTotalSize;
 
         if (pnode->nSendSize > nSendBufferMaxSize) pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize) pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.emplace_back(std::move(serializedHeader));
+        if (nMessageSize) {
+            if (msg.m_shared_payload) {
+                pnode->vSendMsg.emplace_back(std::move(msg.m_shared_payload));
+            } else {
+                pnode->vSendMsg.emplace_back(std::move(msg.data));
+            }
+        }
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend) nBytesSent = SocketSendData(*pnode);
@@ -25,7 +25,9 @@
 #include <threadinterrupt.h>
 #include <uint256.h>
 #include <util/check.h>
+#include <util/sock.h>
 
+#include <array>
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
@@ -34,6 +36,8 @@
 #include <memory>
 #include <optional>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class AddrMan;
@@ -103,6 +107,20 @@ struct AddedNodeInfo
 class CNodeStats;
 class CClientUIInterface;
 
+/**
+ * A message payload that is sent to several peers without being copied for
+ * each of them, such as a block. Its checksum is computed only once.
+ */
+struct SharedNetPayload
+{
+    explicit SharedNetPayload(std::vector<unsigned char>&& data_in)
+        : data{std::move(data_in)}, hash{Hash(data)} {}
+
+    const std::vector<unsigned char> data;
+    //! Double-SHA256 of data
+    const uint256 hash;
+};
+
 struct CSerializedNetMsg
 {
     CSerializedNetMsg() = default;
@@ -114,6 +132,24 @@ struct CSerializedNetMsg
 
     std::vector<unsigned char> data;
     std::string m_type;
+    //! If set, the payload, in place of data
+    std::shared_ptr<const SharedNetPayload> m_shared_payload;
+
+    Span<const unsigned char> Payload() const { return m_shared_payload ? Span{m_shared_payload->data} : Span{data}; }
+};
+
+/** Data queued for sending to a peer: either owned, or a payload shared with other peers. */
+class SendBuffer
+{
+public:
+    explicit SendBuffer(std::vector<unsigned char>&& data) : m_data{std::move(data)} {}
+    explicit SendBuffer(std::shared_ptr<const SharedNetPayload> shared) : m_shared{std::move(shared)} {}
+
+    Span<const unsigned char> Data() const { return m_shared ? Span{m_shared->data} : Span{m_data}; }
+
+private:
+    std::vector<unsigned char> m_data;
+    std::shared_ptr<const SharedNetPayload> m_shared;
 };
 
 /** Different types of connections to a peer. This enum encapsulates the
@@ -281,6 +317,62 @@ public:
 };
 
 
+struct RecvBufferPoolStats {
+    //! Buffers that had to be allocated
+    uint64_t allocations{0};
+    //! Buffers handed out again after being released
+    uint64_t reuses{0};
+    //! Total capacity of the buffers waiting to be reused
+    size_t pooled_bytes{0};
+};
+
+/**
+ * Buffers for the payload of received messages, shared by all peers. A
+ * buffer given back once its message has been processed is handed out again
+ * for a later message of similar size, instead of being freed (and wiped,
+ * see zero_after_free_allocator) and allocated anew.
+ *
+ * Buffers are sorted into power of two size classes, from RECV_BUFFER_MIN_SIZE
+ * up to MAX_PROTOCOL_MESSAGE_LENGTH. At most m_max_pooled_bytes are kept.
+ */
+class RecvBufferPool
+{
+public:
+    static constexpr size_t RECV_BUFFER_MIN_SIZE{4096};
+    /** Default for the total capacity of the buffers kept for reuse */
+    static constexpr size_t DEFAULT_MAX_POOLED_BYTES{16 << 20};
+
+    explicit RecvBufferPool(size_t max_pooled_bytes = DEFAULT_MAX_POOLED_BYTES) : m_max_pooled_bytes{max_pooled_bytes} {}
+
+    /**
+     * Get an empty buffer with room for at least size bytes. If a buffer with
+     * room for preferred_size bytes is waiting to be reused, that one is
+     * returned instead: it costs nothing more, and saves growing the buffer
+     * later. Only size is ever allocated, though.
+     */
+    SerializeData Acquire(size_t size, size_t preferred_size = 0) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Give back a buffer for reuse. */
+    void Release(SerializeData&& buffer) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    RecvBufferPoolStats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    static constexpr int MIN_CLASS{12};
+    static constexpr int MAX_CLASS{25};
+    static_assert(size_t{1} << MIN_CLASS == RECV_BUFFER_MIN_SIZE);
+    static_assert(size_t{1} << MAX_CLASS >= MAX_PROTOCOL_MESSAGE_LENGTH);
+
+    /** The smallest class of buffers with room for size bytes */
+    static int SizeClass(size_t size);
+
+    const size_t m_max_pooled_bytes;
+
+    mutable Mutex m_mutex;
+    std::array<std::vector<SerializeData>, MAX_CLASS - MIN_CLASS + 1> m_free GUARDED_BY(m_mutex);
+    RecvBufferPoolStats m_stats GUARDED_BY(m_mutex);
+};
+
 /** Transport protocol agnostic message container.
  * Ideally it should only contain receive time, payload,
  * command and size.
@@ -291,14 +383,24 @@ public:
     std::chrono::microseconds m_time{0}; //!< time of message receipt
     uint32_t m_message_size{0};          //!< size of the payload
     uint32_t m_raw_message_size{0};      //!< used wire size of the message (including header/checksum)
+    //! Payload bytes copied on the way from the socket into m_recv (as opposed to received in place)
+    uint32_t m_bytes_copied{0};
     std::string m_command;
 
-    CNetMessage(CDataStream&& recv_in) : m_recv(std::move(recv_in)) {}
+    CNetMessage(CDataStream&& recv_in, std::shared_ptr<RecvBufferPool> pool = nullptr)
+        : m_recv(std::move(recv_in)), m_pool(std::move(pool)) {}
+    CNetMessage(CNetMessage&&) = default;
+    CNetMessage& operator=(CNetMessage&&) = default;
+    ~CNetMessage();
 
     void SetVersion(int nVersionIn)
     {
         m_recv.SetVersion(nVersionIn);
     }
+
+private:
+    //! Where the buffer of m_recv goes once the message is processed
+    std::shared_ptr<RecvBufferPool> m_pool;
 };
 
 /** The TransportDeserializer takes care of holding and deserializing the
@@ -313,6 +415,13 @@ public:
     virtual void SetVersion(int version) = 0;
     /** read and deserialize data, advances msg_bytes data pointer */
     virtual int Read(Span<const uint8_t>& msg_bytes) = 0;
+    /**
+     * Where to receive the next bytes from the socket, if they can go straight
+     * into the buffer of the message being received. Passing them to Read()
+     * afterwards then doesn't copy them. Empty if they must be received into a
+     * separate buffer.
+     */
+    virtual Span<uint8_t> GetDirectReadBuffer() { return {}; }
     // decomposes a message from the context
     virtual CNetMessage GetMessage(std::chrono::microseconds time, bool& reject_message) = 0;
     virtual ~TransportDeserializer() {}
@@ -323,18 +432,29 @@ class V1TransportDeserializer final : public TransportDeserializer
 private:
     const CChainParams& m_chain_params;
     const NodeId m_node_id; // Only for logging
+    const std::shared_ptr<RecvBufferPool> m_pool;
     mutable CHash256 hasher;
     mutable uint256 data_hash;
     bool in_data;                   // parsing header (false) or data (true)
     CDataStream hdrbuf;             // partially received header
     CMessageHeader hdr;             // complete header
-    CDataStream vRecv;              // received message data
+    SerializeData vRecv;            // received message data
+    int m_recv_type;
+    int m_recv_version;
     unsigned int nHdrPos;
     unsigned int nDataPos;
+    unsigned int m_bytes_copied;
+
+    /** How far ahead of the received data to allocate the payload buffer */
+    static constexpr unsigned int RECV_ALLOC_AHEAD{256 * 1024};
+    /** Smaller remainders of a payload are received along with what follows them instead of in place */
+    static constexpr unsigned int DIRECT_READ_MIN_SIZE{64 * 1024};
 
     const uint256& GetMessageHash() const;
     int readHeader(Span<const uint8_t> msg_bytes);
     int readData(Span<const uint8_t> msg_bytes);
+    /** Make room in vRecv for the payload up to the given size. */
+    void GrowRecvBuffer(unsigned int size);
 
     void Reset() {
         vRecv.clear();
@@ -343,16 +463,21 @@ private:
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
+        m_bytes_copied = 0;
         data_hash.SetNull();
         hasher.Reset();
     }
 
 public:
-    V1TransportDeserializer(const CChainParams& chain_params, const NodeId node_id, int nTypeIn, int nVersionIn)
+    /** Receive buffers are taken from the given pool, if any, and return to it once the message is processed. */
+    V1TransportDeserializer(const CChainParams& chain_params, const NodeId node_id, int nTypeIn, int nVersionIn,
+                            std::shared_ptr<RecvBufferPool> pool = nullptr)
         : m_chain_params(chain_params),
           m_node_id(node_id),
+          m_pool(std::move(pool)),
           hdrbuf(nTypeIn, nVersionIn),
-          vRecv(nTypeIn, nVersionIn)
+          m_recv_type(nTypeIn),
+          m_recv_version(nVersionIn)
     {
         Reset();
     }
@@ -366,7 +491,7 @@ public:
     void SetVersion(int nVersionIn) override
     {
         hdrbuf.SetVersion(nVersionIn);
-        vRecv.SetVersion(nVersionIn);
+        m_recv_version = nVersionIn;
     }
     int Read(Span<const uint8_t>& msg_bytes) override
     {
@@ -378,6 +503,7 @@ public:
         }
         return ret;
     }
+    Span<uint8_t> GetDirectReadBuffer() override;
     CNetMessage GetMessage(std::chrono::microseconds time, bool& reject_message) override;
 };
 
@@ -413,7 +539,7 @@ public:
     /** Offset inside the first vSendMsg already sent */
     size_t nSendOffset GUARDED_BY(cs_vSend){0};
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
+    std::deque<SendBuffer> vSendMsg GUARDED_BY(cs_vSend);
     Mutex cs_vSend;
     Mutex cs_hSocket;
     Mutex cs_vRecv;
@@ -697,6 +823,11 @@ private:
 
     std::list<CNetMessage> vRecvMsg; // Used only by SocketHandler thread
 
+    //! The socket may have data to receive (or be in error), as far as
+    //! edge-triggered readiness events tell. Used only by SocketHandler thread
+    bool m_sock_recv_ready{false};
+    bool m_sock_error{false};
+
     // Our address, as reported by the peer
     CService addrLocal GUARDED_BY(cs_addrLocal);
     mutable RecursiveMutex cs_addrLocal;
@@ -941,6 +1072,9 @@ public:
 
     void WakeMessageHandler();
 
+    /** Interrupt the socket handler's wait, e.g. after a node stops pausing receives. */
+    void WakeSocketHandler();
+
     /** Attempts to obfuscate tx time through exponentially distributed emitting.
         Works assuming that a single interval is used.
         Variable intervals will result in privacy decrease.
@@ -1040,6 +1174,26 @@ private:
      */
     void SocketHandlerListening(const std::set<SOCKET>& recv_set);
 
+    /**
+     * Receive once from a node's socket and hand complete messages to the
+     * message handler. Closes the socket on errors and end of stream.
+     * @return true if the receive buffer was filled, so there may be more to read
+     */
+    bool SocketRecvData(CNode& node);
+
+#ifdef USE_EPOLL
+    /**
+     * SocketHandler() for the epoll backend: register the sockets of new nodes,
+     * wait for readiness events and only service the nodes that got one (or
+     * still have buffered input). Inactivity checks run every
+     * SOCKET_SWEEP_INTERVAL rather than every round.
+     */
+    void SocketHandlerEpoll();
+
+    /** Forget a node that is being disconnected. */
+    void UnregisterNodeSocket(CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(m_nodes_mutex);
+#endif
+
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -1110,6 +1264,23 @@ private:
     std::vector<CNode*> m_nodes GUARDED_BY(m_nodes_mutex);
     std::list<CNode*> m_nodes_disconnected;
     mutable RecursiveMutex m_nodes_mutex;
+
+#ifdef USE_EPOLL
+    /**
+     * Persistent socket registrations of the socket handler, or nullptr to
+     * rebuild a poll() set every round. Created before the socket handler
+     * thread starts and destroyed after it stopped.
+     */
+    std::unique_ptr<EpollEvents> m_epoll;
+    //! Nodes added since the socket handler last registered new sockets
+    std::vector<CNode*> m_nodes_unregistered GUARDED_BY(m_nodes_mutex);
+    //! Registered nodes by node id (the epoll tag). Used only by SocketHandler thread
+    std::unordered_map<NodeId, CNode*> m_epoll_nodes;
+    //! Nodes with I/O to do without waiting for a new event. Used only by SocketHandler thread
+    std::unordered_set<CNode*> m_epoll_ready;
+    //! When to next run inactivity checks over all nodes. Used only by SocketHandler thread
+    std::chrono::seconds m_next_socket_sweep{0};
+#endif
     std::atomic<NodeId> nLastNodeId{0};
     unsigned int nPrevNodeCount{0};
 
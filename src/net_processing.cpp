@@ -18,8 +18,13 @@
 #include <merkleblock.h>
 #include <netbase.h>
 #include <netmessagemaker.h>
+#include <node/blockdownload.h>
+#include <node/blockservecache.h>
 #include <node/blockstorage.h>
+#include <node/txprevalidation.h>
+#include <node/txreconciliation.h>
 #include <policy/fees.h>
+#include <policy/packages.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
@@ -95,8 +100,14 @@ static constexpr auto OVERLOADED_PEER_TX_DELAY = std::chrono::seconds{2};
 static constexpr std::chrono::microseconds GETDATA_TX_INTERVAL{std::chrono::seconds{60}};
 /** Limit to avoid sending big packets. Not used in processing incoming GETDATA for compatibility */
 static const unsigned int MAX_GETDATA_SZ = 1000;
-/** Number of blocks that can be requested at any given time from a single peer. */
-static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** How long the parents of an orphan wait to be requested one by one while its package
+ *  is requested from a package relay peer. */
+static constexpr auto PKGTXNS_RESPONSE_DELAY{2s};
+/** Maximum number of getpkgtxns requests to a peer that can be in flight at once. */
+static constexpr size_t MAX_PKGTXNS_IN_FLIGHT{100};
+/** Maximum number of orphans accepted or rejected in one ProcessOrphanTx call, so
+ *  that a long chain of orphans doesn't hold up the other peers' messages. */
+static constexpr size_t MAX_ORPHANS_PER_BATCH{8};
 /** Time during which a peer must stall block download progress before being disconnected. */
 static constexpr auto BLOCK_STALLING_TIMEOUT = 2s;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -125,8 +136,8 @@ static const int MAX_CMPCTBLOCK_DEPTH = 5;
 static const int MAX_BLOCKTXN_DEPTH = 10;
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
- *  degree of disordering of blocks on disk (which make reindexing and pruning harder). We'll probably
- *  want to make this a per-peer adaptive value at some point. */
+ *  degree of disordering of blocks on disk (which make reindexing and pruning harder). How many blocks
+ *  are in flight from each peer within it is adapted to the peer's speed (see BlockDownloadRate). */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 /** Block download timeout base, expressed in multiples of the block interval (i.e. 10 min) */
 static constexpr double BLOCK_DOWNLOAD_TIMEOUT_BASE = 1;
@@ -189,6 +200,8 @@ struct QueuedBlock {
     const CBlockIndex* pindex;
     /** Optional, used for CMPCTBLOCK downloads */
     std::unique_ptr<PartiallyDownloadedBlock> partialBlock;
+    /** When the block was requested */
+    std::chrono::microseconds m_requested;
 };
 
 /**
@@ -293,6 +306,11 @@ struct Peer {
     /** Set of txids to reconsider once their parent transactions have been accepted **/
     std::set<uint256> m_orphan_work_set GUARDED_BY(g_cs_orphans);
 
+    /** Transaction from this peer being pre-validated, if any. Further
+     *  messages from the peer wait until it is done, so that they are
+     *  processed in order. Only accessed by the message handler thread. */
+    std::shared_ptr<TxPreValidationJob> m_prevalidating_tx;
+
     /** Protects m_getdata_requests **/
     Mutex m_getdata_requests_mutex;
     /** Work queue of items requested by this peer **/
@@ -305,6 +323,8 @@ struct Peer {
 
 using PeerRef = std::shared_ptr<Peer>;
 
+struct CNodeState;
+
 class PeerManagerImpl final : public PeerManager
 {
 public:
@@ -330,6 +350,8 @@ public:
     void CheckForStaleTipAndEvictPeers() override;
     bool FetchBlock(NodeId id, const uint256& hash, const CBlockIndex& index) override;
     bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats) const override;
+    std::optional<TxPreValidationStats> GetTxPreValidationStats() const override;
+    std::optional<BlockServeCacheStats> GetBlockServeCacheStats() const override;
     bool IgnoresIncomingTxs() override { return m_ignore_incoming_txs; }
     void SendPings() override;
     void RelayTransaction(const uint256& txid, const uint256& wtxid) override;
@@ -388,6 +410,17 @@ private:
     bool MaybeDiscourageAndDisconnect(CNode& pnode, Peer& peer);
 
     void ProcessOrphanTx(std::set<uint256>& orphan_work_set) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans);
+    /** Hand a transaction received from a peer to mempool acceptance, and act on the result. */
+    void ProcessIncomingTx(CNode& pfrom, Peer& peer, const CTransactionRef& ptx) LOCKS_EXCLUDED(cs_main, g_cs_orphans);
+    /** Ask a package relay peer for a tx together with its unconfirmed ancestors. Returns false
+     *  if too many such requests to the peer are in flight already. */
+    bool RequestPackage(CNode& node, CNodeState& state, const uint256& wtxid, std::chrono::microseconds current_time)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /** Answer a getpkgtxns request with the tx and its unconfirmed ancestors, parents first. */
+    void SendPackage(CNode& pfrom, const uint256& wtxid) LOCKS_EXCLUDED(cs_main);
+    /** Submit a package received in answer to a getpkgtxns request to the mempool, as a whole. */
+    void ProcessPackageTxns(CNode& pfrom, Peer& peer, const uint256& wtxid, const Package& package)
+        LOCKS_EXCLUDED(cs_main, g_cs_orphans);
     /** Process a single headers message from a peer. */
     void ProcessHeadersMessage(CNode& pfrom, const Peer& peer,
                                const std::vector<CBlockHeader>& headers,
@@ -443,6 +476,18 @@ private:
     /** Whether this node is running in blocks only mode */
     const bool m_ignore_incoming_txs;
 
+    /** Per-peer state of transaction reconciliation (BIP330), if enabled with -txreconciliation. */
+    std::unique_ptr<TxReconciliationTracker> m_txreconciliation;
+
+    /** Whether we relay packages of unconfirmed transactions, if enabled with -packagerelay. */
+    bool m_package_relay{false};
+
+    /** Workers pre-validating transactions from peers, if enabled with -txprevalidationthreads. */
+    std::unique_ptr<TxPreValidator> m_txprevalidator;
+
+    /** Blocks recently served to peers, in their serialized form, if enabled with -blockservecachesize. */
+    std::unique_ptr<BlockServeCache> m_block_serve_cache;
+
     /** Whether we've completed initial sync yet, for determining when to turn
       * on extra block-relay-only peers. */
     bool m_initial_sync_finished{false};
@@ -552,7 +597,7 @@ private:
     /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
      *  at most count entries.
      */
-    void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const CBlockIndex*& stalled_block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight GUARDED_BY(cs_main);
 
@@ -615,6 +660,9 @@ private:
     bool AlreadyHaveBlock(const uint256& block_hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     void ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv& inv);
 
+    /** Send a block message to a peer, sharing its payload with other peers through the block serve cache. */
+    void PushBlockMessage(CNode& node, const uint256& hash, BlockServeFormat format, CSerializedNetMsg&& msg);
+
     /**
      * Validation logic for compact filters request handling.
      *
@@ -665,6 +713,12 @@ private:
      */
     void ProcessGetCFCheckPt(CNode& peer, CDataStream& vRecv);
 
+    /**
+     * Announce transactions resulting from a reconciliation round to a peer,
+     * skipping those that have left the mempool in the meantime.
+     */
+    void AnnounceReconciledTxs(CNode& peer, const std::vector<uint256>& wtxids) LOCKS_EXCLUDED(::cs_main);
+
     /** Checks if address relay is permitted with peer. If needed, initializes
      * the m_addr_known bloom filter and sets m_addr_relay_enabled to true.
      *
@@ -708,6 +762,8 @@ struct CNodeState {
     //! When the first entry in vBlocksInFlight started downloading. Don't care when vBlocksInFlight is empty.
     std::chrono::microseconds m_downloading_since{0us};
     int nBlocksInFlight{0};
+    //! How fast the peer delivers blocks, which sets how many we request from it at once.
+    BlockDownloadRate m_block_download;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload{false};
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -779,6 +835,11 @@ struct CNodeState {
     //! Whether this peer relays txs via wtxid
     bool m_wtxid_relay{false};
 
+    //! Whether this peer serves the unconfirmed ancestors of its txs on request (package relay)
+    bool m_package_relay{false};
+    //! Wtxids of the txs whose packages were requested from this peer, with the request times
+    std::map<uint256, std::chrono::microseconds> m_pkgtxns_requested;
+
     CNodeState(bool is_inbound) : m_is_inbound(is_inbound) {}
 };
 
@@ -885,7 +946,8 @@ bool PeerManagerImpl::BlockRequested(NodeId nodeid, const CBlockIndex& block, st
     RemoveBlockRequest(hash);
 
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(),
-            {&block, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&m_mempool) : nullptr)});
+            {&block, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&m_mempool) : nullptr),
+             GetTime<std::chrono::microseconds>()});
     state->nBlocksInFlight++;
     if (state->nBlocksInFlight == 1) {
         // We're starting a block download (batch) from this peer.
@@ -899,6 +961,23 @@ bool PeerManagerImpl::BlockRequested(NodeId nodeid, const CBlockIndex& block, st
     return true;
 }
 
+/**
+ * Whether to ask a peer for a block that holds up the download window instead
+ * of waiting for the staller it was requested from: the block is overdue
+ * there, and the peer is expected to deliver it sooner.
+ *
+ * @param[in] position  The position of the block in the staller's queue
+ */
+static bool ShouldRerequestBlock(const CNodeState& state, const CNodeState& staller_state, const QueuedBlock& queued,
+                                 int position, std::chrono::microseconds now) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    // Leave compact block reconstructions alone.
+    if (queued.partialBlock) return false;
+    const auto staller_expected{staller_state.m_block_download.ExpectedDelivery(position)};
+    if (now - queued.m_requested <= staller_expected) return false;
+    return state.m_block_download.ExpectedDelivery(state.nBlocksInFlight) < staller_expected;
+}
+
 void PeerManagerImpl::MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid)
 {
     AssertLockHeld(cs_main);
@@ -1016,7 +1095,7 @@ void PeerManagerImpl::UpdateBlockAvailability(NodeId nodeid, const uint256 &hash
     }
 }
 
-void PeerManagerImpl::FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller)
+void PeerManagerImpl::FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const CBlockIndex*& stalled_block)
 {
     if (count == 0)
         return;
@@ -1054,6 +1133,7 @@ void PeerManagerImpl::FindNextBlocksToDownload(NodeId nodeid, unsigned int count
     int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    const CBlockIndex* waiting_block{nullptr};
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed) successors of pindexWalk (towards
         // pindexBestKnownBlock) into vToFetch. We fetch 128, because CBlockIndex::GetAncestor may be as expensive
@@ -1089,6 +1169,7 @@ void PeerManagerImpl::FindNextBlocksToDownload(NodeId nodeid, unsigned int count
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
                         // We aren't able to fetch anything, but we would be if the download window was one larger.
                         nodeStaller = waitingfor;
+                        stalled_block = waiting_block;
                     }
                     return;
                 }
@@ -1099,6 +1180,7 @@ void PeerManagerImpl::FindNextBlocksToDownload(NodeId nodeid, unsigned int count
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
                 waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                waiting_block = pindex;
             }
         }
     }
@@ -1256,6 +1338,7 @@ void PeerManagerImpl::FinalizeNode(const CNode& node)
         assert(m_orphanage.Size() == 0);
     }
     } // cs_main
+    if (m_txreconciliation) m_txreconciliation->ForgetPeer(nodeid);
     if (node.fSuccessfullyConnected && misbehavior == 0 &&
         !node.IsBlockOnlyConn() && !node.IsInboundConn()) {
         // Only change visible addrman state for full outbound peers.  We don't
@@ -1298,6 +1381,7 @@ bool PeerManagerImpl::GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats) c
             if (queue.pindex)
                 stats.vHeightInFlight.push_back(queue.pindex->nHeight);
         }
+        stats.m_block_download = state->m_block_download.GetStats();
     }
 
     PeerRef peer = GetPeerRef(nodeid);
@@ -1318,10 +1402,23 @@ bool PeerManagerImpl::GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats) c
     stats.m_addr_processed = peer->m_addr_processed.load();
     stats.m_addr_rate_limited = peer->m_addr_rate_limited.load();
     stats.m_addr_relay_enabled = peer->m_addr_relay_enabled.load();
+    if (m_txreconciliation) stats.m_txrecon = m_txreconciliation->GetPeerStats(nodeid);
 
     return true;
 }
 
+std::optional<TxPreValidationStats> PeerManagerImpl::GetTxPreValidationStats() const
+{
+    if (!m_txprevalidator) return std::nullopt;
+    return m_txprevalidator->GetStats();
+}
+
+std::optional<BlockServeCacheStats> PeerManagerImpl::GetBlockServeCacheStats() const
+{
+    if (!m_block_serve_cache) return std::nullopt;
+    return m_block_serve_cache->GetStats();
+}
+
 void PeerManagerImpl::AddToCompactExtraTransactions(const CTransactionRef& tx)
 {
     size_t max_extra_txn = gArgs.GetIntArg("-blockreconstructionextratxn", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN);
@@ -1497,6 +1594,23 @@ PeerManagerImpl::PeerManagerImpl(const CChainParams& chainparams, CConnman& conn
       m_mempool(pool),
       m_ignore_incoming_txs(ignore_incoming_txs)
 {
+    // While Erlay support is incomplete, it must be enabled explicitly via -txreconciliation.
+    // This argument can go away after Erlay support is complete.
+    if (gArgs.GetBoolArg("-txreconciliation", DEFAULT_TXRECONCILIATION_ENABLE)) {
+        m_txreconciliation = std::make_unique<TxReconciliationTracker>(TXRECONCILIATION_VERSION);
+    }
+    m_package_relay = gArgs.GetBoolArg("-packagerelay", DEFAULT_PACKAGE_RELAY);
+    const int prevalidation_threads{std::clamp<int>(gArgs.GetIntArg("-txprevalidationthreads", DEFAULT_TXPREVALIDATION_THREADS), 0, MAX_TXPREVALIDATION_THREADS)};
+    if (prevalidation_threads > 0) {
+        m_txprevalidator = std::make_unique<TxPreValidator>(
+            m_chainman, m_mempool, prevalidation_threads,
+            [this](const CTransaction& tx) { return WITH_LOCK(cs_main, return AlreadyHaveTx(GenTxid::Wtxid(tx.GetWitnessHash()))); },
+            [this] { m_connman.WakeMessageHandler(); });
+    }
+    const int64_t block_serve_cache_size{gArgs.GetIntArg("-blockservecachesize", DEFAULT_BLOCK_SERVE_CACHE_SIZE)};
+    if (block_serve_cache_size > 0) {
+        m_block_serve_cache = std::make_unique<BlockServeCache>(size_t(block_serve_cache_size) << 20);
+    }
 }
 
 void PeerManagerImpl::StartScheduledTasks(CScheduler& scheduler)
@@ -1589,10 +1703,12 @@ void PeerManagerImpl::NewPoWValidBlock(const CBlockIndex *pindex, const std::sha
         fWitnessesPresentInMostRecentCompactBlock = fWitnessEnabled;
     }
 
-    m_connman.ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) {
+    // Serialized once, for the first peer it's sent to
+    std::shared_ptr<const SharedNetPayload> cmpctblock_payload;
+
+    m_connman.ForEachNode([this, &pcmpctblock, &cmpctblock_payload, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) {
         AssertLockHeld(::cs_main);
 
-        // TODO: Avoid the repeated-serialization here
         if (pnode->GetCommonVersion() < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
@@ -1604,7 +1720,15 @@ void PeerManagerImpl::NewPoWValidBlock(const CBlockIndex *pindex, const std::sha
 
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerManager::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
-            m_connman.PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            if (!cmpctblock_payload) {
+                std::vector<unsigned char> data{msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock).data};
+                cmpctblock_payload = m_block_serve_cache ? m_block_serve_cache->Insert(hashBlock, BlockServeFormat::CMPCTBLOCK_WITNESS, std::move(data))
+                                                         : std::make_shared<const SharedNetPayload>(std::move(data));
+            }
+            CSerializedNetMsg msg;
+            msg.m_type = NetMsgType::CMPCTBLOCK;
+            msg.m_shared_payload = cmpctblock_payload;
+            m_connman.PushMessage(pnode, std::move(msg));
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -1789,6 +1913,15 @@ void PeerManagerImpl::RelayAddress(NodeId originator,
     }
 }
 
+void PeerManagerImpl::PushBlockMessage(CNode& node, const uint256& hash, BlockServeFormat format, CSerializedNetMsg&& msg)
+{
+    if (m_block_serve_cache) {
+        msg.m_shared_payload = m_block_serve_cache->Insert(hash, format, std::move(msg.data));
+        msg.data.clear();
+    }
+    m_connman.PushMessage(&node, std::move(msg));
+}
+
 void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv& inv)
 {
     std::shared_ptr<const CBlock> a_recent_block;
@@ -1857,17 +1990,47 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
     if (!(pindex->nStatus & BLOCK_HAVE_DATA)) {
         return;
     }
+    // The form in which the block will be sent, unless it's a merkleblock.
+    const bool fPeerWantsWitness = State(pfrom.GetId())->fWantsCmpctWitness;
+    const bool send_compact = CanDirectFetch() && pindex->nHeight >= m_chainman.ActiveChain().Height() - MAX_CMPCTBLOCK_DEPTH;
+    std::optional<BlockServeFormat> format;
+    if (inv.IsMsgBlk()) {
+        format = BlockServeFormat::BLOCK;
+    } else if (inv.IsMsgWitnessBlk()) {
+        format = BlockServeFormat::BLOCK_WITNESS;
+    } else if (inv.IsMsgCmpctBlk()) {
+        if (send_compact) {
+            format = fPeerWantsWitness ? BlockServeFormat::CMPCTBLOCK_WITNESS : BlockServeFormat::CMPCTBLOCK;
+        } else {
+            format = fPeerWantsWitness ? BlockServeFormat::BLOCK_WITNESS : BlockServeFormat::BLOCK;
+        }
+    }
+    std::shared_ptr<const SharedNetPayload> cached_payload;
+    if (m_block_serve_cache && format) {
+        cached_payload = m_block_serve_cache->Get(pindex->GetBlockHash(), *format);
+    }
+
     std::shared_ptr<const CBlock> pblock;
-    if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
+    if (cached_payload) {
+        CSerializedNetMsg msg;
+        msg.m_type = BlockServeMsgType(*format);
+        msg.m_shared_payload = std::move(cached_payload);
+        m_connman.PushMessage(&pfrom, std::move(msg));
+        // Don't set pblock as we've sent the block
+    } else if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
         pblock = a_recent_block;
-    } else if (inv.IsMsgWitnessBlk()) {
+    } else if (format == BlockServeFormat::BLOCK || format == BlockServeFormat::BLOCK_WITNESS) {
         // Fast-path: in this case it is possible to serve the block directly from disk,
-        // as the network format matches the format on disk
+        // as the network format matches the format on disk, with the witness data
+        // left out if the peer doesn't want it
         std::vector<uint8_t> block_data;
-        if (!ReadRawBlockFromDisk(block_data, pindex, m_chainparams.MessageStart())) {
+        if (!ReadRawBlockFromDisk(block_data, pindex, m_chainparams.MessageStart(), /*with_witness=*/format == BlockServeFormat::BLOCK_WITNESS)) {
             assert(!"cannot load block from disk");
         }
-        m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCK, Span{block_data}));
+        CSerializedNetMsg msg;
+        msg.m_type = NetMsgType::BLOCK;
+        msg.data = std::move(block_data);
+        PushBlockMessage(pfrom, pindex->GetBlockHash(), *format, std::move(msg));
         // Don't set pblock as we've sent the block
     } else {
         // Send block from disk
@@ -1879,9 +2042,9 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
     }
     if (pblock) {
         if (inv.IsMsgBlk()) {
-            m_connman.PushMessage(&pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
+            PushBlockMessage(pfrom, pindex->GetBlockHash(), *format, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
         } else if (inv.IsMsgWitnessBlk()) {
-            m_connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
+            PushBlockMessage(pfrom, pindex->GetBlockHash(), *format, msgMaker.Make(NetMsgType::BLOCK, *pblock));
         } else if (inv.IsMsgFilteredBlk()) {
             bool sendMerkleBlock = false;
             CMerkleBlock merkleBlock;
@@ -1911,17 +2074,16 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
             // they won't have a useful mempool to match against a compact block,
             // and we don't feel like constructing the object for them, so
             // instead we respond with the full, non-compact block.
-            bool fPeerWantsWitness = State(pfrom.GetId())->fWantsCmpctWitness;
             int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
-            if (CanDirectFetch() && pindex->nHeight >= m_chainman.ActiveChain().Height() - MAX_CMPCTBLOCK_DEPTH) {
+            if (send_compact) {
                 if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
-                    m_connman.PushMessage(&pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
+                    PushBlockMessage(pfrom, pindex->GetBlockHash(), *format, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                 } else {
                     CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
-                    m_connman.PushMessage(&pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
+                    PushBlockMessage(pfrom, pindex->GetBlockHash(), *format, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
                 }
             } else {
-                m_connman.PushMessage(&pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock));
+                PushBlockMessage(pfrom, pindex->GetBlockHash(), *format, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock));
             }
         }
     }
@@ -2228,7 +2390,7 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, const Peer& peer,
                 std::vector<CInv> vGetData;
                 // Download as much as possible, from earliest to latest.
                 for (const CBlockIndex *pindex : reverse_iterate(vToFetch)) {
-                    if (nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                    if (nodestate->nBlocksInFlight >= nodestate->m_block_download.Window()) {
                         // Can't download any more from this peer
                         break;
                     }
@@ -2296,17 +2458,20 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, const Peer& peer,
 /**
  * Reconsider orphan transactions after a parent has been accepted to the mempool.
  *
- * @param[in,out]  orphan_work_set  The set of orphan transactions to reconsider. Generally only one
- *                                  orphan will be reconsidered on each call of this function. This set
- *                                  may be added to if accepting an orphan causes its children to be
- *                                  reconsidered.
+ * @param[in,out]  orphan_work_set  The set of orphan transactions to reconsider. At most
+ *                                  MAX_ORPHANS_PER_BATCH orphans are accepted or rejected on each
+ *                                  call of this function. This set may be added to if accepting
+ *                                  orphans causes their children to be reconsidered; the children
+ *                                  of the whole batch are looked up at once.
  */
 void PeerManagerImpl::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
 {
     AssertLockHeld(cs_main);
     AssertLockHeld(g_cs_orphans);
 
-    while (!orphan_work_set.empty()) {
+    std::vector<CTransactionRef> accepted;
+    size_t processed{0};
+    while (!orphan_work_set.empty() && processed < MAX_ORPHANS_PER_BATCH) {
         const uint256 orphanHash = *orphan_work_set.begin();
         orphan_work_set.erase(orphan_work_set.begin());
 
@@ -2319,12 +2484,12 @@ void PeerManagerImpl::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
         if (result.m_result_type == MempoolAcceptResult::ResultType::VALID) {
             LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
             _RelayTransaction(orphanHash, porphanTx->GetWitnessHash());
-            m_orphanage.AddChildrenToWorkSet(*porphanTx, orphan_work_set);
+            accepted.push_back(porphanTx);
             m_orphanage.EraseTx(orphanHash);
             for (const CTransactionRef& removedTx : result.m_replaced_transactions.value()) {
                 AddToCompactExtraTransactions(removedTx);
             }
-            break;
+            ++processed;
         } else if (state.GetResult() != TxValidationResult::TX_MISSING_INPUTS) {
             if (state.IsInvalid()) {
                 LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s from peer=%d. %s\n",
@@ -2367,9 +2532,10 @@ void PeerManagerImpl::ProcessOrphanTx(std::set<uint256>& orphan_work_set)
                 }
             }
             m_orphanage.EraseTx(orphanHash);
-            break;
+            ++processed;
         }
     }
+    m_orphanage.AddChildrenToWorkSet(accepted, orphan_work_set);
 }
 
 bool PeerManagerImpl::PrepareBlockFilterRequest(CNode& peer,
@@ -2540,6 +2706,331 @@ void PeerManagerImpl::ProcessGetCFCheckPt(CNode& peer, CDataStream& vRecv)
     m_connman.PushMessage(&peer, std::move(msg));
 }
 
+void PeerManagerImpl::AnnounceReconciledTxs(CNode& peer, const std::vector<uint256>& wtxids)
+{
+    if (wtxids.empty() || peer.m_tx_relay == nullptr) return;
+
+    const CNetMsgMaker msgMaker(peer.GetCommonVersion());
+    std::vector<CInv> vInv;
+    LOCK2(cs_main, peer.m_tx_relay->cs_tx_inventory);
+    for (const uint256& wtxid : wtxids) {
+        if (!m_mempool.exists(GenTxid::Wtxid(wtxid))) continue;
+        peer.m_tx_relay->filterInventoryKnown.insert(wtxid);
+        State(peer.GetId())->m_recently_announced_invs.insert(wtxid);
+        vInv.emplace_back(MSG_WTX, wtxid);
+        if (vInv.size() == MAX_INV_SZ) {
+            m_connman.PushMessage(&peer, msgMaker.Make(NetMsgType::INV, vInv));
+            vInv.clear();
+        }
+    }
+    if (!vInv.empty()) m_connman.PushMessage(&peer, msgMaker.Make(NetMsgType::INV, vInv));
+}
+
+void PeerManagerImpl::ProcessIncomingTx(CNode& pfrom, Peer& peer, const CTransactionRef& ptx)
+{
+    const CTransaction& tx = *ptx;
+
+    const uint256& txid = ptx->GetHash();
+    const uint256& wtxid = ptx->GetWitnessHash();
+
+    LOCK2(cs_main, g_cs_orphans);
+
+    CNodeState* nodestate = State(pfrom.GetId());
+
+    const uint256& hash = nodestate->m_wtxid_relay ? wtxid : txid;
+    pfrom.AddKnownTx(hash);
+    if (m_txreconciliation && nodestate->m_wtxid_relay) m_txreconciliation->TryRemovingFromSet(pfrom.GetId(), wtxid);
+    if (nodestate->m_wtxid_relay && txid != wtxid) {
+        // Insert txid into filterInventoryKnown, even for
+        // wtxidrelay peers. This prevents re-adding of
+        // unconfirmed parents to the recently_announced
+        // filter, when a child tx is requested. See
+        // ProcessGetData().
+        pfrom.AddKnownTx(txid);
+    }
+
+    m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
+    if (tx.HasWitness()) m_txrequest.ReceivedResponse(pfrom.GetId(), wtxid);
+
+    // We do the AlreadyHaveTx() check using wtxid, rather than txid - in the
+    // absence of witness malleation, this is strictly better, because the
+    // recent rejects filter may contain the wtxid but rarely contains
+    // the txid of a segwit transaction that has been rejected.
+    // In the presence of witness malleation, it's possible that by only
+    // doing the check with wtxid, we could overlook a transaction which
+    // was confirmed with a different witness, or exists in our mempool
+    // with a different witness, but this has limited downside:
+    // mempool validation does its own lookup of whether we have the txid
+    // already; and an adversary can already relay us old transactions
+    // (older than our recency filter) if trying to DoS us, without any need
+    // for witness malleation.
+    if (AlreadyHaveTx(GenTxid::Wtxid(wtxid))) {
+        if (pfrom.HasPermission(NetPermissionFlags::ForceRelay)) {
+            // Always relay transactions received from peers with forcerelay
+            // permission, even if they were already in the mempool, allowing
+            // the node to function as a gateway for nodes hidden behind it.
+            if (!m_mempool.exists(GenTxid::Txid(tx.GetHash()))) {
+                LogPrintf("Not relaying non-mempool transaction %s from forcerelay peer=%d\n", tx.GetHash().ToString(), pfrom.GetId());
+            } else {
+                LogPrintf("Force relaying tx %s from peer=%d\n", tx.GetHash().ToString(), pfrom.GetId());
+                _RelayTransaction(tx.GetHash(), tx.GetWitnessHash());
+            }
+        }
+        return;
+    }
+
+    const MempoolAcceptResult result = m_chainman.ProcessTransaction(ptx);
+    const TxValidationState& state = result.m_state;
+
+    if (result.m_result_type == MempoolAcceptResult::ResultType::VALID) {
+        // As this version of the transaction was acceptable, we can forget about any
+        // requests for it.
+        m_txrequest.ForgetTxHash(tx.GetHash());
+        m_txrequest.ForgetTxHash(tx.GetWitnessHash());
+        _RelayTransaction(tx.GetHash(), tx.GetWitnessHash());
+        m_orphanage.AddChildrenToWorkSet(tx, peer.m_orphan_work_set);
+
+        pfrom.nLastTXTime = GetTime();
+
+        LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
+            pfrom.GetId(),
+            tx.GetHash().ToString(),
+            m_mempool.size(), m_mempool.DynamicMemoryUsage() / 1000);
+
+        for (const CTransactionRef& removedTx : result.m_replaced_transactions.value()) {
+            AddToCompactExtraTransactions(removedTx);
+        }
+
+        // Recursively process any orphan transactions that depended on this one
+        ProcessOrphanTx(peer.m_orphan_work_set);
+    }
+    else if (state.GetResult() == TxValidationResult::TX_MISSING_INPUTS)
+    {
+        bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
+
+        // Deduplicate parent txids, so that we don't have to loop over
+        // the same parent txid more than once down below.
+        std::vector<uint256> unique_parents;
+        unique_parents.reserve(tx.vin.size());
+        for (const CTxIn& txin : tx.vin) {
+            // We start with all parents, and then remove duplicates below.
+            unique_parents.push_back(txin.prevout.hash);
+        }
+        std::sort(unique_parents.begin(), unique_parents.end());
+        unique_parents.erase(std::unique(unique_parents.begin(), unique_parents.end()), unique_parents.end());
+        for (const uint256& parent_txid : unique_parents) {
+            if (m_recent_rejects.contains(parent_txid)) {
+                fRejectedParents = true;
+                break;
+            }
+        }
+        if (!fRejectedParents) {
+            const auto current_time = GetTime<std::chrono::microseconds>();
+
+            // A package relay peer sends the orphan with all its unconfirmed
+            // ancestors in one message, however long the chain (think of a
+            // name_update on top of a pending name_doi). The parents are
+            // still requested one by one, later, in case no package comes.
+            auto parent_request_time = current_time;
+            if (nodestate->m_package_relay && RequestPackage(pfrom, *nodestate, wtxid, current_time)) {
+                parent_request_time += PKGTXNS_RESPONSE_DELAY;
+            }
+
+            for (const uint256& parent_txid : unique_parents) {
+                // Here, we only have the txid (and not wtxid) of the
+                // inputs, so we only request in txid mode, even for
+                // wtxidrelay peers.
+                const auto gtxid{GenTxid::Txid(parent_txid)};
+                pfrom.AddKnownTx(parent_txid);
+                if (!AlreadyHaveTx(gtxid)) AddTxAnnouncement(pfrom, gtxid, parent_request_time);
+            }
+
+            if (m_orphanage.AddTx(ptx, pfrom.GetId())) {
+                AddToCompactExtraTransactions(ptx);
+            }
+
+            // Once added to the orphan pool, a tx is considered AlreadyHave, and we shouldn't request it anymore.
+            m_txrequest.ForgetTxHash(tx.GetHash());
+            m_txrequest.ForgetTxHash(tx.GetWitnessHash());
+
+            // DoS prevention: do not allow m_orphanage to grow unbounded (see CVE-2012-3789)
+            unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, gArgs.GetIntArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+            size_t nMaxOrphanMemory = (size_t)std::max((int64_t)0, gArgs.GetIntArg("-maxorphanmemory", DEFAULT_MAX_ORPHAN_MEMORY)) * 1000000;
+            unsigned int nEvicted = m_orphanage.LimitOrphans(nMaxOrphanTx, nMaxOrphanMemory);
+            if (nEvicted > 0) {
+                LogPrint(BCLog::MEMPOOL, "orphanage overflow, removed %u tx\n", nEvicted);
+            }
+        } else {
+            LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
+            // We will continue to reject this tx since it has rejected
+            // parents so avoid re-requesting it from other peers.
+            // Here we add both the txid and the wtxid, as we know that
+            // regardless of what witness is provided, we will not accept
+            // this, so we don't need to allow for redownload of this txid
+            // from any of our non-wtxidrelay peers.
+            m_recent_rejects.insert(tx.GetHash());
+            m_recent_rejects.insert(tx.GetWitnessHash());
+            m_txrequest.ForgetTxHash(tx.GetHash());
+            m_txrequest.ForgetTxHash(tx.GetWitnessHash());
+        }
+    } else {
+        if (state.GetResult() != TxValidationResult::TX_WITNESS_STRIPPED) {
+            // We can add the wtxid of this transaction to our reject filter.
+            // Do not add txids of witness transactions or witness-stripped
+            // transactions to the filter, as they can have been malleated;
+            // adding such txids to the reject filter would potentially
+            // interfere with relay of valid transactions from peers that
+            // do not support wtxid-based relay. See
+            // https://github.com/bitcoin/bitcoin/issues/8279 for details.
+            // We can remove this restriction (and always add wtxids to
+            // the filter even for witness stripped transactions) once
+            // wtxid-based relay is broadly deployed.
+            // See also comments in https://github.com/bitcoin/bitcoin/pull/18044#discussion_r443419034
+            // for concerns around weakening security of unupgraded nodes
+            // if we start doing this too early.
+            m_recent_rejects.insert(tx.GetWitnessHash());
+            m_txrequest.ForgetTxHash(tx.GetWitnessHash());
+            // If the transaction failed for TX_INPUTS_NOT_STANDARD,
+            // then we know that the witness was irrelevant to the policy
+            // failure, since this check depends only on the txid
+            // (the scriptPubKey being spent is covered by the txid).
+            // Add the txid to the reject filter to prevent repeated
+            // processing of this transaction in the event that child
+            // transactions are later received (resulting in
+            // parent-fetching by txid via the orphan-handling logic).
+            if (state.GetResult() == TxValidationResult::TX_INPUTS_NOT_STANDARD && tx.GetWitnessHash() != tx.GetHash()) {
+                m_recent_rejects.insert(tx.GetHash());
+                m_txrequest.ForgetTxHash(tx.GetHash());
+            }
+            if (RecursiveDynamicUsage(*ptx) < 100000) {
+                AddToCompactExtraTransactions(ptx);
+            }
+        }
+    }
+
+    // If a tx has been detected by m_recent_rejects, we will have reached
+    // this point and the tx will have been ignored. Because we haven't
+    // submitted the tx to our mempool, we won't have computed a DoS
+    // score for it or determined exactly why we consider it invalid.
+    //
+    // This means we won't penalize any peer subsequently relaying a DoSy
+    // tx (even if we penalized the first peer who gave it to us) because
+    // we have to account for m_recent_rejects showing false positives. In
+    // other words, we shouldn't penalize a peer if we aren't *sure* they
+    // submitted a DoSy tx.
+    //
+    // Note that m_recent_rejects doesn't just record DoSy or invalid
+    // transactions, but any tx not accepted by the mempool, which may be
+    // due to node policy (vs. consensus). So we can't blanket penalize a
+    // peer simply for relaying a tx that our m_recent_rejects has caught,
+    // regardless of false positives.
+
+    if (state.IsInvalid()) {
+        LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
+            pfrom.GetId(),
+            state.ToString());
+        MaybePunishNodeForTx(pfrom.GetId(), state);
+    }
+}
+
+bool PeerManagerImpl::RequestPackage(CNode& node, CNodeState& state, const uint256& wtxid, std::chrono::microseconds current_time)
+{
+    // Forget the requests the peer did not answer in time; their parents are
+    // requested one by one by now.
+    for (auto it = state.m_pkgtxns_requested.begin(); it != state.m_pkgtxns_requested.end();) {
+        if (it->second <= current_time - GETDATA_TX_INTERVAL) {
+            it = state.m_pkgtxns_requested.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (state.m_pkgtxns_requested.size() >= MAX_PKGTXNS_IN_FLIGHT) return false;
+    if (!state.m_pkgtxns_requested.emplace(wtxid, current_time).second) return false;
+
+    m_connman.PushMessage(&node, CNetMsgMaker(node.GetCommonVersion()).Make(NetMsgType::GETPKGTXNS, wtxid));
+    return true;
+}
+
+void PeerManagerImpl::SendPackage(CNode& pfrom, const uint256& wtxid)
+{
+    const std::chrono::seconds now = GetTime<std::chrono::seconds>();
+    const CTransactionRef tx = FindTxForGetData(pfrom, GenTxid::Wtxid(wtxid), pfrom.m_tx_relay->m_last_mempool_req.load(), now);
+
+    // An empty package tells the peer that we cannot serve it, e.g. because
+    // the tx left the mempool or has too many unconfirmed ancestors.
+    Package package;
+    if (tx) {
+        LOCK(m_mempool.cs);
+        const auto it = m_mempool.GetIter(tx->GetHash());
+        if (it && (*it)->GetCountWithAncestors() <= MAX_PACKAGE_COUNT &&
+            (*it)->GetSizeWithAncestors() <= MAX_PACKAGE_SIZE * 1000) {
+            CTxMemPool::setEntries ancestors;
+            const auto no_limit = std::numeric_limits<uint64_t>::max();
+            std::string dummy;
+            m_mempool.CalculateMemPoolAncestors(**it, ancestors, no_limit, no_limit, no_limit, no_limit, dummy, /*fSearchForParents=*/false);
+            std::vector<CTxMemPool::txiter> sorted(ancestors.begin(), ancestors.end());
+            // A tx has more ancestors than any of its parents.
+            std::sort(sorted.begin(), sorted.end(), [](const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) {
+                return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+            });
+            package.reserve(sorted.size() + 1);
+            for (const CTxMemPool::txiter& ancestor : sorted) package.push_back(ancestor->GetSharedTx());
+            package.push_back(tx);
+        }
+    }
+    m_connman.PushMessage(&pfrom, CNetMsgMaker(pfrom.GetCommonVersion()).Make(NetMsgType::PKGTXNS, wtxid, package));
+    for (const CTransactionRef& ptx : package) m_mempool.RemoveUnbroadcastTx(ptx->GetHash());
+}
+
+void PeerManagerImpl::ProcessPackageTxns(CNode& pfrom, Peer& peer, const uint256& wtxid, const Package& package)
+{
+    LOCK2(cs_main, g_cs_orphans);
+
+    for (const CTransactionRef& ptx : package) {
+        pfrom.AddKnownTx(ptx->GetWitnessHash());
+        pfrom.AddKnownTx(ptx->GetHash());
+    }
+    // Otherwise the parents of the orphan are requested one by one, as
+    // without package relay.
+    if (package.empty() || package.back()->GetWitnessHash() != wtxid) {
+        LogPrint(BCLog::MEMPOOL, "peer=%d did not send the package of %s\n", pfrom.GetId(), wtxid.ToString());
+        return;
+    }
+
+    const PackageMempoolAcceptResult result = ProcessNewPackage(m_chainman.ActiveChainstate(), m_mempool, package, /*test_accept=*/false);
+    if (!result.m_state.IsValid()) {
+        LogPrint(BCLog::MEMPOOL, "package of %s from peer=%d was not accepted: %s\n",
+                 wtxid.ToString(), pfrom.GetId(), result.m_state.ToString());
+    }
+
+    // Parents that went in before a later transaction failed stay in the mempool,
+    // and are relayed like the rest.
+    std::vector<CTransactionRef> accepted;
+    for (const CTransactionRef& ptx : package) {
+        const auto it = result.m_tx_results.find(ptx->GetWitnessHash());
+        const bool submitted{it != result.m_tx_results.end() && it->second.m_result_type == MempoolAcceptResult::ResultType::VALID};
+        // Transactions we had in the mempool already have no result. Of a package that
+        // failed, only those that went in are done with.
+        if (!submitted && (it != result.m_tx_results.end() || !result.m_state.IsValid())) continue;
+        m_txrequest.ForgetTxHash(ptx->GetHash());
+        m_txrequest.ForgetTxHash(ptx->GetWitnessHash());
+        if (!submitted) continue;
+        _RelayTransaction(ptx->GetHash(), ptx->GetWitnessHash());
+        m_orphanage.EraseTx(ptx->GetHash());
+        accepted.push_back(ptx);
+    }
+    if (accepted.empty()) return;
+    m_orphanage.AddChildrenToWorkSet(accepted, peer.m_orphan_work_set);
+    pfrom.nLastTXTime = GetTime();
+
+    LogPrint(BCLog::MEMPOOL, "ProcessNewPackage: peer=%d: accepted %u txs for %s (poolsz %u txn, %u kB)\n",
+             pfrom.GetId(), accepted.size(), wtxid.ToString(),
+             m_mempool.size(), m_mempool.DynamicMemoryUsage() / 1000);
+
+    // Other orphans may have been waiting for the same parents.
+    ProcessOrphanTx(peer.m_orphan_work_set);
+}
+
 void PeerManagerImpl::ProcessBlock(CNode& node, const std::shared_ptr<const CBlock>& block, bool force_processing)
 {
     bool new_block{false};
@@ -2655,6 +3146,24 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             m_connman.PushMessage(&pfrom, msg_maker.Make(NetMsgType::SENDADDRV2));
         }
 
+        // Signal transaction reconciliation support (BIP330) to peers that
+        // may relay transactions to us and can do so by wtxid. Peers that
+        // don't negotiate it keep receiving plain INV announcements.
+        if (m_txreconciliation && greatest_common_version >= WTXID_RELAY_VERSION &&
+            fRelay && pfrom.m_tx_relay != nullptr && !m_ignore_incoming_txs) {
+            const uint64_t recon_salt = m_txreconciliation->PreRegisterPeer(pfrom.GetId());
+            m_connman.PushMessage(&pfrom, msg_maker.Make(NetMsgType::SENDTXRCNCL,
+                                                         TXRECONCILIATION_VERSION, recon_salt));
+        }
+
+        // Offer package relay to peers that may relay transactions to us by
+        // wtxid, so that they can ask us for the unconfirmed ancestors of
+        // what we announce and we them.
+        if (m_package_relay && greatest_common_version >= WTXID_RELAY_VERSION &&
+            fRelay && pfrom.m_tx_relay != nullptr && !m_ignore_incoming_txs) {
+            m_connman.PushMessage(&pfrom, msg_maker.Make(NetMsgType::SENDPACKAGES, PACKAGE_RELAY_VERSION));
+        }
+
         m_connman.PushMessage(&pfrom, msg_maker.Make(NetMsgType::VERACK));
 
         pfrom.nServices = nServices;
@@ -2884,6 +3393,77 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         return;
     }
 
+    // Received from a peer demonstrating readiness to announce transactions via reconciliations.
+    // This feature negotiation must happen between VERSION and VERACK to avoid relay problems
+    // from switching announcement protocols after the connection is up.
+    if (msg_type == NetMsgType::SENDTXRCNCL) {
+        if (!m_txreconciliation) {
+            LogPrint(BCLog::NET, "sendtxrcncl from peer=%d ignored, as our node does not have txreconciliation enabled\n", pfrom.GetId());
+            return;
+        }
+
+        if (pfrom.fSuccessfullyConnected) {
+            LogPrint(BCLog::NET, "sendtxrcncl received after verack from peer=%d; disconnecting\n", pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+
+        if (!WITH_LOCK(cs_main, return State(pfrom.GetId())->m_wtxid_relay)) {
+            LogPrint(BCLog::NET, "sendtxrcncl received from peer=%d before wtxidrelay; ignoring\n", pfrom.GetId());
+            return;
+        }
+
+        uint32_t peer_txreconcl_version;
+        uint64_t remote_salt;
+        vRecv >> peer_txreconcl_version >> remote_salt;
+
+        const ReconciliationRegisterResult result = m_txreconciliation->RegisterPeer(pfrom.GetId(), pfrom.IsInboundConn(),
+                                                                                     peer_txreconcl_version, remote_salt);
+        switch (result) {
+        case ReconciliationRegisterResult::NOT_FOUND:
+            // We didn't offer reconciliation to this peer (e.g. it is block-relay-only).
+            LogPrint(BCLog::NET, "Ignore unexpected txreconciliation signal from peer=%d\n", pfrom.GetId());
+            break;
+        case ReconciliationRegisterResult::SUCCESS:
+            break;
+        case ReconciliationRegisterResult::ALREADY_REGISTERED:
+            LogPrint(BCLog::NET, "txreconciliation protocol violation from peer=%d (sendtxrcncl received from already registered peer); disconnecting\n", pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        case ReconciliationRegisterResult::PROTOCOL_VIOLATION:
+            LogPrint(BCLog::NET, "txreconciliation protocol violation from peer=%d; disconnecting\n", pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+        return;
+    }
+
+    // Received from a peer that serves packages of unconfirmed transactions. Like the other
+    // relay features, this is negotiated between VERSION and VERACK.
+    if (msg_type == NetMsgType::SENDPACKAGES) {
+        if (pfrom.fSuccessfullyConnected) {
+            LogPrint(BCLog::NET, "sendpackages received after verack from peer=%d; disconnecting\n", pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+
+        uint32_t version;
+        vRecv >> version;
+        if (!m_package_relay || version < PACKAGE_RELAY_VERSION) {
+            LogPrint(BCLog::NET, "sendpackages version=%u from peer=%d ignored\n", version, pfrom.GetId());
+            return;
+        }
+
+        LOCK(cs_main);
+        CNodeState* state = State(pfrom.GetId());
+        if (!state->m_wtxid_relay) {
+            LogPrint(BCLog::NET, "sendpackages received from peer=%d before wtxidrelay; ignoring\n", pfrom.GetId());
+            return;
+        }
+        state->m_package_relay = true;
+        return;
+    }
+
     if (!pfrom.fSuccessfullyConnected) {
         LogPrint(BCLog::NET, "Unsupported message \"%s\" prior to verack from peer=%d\n", SanitizeString(msg_type), pfrom.GetId());
         return;
@@ -3044,6 +3624,8 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                 LogPrint(BCLog::NET, "got inv: %s  %s peer=%d\n", inv.ToString(), fAlreadyHave ? "have" : "new", pfrom.GetId());
 
                 pfrom.AddKnownTx(inv.hash);
+                // No need to reconcile a transaction the peer already has.
+                if (m_txreconciliation && inv.IsMsgWtx()) m_txreconciliation->TryRemovingFromSet(pfrom.GetId(), inv.hash);
                 if (!fAlreadyHave && !m_chainman.ActiveChainstate().IsInitialBlockDownload()) {
                     AddTxAnnouncement(pfrom, gtxid, current_time);
                 }
@@ -3307,202 +3889,51 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         // is not considered a protocol violation, so don't punish the peer.
         if (m_chainman.ActiveChainstate().IsInitialBlockDownload()) return;
 
-        CTransactionRef ptx;
-        vRecv >> ptx;
-        const CTransaction& tx = *ptx;
-
-        const uint256& txid = ptx->GetHash();
-        const uint256& wtxid = ptx->GetWitnessHash();
-
-        LOCK2(cs_main, g_cs_orphans);
-
-        CNodeState* nodestate = State(pfrom.GetId());
-
-        const uint256& hash = nodestate->m_wtxid_relay ? wtxid : txid;
-        pfrom.AddKnownTx(hash);
-        if (nodestate->m_wtxid_relay && txid != wtxid) {
-            // Insert txid into filterInventoryKnown, even for
-            // wtxidrelay peers. This prevents re-adding of
-            // unconfirmed parents to the recently_announced
-            // filter, when a child tx is requested. See
-            // ProcessGetData().
-            pfrom.AddKnownTx(txid);
-        }
-
-        m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
-        if (tx.HasWitness()) m_txrequest.ReceivedResponse(pfrom.GetId(), wtxid);
-
-        // We do the AlreadyHaveTx() check using wtxid, rather than txid - in the
-        // absence of witness malleation, this is strictly better, because the
-        // recent rejects filter may contain the wtxid but rarely contains
-        // the txid of a segwit transaction that has been rejected.
-        // In the presence of witness malleation, it's possible that by only
-        // doing the check with wtxid, we could overlook a transaction which
-        // was confirmed with a different witness, or exists in our mempool
-        // with a different witness, but this has limited downside:
-        // mempool validation does its own lookup of whether we have the txid
-        // already; and an adversary can already relay us old transactions
-        // (older than our recency filter) if trying to DoS us, without any need
-        // for witness malleation.
-        if (AlreadyHaveTx(GenTxid::Wtxid(wtxid))) {
-            if (pfrom.HasPermission(NetPermissionFlags::ForceRelay)) {
-                // Always relay transactions received from peers with forcerelay
-                // permission, even if they were already in the mempool, allowing
-                // the node to function as a gateway for nodes hidden behind it.
-                if (!m_mempool.exists(GenTxid::Txid(tx.GetHash()))) {
-                    LogPrintf("Not relaying non-mempool transaction %s from forcerelay peer=%d\n", tx.GetHash().ToString(), pfrom.GetId());
-                } else {
-                    LogPrintf("Force relaying tx %s from peer=%d\n", tx.GetHash().ToString(), pfrom.GetId());
-                    _RelayTransaction(tx.GetHash(), tx.GetWitnessHash());
-                }
-            }
+        if (m_txprevalidator) {
+            // Deserialization, context-free checks and script verification
+            // happen on the pre-validation workers; ProcessMessages picks the
+            // transaction up again once they are done.
+            auto job{std::make_shared<TxPreValidationJob>(pfrom.GetId(), std::move(vRecv))};
+            peer->m_prevalidating_tx = job;
+            m_txprevalidator->Submit(std::move(job));
             return;
         }
 
-        const MempoolAcceptResult result = m_chainman.ProcessTransaction(ptx);
-        const TxValidationState& state = result.m_state;
-
-        if (result.m_result_type == MempoolAcceptResult::ResultType::VALID) {
-            // As this version of the transaction was acceptable, we can forget about any
-            // requests for it.
-            m_txrequest.ForgetTxHash(tx.GetHash());
-            m_txrequest.ForgetTxHash(tx.GetWitnessHash());
-            _RelayTransaction(tx.GetHash(), tx.GetWitnessHash());
-            m_orphanage.AddChildrenToWorkSet(tx, peer->m_orphan_work_set);
-
-            pfrom.nLastTXTime = GetTime();
-
-            LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
-                pfrom.GetId(),
-                tx.GetHash().ToString(),
-                m_mempool.size(), m_mempool.DynamicMemoryUsage() / 1000);
-
-            for (const CTransactionRef& removedTx : result.m_replaced_transactions.value()) {
-                AddToCompactExtraTransactions(removedTx);
-            }
+        CTransactionRef ptx;
+        vRecv >> ptx;
+        ProcessIncomingTx(pfrom, *peer, ptx);
+        return;
+    }
 
-            // Recursively process any orphan transactions that depended on this one
-            ProcessOrphanTx(peer->m_orphan_work_set);
+    if (msg_type == NetMsgType::GETPKGTXNS) {
+        if (!m_package_relay || pfrom.m_tx_relay == nullptr ||
+            !WITH_LOCK(cs_main, return State(pfrom.GetId())->m_package_relay)) {
+            LogPrint(BCLog::NET, "getpkgtxns from peer=%d ignored, as we do not relay packages to it\n", pfrom.GetId());
+            return;
         }
-        else if (state.GetResult() == TxValidationResult::TX_MISSING_INPUTS)
-        {
-            bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
-
-            // Deduplicate parent txids, so that we don't have to loop over
-            // the same parent txid more than once down below.
-            std::vector<uint256> unique_parents;
-            unique_parents.reserve(tx.vin.size());
-            for (const CTxIn& txin : tx.vin) {
-                // We start with all parents, and then remove duplicates below.
-                unique_parents.push_back(txin.prevout.hash);
-            }
-            std::sort(unique_parents.begin(), unique_parents.end());
-            unique_parents.erase(std::unique(unique_parents.begin(), unique_parents.end()), unique_parents.end());
-            for (const uint256& parent_txid : unique_parents) {
-                if (m_recent_rejects.contains(parent_txid)) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                const auto current_time = GetTime<std::chrono::microseconds>();
-
-                for (const uint256& parent_txid : unique_parents) {
-                    // Here, we only have the txid (and not wtxid) of the
-                    // inputs, so we only request in txid mode, even for
-                    // wtxidrelay peers.
-                    // Eventually we should replace this with an improved
-                    // protocol for getting all unconfirmed parents.
-                    const auto gtxid{GenTxid::Txid(parent_txid)};
-                    pfrom.AddKnownTx(parent_txid);
-                    if (!AlreadyHaveTx(gtxid)) AddTxAnnouncement(pfrom, gtxid, current_time);
-                }
-
-                if (m_orphanage.AddTx(ptx, pfrom.GetId())) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-
-                // Once added to the orphan pool, a tx is considered AlreadyHave, and we shouldn't request it anymore.
-                m_txrequest.ForgetTxHash(tx.GetHash());
-                m_txrequest.ForgetTxHash(tx.GetWitnessHash());
+        uint256 wtxid;
+        vRecv >> wtxid;
+        SendPackage(pfrom, wtxid);
+        return;
+    }
 
-                // DoS prevention: do not allow m_orphanage to grow unbounded (see CVE-2012-3789)
-                unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, gArgs.GetIntArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = m_orphanage.LimitOrphans(nMaxOrphanTx);
-                if (nEvicted > 0) {
-                    LogPrint(BCLog::MEMPOOL, "orphanage overflow, removed %u tx\n", nEvicted);
-                }
-            } else {
-                LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                // Here we add both the txid and the wtxid, as we know that
-                // regardless of what witness is provided, we will not accept
-                // this, so we don't need to allow for redownload of this txid
-                // from any of our non-wtxidrelay peers.
-                m_recent_rejects.insert(tx.GetHash());
-                m_recent_rejects.insert(tx.GetWitnessHash());
-                m_txrequest.ForgetTxHash(tx.GetHash());
-                m_txrequest.ForgetTxHash(tx.GetWitnessHash());
-            }
-        } else {
-            if (state.GetResult() != TxValidationResult::TX_WITNESS_STRIPPED) {
-                // We can add the wtxid of this transaction to our reject filter.
-                // Do not add txids of witness transactions or witness-stripped
-                // transactions to the filter, as they can have been malleated;
-                // adding such txids to the reject filter would potentially
-                // interfere with relay of valid transactions from peers that
-                // do not support wtxid-based relay. See
-                // https://github.com/bitcoin/bitcoin/issues/8279 for details.
-                // We can remove this restriction (and always add wtxids to
-                // the filter even for witness stripped transactions) once
-                // wtxid-based relay is broadly deployed.
-                // See also comments in https://github.com/bitcoin/bitcoin/pull/18044#discussion_r443419034
-                // for concerns around weakening security of unupgraded nodes
-                // if we start doing this too early.
-                m_recent_rejects.insert(tx.GetWitnessHash());
-                m_txrequest.ForgetTxHash(tx.GetWitnessHash());
-                // If the transaction failed for TX_INPUTS_NOT_STANDARD,
-                // then we know that the witness was irrelevant to the policy
-                // failure, since this check depends only on the txid
-                // (the scriptPubKey being spent is covered by the txid).
-                // Add the txid to the reject filter to prevent repeated
-                // processing of this transaction in the event that child
-                // transactions are later received (resulting in
-                // parent-fetching by txid via the orphan-handling logic).
-                if (state.GetResult() == TxValidationResult::TX_INPUTS_NOT_STANDARD && tx.GetWitnessHash() != tx.GetHash()) {
-                    m_recent_rejects.insert(tx.GetHash());
-                    m_txrequest.ForgetTxHash(tx.GetHash());
-                }
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-            }
+    if (msg_type == NetMsgType::PKGTXNS) {
+        if (!m_package_relay || pfrom.m_tx_relay == nullptr) {
+            LogPrint(BCLog::NET, "pkgtxns from peer=%d ignored, as we do not relay packages with it\n", pfrom.GetId());
+            return;
         }
+        if (m_chainman.ActiveChainstate().IsInitialBlockDownload()) return;
 
-        // If a tx has been detected by m_recent_rejects, we will have reached
-        // this point and the tx will have been ignored. Because we haven't
-        // submitted the tx to our mempool, we won't have computed a DoS
-        // score for it or determined exactly why we consider it invalid.
-        //
-        // This means we won't penalize any peer subsequently relaying a DoSy
-        // tx (even if we penalized the first peer who gave it to us) because
-        // we have to account for m_recent_rejects showing false positives. In
-        // other words, we shouldn't penalize a peer if we aren't *sure* they
-        // submitted a DoSy tx.
-        //
-        // Note that m_recent_rejects doesn't just record DoSy or invalid
-        // transactions, but any tx not accepted by the mempool, which may be
-        // due to node policy (vs. consensus). So we can't blanket penalize a
-        // peer simply for relaying a tx that our m_recent_rejects has caught,
-        // regardless of false positives.
-
-        if (state.IsInvalid()) {
-            LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
-                pfrom.GetId(),
-                state.ToString());
-            MaybePunishNodeForTx(pfrom.GetId(), state);
+        uint256 wtxid;
+        vRecv >> wtxid;
+        // Only packages we asked for are worth deserializing.
+        if (WITH_LOCK(cs_main, return State(pfrom.GetId())->m_pkgtxns_requested.erase(wtxid)) == 0) {
+            LogPrint(BCLog::NET, "unrequested pkgtxns for %s from peer=%d ignored\n", wtxid.ToString(), pfrom.GetId());
+            return;
         }
+        Package package;
+        vRecv >> package;
+        ProcessPackageTxns(pfrom, *peer, wtxid, package);
         return;
     }
 
@@ -3605,7 +4036,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         // We want to be a bit conservative just to be extra careful about DoS
         // possibilities in compact block processing...
         if (pindex->nHeight <= m_chainman.ActiveChain().Height() + 2) {
-            if ((!fAlreadyInFlight && nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) ||
+            if ((!fAlreadyInFlight && nodestate->nBlocksInFlight < nodestate->m_block_download.Window()) ||
                  (fAlreadyInFlight && blockInFlightIt->second.first == pfrom.GetId())) {
                 std::list<QueuedBlock>::iterator* queuedBlockIt = nullptr;
                 if (!BlockRequested(pfrom.GetId(), *pindex, &queuedBlockIt)) {
@@ -3830,6 +4261,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             return;
         }
 
+        const size_t block_size{vRecv.size()};
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         vRecv >> *pblock;
 
@@ -3841,7 +4273,11 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             LOCK(cs_main);
             // Always process the block if we requested it, since we may
             // need it even when it's not a candidate for a new best tip.
-            forceProcessing = IsBlockRequested(hash);
+            const auto it{mapBlocksInFlight.find(hash)};
+            forceProcessing = it != mapBlocksInFlight.end();
+            if (forceProcessing && it->second.first == pfrom.GetId()) {
+                State(pfrom.GetId())->m_block_download.BlockReceived(it->second.second->m_requested, GetTime<std::chrono::microseconds>(), block_size);
+            }
             RemoveBlockRequest(hash);
             // mapBlockSource is only used for punishing peers and setting
             // which peers send us compact blocks, so the race between here and
@@ -4070,6 +4506,57 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         return;
     }
 
+    // Transaction reconciliation rounds (BIP330). The side that made the
+    // connection requests a sketch, the other one answers it and announces
+    // what the difference says the requester lacks.
+    if (msg_type == NetMsgType::REQTXRCNCL) {
+        if (!m_txreconciliation) return;
+        uint16_t peer_set_size, peer_q;
+        vRecv >> peer_set_size >> peer_q;
+        std::vector<uint8_t> skdata;
+        if (!m_txreconciliation->HandleReconciliationRequest(pfrom.GetId(), peer_set_size, peer_q, skdata, GetTime<std::chrono::microseconds>())) {
+            LogPrint(BCLog::NET, "txreconciliation protocol violation from peer=%d (unexpected reqtxrcncl); disconnecting\n", pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+        m_connman.PushMessage(&pfrom, CNetMsgMaker(pfrom.GetCommonVersion()).Make(NetMsgType::SKETCH, skdata));
+        return;
+    }
+
+    if (msg_type == NetMsgType::SKETCH) {
+        if (!m_txreconciliation) return;
+        std::vector<uint8_t> skdata;
+        vRecv >> skdata;
+        bool success;
+        std::vector<uint256> txs_to_announce;
+        std::vector<uint32_t> ask_shortids;
+        if (!m_txreconciliation->HandleSketch(pfrom.GetId(), skdata, success, txs_to_announce, ask_shortids)) {
+            LogPrint(BCLog::NET, "txreconciliation protocol violation from peer=%d (unexpected sketch); disconnecting\n", pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+        LogPrint(BCLog::NET, "reconciliation with peer=%d %s: announcing %u, requesting %u\n", pfrom.GetId(),
+                 success ? "succeeded" : "failed", txs_to_announce.size(), ask_shortids.size());
+        m_connman.PushMessage(&pfrom, CNetMsgMaker(pfrom.GetCommonVersion()).Make(NetMsgType::RECONCILDIFF, uint8_t{success}, ask_shortids));
+        AnnounceReconciledTxs(pfrom, txs_to_announce);
+        return;
+    }
+
+    if (msg_type == NetMsgType::RECONCILDIFF) {
+        if (!m_txreconciliation) return;
+        uint8_t success;
+        std::vector<uint32_t> ask_shortids;
+        vRecv >> success >> ask_shortids;
+        std::vector<uint256> txs_to_announce;
+        if (!m_txreconciliation->HandleReconciliationDifference(pfrom.GetId(), success != 0, ask_shortids, txs_to_announce)) {
+            LogPrint(BCLog::NET, "txreconciliation protocol violation from peer=%d (unexpected reconcildiff); disconnecting\n", pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+        AnnounceReconciledTxs(pfrom, txs_to_announce);
+        return;
+    }
+
     if (msg_type == NetMsgType::GETCFILTERS) {
         ProcessGetCFilters(pfrom, vRecv);
         return;
@@ -4159,6 +4646,19 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
         }
     }
 
+    if (peer->m_prevalidating_tx) {
+        // Workers wake us up again once they are done with it.
+        if (!peer->m_prevalidating_tx->m_done.load(std::memory_order_acquire)) return false;
+        const auto job{std::move(peer->m_prevalidating_tx)};
+        peer->m_prevalidating_tx.reset();
+        if (job->m_tx) {
+            ProcessIncomingTx(*pfrom, *peer, job->m_tx);
+        } else {
+            LogPrint(BCLog::NET, "%s(%s) from peer=%d: Exception '%s' caught\n", __func__, NetMsgType::TX, pfrom->GetId(), job->m_error);
+        }
+        m_txprevalidator->FinishJob(*job);
+    }
+
     {
         LOCK2(cs_main, g_cs_orphans);
         if (!peer->m_orphan_work_set.empty()) {
@@ -4185,15 +4685,21 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
     if (pfrom->fPauseSend) return false;
 
     std::list<CNetMessage> msgs;
+    bool resume_recv{false};
     {
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty()) return false;
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().m_raw_message_size;
+        resume_recv = pfrom->fPauseRecv;
         pfrom->fPauseRecv = pfrom->nProcessQueueSize > m_connman.GetReceiveFloodSize();
+        resume_recv &= !pfrom->fPauseRecv;
         fMoreWork = !pfrom->vProcessMsg.empty();
     }
+    // The socket handler may be waiting for events that won't come for
+    // input that is already buffered.
+    if (resume_recv) m_connman.WakeSocketHandler();
     CNetMessage& msg(msgs.front());
 
     TRACE6(net, inbound_message,
@@ -4893,6 +5399,9 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                     // No reason to drain out at many times the network's capacity,
                     // especially since we have many peers and some will draw much shorter delays.
                     unsigned int nRelayedTransactions = 0;
+                    // Peers we reconcile with get transactions added to their reconciliation set
+                    // instead of an INV, unless the set is full, in which case we fall back to flooding.
+                    const bool reconcile{m_txreconciliation && m_txreconciliation->IsPeerRegistered(pto->GetId())};
                     LOCK(pto->m_tx_relay->cs_filter);
                     while (!vInvTx.empty() && nRelayedTransactions < INVENTORY_BROADCAST_MAX) {
                         // Fetch the top element from the heap
@@ -4919,6 +5428,10 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                             continue;
                         }
                         if (pto->m_tx_relay->pfilter && !pto->m_tx_relay->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
+                        if (reconcile && m_txreconciliation->AddToSet(pto->GetId(), wtxid)) {
+                            // Announced after the next reconciliation round, if the peer lacks it.
+                            continue;
+                        }
                         // Send
                         State(pto->GetId())->m_recently_announced_invs.insert(hash);
                         vInv.push_back(inv);
@@ -4960,6 +5473,13 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
         if (!vInv.empty())
             m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
 
+        // Start a reconciliation round if it's our turn with this peer.
+        if (m_txreconciliation) {
+            if (const auto request{m_txreconciliation->MaybeRequestReconciliation(pto->GetId(), current_time)}) {
+                m_connman.PushMessage(pto, msgMaker.Make(NetMsgType::REQTXRCNCL, request->first, request->second));
+            }
+        }
+
         // Detect whether we're stalling
         if (state.m_stalling_since.count() && state.m_stalling_since < current_time - BLOCK_STALLING_TIMEOUT) {
             // Stalling only triggers when the block download window cannot move. During normal steady state,
@@ -5024,10 +5544,26 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !m_chainman.ActiveChainstate().IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        const int block_window{state.m_block_download.Window()};
+        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !m_chainman.ActiveChainstate().IsInitialBlockDownload()) && state.nBlocksInFlight < block_window) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller);
+            const CBlockIndex* stalled_block{nullptr};
+            FindNextBlocksToDownload(pto->GetId(), block_window - state.nBlocksInFlight, vToDownload, staller, stalled_block);
+            if (staller != -1) {
+                // The window can't move until the staller delivers its block.
+                // Rather than wait for it to time out, ask this peer for the
+                // block if it is likely to be faster.
+                CNodeState& staller_state{*State(staller)};
+                const auto queued_it{mapBlocksInFlight.at(stalled_block->GetBlockHash()).second};
+                const int position = std::distance(staller_state.vBlocksInFlight.begin(), queued_it);
+                if (ShouldRerequestBlock(state, staller_state, *queued_it, position, current_time)) {
+                    staller_state.m_block_download.BlockRerequested(current_time - queued_it->m_requested);
+                    LogPrint(BCLog::NET, "Block %s (%d) is overdue from peer=%d, rerequesting it from peer=%d\n",
+                        stalled_block->GetBlockHash().ToString(), stalled_block->nHeight, staller, pto->GetId());
+                    vToDownload.push_back(stalled_block);
+                }
+            }
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(*pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -7,8 +7,14 @@
 #define BITCOIN_NET_PROCESSING_H
 
 #include <net.h>
+#include <node/blockdownload.h>
+#include <node/blockservecache.h>
+#include <node/txprevalidation.h>
+#include <node/txreconciliation.h>
 #include <validationinterface.h>
 
+#include <optional>
+
 class AddrMan;
 class CChainParams;
 class CTxMemPool;
@@ -16,12 +22,18 @@ class ChainstateManager;
 
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxorphanmemory, maximum memory used by orphan transactions in megabytes */
+static const unsigned int DEFAULT_MAX_ORPHAN_MEMORY = 10;
 /** Default number of orphan+recently-replaced txn to keep around for block reconstruction */
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
 static const bool DEFAULT_PEERBLOOMFILTERS = false;
 static const bool DEFAULT_PEERBLOCKFILTERS = false;
 /** Threshold for marking a node to be discouraged, e.g. disconnected and added to the discouragement filter. */
 static const int DISCOURAGEMENT_THRESHOLD{100};
+/** Default for -packagerelay */
+static constexpr bool DEFAULT_PACKAGE_RELAY{false};
+/** Version of package relay sent in sendpackages */
+static constexpr uint32_t PACKAGE_RELAY_VERSION{1};
 
 struct CNodeStateStats {
     int nSyncHeight = -1;
@@ -29,9 +41,12 @@ struct CNodeStateStats {
     int m_starting_height = -1;
     std::chrono::microseconds m_ping_wait;
     std::vector<int> vHeightInFlight;
+    BlockDownloadStats m_block_download;
     uint64_t m_addr_processed = 0;
     uint64_t m_addr_rate_limited = 0;
     bool m_addr_relay_enabled{false};
+    //! Set if transactions are reconciled with this peer (BIP330)
+    std::optional<TxReconciliationStats> m_txrecon;
 };
 
 class PeerManager : public CValidationInterface, public NetEventsInterface
@@ -58,6 +73,12 @@ public:
     /** Get statistics from node state */
     virtual bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats) const = 0;
 
+    /** Get statistics of transaction pre-validation, if enabled */
+    virtual std::optional<TxPreValidationStats> GetTxPreValidationStats() const = 0;
+
+    /** Get statistics of the cache of blocks served to peers, if enabled */
+    virtual std::optional<BlockServeCacheStats> GetBlockServeCacheStats() const = 0;
+
     /** Whether this node ignores txs received over p2p. */
     virtual bool IgnoresIncomingTxs() = 0;
 
@@ -0,0 +1,77 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockdownload.h>
+
+#include <algorithm>
+
+namespace {
+/** Move a smoothed value 1/8th of the way towards a new sample. */
+template <typename T>
+T Smooth(T value, T sample)
+{
+    return value + (sample - value) / 8;
+}
+} // namespace
+
+void BlockDownloadRate::BlockReceived(std::chrono::microseconds requested, std::chrono::microseconds now, size_t size)
+{
+    const bool first{m_blocks_received == 0};
+    const auto service_time{std::max(now - std::max(requested, m_last_received), std::chrono::microseconds{0})};
+
+    if (requested >= m_last_received) {
+        // Nothing of ours was left for the peer to send when we asked, so
+        // this is a latency sample.
+        const auto latency{service_time};
+        if (first) {
+            m_latency = latency;
+            m_latency_var = latency / 2;
+        } else {
+            m_latency_var += (std::chrono::abs(m_latency - latency) - m_latency_var) / 4;
+            m_latency = Smooth(m_latency, latency);
+        }
+    }
+
+    m_service_time = first ? service_time : Smooth(m_service_time, service_time);
+    if (service_time.count() > 0) {
+        const double bytes_per_sec{size / std::chrono::duration<double>{service_time}.count()};
+        m_bytes_per_sec = first ? bytes_per_sec : Smooth(m_bytes_per_sec, bytes_per_sec);
+    }
+    m_last_received = std::max(m_last_received, now);
+    ++m_blocks_received;
+}
+
+void BlockDownloadRate::BlockRerequested(std::chrono::microseconds waited)
+{
+    // The peer took at least this long for the block; count it as such, so
+    // that it is asked for fewer blocks.
+    m_service_time = HasEstimate() ? Smooth(m_service_time, waited) : waited;
+    ++m_blocks_rerequested;
+}
+
+int BlockDownloadRate::Window() const
+{
+    if (!HasEstimate()) return DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER;
+    if (m_service_time.count() <= 0) return MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    const auto horizon{m_latency + std::chrono::microseconds{BLOCK_DOWNLOAD_QUEUE_TARGET}};
+    const int64_t blocks{(horizon.count() + m_service_time.count() - 1) / m_service_time.count()};
+    return static_cast<int>(std::clamp<int64_t>(blocks, MIN_BLOCKS_IN_TRANSIT_PER_PEER, MAX_BLOCKS_IN_TRANSIT_PER_PEER));
+}
+
+std::chrono::microseconds BlockDownloadRate::ExpectedDelivery(int position) const
+{
+    if (!HasEstimate()) return std::chrono::microseconds::max();
+    return m_latency + 4 * m_latency_var + position * m_service_time;
+}
+
+BlockDownloadStats BlockDownloadRate::GetStats() const
+{
+    BlockDownloadStats stats;
+    stats.window = Window();
+    stats.bytes_per_sec = m_bytes_per_sec;
+    stats.latency = m_latency;
+    stats.blocks_received = m_blocks_received;
+    stats.blocks_rerequested = m_blocks_rerequested;
+    return stats;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCKDOWNLOAD_H
+#define BITCOIN_NODE_BLOCKDOWNLOAD_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/** Number of blocks requested from a peer before anything is known about its speed. */
+static constexpr int DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER{16};
+/** Bounds of the number of blocks that can be requested at any given time from a single peer. */
+static constexpr int MIN_BLOCKS_IN_TRANSIT_PER_PEER{2};
+static constexpr int MAX_BLOCKS_IN_TRANSIT_PER_PEER{128};
+/** How much work, in time, to keep queued at each peer beyond its round-trip latency. */
+static constexpr std::chrono::seconds BLOCK_DOWNLOAD_QUEUE_TARGET{1};
+
+/** Per-peer block download figures, reported by getpeerinfo. */
+struct BlockDownloadStats {
+    //! Number of blocks we currently allow in flight from the peer
+    int window{DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER};
+    //! Smoothed download rate, in bytes per second (0 until a block arrived)
+    double bytes_per_sec{0};
+    //! Smoothed time between asking an idle peer for a block and receiving it
+    std::chrono::microseconds latency{0};
+    uint64_t blocks_received{0};
+    //! Blocks that were requested from another peer because this one was too slow to deliver them
+    uint64_t blocks_rerequested{0};
+};
+
+/**
+ * Estimates how fast a peer delivers the blocks we ask it for, to size the
+ * number of blocks requested from it at once.
+ *
+ * Two quantities are tracked, smoothed the way TCP smooths round-trip times
+ * (RFC 6298):
+ * - the latency, from blocks requested while the peer had none of ours left
+ *   to send, so that it isn't inflated by the blocks queued ahead of them;
+ * - the service time, i.e. how long the peer takes per block once it is
+ *   busy: the time since the later of the request and the previous block.
+ *
+ * The window is then the number of blocks the peer can deliver within one
+ * latency plus BLOCK_DOWNLOAD_QUEUE_TARGET, which keeps the connection busy
+ * without handing a slow peer blocks others are waiting on.
+ */
+class BlockDownloadRate
+{
+public:
+    /** A block of the given size, requested at the given time, was received. */
+    void BlockReceived(std::chrono::microseconds requested, std::chrono::microseconds now, size_t size);
+
+    /** A block was requested from another peer after waiting for it this long. */
+    void BlockRerequested(std::chrono::microseconds waited);
+
+    /** Number of blocks to allow in flight from the peer. */
+    int Window() const;
+
+    /**
+     * How long after being requested the block at the given position in the
+     * peer's queue should have arrived, leaving room for the usual variance.
+     * Position 0 is the first block in flight. Returns max() while nothing was
+     * received from the peer yet.
+     */
+    std::chrono::microseconds ExpectedDelivery(int position) const;
+
+    bool HasEstimate() const { return m_blocks_received > 0; }
+
+    BlockDownloadStats GetStats() const;
+
+private:
+    //! When the last block was received from the peer
+    std::chrono::microseconds m_last_received{0};
+    std::chrono::microseconds m_latency{0};
+    std::chrono::microseconds m_latency_var{0};
+    std::chrono::microseconds m_service_time{0};
+    double m_bytes_per_sec{0};
+    uint64_t m_blocks_received{0};
+    uint64_t m_blocks_rerequested{0};
+};
+
+#endif // BITCOIN_NODE_BLOCKDOWNLOAD_H
@@ -0,0 +1,72 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockservecache.h>
+
+#include <protocol.h>
+
+#include <cassert>
+
+std::string BlockServeMsgType(BlockServeFormat format)
+{
+    switch (format) {
+    case BlockServeFormat::BLOCK:
+    case BlockServeFormat::BLOCK_WITNESS:
+        return NetMsgType::BLOCK;
+    case BlockServeFormat::CMPCTBLOCK:
+    case BlockServeFormat::CMPCTBLOCK_WITNESS:
+        return NetMsgType::CMPCTBLOCK;
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
+std::shared_ptr<const SharedNetPayload> BlockServeCache::Get(const uint256& hash, BlockServeFormat format)
+{
+    LOCK(m_mutex);
+    const auto it{m_index.find({hash, format})};
+    if (it == m_index.end()) {
+        ++m_misses;
+        return nullptr;
+    }
+    ++m_hits;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->payload;
+}
+
+std::shared_ptr<const SharedNetPayload> BlockServeCache::Insert(const uint256& hash, BlockServeFormat format, std::vector<unsigned char>&& data)
+{
+    auto payload{std::make_shared<const SharedNetPayload>(std::move(data))};
+    const size_t size{payload->data.size()};
+    if (size > m_max_usage) return payload;
+
+    LOCK(m_mutex);
+    const Key key{hash, format};
+    if (const auto it{m_index.find(key)}; it != m_index.end()) {
+        // Serialized concurrently; keep the one already shared with others.
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return it->second->payload;
+    }
+    while (m_usage + size > m_max_usage) {
+        const Entry& oldest{m_entries.back()};
+        m_usage -= oldest.payload->data.size();
+        m_index.erase(oldest.key);
+        m_entries.pop_back();
+    }
+    m_entries.push_front(Entry{key, payload});
+    m_index.emplace(key, m_entries.begin());
+    m_usage += size;
+    return payload;
+}
+
+BlockServeCacheStats BlockServeCache::GetStats() const
+{
+    LOCK(m_mutex);
+    BlockServeCacheStats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.entries = m_entries.size();
+    stats.usage = m_usage;
+    stats.max_usage = m_max_usage;
+    return stats;
+}
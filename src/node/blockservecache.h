@@ -0,0 +1,86 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCKSERVECACHE_H
+#define BITCOIN_NODE_BLOCKSERVECACHE_H
+
+#include <net.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Default for -blockservecachesize, in MiB (0 = off) */
+static constexpr int64_t DEFAULT_BLOCK_SERVE_CACHE_SIZE{32};
+
+/** The wire forms in which a block is served to peers. */
+enum class BlockServeFormat : uint8_t {
+    BLOCK,              //!< block message without witness data
+    BLOCK_WITNESS,      //!< block message with witness data
+    CMPCTBLOCK,         //!< cmpctblock message with txid short ids (version 1)
+    CMPCTBLOCK_WITNESS, //!< cmpctblock message with wtxid short ids (version 2)
+};
+
+/** The message type for a block served in the given format. */
+std::string BlockServeMsgType(BlockServeFormat format);
+
+struct BlockServeCacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    size_t entries{0};
+    //! Total payload size of the entries, in bytes
+    size_t usage{0};
+    size_t max_usage{0};
+};
+
+/**
+ * Least recently used cache of block messages served to peers, in their
+ * serialized form. Peers catching up with the tip ask for the same few blocks
+ * one after the other; this way each of them is read, deserialized and
+ * serialized again only once, and the payload is shared by the send queues
+ * of all peers it is sent to.
+ */
+class BlockServeCache
+{
+public:
+    explicit BlockServeCache(size_t max_usage) : m_max_usage{max_usage} {}
+
+    /** Look up a block, marking it as recently used. Returns nullptr if it isn't cached. */
+    std::shared_ptr<const SharedNetPayload> Get(const uint256& hash, BlockServeFormat format) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /**
+     * Add a serialized block, evicting the least recently used ones to make
+     * room. Blocks too large for the cache are not added, but are still
+     * returned as a shared payload.
+     */
+    std::shared_ptr<const SharedNetPayload> Insert(const uint256& hash, BlockServeFormat format, std::vector<unsigned char>&& data) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    BlockServeCacheStats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    using Key = std::pair<uint256, BlockServeFormat>;
+    struct Entry {
+        Key key;
+        std::shared_ptr<const SharedNetPayload> payload;
+    };
+
+    const size_t m_max_usage;
+
+    mutable Mutex m_mutex;
+    //! Most recently used first
+    std::list<Entry> m_entries GUARDED_BY(m_mutex);
+    std::map<Key, std::list<Entry>::iterator> m_index GUARDED_BY(m_mutex);
+    size_t m_usage GUARDED_BY(m_mutex){0};
+    uint64_t m_hits GUARDED_BY(m_mutex){0};
+    uint64_t m_misses GUARDED_BY(m_mutex){0};
+};
+
+#endif // BITCOIN_NODE_BLOCKSERVECACHE_H
@@ -18,8 +18,13 @@
 #include <undo.h>
 #include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/thread.h>
+#include <util/threadnames.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <tuple>
+
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fHavePruned = false;
@@ -136,9 +141,8 @@ static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const
     return true;
 }
 
-bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+static bool UndoReadFromDisk(CBlockUndo& blockundo, const FlatFilePos& pos, const uint256& hashPrev)
 {
-    FlatFilePos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
         return error("%s: no undo data available", __func__);
     }
@@ -153,7 +157,7 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
     uint256 hashChecksum;
     CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
     try {
-        verifier << pindex->pprev->GetBlockHash();
+        verifier << hashPrev;
         verifier >> blockundo;
         filein >> hashChecksum;
     } catch (const std::exception& e) {
@@ -168,6 +172,11 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
     return true;
 }
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    return UndoReadFromDisk(blockundo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash());
+}
+
 static void FlushUndoFile(int block_file, bool finalize = false)
 {
     FlatFilePos undo_pos_old(block_file, vinfoBlockFile[block_file].nUndoSize);
@@ -474,6 +483,211 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex
     return ReadRawBlockFromDisk(block, block_pos, message_start);
 }
 
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start, bool with_witness)
+{
+    if (with_witness) return ReadRawBlockFromDisk(block, pindex, message_start);
+
+    std::vector<uint8_t> block_data;
+    if (!ReadRawBlockFromDisk(block_data, pindex, message_start)) return false;
+    if (!StripRawBlockWitness(block_data, block)) {
+        return error("%s: Malformed block data for %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    return true;
+}
+
+namespace {
+/**
+ * Walks a serialized block, copying everything but the witness data to the
+ * output. Mirrors the (un)serialization of CBlock, CAuxPow and CTransaction.
+ */
+class WitnessStripper
+{
+public:
+    WitnessStripper(Span<const uint8_t> in, std::vector<uint8_t>& out) : m_in{in}, m_out{out} {}
+
+    void Block()
+    {
+        const Span<const uint8_t> header_data{Take(80)};
+        m_out.insert(m_out.end(), header_data.begin(), header_data.end());
+        CPureBlockHeader header;
+        SpanReader{SER_NETWORK, PROTOCOL_VERSION, header_data} >> header;
+        if (header.IsAuxpow()) {
+            Transaction();
+            Copy(32);                          // hashBlock
+            Copy(32 * CopyCompactSize() + 4);  // vMerkleBranch, nIndex
+            Copy(32 * CopyCompactSize() + 4);  // vChainMerkleBranch, nChainIndex
+            Copy(80);                          // parentBlock
+        }
+        for (uint64_t n_tx{CopyCompactSize()}; n_tx > 0; --n_tx) {
+            Transaction();
+        }
+        if (!m_in.subspan(m_pos).empty()) throw std::ios_base::failure("trailing data");
+    }
+
+private:
+    Span<const uint8_t> Take(size_t n)
+    {
+        if (n > m_in.size() - m_pos) throw std::ios_base::failure("end of data");
+        const Span<const uint8_t> taken{m_in.subspan(m_pos, n)};
+        m_pos += n;
+        return taken;
+    }
+
+    void Copy(size_t n)
+    {
+        const Span<const uint8_t> taken{Take(n)};
+        m_out.insert(m_out.end(), taken.begin(), taken.end());
+    }
+
+    uint64_t ReadCompactSize()
+    {
+        SpanReader reader{SER_NETWORK, PROTOCOL_VERSION, m_in.subspan(m_pos)};
+        const uint64_t size{::ReadCompactSize(reader)};
+        m_pos = m_in.size() - reader.size();
+        return size;
+    }
+
+    uint64_t CopyCompactSize()
+    {
+        const size_t start{m_pos};
+        const uint64_t size{ReadCompactSize()};
+        m_out.insert(m_out.end(), m_in.begin() + start, m_in.begin() + m_pos);
+        return size;
+    }
+
+    void Transaction()
+    {
+        Copy(4); // nVersion
+        uint64_t n_in{ReadCompactSize()};
+        uint8_t flags{0};
+        uint64_t n_out{0};
+        if (n_in == 0) {
+            // The dummy vin of the extended format, or an empty vin
+            flags = Take(1)[0];
+            if (flags != 0) n_in = ReadCompactSize();
+        }
+        CVectorWriter writer{SER_NETWORK, PROTOCOL_VERSION, m_out, m_out.size()};
+        WriteCompactSize(writer, n_in);
+        for (uint64_t i = 0; i < n_in; ++i) {
+            Copy(36);                     // prevout
+            Copy(CopyCompactSize() + 4);  // scriptSig, nSequence
+        }
+        if (n_in > 0 || flags != 0) {
+            n_out = CopyCompactSize();
+        } else {
+            // Empty vin and no flags: no vout was read, an empty one is written
+            m_out.push_back(0);
+        }
+        for (uint64_t i = 0; i < n_out; ++i) {
+            Copy(8);                      // nValue
+            Copy(CopyCompactSize());      // scriptPubKey
+        }
+        if (flags & 1) {
+            flags ^= 1;
+            bool has_witness{false};
+            for (uint64_t i = 0; i < n_in; ++i) {
+                for (uint64_t n_items{ReadCompactSize()}; n_items > 0; --n_items) {
+                    Take(ReadCompactSize());
+                    has_witness = true;
+                }
+            }
+            if (!has_witness) throw std::ios_base::failure("Superfluous witness record");
+        }
+        if (flags) throw std::ios_base::failure("Unknown transaction optional data");
+        Copy(4); // nLockTime
+    }
+
+    const Span<const uint8_t> m_in;
+    size_t m_pos{0};
+    std::vector<uint8_t>& m_out;
+};
+} // namespace
+
+bool StripRawBlockWitness(Span<const uint8_t> block, std::vector<uint8_t>& stripped)
+{
+    stripped.clear();
+    stripped.reserve(block.size());
+    try {
+        WitnessStripper{block, stripped}.Block();
+    } catch (const std::ios_base::failure&) {
+        return false;
+    }
+    return true;
+}
+
+BlockUndoReadahead::BlockUndoReadahead(const std::vector<const CBlockIndex*>& run, const Consensus::Params& params, size_t max_ahead, WarmFn warm)
+    : m_max_ahead{std::max<size_t>(max_ahead, 1)}, m_warm{std::move(warm)}
+{
+    AssertLockHeld(cs_main);
+    m_run.reserve(run.size());
+    for (const CBlockIndex* pindex : run) {
+        assert(pindex->pprev);
+        m_run.push_back({pindex, pindex->GetBlockHash(), pindex->pprev->GetBlockHash(), pindex->GetBlockPos(), pindex->GetUndoPos()});
+    }
+    m_thread = std::thread(&util::TraceThread, "undoread", [this, &params] { ThreadRead(params); });
+}
+
+BlockUndoReadahead::~BlockUndoReadahead()
+{
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+void BlockUndoReadahead::ThreadRead(const Consensus::Params& params)
+{
+    for (const Planned& planned : m_run) {
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || m_ready.size() < m_max_ahead; });
+            if (m_stop) return;
+        }
+
+        auto block = std::make_shared<CBlock>();
+        auto undo = std::make_shared<CBlockUndo>();
+        if (!ReadBlockFromDisk(*block, planned.block_pos, params) || block->GetHash() != planned.hash ||
+            !UndoReadFromDisk(*undo, planned.undo_pos, planned.hash_prev)) {
+            LogPrint(BCLog::VALIDATION, "%s: failed to read %s ahead, leaving it to the caller\n", __func__, planned.hash.ToString());
+            block.reset();
+            undo.reset();
+        } else if (m_warm) {
+            try {
+                m_warm(*block, *undo);
+            } catch (const std::exception& e) {
+                // Only a cache warm-up; the disconnect itself will report it.
+                LogPrint(BCLog::VALIDATION, "%s: warm-up failed: %s\n", __func__, e.what());
+            }
+        }
+
+        WITH_LOCK(m_mutex, m_ready.emplace_back(std::move(block), std::move(undo)));
+        m_cv.notify_all();
+    }
+}
+
+bool BlockUndoReadahead::Take(const CBlockIndex* pindex, std::shared_ptr<CBlock>& block, CBlockUndo& undo)
+{
+    Entry entry;
+    {
+        WAIT_LOCK(m_mutex, lock);
+        if (m_stop) return false;
+        if (m_next >= m_run.size() || m_run[m_next].pindex != pindex) {
+            m_stop = true;
+            m_cv.notify_all();
+            return false;
+        }
+        m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return !m_ready.empty(); });
+        entry = std::move(m_ready.front());
+        m_ready.pop_front();
+        ++m_next;
+    }
+    m_cv.notify_all();
+
+    if (!entry.first) return false;
+    block = std::move(entry.first);
+    undo = std::move(*entry.second);
+    return true;
+}
+
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
 FlatFilePos SaveBlockToDisk(const CBlock& block, int nHeight, CChain& active_chain, const CChainParams& chainparams, const FlatFilePos* dbp)
 {
@@ -509,6 +723,147 @@ struct CImportingNow {
     }
 };
 
+/** Bytes of scanned blocks buffered per block file during -reindex */
+static constexpr size_t REINDEX_FILE_BUFFER_SIZE{32 << 20};
+
+/**
+ * Reindex the block files.  Scanner threads read and deserialize the files
+ * (including auxpow) and pre-check their blocks (merkle root, proof of work),
+ * a few files ahead of this thread, which takes the blocks over in file order
+ * and adds them to the block index just like a sequential reindex would.
+ * @returns false if shutdown was requested
+ */
+static bool ReindexBlockFiles(CChainState& chainstate, int threads)
+{
+    int nFiles = 0;
+    while (fs::exists(GetBlockPosFilename(FlatFilePos(nFiles, 0)))) {
+        ++nFiles;
+    }
+    threads = std::max(1, std::min(threads, nFiles));
+
+    struct ScannedFile {
+        //! Blocks with their position and size in the file, in file order
+        std::deque<std::tuple<std::shared_ptr<CBlock>, uint64_t, unsigned int>> blocks;
+        size_t bytes{0};
+        bool done{false};
+    };
+    Mutex mutex;
+    std::condition_variable cv;
+    // All guarded by mutex:
+    std::vector<ScannedFile> files(nFiles);
+    int next_scan{0};
+    int next_load{0};
+    bool stop{false};
+
+    std::atomic<int64_t> scan_micros{0};
+    const Consensus::Params& consensus = chainstate.m_params.GetConsensus();
+    auto scan = [&] {
+        while (true) {
+            int nFile;
+            {
+                WAIT_LOCK(mutex, lock);
+                // Stay at most `threads` files ahead of the loading thread.
+                cv.wait(lock, [&] { return stop || next_scan >= nFiles || next_scan <= next_load + threads; });
+                if (stop || next_scan >= nFiles) return;
+                nFile = next_scan++;
+            }
+            ScannedFile& file = files[nFile];
+            const int64_t start{GetTimeMicros()};
+            if (FILE* fileIn = OpenBlockFile(FlatFilePos(nFile, 0), true)) {
+                try {
+                    ScanExternalBlockFile(fileIn, chainstate.m_params, [&](std::shared_ptr<CBlock> pblock, uint64_t nBlockPos, unsigned int nSize) {
+                        // The result is cached in CBlock::fChecked; failures are
+                        // reported when the block is loaded.
+                        BlockValidationState state;
+                        CheckBlock(*pblock, state, consensus);
+
+                        WAIT_LOCK(mutex, lock);
+                        cv.wait(lock, [&] { return stop || file.bytes < REINDEX_FILE_BUFFER_SIZE; });
+                        if (stop) return false;
+                        file.blocks.emplace_back(std::move(pblock), nBlockPos, nSize);
+                        file.bytes += nSize;
+                        cv.notify_all();
+                        return true;
+                    });
+                } catch (const std::runtime_error& e) {
+                    AbortNode(std::string("System error: ") + e.what());
+                }
+            }
+            scan_micros += GetTimeMicros() - start;
+            WITH_LOCK(mutex, file.done = true);
+            cv.notify_all();
+        }
+    };
+    std::vector<std::thread> scanners;
+    for (int n = 0; n < threads; ++n) {
+        scanners.emplace_back([&scan, n] {
+            util::ThreadRename(strprintf("reindex.%i", n));
+            scan();
+        });
+    }
+
+    const int64_t start{GetTimeMicros()};
+    int64_t wait_micros{0};
+    uint64_t total_blocks{0};
+    uint64_t total_bytes{0};
+    bool shutdown{false};
+    for (int nFile = 0; nFile < nFiles && !shutdown; ++nFile) {
+        LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+        const int64_t file_start{GetTimeMillis()};
+        ScannedFile& file = files[nFile];
+        FlatFilePos pos(nFile, 0);
+        int nLoaded = 0;
+        bool skip = false;
+        while (true) {
+            std::shared_ptr<CBlock> pblock;
+            unsigned int nSize;
+            {
+                WAIT_LOCK(mutex, lock);
+                if (file.blocks.empty() && !file.done) {
+                    const int64_t wait_start{GetTimeMicros()};
+                    cv.wait(lock, [&] { return !file.blocks.empty() || file.done; });
+                    wait_micros += GetTimeMicros() - wait_start;
+                }
+                if (file.blocks.empty()) break;
+                std::tie(pblock, pos.nPos, nSize) = std::move(file.blocks.front());
+                file.blocks.pop_front();
+                file.bytes -= nSize;
+            }
+            cv.notify_all();
+            ++total_blocks;
+            total_bytes += nSize;
+
+            if (ShutdownRequested()) {
+                shutdown = true;
+                break;
+            }
+            if (skip) continue;
+            try {
+                skip = !chainstate.LoadExternalBlock(pblock, &pos, nLoaded);
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - file_start);
+        WITH_LOCK(mutex, next_load = nFile + 1);
+        cv.notify_all();
+        shutdown = shutdown || ShutdownRequested();
+    }
+
+    WITH_LOCK(mutex, stop = true);
+    cv.notify_all();
+    for (std::thread& scanner : scanners) {
+        scanner.join();
+    }
+
+    const int64_t total_micros{GetTimeMicros() - start};
+    LogPrintf("Reindexed %u blocks (%.1f MiB) from %d block files in %.2fs using %d scanner threads "
+              "(scanning %.2fs, loading %.2fs, waiting for scanners %.2fs)\n",
+              total_blocks, total_bytes / double(1 << 20), nFiles, total_micros * 0.000001, threads,
+              scan_micros * 0.000001, (total_micros - wait_micros) * 0.000001, wait_micros * 0.000001);
+    return !shutdown;
+}
+
 void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFiles, const ArgsManager& args)
 {
     SetSyscallSandboxPolicy(SyscallSandboxPolicy::INITIALIZATION_LOAD_BLOCKS);
@@ -519,23 +874,14 @@ void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFile
 
         // -reindex
         if (fReindex) {
-            int nFile = 0;
-            while (true) {
-                FlatFilePos pos(nFile, 0);
-                if (!fs::exists(GetBlockPosFilename(pos))) {
-                    break; // No block files left to reindex
-                }
-                FILE* file = OpenBlockFile(pos, true);
-                if (!file) {
-                    break; // This error is logged in OpenBlockFile
-                }
-                LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-                chainman.ActiveChainstate().LoadExternalBlockFile(file, &pos);
-                if (ShutdownRequested()) {
-                    LogPrintf("Shutdown requested. Exit %s\n", __func__);
-                    return;
-                }
-                nFile++;
+            int threads = args.GetIntArg("-reindexthreads", DEFAULT_REINDEX_THREADS);
+            if (threads <= 0) {
+                threads = GetNumCores() - 1;
+            }
+            threads = std::clamp(threads, 1, MAX_REINDEX_THREADS);
+            if (!ReindexBlockFiles(chainman.ActiveChainstate(), threads)) {
+                LogPrintf("Shutdown requested. Exit %s\n", __func__);
+                return;
             }
             WITH_LOCK(::cs_main, chainman.m_blockman.m_block_tree_db->WriteReindexing(false));
             fReindex = false;
@@ -5,11 +5,20 @@
 #ifndef BITCOIN_NODE_BLOCKSTORAGE_H
 #define BITCOIN_NODE_BLOCKSTORAGE_H
 
+#include <flatfile.h>
 #include <fs.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
+#include <sync.h>
+#include <uint256.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
 #include <vector>
 
 class ArgsManager;
@@ -28,6 +37,10 @@ struct Params;
 }
 
 static constexpr bool DEFAULT_STOPAFTERBLOCKIMPORT{false};
+/** Default for -reindexthreads (0 = one less than the number of cores, up to MAX_REINDEX_THREADS) */
+static constexpr int DEFAULT_REINDEX_THREADS{0};
+/** Maximum number of threads scanning block files during -reindex */
+static constexpr int MAX_REINDEX_THREADS{8};
 
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
@@ -72,11 +85,78 @@ bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::P
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+/** Read a block in its network serialization, without the witness data unless with_witness is set. */
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start, bool with_witness);
+/**
+ * Copy a serialized block without the witness data of its transactions,
+ * including the coinbase of an auxpow, as it would be serialized with
+ * SERIALIZE_TRANSACTION_NO_WITNESS. This works on the bytes as they are,
+ * without deserializing the block. Returns false if they aren't a
+ * well-formed block.
+ */
+bool StripRawBlockWitness(Span<const uint8_t> block, std::vector<uint8_t>& stripped);
 bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 bool WriteUndoDataForBlock(const CBlockUndo& blockundo, BlockValidationState& state, CBlockIndex* pindex, const CChainParams& chainparams);
 
+/**
+ * Reads the block and undo data of a planned run of disconnects on a
+ * background thread, ahead of the caller.  The run is given tip first, which
+ * is the order DisconnectTip consumes it in, and at most max_ahead entries
+ * are buffered.  An optional hook runs on the reader thread after each entry
+ * has been read, e.g. to warm database caches for the records the
+ * disconnect will touch.
+ *
+ * The block positions are captured at construction (under cs_main), so the
+ * reader thread never touches the block index.
+ */
+class BlockUndoReadahead
+{
+public:
+    using WarmFn = std::function<void(const CBlock&, const CBlockUndo&)>;
+
+    BlockUndoReadahead(const std::vector<const CBlockIndex*>& run, const Consensus::Params& params, size_t max_ahead, WarmFn warm = {});
+    ~BlockUndoReadahead();
+
+    BlockUndoReadahead(const BlockUndoReadahead&) = delete;
+    BlockUndoReadahead& operator=(const BlockUndoReadahead&) = delete;
+
+    /**
+     * Hand over the data for pindex, waiting for the reader if needed.
+     * Returns false if pindex is not the next block of the run or reading it
+     * failed; the caller then reads it from disk itself.  Once the caller
+     * strays from the run, the readahead stops.
+     */
+    bool Take(const CBlockIndex* pindex, std::shared_ptr<CBlock>& block, CBlockUndo& undo);
+
+private:
+    struct Planned {
+        const CBlockIndex* pindex;
+        uint256 hash;
+        uint256 hash_prev;
+        FlatFilePos block_pos;
+        FlatFilePos undo_pos;
+    };
+    using Entry = std::pair<std::shared_ptr<CBlock>, std::shared_ptr<CBlockUndo>>;
+
+    void ThreadRead(const Consensus::Params& params);
+
+    std::vector<Planned> m_run;
+    const size_t m_max_ahead;
+    const WarmFn m_warm;
+
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    //! Entries read but not yet taken, in run order (null on read failure)
+    std::deque<Entry> m_ready GUARDED_BY(m_mutex);
+    //! Index into m_run of the next entry to be taken
+    size_t m_next GUARDED_BY(m_mutex){0};
+    bool m_stop GUARDED_BY(m_mutex){false};
+
+    std::thread m_thread;
+};
+
 FlatFilePos SaveBlockToDisk(const CBlock& block, int nHeight, CChain& active_chain, const CChainParams& chainparams, const FlatFilePos* dbp);
 
 void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImportFiles, const ArgsManager& args);
@@ -4,7 +4,9 @@
 
 #include <node/caches.h>
 
+#include <index/addressindex.h>
 #include <index/namehash.h>
+#include <index/namehistory.h>
 #include <txdb.h>
 #include <util/system.h>
 #include <validation.h>
@@ -21,6 +23,10 @@ CacheSizes CalculateCacheSizes(const ArgsManager& args, size_t n_indexes)
     nTotalCache -= sizes.tx_index;
     sizes.name_hash_index = std::min(nTotalCache / 8, gArgs.GetBoolArg("-namehashindex", DEFAULT_NAMEHASHINDEX) ? MAX_NAMEHASH_CACHE << 20 : 0);
     nTotalCache -= sizes.name_hash_index;
+    sizes.name_history_index = std::min(nTotalCache / 8, args.GetBoolArg("-namehistory", DEFAULT_NAMEHISTORY) ? MAX_NAMEHISTORY_CACHE << 20 : 0);
+    nTotalCache -= sizes.name_history_index;
+    sizes.address_index = std::min(nTotalCache / 8, args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ? MAX_ADDRESS_INDEX_CACHE << 20 : 0);
+    nTotalCache -= sizes.address_index;
     sizes.filter_index = 0;
     if (n_indexes > 0) {
         int64_t max_cache = std::min(nTotalCache / 8, max_filter_index_cache << 20);
@@ -16,6 +16,8 @@ struct CacheSizes {
     int64_t coins;
     int64_t tx_index;
     int64_t name_hash_index;
+    int64_t name_history_index;
+    int64_t address_index;
     int64_t filter_index;
 };
 CacheSizes CalculateCacheSizes(const ArgsManager& args, size_t n_indexes = 0);
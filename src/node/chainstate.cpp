@@ -12,7 +12,6 @@ std::optional<ChainstateLoadingError> LoadChainstate(bool fReset,
                                                      ChainstateManager& chainman,
                                                      CTxMemPool* mempool,
                                                      bool fPruneMode,
-                                                     bool fNameHistory,
                                                      const Consensus::Params& consensus_params,
                                                      bool fReindexChainState,
                                                      int64_t nBlockTreeDBCache,
@@ -69,11 +68,6 @@ std::optional<ChainstateLoadingError> LoadChainstate(bool fReset,
         return ChainstateLoadingError::ERROR_PRUNED_NEEDS_REINDEX;
     }
 
-    // Check for changed -namehistory state
-    if (fNameHistory != fNameHistory) {
-        return ChainstateLoadingError::ERROR_NAME_HISTORY_NEEDS_REINDEX;
-    }
-
     // At this point blocktree args are consistent with what's on disk.
     // If we're not mid-reindex (based on disk + args), add a genesis block on disk
     // (otherwise we use the one already on disk).
@@ -0,0 +1,148 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/mempool_persist.h>
+
+#include <consensus/tx_check.h>
+#include <consensus/validation.h>
+#include <crypto/common.h>
+#include <hash.h>
+#include <tinyformat.h>
+#include <txmempool.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+#include <cassert>
+
+uint32_t MempoolRecordChecksum(Span<const unsigned char> data)
+{
+    const uint256 hash{Hash(data)};
+    return ReadLE32(hash.begin());
+}
+
+MempoolReloader::MempoolReloader(CChainState& chainstate, CTxMemPool& pool, int threads, int version, int64_t expiry_cutoff)
+    : m_chainstate(chainstate), m_pool(pool), m_version(version), m_expiry_cutoff(expiry_cutoff)
+{
+    for (int n = 0; n < threads; ++n) {
+        m_threads.emplace_back([this, n]() {
+            util::ThreadRename(strprintf("loadmempool.%i", n));
+            ThreadPreValidate();
+        });
+    }
+}
+
+MempoolReloader::~MempoolReloader()
+{
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_cv.notify_all();
+    for (std::thread& t : m_threads) t.join();
+}
+
+void MempoolReloader::Push(std::unique_ptr<Job> job)
+{
+    WITH_LOCK(m_mutex, m_jobs.push_back(Slot{std::move(job)}));
+    m_cv.notify_all();
+}
+
+void MempoolReloader::Add(MempoolRecord&& record)
+{
+    auto job{std::make_unique<Job>()};
+    job->record = std::move(record);
+    Push(std::move(job));
+}
+
+void MempoolReloader::Add(MempoolDumpEntry&& entry)
+{
+    auto job{std::make_unique<Job>()};
+    job->entry = std::move(entry);
+    Push(std::move(job));
+}
+
+size_t MempoolReloader::Pending() const
+{
+    LOCK(m_mutex);
+    return m_jobs.size();
+}
+
+uint64_t MempoolReloader::ScriptsOk() const
+{
+    LOCK(m_mutex);
+    return m_scripts_ok;
+}
+
+MempoolReloader::Slot* MempoolReloader::StartJob()
+{
+    AssertLockHeld(m_mutex);
+    if (m_started == m_jobs.size()) return nullptr;
+    return &m_jobs[m_started++];
+}
+
+std::unique_ptr<MempoolReloader::Job> MempoolReloader::Next()
+{
+    WAIT_LOCK(m_mutex, lock);
+    assert(!m_jobs.empty());
+    Slot& front{m_jobs.front()};
+    if (m_started == 0) {
+        // No worker got to it yet (or there are none): do it here rather
+        // than wait for one.
+        StartJob();
+        REVERSE_LOCK(lock);
+        PreValidate(*front.job);
+    } else {
+        m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return front.done; });
+    }
+    std::unique_ptr<Job> job{std::move(front.job)};
+    m_jobs.pop_front();
+    --m_started;
+    return job;
+}
+
+void MempoolReloader::ThreadPreValidate()
+{
+    while (true) {
+        Slot* slot;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || m_started < m_jobs.size(); });
+            if (m_stop) return;
+            slot = StartJob();
+        }
+        // The slot stays where it is until it is done: Next() waits for it.
+        PreValidate(*slot->job);
+        WITH_LOCK(m_mutex, slot->done = true);
+        m_cv.notify_all();
+    }
+}
+
+void MempoolReloader::PreValidate(Job& job)
+{
+    if (!job.entry) {
+        MempoolDumpEntry entry;
+        if (!job.record.Parse(entry, m_version)) return;
+        job.entry = std::move(entry);
+        job.record = {};
+    }
+    if (job.entry->time <= m_expiry_cutoff) {
+        job.expired = true;
+        return;
+    }
+
+    // As for transactions from peers, failures are left for mempool
+    // acceptance to report; all that matters here is the signature cache.
+    const CTransaction& tx{*job.entry->tx};
+    TxValidationState state;
+    if (!CheckTransaction(tx, state)) return;
+
+    std::vector<CTxOut> spent_outputs{job.entry->spent_outputs};
+    if (spent_outputs.size() != tx.vin.size()) {
+        // Dumped by an older version: look the outputs up, which only
+        // works for those of confirmed or already added transactions.
+        auto snapshot{GetSpentOutputsSnapshot(m_chainstate, m_pool, tx)};
+        if (!snapshot) return;
+        spent_outputs = std::move(*snapshot);
+    }
+    if (PreVerifyInputScripts(tx, std::move(spent_outputs))) {
+        WITH_LOCK(m_mutex, ++m_scripts_ok);
+    }
+}
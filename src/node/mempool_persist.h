@@ -0,0 +1,186 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_MEMPOOL_PERSIST_H
+#define BITCOIN_NODE_MEMPOOL_PERSIST_H
+
+#include <consensus/amount.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <span.h>
+#include <streams.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <thread>
+#include <vector>
+
+class CChainState;
+class CTxMemPool;
+
+/** Version of mempool.dat written by DumpMempool */
+static constexpr uint64_t MEMPOOL_DUMP_VERSION{2};
+/** Previous version of mempool.dat, without validation metadata or checksums, which can still be loaded */
+static constexpr uint64_t MEMPOOL_DUMP_VERSION_NO_METADATA{1};
+
+/** Maximum number of threads pre-validating transactions while the mempool is loaded */
+static constexpr int MAX_MEMPOOL_LOAD_THREADS{16};
+/** Number of entries read ahead of the one being added to the mempool */
+static constexpr size_t MEMPOOL_LOAD_WINDOW{1000};
+
+/**
+ * A mempool transaction as stored in mempool.dat. Entries are written in
+ * topological order, parents before their children, so they can be added
+ * back to the mempool one after the other.
+ */
+struct MempoolDumpEntry {
+    CTransactionRef tx;
+    int64_t time{0};
+    int64_t fee_delta{0};
+    /**
+     * The outputs spent by tx, in input order, as they were when the mempool
+     * was dumped. They let the scripts be checked before the parents are
+     * back in the mempool; acceptance still checks against the actual coins.
+     * Empty if unknown.
+     */
+    std::vector<CTxOut> spent_outputs;
+
+    SERIALIZE_METHODS(MempoolDumpEntry, obj) { READWRITE(obj.tx, obj.time, obj.fee_delta, obj.spent_outputs); }
+};
+
+/** What follows the entries in mempool.dat */
+struct MempoolDumpTrailer {
+    //! Fee deltas of transactions not in the mempool
+    std::map<uint256, CAmount> deltas;
+    std::set<uint256> unbroadcast_txids;
+
+    SERIALIZE_METHODS(MempoolDumpTrailer, obj) { READWRITE(obj.deltas, obj.unbroadcast_txids); }
+};
+
+/** Checksum of a record in mempool.dat: the first four bytes of its double SHA256. */
+uint32_t MempoolRecordChecksum(Span<const unsigned char> data);
+
+/**
+ * Records in mempool.dat are length-prefixed and followed by their checksum,
+ * so that a corrupt file is detected where the corruption starts, and the
+ * records can be deserialized away from the thread reading the file.
+ */
+template <typename Stream, typename T>
+void WriteMempoolRecord(Stream& file, const T& obj)
+{
+    CDataStream record(SER_DISK, file.GetVersion());
+    record << obj;
+    WriteCompactSize(file, record.size());
+    file.write(reinterpret_cast<const char*>(record.data()), record.size());
+    file << MempoolRecordChecksum(record);
+}
+
+/** A record read from mempool.dat, not checked or deserialized yet. */
+struct MempoolRecord {
+    std::vector<unsigned char> data;
+    uint32_t checksum{0};
+
+    template <typename Stream>
+    void Unserialize(Stream& file)
+    {
+        data.resize(ReadCompactSize(file));
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+        file >> checksum;
+    }
+
+    /** Check the record and deserialize it. Returns false if it is corrupt. */
+    template <typename T>
+    bool Parse(T& obj, int version) const
+    {
+        if (MempoolRecordChecksum(data) != checksum) return false;
+        try {
+            CDataStream stream(data, SER_DISK, version);
+            stream >> obj;
+            return stream.empty();
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+};
+
+/**
+ * Pre-validates the transactions of a mempool dump on worker threads while
+ * the file is read: the records are checked and deserialized, and the
+ * scripts verified against the spent outputs stored with them, filling the
+ * signature cache. Adding the transactions to the mempool, which needs
+ * cs_main, stays sequential and in file order, but finds the signatures
+ * already verified.
+ */
+class MempoolReloader
+{
+public:
+    struct Job {
+        //! The record as read from the file; empty for the previous format
+        MempoolRecord record;
+        //! The deserialized entry, unless the record is corrupt
+        std::optional<MempoolDumpEntry> entry;
+        //! Whether the entry is too old to go back into the mempool
+        bool expired{false};
+    };
+
+    /**
+     * @param[in] threads Number of worker threads; with none, all the work
+     *                    happens in Next()
+     * @param[in] expiry_cutoff Entries with an earlier time are expired
+     */
+    MempoolReloader(CChainState& chainstate, CTxMemPool& pool, int threads, int version, int64_t expiry_cutoff);
+    ~MempoolReloader();
+
+    /** Queue a record read from the file. */
+    void Add(MempoolRecord&& record) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Queue an entry read from a file in the previous format. */
+    void Add(MempoolDumpEntry&& entry) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Number of queued entries not returned by Next() yet. */
+    size_t Pending() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Return the oldest queued entry once it is pre-validated, doing that here if no worker has started on it. */
+    std::unique_ptr<Job> Next() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    int Threads() const { return m_threads.size(); }
+    /** Number of entries whose scripts passed pre-validation so far. */
+    uint64_t ScriptsOk() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    struct Slot {
+        std::unique_ptr<Job> job;
+        bool done{false};
+    };
+
+    void Push(std::unique_ptr<Job> job) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void ThreadPreValidate() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Start the next job not started yet; returns nullptr if there is none. */
+    Slot* StartJob() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    void PreValidate(Job& job) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    CChainState& m_chainstate;
+    CTxMemPool& m_pool;
+    const int m_version;
+    const int64_t m_expiry_cutoff;
+
+    mutable Mutex m_mutex;
+    std::condition_variable m_cv;
+    //! Queued jobs in file order
+    std::deque<Slot> m_jobs GUARDED_BY(m_mutex);
+    //! Number of jobs at the front of m_jobs already started
+    size_t m_started GUARDED_BY(m_mutex){0};
+    uint64_t m_scripts_ok GUARDED_BY(m_mutex){0};
+    bool m_stop GUARDED_BY(m_mutex){false};
+
+    std::vector<std::thread> m_threads;
+};
+
+#endif // BITCOIN_NODE_MEMPOOL_PERSIST_H
@@ -0,0 +1,152 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txprevalidation.h>
+
+#include <consensus/tx_check.h>
+#include <consensus/validation.h>
+#include <logging.h>
+#include <policy/settings.h>
+#include <tinyformat.h>
+#include <txmempool.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+#include <algorithm>
+
+std::string TxPreValidationStageName(TxPreValidationStage stage)
+{
+    switch (stage) {
+    case TxPreValidationStage::QUEUE: return "queue";
+    case TxPreValidationStage::DESERIALIZE: return "deserialize";
+    case TxPreValidationStage::CHECK: return "check";
+    case TxPreValidationStage::SNAPSHOT: return "snapshot";
+    case TxPreValidationStage::SCRIPTS: return "scripts";
+    case TxPreValidationStage::ACCEPT: return "accept";
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
+void LatencyHistogram::Add(std::chrono::microseconds duration)
+{
+    const auto bound = std::lower_bound(BUCKET_BOUNDS_US.begin(), BUCKET_BOUNDS_US.end(), duration.count());
+    ++m_counts[bound - BUCKET_BOUNDS_US.begin()];
+    ++m_count;
+    m_total += duration;
+    m_max = std::max(m_max, duration);
+}
+
+TxPreValidationJob::TxPreValidationJob(NodeId peer, CDataStream&& payload)
+    : m_peer(peer), m_payload(std::move(payload)), m_stage_start(std::chrono::steady_clock::now()) {}
+
+TxPreValidator::TxPreValidator(ChainstateManager& chainman, CTxMemPool& mempool, int threads,
+                               std::function<bool(const CTransaction&)> already_have, std::function<void()> on_done)
+    : m_chainman(chainman), m_mempool(mempool), m_already_have(std::move(already_have)), m_on_done(std::move(on_done))
+{
+    assert(threads > 0);
+    for (int n = 0; n < threads; ++n) {
+        m_threads.emplace_back([this, n]() {
+            util::ThreadRename(strprintf("txpreval.%i", n));
+            ThreadPreValidate();
+        });
+    }
+}
+
+TxPreValidator::~TxPreValidator()
+{
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_cv.notify_all();
+    for (std::thread& t : m_threads) t.join();
+}
+
+void TxPreValidator::Submit(std::shared_ptr<TxPreValidationJob> job)
+{
+    {
+        LOCK(m_mutex);
+        m_queue.push_back(std::move(job));
+        ++m_pending;
+    }
+    m_cv.notify_one();
+}
+
+void TxPreValidator::FinishJob(TxPreValidationJob& job)
+{
+    assert(job.m_done);
+    EndStage(job, TxPreValidationStage::ACCEPT);
+}
+
+TxPreValidationStats TxPreValidator::GetStats() const
+{
+    LOCK(m_mutex);
+    TxPreValidationStats stats;
+    stats.threads = m_threads.size();
+    stats.pending = m_pending;
+    stats.scripts_ok = m_scripts_ok;
+    stats.stages = m_stages;
+    return stats;
+}
+
+void TxPreValidator::ThreadPreValidate()
+{
+    while (true) {
+        std::shared_ptr<TxPreValidationJob> job;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || !m_queue.empty(); });
+            if (m_stop) return;
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        PreValidate(*job);
+        WITH_LOCK(m_mutex, --m_pending);
+        job->m_done.store(true, std::memory_order_release);
+        m_on_done();
+    }
+}
+
+void TxPreValidator::PreValidate(TxPreValidationJob& job)
+{
+    EndStage(job, TxPreValidationStage::QUEUE);
+
+    try {
+        job.m_payload >> job.m_tx;
+    } catch (const std::exception& e) {
+        job.m_error = e.what();
+    }
+    EndStage(job, TxPreValidationStage::DESERIALIZE);
+    if (!job.m_tx) return;
+    const CTransaction& tx{*job.m_tx};
+
+    // Failures are left for mempool acceptance to report and act on; all
+    // that is decided here is whether there is any point in going on. The
+    // cheap checks that make mempool acceptance stop before its script
+    // checks come first, so that no scripts are verified for nothing.
+    TxValidationState state;
+    std::string reason;
+    const bool check_ok{CheckTransaction(tx, state) && !tx.IsCoinBase() &&
+                        (!fRequireStandard || IsStandardTx(tx, reason)) && !m_already_have(tx)};
+    EndStage(job, TxPreValidationStage::CHECK);
+    if (!check_ok) return;
+
+    auto spent_outputs{GetSpentOutputsSnapshot(m_chainman.ActiveChainstate(), m_mempool, tx)};
+    EndStage(job, TxPreValidationStage::SNAPSHOT);
+    if (!spent_outputs) return;
+
+    const bool scripts_ok{PreVerifyInputScripts(tx, std::move(*spent_outputs))};
+    EndStage(job, TxPreValidationStage::SCRIPTS);
+    if (scripts_ok) {
+        WITH_LOCK(m_mutex, ++m_scripts_ok);
+    } else {
+        LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d failed script pre-validation\n", tx.GetHash().ToString(), job.m_peer);
+    }
+}
+
+void TxPreValidator::EndStage(TxPreValidationJob& job, TxPreValidationStage stage)
+{
+    const auto now{std::chrono::steady_clock::now()};
+    const auto duration{std::chrono::duration_cast<std::chrono::microseconds>(now - job.m_stage_start)};
+    job.m_stage_start = now;
+    LOCK(m_mutex);
+    m_stages[static_cast<size_t>(stage)].Add(duration);
+}
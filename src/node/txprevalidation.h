@@ -0,0 +1,144 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_TXPREVALIDATION_H
+#define BITCOIN_NODE_TXPREVALIDATION_H
+
+#include <net.h>
+#include <primitives/transaction.h>
+#include <streams.h>
+#include <sync.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ChainstateManager;
+class CTxMemPool;
+
+/** Default for -txprevalidationthreads, the threads pre-validating transactions from peers (0 = off) */
+static constexpr int DEFAULT_TXPREVALIDATION_THREADS{0};
+/** Maximum for -txprevalidationthreads */
+static constexpr int MAX_TXPREVALIDATION_THREADS{16};
+
+/** Stages a transaction from a peer goes through, in order. */
+enum class TxPreValidationStage {
+    QUEUE,       //!< Waiting for a worker
+    DESERIALIZE, //!< Parsing the message
+    CHECK,       //!< Context-free, standardness and duplicate checks
+    SNAPSHOT,    //!< Looking up the spent outputs, under cs_main
+    SCRIPTS,     //!< Script verification, filling the signature cache
+    ACCEPT,      //!< Waiting for and running mempool acceptance on the message handler thread
+};
+static constexpr size_t TXPREVALIDATION_STAGES{6};
+
+std::string TxPreValidationStageName(TxPreValidationStage stage);
+
+/** Counts of durations in buckets with (roughly) logarithmically spaced bounds. */
+class LatencyHistogram
+{
+public:
+    /** Inclusive upper bounds of all buckets but the last one, which is unbounded. */
+    static constexpr std::array<int64_t, 11> BUCKET_BOUNDS_US{10, 30, 100, 300, 1'000, 3'000, 10'000, 30'000, 100'000, 300'000, 1'000'000};
+
+    std::array<uint64_t, BUCKET_BOUNDS_US.size() + 1> m_counts{};
+    uint64_t m_count{0};
+    std::chrono::microseconds m_total{0};
+    std::chrono::microseconds m_max{0};
+
+    void Add(std::chrono::microseconds duration);
+};
+
+/** Latency of each stage, over all transactions pre-validated since startup. */
+struct TxPreValidationStats {
+    int threads{0};
+    //! Transactions waiting for or being pre-validated
+    size_t pending{0};
+    //! Transactions whose scripts passed pre-validation
+    uint64_t scripts_ok{0};
+    std::array<LatencyHistogram, TXPREVALIDATION_STAGES> stages;
+};
+
+/** A transaction message from a peer, on its way through the pre-validation stages. */
+struct TxPreValidationJob {
+    TxPreValidationJob(NodeId peer, CDataStream&& payload);
+
+    const NodeId m_peer;
+    //! The message payload; consumed by deserialization
+    CDataStream m_payload;
+    //! Set by deserialization, unless the payload is malformed
+    CTransactionRef m_tx;
+    //! Deserialization error, if any
+    std::string m_error;
+
+    //! Start of the current stage
+    std::chrono::steady_clock::time_point m_stage_start;
+    //! Set once pre-validation is over; the fields above are then read-only
+    std::atomic<bool> m_done{false};
+};
+
+/**
+ * Runs the expensive parts of validating transactions from peers on worker
+ * threads, ahead of mempool acceptance: deserialization, context-free
+ * checks, and script verification against a snapshot of the spent outputs.
+ * Transactions that are already known, recently rejected or non-standard
+ * are left to mempool acceptance without verifying their scripts. Mempool
+ * acceptance itself still happens on the message handler thread under
+ * cs_main, but finds the signatures in the signature cache.
+ *
+ * The workers verify scripts themselves rather than through the script
+ * check queue, which stays free for block validation.
+ */
+class TxPreValidator
+{
+public:
+    /**
+     * @param[in] already_have Called on a worker thread with a transaction
+     * that passed the context-free checks; whether mempool acceptance would
+     * skip it anyway, e.g. as already known or recently rejected
+     * @param[in] on_done Called on a worker thread after a job is done, e.g.
+     * to wake up the message handler
+     */
+    TxPreValidator(ChainstateManager& chainman, CTxMemPool& mempool, int threads,
+                   std::function<bool(const CTransaction&)> already_have, std::function<void()> on_done);
+    ~TxPreValidator();
+
+    void Submit(std::shared_ptr<TxPreValidationJob> job) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Account for the ACCEPT stage of a job, after mempool acceptance. */
+    void FinishJob(TxPreValidationJob& job) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    TxPreValidationStats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    void ThreadPreValidate() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void PreValidate(TxPreValidationJob& job) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Record the end of a job's current stage and start the next one. */
+    void EndStage(TxPreValidationJob& job, TxPreValidationStage stage) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    ChainstateManager& m_chainman;
+    CTxMemPool& m_mempool;
+    const std::function<bool(const CTransaction&)> m_already_have;
+    const std::function<void()> m_on_done;
+
+    mutable Mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::shared_ptr<TxPreValidationJob>> m_queue GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    size_t m_pending GUARDED_BY(m_mutex){0};
+    uint64_t m_scripts_ok GUARDED_BY(m_mutex){0};
+    std::array<LatencyHistogram, TXPREVALIDATION_STAGES> m_stages GUARDED_BY(m_mutex);
+
+    std::vector<std::thread> m_threads;
+};
+
+#endif // BITCOIN_NODE_TXPREVALIDATION_H
@@ -0,0 +1,423 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txreconciliation.h>
+
+#include <crypto/siphash.h>
+#include <hash.h>
+#include <logging.h>
+#include <node/minisketchwrapper.h>
+#include <random.h>
+#include <sync.h>
+
+#include <minisketch.h>
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+
+namespace {
+
+/** Static salt component used to compute short txids for sketch construction, see BIP-330. */
+const std::string RECON_STATIC_SALT = "Tx Relay Salting";
+const CHashWriter RECON_SALT_HASHER = TaggedHash(RECON_STATIC_SALT);
+
+using WtxidSet = std::set<uint256>;
+
+/** Number of differences a sketch has to be able to hold for sets of these sizes. */
+uint32_t EstimateSketchCapacity(size_t local_set_size, size_t remote_set_size, uint16_t q)
+{
+    const size_t set_size_diff = local_set_size > remote_set_size ? local_set_size - remote_set_size : remote_set_size - local_set_size;
+    const size_t min_size = std::min(local_set_size, remote_set_size);
+    const size_t capacity = set_size_diff + min_size * q / Q_PRECISION + 1;
+    return std::min<size_t>(capacity, MAX_SKETCH_CAPACITY);
+}
+
+/**
+ * Reconciliation state of a registered peer.
+ */
+class TxReconciliationState
+{
+public:
+    /** Whether we start the rounds with this peer (it is an outbound connection). */
+    bool m_we_initiate;
+
+    /** Keys of the SipHash used for short txids, derived from both salts. */
+    uint64_t m_k0, m_k1;
+
+    /** Transactions we would have announced to the peer since the last round. */
+    WtxidSet m_local_set;
+
+    /**
+     * Responder: the set we sent a sketch of, kept until the peer's
+     * RECONCILDIFF tells us which of its transactions to announce.
+     */
+    WtxidSet m_local_set_snapshot;
+    bool m_have_snapshot{false};
+    /** Responder: when the peer's request for the open round came in. */
+    std::chrono::microseconds m_snapshot_time{0};
+
+    /** Initiator: a REQTXRCNCL is outstanding since this time. */
+    std::optional<std::chrono::microseconds> m_request_time;
+    /** Initiator: when the next round is due. */
+    std::chrono::microseconds m_next_request{0};
+
+    TxReconciliationStats m_stats;
+
+    TxReconciliationState(bool we_initiate, uint64_t k0, uint64_t k1) : m_we_initiate(we_initiate), m_k0(k0), m_k1(k1)
+    {
+        m_stats.we_initiate = we_initiate;
+    }
+
+    /** 32-bit short id of a transaction on this connection, never 0. */
+    uint32_t ComputeShortID(const uint256& wtxid) const
+    {
+        const uint64_t s = SipHashUint256(m_k0, m_k1, wtxid);
+        const uint32_t short_txid = 1 + (s & 0xFFFFFFFF);
+        return short_txid;
+    }
+
+    Minisketch ComputeSketch(const WtxidSet& set, uint32_t capacity) const
+    {
+        Minisketch sketch = MakeMinisketch32(capacity);
+        for (const uint256& wtxid : set) sketch.Add(ComputeShortID(wtxid));
+        return sketch;
+    }
+};
+
+} // namespace
+
+/** Actual implementation for TxReconciliationTracker's data structure. */
+class TxReconciliationTracker::Impl
+{
+private:
+    mutable Mutex m_txreconciliation_mutex;
+
+    // Local protocol version
+    uint32_t m_recon_version;
+
+    /**
+     * Keeps track of txreconciliation states of eligible peers.
+     * For pre-registered peers, the locally generated salt is stored.
+     * For registered peers, the locally generated salt is forgotten, and the state (including
+     * "full" salt) is stored instead.
+     */
+    std::unordered_map<NodeId, std::variant<uint64_t, TxReconciliationState>> m_states GUARDED_BY(m_txreconciliation_mutex);
+
+    TxReconciliationState* GetRegisteredState(NodeId peer_id) EXCLUSIVE_LOCKS_REQUIRED(m_txreconciliation_mutex)
+    {
+        auto it = m_states.find(peer_id);
+        if (it == m_states.end()) return nullptr;
+        return std::get_if<TxReconciliationState>(&it->second);
+    }
+
+public:
+    explicit Impl(uint32_t recon_version) : m_recon_version(recon_version) {}
+
+    uint64_t PreRegisterPeer(NodeId peer_id) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+
+        LogPrint(BCLog::NET, "Pre-register peer=%d for reconciling.\n", peer_id);
+        const uint64_t local_salt{GetRand(std::numeric_limits<uint64_t>::max())};
+
+        // We do this exactly once per peer (which are unique by NodeId, see GetNewNodeId) so it's
+        // safe to assume we don't have this record yet.
+        Assume(m_states.emplace(peer_id, local_salt).second);
+        return local_salt;
+    }
+
+    ReconciliationRegisterResult RegisterPeer(NodeId peer_id, bool is_peer_inbound, uint32_t peer_recon_version,
+                                              uint64_t remote_salt) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto recon_state = m_states.find(peer_id);
+
+        if (recon_state == m_states.end()) return ReconciliationRegisterResult::NOT_FOUND;
+
+        if (std::holds_alternative<TxReconciliationState>(recon_state->second)) {
+            return ReconciliationRegisterResult::ALREADY_REGISTERED;
+        }
+
+        uint64_t local_salt = *std::get_if<uint64_t>(&recon_state->second);
+
+        // If the peer supports the version which is lower than ours, we downgrade to the version
+        // it supports. For now, this only guarantees that nodes with future reconciliation
+        // versions have the choice of reconciling with this current version. However, they also
+        // have the choice to refuse supporting reconciliations if the common version is not
+        // satisfactory (e.g. too low).
+        const uint32_t recon_version{std::min(peer_recon_version, m_recon_version)};
+        // v1 is the lowest version, so suggesting something below must be a protocol violation.
+        if (recon_version < 1) return ReconciliationRegisterResult::PROTOCOL_VIOLATION;
+
+        LogPrint(BCLog::NET, "Register peer=%d (%s) with local_salt=%d, remote_salt=%d for reconciling.\n",
+                 peer_id, is_peer_inbound ? "inbound" : "outbound", local_salt, remote_salt);
+
+        // Both sides compute the same key by ordering the salts.
+        const uint64_t salt1 = local_salt, salt2 = remote_salt;
+        const uint256 full_salt{(CHashWriter(RECON_SALT_HASHER) << std::min(salt1, salt2) << std::max(salt1, salt2)).GetSHA256()};
+
+        recon_state->second.emplace<TxReconciliationState>(!is_peer_inbound, full_salt.GetUint64(0), full_salt.GetUint64(1));
+        return ReconciliationRegisterResult::SUCCESS;
+    }
+
+    void ForgetPeer(NodeId peer_id) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        if (m_states.erase(peer_id)) {
+            LogPrint(BCLog::NET, "Forget txreconciliation state of peer=%d\n", peer_id);
+        }
+    }
+
+    bool IsPeerRegistered(NodeId peer_id) const EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto recon_state = m_states.find(peer_id);
+        return (recon_state != m_states.end() &&
+                std::holds_alternative<TxReconciliationState>(recon_state->second));
+    }
+
+    bool AddToSet(NodeId peer_id, const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState* state = GetRegisteredState(peer_id);
+        if (!state) return false;
+
+        if (state->m_local_set.size() >= MAX_RECONSET_SIZE) {
+            ++state->m_stats.set_overflows;
+            return false;
+        }
+        state->m_local_set.insert(wtxid);
+        return true;
+    }
+
+    void TryRemovingFromSet(NodeId peer_id, const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState* state = GetRegisteredState(peer_id);
+        if (!state) return;
+        state->m_local_set.erase(wtxid);
+    }
+
+    std::optional<std::pair<uint16_t, uint16_t>> MaybeRequestReconciliation(NodeId peer_id, std::chrono::microseconds now)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState* state = GetRegisteredState(peer_id);
+        if (!state || !state->m_we_initiate) return std::nullopt;
+
+        if (state->m_request_time) {
+            if (now < *state->m_request_time + RECON_RESPONSE_TIMEOUT) return std::nullopt;
+            // The peer never answered; start over rather than stall relay to it.
+            LogPrint(BCLog::NET, "Reconciliation request to peer=%d timed out\n", peer_id);
+            state->m_request_time.reset();
+        }
+        if (now < state->m_next_request) return std::nullopt;
+
+        state->m_request_time = now;
+        state->m_next_request = now + RECON_REQUEST_INTERVAL;
+        ++state->m_stats.rounds;
+        // MAX_RECONSET_SIZE fits in the 16 bits of the message.
+        return std::make_pair(uint16_t(state->m_local_set.size()), RECON_Q);
+    }
+
+    bool HandleReconciliationRequest(NodeId peer_id, uint16_t peer_set_size, uint16_t peer_q, std::vector<uint8_t>& skdata,
+                                     std::chrono::microseconds now)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState* state = GetRegisteredState(peer_id);
+        if (!state || state->m_we_initiate) return false;
+        if (peer_q > Q_PRECISION) return false;
+
+        if (state->m_have_snapshot) {
+            // The peer has to finish a round with RECONCILDIFF before it requests
+            // the next sketch. It may only start over once it gave up waiting for
+            // ours, so that it can't have us compute a sketch for every message.
+            if (now < state->m_snapshot_time + RECON_RESPONSE_TIMEOUT) return false;
+            // The previous round was abandoned by the peer; those transactions
+            // are still to be reconciled.
+            state->m_local_set.insert(state->m_local_set_snapshot.begin(), state->m_local_set_snapshot.end());
+        }
+        state->m_local_set_snapshot.clear();
+        std::swap(state->m_local_set, state->m_local_set_snapshot);
+        state->m_have_snapshot = true;
+        state->m_snapshot_time = now;
+        ++state->m_stats.rounds;
+
+        if (state->m_local_set_snapshot.empty() && peer_set_size == 0) {
+            // Nothing to reconcile: an empty sketch finishes the round.
+            skdata.clear();
+            return true;
+        }
+        const uint32_t capacity = EstimateSketchCapacity(state->m_local_set_snapshot.size(), peer_set_size, peer_q);
+        skdata = state->ComputeSketch(state->m_local_set_snapshot, capacity).Serialize();
+        state->m_stats.sketch_bytes_sent += skdata.size();
+        return true;
+    }
+
+    bool HandleSketch(NodeId peer_id, const std::vector<uint8_t>& skdata, bool& success,
+                      std::vector<uint256>& txs_to_announce, std::vector<uint32_t>& ask_shortids)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState* state = GetRegisteredState(peer_id);
+        if (!state || !state->m_we_initiate || !state->m_request_time) return false;
+        // Each element of a sketch takes 32 bits.
+        if (skdata.size() % 4 != 0 || skdata.size() / 4 > MAX_SKETCH_CAPACITY) return false;
+
+        state->m_request_time.reset();
+        state->m_stats.sketch_bytes_recv += skdata.size();
+        txs_to_announce.clear();
+        ask_shortids.clear();
+
+        const uint32_t capacity = skdata.size() / 4;
+        std::optional<std::vector<uint64_t>> differences;
+        if (capacity > 0) {
+            Minisketch remote_sketch = MakeMinisketch32(capacity);
+            remote_sketch.Deserialize(skdata);
+            differences = state->ComputeSketch(state->m_local_set, capacity).Merge(remote_sketch).Decode(capacity);
+        } else if (state->m_local_set.empty()) {
+            // Both sets were empty.
+            differences.emplace();
+        }
+
+        if (!differences) {
+            // Fall back to announcing everything; the peer does the same.
+            success = false;
+            ++state->m_stats.failed_rounds;
+            txs_to_announce.assign(state->m_local_set.begin(), state->m_local_set.end());
+        } else {
+            success = true;
+            std::unordered_map<uint32_t, uint256> local_shortids;
+            for (const uint256& wtxid : state->m_local_set) local_shortids.emplace(state->ComputeShortID(wtxid), wtxid);
+            for (const uint64_t diff : *differences) {
+                auto it = local_shortids.find(diff);
+                if (it != local_shortids.end()) {
+                    txs_to_announce.push_back(it->second);
+                } else {
+                    ask_shortids.push_back(diff);
+                }
+            }
+        }
+        state->m_local_set.clear();
+        state->m_stats.txs_announced += txs_to_announce.size();
+        state->m_stats.txs_requested += ask_shortids.size();
+        return true;
+    }
+
+    bool HandleReconciliationDifference(NodeId peer_id, bool success, const std::vector<uint32_t>& ask_shortids,
+                                        std::vector<uint256>& txs_to_announce)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState* state = GetRegisteredState(peer_id);
+        if (!state || state->m_we_initiate || !state->m_have_snapshot) return false;
+        if (ask_shortids.size() > MAX_SKETCH_CAPACITY) return false;
+
+        txs_to_announce.clear();
+        if (!success) {
+            ++state->m_stats.failed_rounds;
+            txs_to_announce.assign(state->m_local_set_snapshot.begin(), state->m_local_set_snapshot.end());
+        } else if (!ask_shortids.empty()) {
+            const std::unordered_set<uint32_t> asked(ask_shortids.begin(), ask_shortids.end());
+            for (const uint256& wtxid : state->m_local_set_snapshot) {
+                if (asked.count(state->ComputeShortID(wtxid))) txs_to_announce.push_back(wtxid);
+            }
+        }
+        state->m_local_set_snapshot.clear();
+        state->m_have_snapshot = false;
+        state->m_stats.txs_announced += txs_to_announce.size();
+        return true;
+    }
+
+    std::optional<TxReconciliationStats> GetPeerStats(NodeId peer_id) const EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex)
+    {
+        AssertLockNotHeld(m_txreconciliation_mutex);
+        LOCK(m_txreconciliation_mutex);
+        auto it = m_states.find(peer_id);
+        if (it == m_states.end()) return std::nullopt;
+        const auto* state = std::get_if<TxReconciliationState>(&it->second);
+        if (!state) return std::nullopt;
+        TxReconciliationStats stats{state->m_stats};
+        stats.set_size = state->m_local_set.size();
+        return stats;
+    }
+};
+
+TxReconciliationTracker::TxReconciliationTracker(uint32_t recon_version) : m_impl{std::make_unique<TxReconciliationTracker::Impl>(recon_version)} {}
+
+TxReconciliationTracker::~TxReconciliationTracker() = default;
+
+uint64_t TxReconciliationTracker::PreRegisterPeer(NodeId peer_id)
+{
+    return m_impl->PreRegisterPeer(peer_id);
+}
+
+ReconciliationRegisterResult TxReconciliationTracker::RegisterPeer(NodeId peer_id, bool is_peer_inbound,
+                                                                   uint32_t peer_recon_version, uint64_t remote_salt)
+{
+    return m_impl->RegisterPeer(peer_id, is_peer_inbound, peer_recon_version, remote_salt);
+}
+
+void TxReconciliationTracker::ForgetPeer(NodeId peer_id)
+{
+    m_impl->ForgetPeer(peer_id);
+}
+
+bool TxReconciliationTracker::IsPeerRegistered(NodeId peer_id) const
+{
+    return m_impl->IsPeerRegistered(peer_id);
+}
+
+bool TxReconciliationTracker::AddToSet(NodeId peer_id, const uint256& wtxid)
+{
+    return m_impl->AddToSet(peer_id, wtxid);
+}
+
+void TxReconciliationTracker::TryRemovingFromSet(NodeId peer_id, const uint256& wtxid)
+{
+    m_impl->TryRemovingFromSet(peer_id, wtxid);
+}
+
+std::optional<std::pair<uint16_t, uint16_t>> TxReconciliationTracker::MaybeRequestReconciliation(NodeId peer_id, std::chrono::microseconds now)
+{
+    return m_impl->MaybeRequestReconciliation(peer_id, now);
+}
+
+bool TxReconciliationTracker::HandleReconciliationRequest(NodeId peer_id, uint16_t peer_set_size, uint16_t peer_q,
+                                                          std::vector<uint8_t>& skdata, std::chrono::microseconds now)
+{
+    return m_impl->HandleReconciliationRequest(peer_id, peer_set_size, peer_q, skdata, now);
+}
+
+bool TxReconciliationTracker::HandleSketch(NodeId peer_id, const std::vector<uint8_t>& skdata, bool& success,
+                                           std::vector<uint256>& txs_to_announce, std::vector<uint32_t>& ask_shortids)
+{
+    return m_impl->HandleSketch(peer_id, skdata, success, txs_to_announce, ask_shortids);
+}
+
+bool TxReconciliationTracker::HandleReconciliationDifference(NodeId peer_id, bool success, const std::vector<uint32_t>& ask_shortids,
+                                                             std::vector<uint256>& txs_to_announce)
+{
+    return m_impl->HandleReconciliationDifference(peer_id, success, ask_shortids, txs_to_announce);
+}
+
+std::optional<TxReconciliationStats> TxReconciliationTracker::GetPeerStats(NodeId peer_id) const
+{
+    return m_impl->GetPeerStats(peer_id);
+}
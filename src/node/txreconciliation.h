@@ -0,0 +1,161 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_TXRECONCILIATION_H
+#define BITCOIN_NODE_TXRECONCILIATION_H
+
+#include <net.h>
+#include <uint256.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/** Whether transaction reconciliation protocol should be enabled by default. */
+static constexpr bool DEFAULT_TXRECONCILIATION_ENABLE{false};
+/** Supported transaction reconciliation protocol version */
+static constexpr uint32_t TXRECONCILIATION_VERSION{1};
+/** How often the initiating side of a connection starts a reconciliation round. */
+static constexpr std::chrono::seconds RECON_REQUEST_INTERVAL{8};
+/** A round the peer did not answer within this time is abandoned. */
+static constexpr std::chrono::seconds RECON_RESPONSE_TIMEOUT{60};
+/** Maximum number of transactions in a reconciliation set; further ones are flooded. */
+static constexpr size_t MAX_RECONSET_SIZE{3000};
+/** Maximum number of differences a sketch we send or accept can hold. */
+static constexpr uint32_t MAX_SKETCH_CAPACITY{1024};
+/** Precision of the q coefficient (BIP330) as sent on the wire. */
+static constexpr uint16_t Q_PRECISION{(2 << 14) - 1};
+/**
+ * Expected fraction of the smaller set that differs between both sides,
+ * scaled by Q_PRECISION. Used to size sketches.
+ */
+static constexpr uint16_t RECON_Q{Q_PRECISION / 4};
+
+enum class ReconciliationRegisterResult {
+    NOT_FOUND,
+    SUCCESS,
+    ALREADY_REGISTERED,
+    PROTOCOL_VIOLATION,
+};
+
+/** Per-peer reconciliation counters, reported by getpeerinfo. */
+struct TxReconciliationStats {
+    //! Whether we start the rounds (we made the connection)
+    bool we_initiate{false};
+    size_t set_size{0};
+    uint64_t rounds{0};
+    //! Rounds whose difference could not be decoded, after which both sides
+    //! announce their whole set
+    uint64_t failed_rounds{0};
+    //! Transactions announced to the peer as the result of a round
+    uint64_t txs_announced{0};
+    //! Transactions requested from the peer as the result of a round
+    uint64_t txs_requested{0};
+    //! Transactions flooded because the set was full
+    uint64_t set_overflows{0};
+    uint64_t sketch_bytes_sent{0};
+    uint64_t sketch_bytes_recv{0};
+};
+
+/**
+ * Transaction reconciliation (BIP330, Erlay) is a way of relaying
+ * transactions between two peers that costs bandwidth proportional to the
+ * difference between what the peers know, instead of announcing every
+ * transaction with an INV.
+ *
+ * Both peers send SENDTXRCNCL with a salt before VERACK, from which the
+ * 32-bit short ids of the connection are derived. Transactions that would
+ * have been announced to the peer are then kept in a per-peer set instead.
+ * Every RECON_REQUEST_INTERVAL, the side that made the connection sends
+ * REQTXRCNCL with its set size; the other side answers with a SKETCH of its
+ * set (and sets it aside). The initiator merges it with a sketch of its own
+ * set, which yields the short ids in one set but not the other. It announces
+ * its own missing transactions and asks for the others with RECONCILDIFF, to
+ * which the responder answers with their INVs. If the difference can't be
+ * decoded, both sides announce their whole set.
+ *
+ * This class keeps the per-peer state and does not send any messages itself.
+ */
+class TxReconciliationTracker
+{
+private:
+    class Impl;
+    const std::unique_ptr<Impl> m_impl;
+
+public:
+    explicit TxReconciliationTracker(uint32_t recon_version);
+
+    ~TxReconciliationTracker();
+
+    /**
+     * Step 0. Generates the salt to send to a peer in SENDTXRCNCL, which we
+     * use once it sent us its own.
+     */
+    uint64_t PreRegisterPeer(NodeId peer_id);
+
+    /**
+     * Step 1. Finishes the negotiation after the peer's SENDTXRCNCL. The
+     * side that made the connection initiates the rounds.
+     */
+    ReconciliationRegisterResult RegisterPeer(NodeId peer_id, bool is_peer_inbound,
+                                              uint32_t peer_recon_version, uint64_t remote_salt);
+
+    /** Forget all state about a peer (e.g. on disconnect). */
+    void ForgetPeer(NodeId peer_id);
+
+    /** Whether transactions for this peer go into a reconciliation set rather than an INV. */
+    bool IsPeerRegistered(NodeId peer_id) const;
+
+    /**
+     * Keep a transaction to be reconciled with the peer.
+     * @return false if it has to be flooded instead (the set is full or the
+     * peer is not registered)
+     */
+    bool AddToSet(NodeId peer_id, const uint256& wtxid);
+
+    /** Drop a transaction the peer turned out to know already. */
+    void TryRemovingFromSet(NodeId peer_id, const uint256& wtxid);
+
+    /**
+     * Initiator: if it is time for a round with the peer, start it.
+     * @return the set size and q to send in REQTXRCNCL
+     */
+    std::optional<std::pair<uint16_t, uint16_t>> MaybeRequestReconciliation(NodeId peer_id, std::chrono::microseconds now);
+
+    /**
+     * Responder: answer a REQTXRCNCL with a sketch of our set, which is set
+     * aside until the peer tells us the result.
+     * @return false if the peer violated the protocol, including by starting
+     * a new round within RECON_RESPONSE_TIMEOUT of one it didn't finish
+     */
+    bool HandleReconciliationRequest(NodeId peer_id, uint16_t peer_set_size, uint16_t peer_q,
+                                     std::vector<uint8_t>& skdata, std::chrono::microseconds now);
+
+    /**
+     * Initiator: compute the difference from the peer's SKETCH.
+     * @param[out] success Whether the difference could be decoded; if not,
+     * `txs_to_announce` is our whole set
+     * @param[out] txs_to_announce Transactions the peer lacks
+     * @param[out] ask_shortids Short ids of transactions we lack, for RECONCILDIFF
+     * @return false if the peer violated the protocol
+     */
+    bool HandleSketch(NodeId peer_id, const std::vector<uint8_t>& skdata, bool& success,
+                      std::vector<uint256>& txs_to_announce, std::vector<uint32_t>& ask_shortids);
+
+    /**
+     * Responder: finish the round with the peer's RECONCILDIFF.
+     * @param[out] txs_to_announce Transactions the peer asked for, or the
+     * whole set aside if the round failed
+     * @return false if the peer violated the protocol
+     */
+    bool HandleReconciliationDifference(NodeId peer_id, bool success, const std::vector<uint32_t>& ask_shortids,
+                                        std::vector<uint256>& txs_to_announce);
+
+    std::optional<TxReconciliationStats> GetPeerStats(NodeId peer_id) const;
+};
+
+#endif // BITCOIN_NODE_TXRECONCILIATION_H
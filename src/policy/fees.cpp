@@ -17,6 +17,9 @@ static const char* FEE_ESTIMATES_FILENAME = "fee_estimates.dat";
 
 static constexpr double INF_FEERATE = 1e99;
 
+/** Version required to read fee estimates files that store the averages sparsely */
+static constexpr int FEE_ESTIMATES_SPARSE_VERSION = 229900;
+
 std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon)
 {
     switch (horizon) {
@@ -44,6 +47,47 @@ struct EncodedDoubleFormatter
     }
 };
 
+/**
+ * Write the values of v multiplied by factor. Most averages are zero, for
+ * feerates no transaction ever had, so each value is preceded by the number
+ * of zeros before it.
+ */
+template <typename Stream>
+void WriteSparseDoubles(Stream& s, const std::vector<double>& v, double factor)
+{
+    WriteCompactSize(s, v.size());
+    size_t pos = 0;
+    while (pos < v.size()) {
+        uint64_t zeros = 0;
+        for (; pos < v.size() && v[pos] == 0; ++pos) ++zeros;
+        s << VARINT(zeros);
+        if (pos < v.size()) s << EncodeDouble(v[pos++] * factor);
+    }
+}
+
+template <typename Stream>
+void ReadSparseDoubles(Stream& s, std::vector<double>& v, size_t size, const std::string& what)
+{
+    if (ReadCompactSize(s) != size) {
+        throw std::runtime_error("Corrupt estimates file. Mismatch in " + what + " bucket count");
+    }
+    v.assign(size, 0);
+    size_t pos = 0;
+    while (pos < size) {
+        uint64_t zeros;
+        s >> VARINT(zeros);
+        if (zeros > size - pos) {
+            throw std::runtime_error("Corrupt estimates file. Run of zeros past the end of " + what);
+        }
+        pos += zeros;
+        if (pos < size) {
+            uint64_t encoded;
+            s >> encoded;
+            v[pos++] = DecodeDouble(encoded);
+        }
+    }
+}
+
 } // namespace
 
 /**
@@ -53,13 +97,23 @@ struct EncodedDoubleFormatter
  *
  * The tracking of unconfirmed (mempool) transactions is completely independent of the
  * historical tracking of transactions that have been confirmed in a block.
+ *
+ * The counters of all buckets are kept in flat arrays. The moving averages
+ * are decayed lazily: they are stored divided by m_decay_scale, the decay
+ * accumulated since they were last rescaled, so that a new block only updates
+ * that factor instead of every counter.
  */
 class TxConfirmStats
 {
 private:
+    /** Rescale the stored averages once the accumulated decay gets this small, long before they could overflow */
+    static constexpr double MIN_DECAY_SCALE = 1e-20;
+
     //Define the buckets we will group transactions into
     const std::vector<double>& buckets;              // The upper-bound of the range for the bucket (inclusive)
-    const std::map<double, unsigned int>& bucketMap; // Map of bucket upper-bound to index into all vectors by bucket
+
+    // Number of buckets, the stride of the per-period arrays below
+    size_t m_num_buckets;
 
     // For each bucket X:
     // Count the total # of txs in each bucket
@@ -68,11 +122,11 @@ private:
 
     // Count the total # of txs confirmed within Y blocks in each bucket
     // Track the historical moving average of these totals over blocks
-    std::vector<std::vector<double>> confAvg; // confAvg[Y][X]
+    std::vector<double> confAvg; // confAvg[Y * m_num_buckets + X]
 
     // Track moving avg of txs which have been evicted from the mempool
     // after failing to be confirmed within Y blocks
-    std::vector<std::vector<double>> failAvg; // failAvg[Y][X]
+    std::vector<double> failAvg; // failAvg[Y * m_num_buckets + X]
 
     // Sum the total feerate of all tx's in each bucket
     // Track the historical moving average of this total over blocks
@@ -83,18 +137,28 @@ private:
 
     double decay;
 
+    // Decay not applied to the stored averages yet: their actual values are
+    // the stored ones multiplied by this
+    double m_decay_scale{1};
+
     // Resolution (# of blocks) with which confirmations are tracked
     unsigned int scale;
 
+    // Number of periods confirmations are tracked for
+    unsigned int m_max_periods;
+
     // Mempool counts of outstanding transactions
     // For each bucket X, track the number of transactions in the mempool
     // that are unconfirmed for each possible confirmation value Y
-    std::vector<std::vector<int> > unconfTxs;  //unconfTxs[Y][X]
+    std::vector<int> unconfTxs; // unconfTxs[X * GetMaxConfirms() + Y]
     // transactions still unconfirmed after GetMaxConfirms for each bucket
     std::vector<int> oldUnconfTxs;
 
     void resizeInMemoryCounters(size_t newbuckets);
 
+    /** Apply the pending decay to the stored averages. */
+    void ApplyDecay();
+
 public:
     /**
      * Create new TxConfirmStats. This is called by BlockPolicyEstimator's
@@ -103,8 +167,7 @@ public:
      * @param maxPeriods max number of periods to track
      * @param decay how much to decay the historical moving average per block
      */
-    TxConfirmStats(const std::vector<double>& defaultBuckets, const std::map<double, unsigned int>& defaultBucketMap,
-                   unsigned int maxPeriods, double decay, unsigned int scale);
+    TxConfirmStats(const std::vector<double>& defaultBuckets, unsigned int maxPeriods, double decay, unsigned int scale);
 
     /** Roll the circular buffer for unconfirmed txs*/
     void ClearCurrent(unsigned int nBlockHeight);
@@ -112,13 +175,14 @@ public:
     /**
      * Record a new transaction data point in the current block stats
      * @param blocksToConfirm the number of blocks it took this transaction to confirm
+     * @param bucketindex the bucket of the transaction's feerate
      * @param val the feerate of the transaction
      * @warning blocksToConfirm is 1-based and has to be >= 1
      */
-    void Record(int blocksToConfirm, double val);
+    void Record(int blocksToConfirm, unsigned int bucketindex, double val);
 
     /** Record a new transaction entering the mempool*/
-    unsigned int NewTx(unsigned int nBlockHeight, double val);
+    void NewTx(unsigned int nBlockHeight, unsigned int bucketindex);
 
     /** Remove a transaction from mempool tracking stats*/
     void removeTx(unsigned int entryHeight, unsigned int nBestSeenHeight,
@@ -142,7 +206,7 @@ public:
                              EstimationResult *result = nullptr) const;
 
     /** Return the max number of confirms we're tracking */
-    unsigned int GetMaxConfirms() const { return scale * confAvg.size(); }
+    unsigned int GetMaxConfirms() const { return scale * m_max_periods; }
 
     /** Write state of estimation data to a file*/
     void Write(CAutoFile& fileout) const;
@@ -150,74 +214,71 @@ public:
     /**
      * Read saved state of estimation data from a file and replace all internal data structures and
      * variables with this state.
+     * @param sparse whether the file stores the averages sparsely, or as in
+     *               files written before FEE_ESTIMATES_SPARSE_VERSION
      */
-    void Read(CAutoFile& filein, int nFileVersion, size_t numBuckets);
+    void Read(CAutoFile& filein, bool sparse, size_t numBuckets);
 };
 
 
 TxConfirmStats::TxConfirmStats(const std::vector<double>& defaultBuckets,
-                                const std::map<double, unsigned int>& defaultBucketMap,
                                unsigned int maxPeriods, double _decay, unsigned int _scale)
-    : buckets(defaultBuckets), bucketMap(defaultBucketMap), decay(_decay), scale(_scale)
+    : buckets(defaultBuckets), m_num_buckets(defaultBuckets.size()), decay(_decay), scale(_scale), m_max_periods(maxPeriods)
 {
     assert(_scale != 0 && "_scale must be non-zero");
-    confAvg.resize(maxPeriods);
-    failAvg.resize(maxPeriods);
-    for (unsigned int i = 0; i < maxPeriods; i++) {
-        confAvg[i].resize(buckets.size());
-        failAvg[i].resize(buckets.size());
-    }
+    confAvg.resize(maxPeriods * m_num_buckets);
+    failAvg.resize(maxPeriods * m_num_buckets);
 
-    txCtAvg.resize(buckets.size());
-    m_feerate_avg.resize(buckets.size());
+    txCtAvg.resize(m_num_buckets);
+    m_feerate_avg.resize(m_num_buckets);
 
-    resizeInMemoryCounters(buckets.size());
+    resizeInMemoryCounters(m_num_buckets);
 }
 
 void TxConfirmStats::resizeInMemoryCounters(size_t newbuckets) {
     // newbuckets must be passed in because the buckets referred to during Read have not been updated yet.
-    unconfTxs.resize(GetMaxConfirms());
-    for (unsigned int i = 0; i < unconfTxs.size(); i++) {
-        unconfTxs[i].resize(newbuckets);
-    }
-    oldUnconfTxs.resize(newbuckets);
+    unconfTxs.assign(GetMaxConfirms() * newbuckets, 0);
+    oldUnconfTxs.assign(newbuckets, 0);
 }
 
 // Roll the unconfirmed txs circular buffer
 void TxConfirmStats::ClearCurrent(unsigned int nBlockHeight)
 {
-    for (unsigned int j = 0; j < buckets.size(); j++) {
-        oldUnconfTxs[j] += unconfTxs[nBlockHeight % unconfTxs.size()][j];
-        unconfTxs[nBlockHeight%unconfTxs.size()][j] = 0;
+    const unsigned int bins = GetMaxConfirms();
+    const unsigned int blockIndex = nBlockHeight % bins;
+    for (unsigned int j = 0; j < m_num_buckets; j++) {
+        oldUnconfTxs[j] += unconfTxs[j * bins + blockIndex];
+        unconfTxs[j * bins + blockIndex] = 0;
     }
 }
 
 
-void TxConfirmStats::Record(int blocksToConfirm, double feerate)
+void TxConfirmStats::Record(int blocksToConfirm, unsigned int bucketindex, double feerate)
 {
     // blocksToConfirm is 1-based
     if (blocksToConfirm < 1)
         return;
+    const double increment = 1 / m_decay_scale;
     int periodsToConfirm = (blocksToConfirm + scale - 1) / scale;
-    unsigned int bucketindex = bucketMap.lower_bound(feerate)->second;
-    for (size_t i = periodsToConfirm; i <= confAvg.size(); i++) {
-        confAvg[i - 1][bucketindex]++;
+    for (size_t i = periodsToConfirm; i <= m_max_periods; i++) {
+        confAvg[(i - 1) * m_num_buckets + bucketindex] += increment;
     }
-    txCtAvg[bucketindex]++;
-    m_feerate_avg[bucketindex] += feerate;
+    txCtAvg[bucketindex] += increment;
+    m_feerate_avg[bucketindex] += feerate * increment;
 }
 
 void TxConfirmStats::UpdateMovingAverages()
 {
-    assert(confAvg.size() == failAvg.size());
-    for (unsigned int j = 0; j < buckets.size(); j++) {
-        for (unsigned int i = 0; i < confAvg.size(); i++) {
-            confAvg[i][j] *= decay;
-            failAvg[i][j] *= decay;
-        }
-        m_feerate_avg[j] *= decay;
-        txCtAvg[j] *= decay;
+    m_decay_scale *= decay;
+    if (m_decay_scale < MIN_DECAY_SCALE) ApplyDecay();
+}
+
+void TxConfirmStats::ApplyDecay()
+{
+    for (std::vector<double>* avg : {&txCtAvg, &confAvg, &failAvg, &m_feerate_avg}) {
+        for (double& val : *avg) val *= m_decay_scale;
     }
+    m_decay_scale = 1;
 }
 
 // returns -1 on error conditions
@@ -232,6 +293,8 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
     double failNum = 0; // Number of tx's that were never confirmed but removed from the mempool after confTarget
     const int periodTarget = (confTarget + scale - 1) / scale;
     const int maxbucketindex = buckets.size() - 1;
+    const double* const periodConfAvg = &confAvg[(periodTarget - 1) * m_num_buckets];
+    const double* const periodFailAvg = &failAvg[(periodTarget - 1) * m_num_buckets];
 
     // We'll combine buckets until we have enough samples.
     // The near and far variables will define the range we've combined
@@ -244,7 +307,7 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
     unsigned int bestFarBucket = maxbucketindex;
 
     bool foundAnswer = false;
-    unsigned int bins = unconfTxs.size();
+    unsigned int bins = GetMaxConfirms();
     bool newBucketRange = true;
     bool passing = true;
     EstimatorBucket passBucket;
@@ -257,11 +320,12 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
             newBucketRange = false;
         }
         curFarBucket = bucket;
-        nConf += confAvg[periodTarget - 1][bucket];
-        totalNum += txCtAvg[bucket];
-        failNum += failAvg[periodTarget - 1][bucket];
-        for (unsigned int confct = confTarget; confct < GetMaxConfirms(); confct++)
-            extraNum += unconfTxs[(nBlockHeight - confct) % bins][bucket];
+        nConf += periodConfAvg[bucket] * m_decay_scale;
+        totalNum += txCtAvg[bucket] * m_decay_scale;
+        failNum += periodFailAvg[bucket] * m_decay_scale;
+        const int* const bucketUnconfTxs = &unconfTxs[bucket * bins];
+        for (unsigned int confct = confTarget; confct < bins; confct++)
+            extraNum += bucketUnconfTxs[(nBlockHeight - confct) % bins];
         extraNum += oldUnconfTxs[bucket];
         // If we have enough transaction data points in this range of buckets,
         // we can test for success
@@ -317,13 +381,13 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
     unsigned int minBucket = std::min(bestNearBucket, bestFarBucket);
     unsigned int maxBucket = std::max(bestNearBucket, bestFarBucket);
     for (unsigned int j = minBucket; j <= maxBucket; j++) {
-        txSum += txCtAvg[j];
+        txSum += txCtAvg[j] * m_decay_scale;
     }
     if (foundAnswer && txSum != 0) {
         txSum = txSum / 2;
         for (unsigned int j = minBucket; j <= maxBucket; j++) {
-            if (txCtAvg[j] < txSum)
-                txSum -= txCtAvg[j];
+            if (txCtAvg[j] * m_decay_scale < txSum)
+                txSum -= txCtAvg[j] * m_decay_scale;
             else { // we're in the right bucket
                 median = m_feerate_avg[j] / txCtAvg[j];
                 break;
@@ -378,16 +442,17 @@ void TxConfirmStats::Write(CAutoFile& fileout) const
 {
     fileout << Using<EncodedDoubleFormatter>(decay);
     fileout << scale;
-    fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(m_feerate_avg);
-    fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(txCtAvg);
-    fileout << Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(confAvg);
-    fileout << Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(failAvg);
+    fileout << VARINT(m_max_periods);
+    WriteSparseDoubles(fileout, m_feerate_avg, m_decay_scale);
+    WriteSparseDoubles(fileout, txCtAvg, m_decay_scale);
+    WriteSparseDoubles(fileout, confAvg, m_decay_scale);
+    WriteSparseDoubles(fileout, failAvg, m_decay_scale);
 }
 
-void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets)
+void TxConfirmStats::Read(CAutoFile& filein, bool sparse, size_t numBuckets)
 {
     // Read data file and do some very basic sanity checking
-    // buckets and bucketMap are not updated yet, so don't access them
+    // buckets are not updated yet, so don't access them
     // If there is a read failure, we'll just discard this entire object anyway
     size_t maxConfirms, maxPeriods;
 
@@ -401,36 +466,59 @@ void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets
         throw std::runtime_error("Corrupt estimates file. Scale must be non-zero");
     }
 
-    filein >> Using<VectorFormatter<EncodedDoubleFormatter>>(m_feerate_avg);
-    if (m_feerate_avg.size() != numBuckets) {
-        throw std::runtime_error("Corrupt estimates file. Mismatch in feerate average bucket count");
-    }
-    filein >> Using<VectorFormatter<EncodedDoubleFormatter>>(txCtAvg);
-    if (txCtAvg.size() != numBuckets) {
-        throw std::runtime_error("Corrupt estimates file. Mismatch in tx count bucket count");
-    }
-    filein >> Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(confAvg);
-    maxPeriods = confAvg.size();
-    maxConfirms = scale * maxPeriods;
+    if (sparse) {
+        filein >> VARINT(maxPeriods);
+        maxConfirms = scale * maxPeriods;
+        if (maxPeriods == 0 || maxPeriods > 6 * 24 * 7 || maxConfirms > 6 * 24 * 7) { // one week
+            throw std::runtime_error("Corrupt estimates file.  Must maintain estimates for between 1 and 1008 (one week) confirms");
+        }
+        ReadSparseDoubles(filein, m_feerate_avg, numBuckets, "feerate average");
+        ReadSparseDoubles(filein, txCtAvg, numBuckets, "tx count");
+        ReadSparseDoubles(filein, confAvg, maxPeriods * numBuckets, "feerate conf average");
+        ReadSparseDoubles(filein, failAvg, maxPeriods * numBuckets, "failure average");
+    } else {
+        filein >> Using<VectorFormatter<EncodedDoubleFormatter>>(m_feerate_avg);
+        if (m_feerate_avg.size() != numBuckets) {
+            throw std::runtime_error("Corrupt estimates file. Mismatch in feerate average bucket count");
+        }
+        filein >> Using<VectorFormatter<EncodedDoubleFormatter>>(txCtAvg);
+        if (txCtAvg.size() != numBuckets) {
+            throw std::runtime_error("Corrupt estimates file. Mismatch in tx count bucket count");
+        }
+        std::vector<std::vector<double>> fileConfAvg, fileFailAvg;
+        filein >> Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(fileConfAvg);
+        maxPeriods = fileConfAvg.size();
+        maxConfirms = scale * maxPeriods;
 
-    if (maxConfirms <= 0 || maxConfirms > 6 * 24 * 7) { // one week
-        throw std::runtime_error("Corrupt estimates file.  Must maintain estimates for between 1 and 1008 (one week) confirms");
-    }
-    for (unsigned int i = 0; i < maxPeriods; i++) {
-        if (confAvg[i].size() != numBuckets) {
-            throw std::runtime_error("Corrupt estimates file. Mismatch in feerate conf average bucket count");
+        if (maxConfirms <= 0 || maxConfirms > 6 * 24 * 7) { // one week
+            throw std::runtime_error("Corrupt estimates file.  Must maintain estimates for between 1 and 1008 (one week) confirms");
+        }
+        for (unsigned int i = 0; i < maxPeriods; i++) {
+            if (fileConfAvg[i].size() != numBuckets) {
+                throw std::runtime_error("Corrupt estimates file. Mismatch in feerate conf average bucket count");
+            }
         }
-    }
 
-    filein >> Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(failAvg);
-    if (maxPeriods != failAvg.size()) {
-        throw std::runtime_error("Corrupt estimates file. Mismatch in confirms tracked for failures");
-    }
-    for (unsigned int i = 0; i < maxPeriods; i++) {
-        if (failAvg[i].size() != numBuckets) {
-            throw std::runtime_error("Corrupt estimates file. Mismatch in one of failure average bucket counts");
+        filein >> Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(fileFailAvg);
+        if (maxPeriods != fileFailAvg.size()) {
+            throw std::runtime_error("Corrupt estimates file. Mismatch in confirms tracked for failures");
+        }
+        for (unsigned int i = 0; i < maxPeriods; i++) {
+            if (fileFailAvg[i].size() != numBuckets) {
+                throw std::runtime_error("Corrupt estimates file. Mismatch in one of failure average bucket counts");
+            }
+        }
+
+        confAvg.clear();
+        failAvg.clear();
+        for (unsigned int i = 0; i < maxPeriods; i++) {
+            confAvg.insert(confAvg.end(), fileConfAvg[i].begin(), fileConfAvg[i].end());
+            failAvg.insert(failAvg.end(), fileFailAvg[i].begin(), fileFailAvg[i].end());
         }
     }
+    m_num_buckets = numBuckets;
+    m_max_periods = maxPeriods;
+    m_decay_scale = 1;
 
     // Resize the current block variables which aren't stored in the data file
     // to match the number of confirms and buckets
@@ -440,12 +528,10 @@ void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets
              numBuckets, maxConfirms);
 }
 
-unsigned int TxConfirmStats::NewTx(unsigned int nBlockHeight, double val)
+void TxConfirmStats::NewTx(unsigned int nBlockHeight, unsigned int bucketindex)
 {
-    unsigned int bucketindex = bucketMap.lower_bound(val)->second;
-    unsigned int blockIndex = nBlockHeight % unconfTxs.size();
-    unconfTxs[blockIndex][bucketindex]++;
-    return bucketindex;
+    unsigned int blockIndex = nBlockHeight % GetMaxConfirms();
+    unconfTxs[bucketindex * GetMaxConfirms() + blockIndex]++;
 }
 
 void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHeight, unsigned int bucketindex, bool inBlock)
@@ -459,7 +545,7 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
         return;  //This can't happen because we call this with our best seen height, no entries can have higher
     }
 
-    if (blocksAgo >= (int)unconfTxs.size()) {
+    if (blocksAgo >= (int)GetMaxConfirms()) {
         if (oldUnconfTxs[bucketindex] > 0) {
             oldUnconfTxs[bucketindex]--;
         } else {
@@ -468,9 +554,10 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
         }
     }
     else {
-        unsigned int blockIndex = entryHeight % unconfTxs.size();
-        if (unconfTxs[blockIndex][bucketindex] > 0) {
-            unconfTxs[blockIndex][bucketindex]--;
+        unsigned int blockIndex = entryHeight % GetMaxConfirms();
+        int& unconf = unconfTxs[bucketindex * GetMaxConfirms() + blockIndex];
+        if (unconf > 0) {
+            unconf--;
         } else {
             LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy error, mempool tx removed from blockIndex=%u,bucketIndex=%u already\n",
                      blockIndex, bucketindex);
@@ -479,8 +566,8 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
     if (!inBlock && (unsigned int)blocksAgo >= scale) { // Only counts as a failure if not confirmed for entire period
         assert(scale != 0);
         unsigned int periodsAgo = blocksAgo / scale;
-        for (size_t i = 0; i < periodsAgo && i < failAvg.size(); i++) {
-            failAvg[i][bucketindex]++;
+        for (size_t i = 0; i < periodsAgo && i < m_max_periods; i++) {
+            failAvg[i * m_num_buckets + bucketindex] += 1 / m_decay_scale;
         }
     }
 }
@@ -499,18 +586,24 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
 bool CBlockPolicyEstimator::_removeTx(const uint256& hash, bool inBlock)
 {
     AssertLockHeld(m_cs_fee_estimator);
-    std::map<uint256, TxStatsInfo>::iterator pos = mapMemPoolTxs.find(hash);
+    auto pos = mapMemPoolTxs.find(hash);
     if (pos != mapMemPoolTxs.end()) {
         feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
-        mapMemPoolTxs.erase(hash);
+        mapMemPoolTxs.erase(pos);
         return true;
     } else {
         return false;
     }
 }
 
+unsigned int CBlockPolicyEstimator::BucketIndex(double feerate) const
+{
+    AssertLockHeld(m_cs_fee_estimator);
+    return bucketMap.lower_bound(feerate)->second;
+}
+
 CBlockPolicyEstimator::CBlockPolicyEstimator()
     : nBestSeenHeight(0), firstRecordedHeight(0), historicalFirst(0), historicalBest(0), trackedTxs(0), untrackedTxs(0)
 {
@@ -525,9 +618,9 @@ CBlockPolicyEstimator::CBlockPolicyEstimator()
     bucketMap[INF_FEERATE] = bucketIndex;
     assert(bucketMap.size() == buckets.size());
 
-    feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
-    shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
-    longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+    feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+    shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
+    longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
 
     // If the fee estimation file is present, read recorded estimations
     fs::path est_filepath = gArgs.GetDataDirNet() / FEE_ESTIMATES_FILENAME;
@@ -545,7 +638,7 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
 {
     LOCK(m_cs_fee_estimator);
     unsigned int txHeight = entry.GetHeight();
-    uint256 hash = entry.GetTx().GetHash();
+    const uint256& hash = entry.GetTx().GetHash();
     if (mapMemPoolTxs.count(hash)) {
         LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy error mempool tx %s already being tracked\n",
                  hash.ToString());
@@ -571,22 +664,25 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     // Feerates are stored and reported as BTC-per-kb:
     CFeeRate feeRate(entry.GetFee(), entry.GetTxSize());
 
-    mapMemPoolTxs[hash].blockHeight = txHeight;
-    unsigned int bucketIndex = feeStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
-    mapMemPoolTxs[hash].bucketIndex = bucketIndex;
-    unsigned int bucketIndex2 = shortStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
-    assert(bucketIndex == bucketIndex2);
-    unsigned int bucketIndex3 = longStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
-    assert(bucketIndex == bucketIndex3);
+    // All horizons share the buckets, so look the bucket up once.
+    TxStatsInfo& info = mapMemPoolTxs[hash];
+    info.blockHeight = txHeight;
+    info.bucketIndex = BucketIndex((double)feeRate.GetFeePerK());
+    feeStats->NewTx(txHeight, info.bucketIndex);
+    shortStats->NewTx(txHeight, info.bucketIndex);
+    longStats->NewTx(txHeight, info.bucketIndex);
 }
 
-bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
+bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry, std::vector<BlockTxStats>& confirmed)
 {
     AssertLockHeld(m_cs_fee_estimator);
-    if (!_removeTx(entry->GetTx().GetHash(), true)) {
+    auto pos = mapMemPoolTxs.find(entry->GetTx().GetHash());
+    if (pos == mapMemPoolTxs.end()) {
         // This transaction wasn't being tracked for fee estimation
         return false;
     }
+    const unsigned int bucketIndex = pos->second.bucketIndex;
+    _removeTx(pos->first, true);
 
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
@@ -602,9 +698,7 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     // Feerates are stored and reported as BTC-per-kb:
     CFeeRate feeRate(entry->GetFee(), entry->GetTxSize());
 
-    feeStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
-    shortStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
-    longStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
+    confirmed.push_back({blocksToConfirm, bucketIndex, (double)feeRate.GetFeePerK()});
     return true;
 }
 
@@ -636,12 +730,19 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     shortStats->UpdateMovingAverages();
     longStats->UpdateMovingAverages();
 
-    unsigned int countedTxs = 0;
-    // Update averages with data points from current block
+    // Collect the data points from the current block, then update the
+    // averages of one horizon at a time with all of them
+    std::vector<BlockTxStats> confirmed;
+    confirmed.reserve(entries.size());
     for (const auto& entry : entries) {
-        if (processBlockTx(nBlockHeight, entry))
-            countedTxs++;
+        processBlockTx(nBlockHeight, entry, confirmed);
+    }
+    for (TxConfirmStats* stats : {feeStats.get(), shortStats.get(), longStats.get()}) {
+        for (const BlockTxStats& tx : confirmed) {
+            stats->Record(tx.blocksToConfirm, tx.bucketIndex, tx.feerate);
+        }
     }
+    const unsigned int countedTxs = confirmed.size();
 
     if (firstRecordedHeight == 0 && countedTxs > 0) {
         firstRecordedHeight = nBestSeenHeight;
@@ -902,7 +1003,7 @@ bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
 {
     try {
         LOCK(m_cs_fee_estimator);
-        fileout << 149900; // version required to read: 0.14.99 or later
+        fileout << FEE_ESTIMATES_SPARSE_VERSION; // version required to read
         fileout << CLIENT_VERSION; // version that wrote the file
         fileout << nBestSeenHeight;
         if (BlockSpan() > HistoricalBlockSpan()/2) {
@@ -953,12 +1054,13 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
                 throw std::runtime_error("Corrupt estimates file. Must have between 2 and 1000 feerate buckets");
             }
 
-            std::unique_ptr<TxConfirmStats> fileFeeStats(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
-            std::unique_ptr<TxConfirmStats> fileShortStats(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
-            std::unique_ptr<TxConfirmStats> fileLongStats(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
-            fileFeeStats->Read(filein, nVersionThatWrote, numBuckets);
-            fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
-            fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
+            const bool sparse = nVersionRequired >= FEE_ESTIMATES_SPARSE_VERSION;
+            std::unique_ptr<TxConfirmStats> fileFeeStats(new TxConfirmStats(buckets, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+            std::unique_ptr<TxConfirmStats> fileShortStats(new TxConfirmStats(buckets, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
+            std::unique_ptr<TxConfirmStats> fileLongStats(new TxConfirmStats(buckets, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+            fileFeeStats->Read(filein, sparse, numBuckets);
+            fileShortStats->Read(filein, sparse, numBuckets);
+            fileLongStats->Read(filein, sparse, numBuckets);
 
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
@@ -968,7 +1070,7 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
                 bucketMap[buckets[i]] = i;
             }
 
-            // Destroy old TxConfirmStats and point to new ones that already reference buckets and bucketMap
+            // Destroy old TxConfirmStats and point to new ones that already reference buckets
             feeStats = std::move(fileFeeStats);
             shortStats = std::move(fileShortStats);
             longStats = std::move(fileLongStats);
@@ -10,11 +10,13 @@
 #include <uint256.h>
 #include <random.h>
 #include <sync.h>
+#include <util/hasher.h>
 
 #include <array>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class CAutoFile;
@@ -253,7 +255,15 @@ private:
     };
 
     // map of txids to information about that transaction
-    std::map<uint256, TxStatsInfo> mapMemPoolTxs GUARDED_BY(m_cs_fee_estimator);
+    std::unordered_map<uint256, TxStatsInfo, SaltedTxidHasher> mapMemPoolTxs GUARDED_BY(m_cs_fee_estimator);
+
+    /** A transaction confirmed in a block, as recorded by each of the TxConfirmStats */
+    struct BlockTxStats
+    {
+        int blocksToConfirm;
+        unsigned int bucketIndex;
+        double feerate;
+    };
 
     /** Classes to track historical data on transaction confirmations */
     std::unique_ptr<TxConfirmStats> feeStats PT_GUARDED_BY(m_cs_fee_estimator);
@@ -266,8 +276,11 @@ private:
     std::vector<double> buckets GUARDED_BY(m_cs_fee_estimator); // The upper-bound of the range for the bucket (inclusive)
     std::map<double, unsigned int> bucketMap GUARDED_BY(m_cs_fee_estimator); // Map of bucket upper-bound to index into all vectors by bucket
 
-    /** Process a transaction confirmed in a block*/
-    bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    /** Stop tracking a transaction confirmed in a block, and add it to confirmed if it was tracked */
+    bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry, std::vector<BlockTxStats>& confirmed) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+
+    /** Index of the bucket a feerate falls into, the same for all TxConfirmStats */
+    unsigned int BucketIndex(double feerate) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
 
     /** Helper for estimateSmartFee */
     double estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
@@ -262,6 +262,43 @@ extern const char* CFCHECKPT;
  * @since protocol version 70016 as described by BIP 339.
  */
 extern const char* WTXIDRELAY;
+/**
+ * Contains a 4-byte version number and an 8-byte salt.
+ * The salt is used to compute short txids needed for efficient
+ * txreconciliation, as described by BIP 330.
+ */
+extern const char* SENDTXRCNCL;
+/**
+ * Starts a reconciliation round. Contains the 2-byte size of the sender's
+ * reconciliation set and the 2-byte q coefficient used to size the sketch.
+ */
+extern const char* REQTXRCNCL;
+/**
+ * The answer to REQTXRCNCL: a sketch of the sender's reconciliation set.
+ */
+extern const char* SKETCH;
+/**
+ * Finishes a reconciliation round. Contains a 1-byte success flag and the
+ * short txids of the transactions the sender is missing.
+ */
+extern const char* RECONCILDIFF;
+/**
+ * Indicates that a node serves the unconfirmed ancestors of the transactions
+ * it relays on request. Contains a 4-byte version number; sent between
+ * VERSION and VERACK.
+ */
+extern const char* SENDPACKAGES;
+/**
+ * Asks a package relay peer for a transaction together with its unconfirmed
+ * ancestors. Contains the wtxid of the transaction.
+ */
+extern const char* GETPKGTXNS;
+/**
+ * The answer to GETPKGTXNS: the requested wtxid and the transaction with its
+ * unconfirmed ancestors, parents before children, or no transactions if the
+ * package cannot be served.
+ */
+extern const char* PKGTXNS;
 }; // namespace NetMsgType
 
 /* Get a vector of all valid message types (see above) */
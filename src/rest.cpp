@@ -7,6 +7,7 @@
 #include <chainparams.h>
 #include <core_io.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
 #include <index/txindex.h>
 #include <names/common.h>
 #include <names/encoding.h>
@@ -326,6 +327,9 @@ static bool rest_block(const std::any& context,
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
     CBlock block;
+    // The serialized block, for the binary and hex formats, which don't need to deserialize it
+    std::vector<uint8_t> block_data;
+    const bool raw{rf == RetFormat::BINARY || rf == RetFormat::HEX};
     CBlockIndex* pblockindex = nullptr;
     CBlockIndex* tip = nullptr;
     {
@@ -342,24 +346,25 @@ static bool rest_block(const std::any& context,
         if (IsBlockPruned(pblockindex))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        if (raw) {
+            const bool with_witness{!(RPCSerializationFlags() & SERIALIZE_TRANSACTION_NO_WITNESS)};
+            if (!ReadRawBlockFromDisk(block_data, pblockindex, Params().MessageStart(), with_witness))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        } else if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        }
     }
 
     switch (rf) {
     case RetFormat::BINARY: {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string binaryBlock = ssBlock.str();
+        const std::string binaryBlock{block_data.begin(), block_data.end()};
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTP_OK, binaryBlock);
         return true;
     }
 
     case RetFormat::HEX: {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock) + "\n";
+        std::string strHex = HexStr(block_data) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -822,6 +827,52 @@ static bool rest_name(const std::any& context, HTTPRequest* req, const std::stri
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_address_history(const std::any& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No start height specified. Use /rest/addresshistory/<start_height>/<address>.json.");
+
+    const auto start_height{ToIntegral<int32_t>(path[0])};
+    if (!start_height.has_value() || *start_height < 0) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + SanitizeString(path[0]));
+    }
+    CScript script;
+    if (!ParseAddressIndexScript(path[1], script)) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address or script: " + SanitizeString(path[1]));
+    }
+    if (!g_address_index) {
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Address index is not enabled");
+    }
+    if (!g_address_index->BlockUntilSyncedToCurrentChain()) {
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Address index is still being built");
+    }
+
+    switch (rf) {
+    case RetFormat::JSON: {
+        std::vector<AddressIndexEntry> entries;
+        if (!g_address_index->FindScriptHistory(script, *start_height, std::numeric_limits<int>::max(), DEFAULT_ADDRESS_HISTORY_LIMIT, entries)) {
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Failed to read the address index");
+        }
+        UniValue resp(UniValue::VOBJ);
+        if (entries.size() >= static_cast<size_t>(DEFAULT_ADDRESS_HISTORY_LIMIT)) resp.pushKV("next_height", entries.back().height + 1);
+        resp.pushKV("entries", AddressHistoryToJSON(entries));
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, resp.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(const std::any& context, HTTPRequest* req, const std::string& strReq);
@@ -836,6 +887,7 @@ static const struct {
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
       {"/rest/name/", rest_name},
+      {"/rest/addresshistory/", rest_address_history},
 };
 
 void StartREST(const std::any& context)
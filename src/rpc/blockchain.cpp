@@ -17,11 +17,14 @@
 #include <deploymentstatus.h>
 #include <fs.h>
 #include <hash.h>
+#include <index/addressindex.h>
 #include <index/blockfilterindex.h>
 #include <index/coinstatsindex.h>
 #include <net.h>
+#include <names/encoding.h>
 #include <net_processing.h>
 #include <node/blockstorage.h>
+#include <key_io.h>
 #include <logging/timer.h>
 #include <node/coinstats.h>
 #include <node/context.h>
@@ -29,7 +32,6 @@
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
-#include <policy/rbf.h>
 #include <primitives/transaction.h>
 #include <rpc/rawtransaction.h>
 #include <rpc/request.h>
@@ -507,45 +509,40 @@ static std::vector<RPCResult> MempoolEntryDescription() { return {
     RPCResult{RPCResult::Type::BOOL, "unbroadcast", "Whether this transaction is currently unbroadcast (initial broadcast not yet acknowledged by any peers)"},
 };}
 
-static void entryToJSON(const CTxMemPool& pool, UniValue& info, const CTxMemPoolEntry& e) EXCLUSIVE_LOCKS_REQUIRED(pool.cs)
+static void entryToJSON(UniValue& info, const MempoolSnapshot::Entry& e)
 {
-    AssertLockHeld(pool.cs);
-
-    info.pushKV("vsize", (int)e.GetTxSize());
-    info.pushKV("weight", (int)e.GetTxWeight());
+    info.pushKV("vsize", (int)e.vsize);
+    info.pushKV("weight", (int)e.weight);
     // TODO: top-level fee fields are deprecated. deprecated_fee_fields_enabled blocks should be removed in v24
     const bool deprecated_fee_fields_enabled{IsDeprecatedRPCEnabled("fees")};
     if (deprecated_fee_fields_enabled) {
-        info.pushKV("fee", ValueFromAmount(e.GetFee()));
-        info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
+        info.pushKV("fee", ValueFromAmount(e.fee));
+        info.pushKV("modifiedfee", ValueFromAmount(e.modified_fee));
     }
-    info.pushKV("time", count_seconds(e.GetTime()));
-    info.pushKV("height", (int)e.GetHeight());
-    info.pushKV("descendantcount", e.GetCountWithDescendants());
-    info.pushKV("descendantsize", e.GetSizeWithDescendants());
+    info.pushKV("time", count_seconds(e.time));
+    info.pushKV("height", (int)e.height);
+    info.pushKV("descendantcount", e.count_with_descendants);
+    info.pushKV("descendantsize", e.size_with_descendants);
     if (deprecated_fee_fields_enabled) {
-        info.pushKV("descendantfees", e.GetModFeesWithDescendants());
+        info.pushKV("descendantfees", e.mod_fees_with_descendants);
     }
-    info.pushKV("ancestorcount", e.GetCountWithAncestors());
-    info.pushKV("ancestorsize", e.GetSizeWithAncestors());
+    info.pushKV("ancestorcount", e.count_with_ancestors);
+    info.pushKV("ancestorsize", e.size_with_ancestors);
     if (deprecated_fee_fields_enabled) {
-        info.pushKV("ancestorfees", e.GetModFeesWithAncestors());
+        info.pushKV("ancestorfees", e.mod_fees_with_ancestors);
     }
-    info.pushKV("wtxid", pool.vTxHashes[e.vTxHashesIdx].first.ToString());
+    info.pushKV("wtxid", e.tx->GetWitnessHash().ToString());
 
     UniValue fees(UniValue::VOBJ);
-    fees.pushKV("base", ValueFromAmount(e.GetFee()));
-    fees.pushKV("modified", ValueFromAmount(e.GetModifiedFee()));
-    fees.pushKV("ancestor", ValueFromAmount(e.GetModFeesWithAncestors()));
-    fees.pushKV("descendant", ValueFromAmount(e.GetModFeesWithDescendants()));
+    fees.pushKV("base", ValueFromAmount(e.fee));
+    fees.pushKV("modified", ValueFromAmount(e.modified_fee));
+    fees.pushKV("ancestor", ValueFromAmount(e.mod_fees_with_ancestors));
+    fees.pushKV("descendant", ValueFromAmount(e.mod_fees_with_descendants));
     info.pushKV("fees", fees);
 
-    const CTransaction& tx = e.GetTx();
     std::set<std::string> setDepends;
-    for (const CTxIn& txin : tx.vin)
-    {
-        if (pool.exists(GenTxid::Txid(txin.prevout.hash)))
-            setDepends.insert(txin.prevout.hash.ToString());
+    for (const uint256& parent : e.parents) {
+        setDepends.insert(parent.ToString());
     }
 
     UniValue depends(UniValue::VARR);
@@ -557,25 +554,14 @@ static void entryToJSON(const CTxMemPool& pool, UniValue& info, const CTxMemPool
     info.pushKV("depends", depends);
 
     UniValue spent(UniValue::VARR);
-    const CTxMemPool::txiter& it = pool.mapTx.find(tx.GetHash());
-    const CTxMemPoolEntry::Children& children = it->GetMemPoolChildrenConst();
-    for (const CTxMemPoolEntry& child : children) {
-        spent.push_back(child.GetTx().GetHash().ToString());
+    for (const uint256& child : e.children) {
+        spent.push_back(child.ToString());
     }
 
     info.pushKV("spentby", spent);
 
-    // Add opt-in RBF status
-    bool rbfStatus = false;
-    RBFTransactionState rbfState = IsRBFOptIn(tx, pool);
-    if (rbfState == RBFTransactionState::UNKNOWN) {
-        throw JSONRPCError(RPC_MISC_ERROR, "Transaction is not in mempool");
-    } else if (rbfState == RBFTransactionState::REPLACEABLE_BIP125) {
-        rbfStatus = true;
-    }
-
-    info.pushKV("bip125-replaceable", rbfStatus);
-    info.pushKV("unbroadcast", pool.IsUnbroadcastTx(tx.GetHash()));
+    info.pushKV("bip125-replaceable", e.bip125_replaceable);
+    info.pushKV("unbroadcast", e.unbroadcast);
 }
 
 UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose, bool include_mempool_sequence)
@@ -584,12 +570,14 @@ UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose, bool include_mempoo
         if (include_mempool_sequence) {
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbose results cannot contain mempool sequence values.");
         }
-        LOCK(pool.cs);
+        // Build the result from a snapshot, so that transactions can enter
+        // the mempool while a large one is written.
+        const auto snapshot{pool.GetSnapshot()};
         UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : pool.mapTx) {
-            const uint256& hash = e.GetTx().GetHash();
+        for (const MempoolSnapshot::Entry& e : snapshot->entries) {
+            const uint256& hash = e.tx->GetHash();
             UniValue info(UniValue::VOBJ);
-            entryToJSON(pool, info, e);
+            entryToJSON(info, e);
             // Mempool has unique entries so there is no advantage in using
             // UniValue::pushKV, which checks if the key already exists in O(N).
             // UniValue::__pushKV is used instead which currently is O(1).
@@ -598,15 +586,24 @@ UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose, bool include_mempoo
         return o;
     } else {
         uint64_t mempool_sequence;
+        std::shared_ptr<const MempoolSnapshot> snapshot;
         std::vector<uint256> vtxid;
         {
             LOCK(pool.cs);
-            pool.queryHashes(vtxid);
+            // Copying all entries for a snapshot costs more than the txids
+            // alone, so one is only used if it is there already.
+            snapshot = pool.GetCurrentSnapshot();
+            if (!snapshot) pool.queryHashes(vtxid);
             mempool_sequence = pool.GetSequence();
         }
         UniValue a(UniValue::VARR);
-        for (const uint256& hash : vtxid)
-            a.push_back(hash.ToString());
+        if (snapshot) {
+            for (const MempoolSnapshot::Entry& e : snapshot->entries)
+                a.push_back(e.tx->GetHash().ToString());
+        } else {
+            for (const uint256& hash : vtxid)
+                a.push_back(hash.ToString());
+        }
 
         if (!include_mempool_sequence) {
             return a;
@@ -721,10 +718,9 @@ static RPCHelpMan getmempoolancestors()
     } else {
         UniValue o(UniValue::VOBJ);
         for (CTxMemPool::txiter ancestorIt : setAncestors) {
-            const CTxMemPoolEntry &e = *ancestorIt;
-            const uint256& _hash = e.GetTx().GetHash();
+            const uint256& _hash = ancestorIt->GetTx().GetHash();
             UniValue info(UniValue::VOBJ);
-            entryToJSON(mempool, info, e);
+            entryToJSON(info, mempool.GetSnapshotEntry(ancestorIt));
             o.pushKV(_hash.ToString(), info);
         }
         return o;
@@ -786,10 +782,9 @@ static RPCHelpMan getmempooldescendants()
     } else {
         UniValue o(UniValue::VOBJ);
         for (CTxMemPool::txiter descendantIt : setDescendants) {
-            const CTxMemPoolEntry &e = *descendantIt;
-            const uint256& _hash = e.GetTx().GetHash();
+            const uint256& _hash = descendantIt->GetTx().GetHash();
             UniValue info(UniValue::VOBJ);
-            entryToJSON(mempool, info, e);
+            entryToJSON(info, mempool.GetSnapshotEntry(descendantIt));
             o.pushKV(_hash.ToString(), info);
         }
         return o;
@@ -823,9 +818,8 @@ static RPCHelpMan getmempoolentry()
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
     }
 
-    const CTxMemPoolEntry &e = *it;
     UniValue info(UniValue::VOBJ);
-    entryToJSON(mempool, info, e);
+    entryToJSON(info, mempool.GetSnapshotEntry(it));
     return info;
 },
     };
@@ -1007,6 +1001,21 @@ static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
     return block;
 }
 
+static std::vector<uint8_t> GetRawBlockChecked(const CBlockIndex* pblockindex)
+{
+    std::vector<uint8_t> block_data;
+    if (IsBlockPruned(pblockindex)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+    }
+
+    const bool with_witness{!(RPCSerializationFlags() & SERIALIZE_TRANSACTION_NO_WITNESS)};
+    if (!ReadRawBlockFromDisk(block_data, pblockindex, Params().MessageStart(), with_witness)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+    }
+
+    return block_data;
+}
+
 static CBlockUndo GetUndoChecked(const CBlockIndex* pblockindex)
 {
     CBlockUndo blockUndo;
@@ -1116,17 +1125,13 @@ static RPCHelpMan getblock()
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
         }
 
+        if (verbosity <= 0) {
+            // Passed through as it is on disk, without deserializing it
+            return HexStr(GetRawBlockChecked(pblockindex));
+        }
         block = GetBlockChecked(pblockindex);
     }
 
-    if (verbosity <= 0)
-    {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock);
-        return strHex;
-    }
-
     TxVerbosity tx_verbosity;
     if (verbosity == 1) {
         tx_verbosity = TxVerbosity::SHOW_TXID;
@@ -2344,7 +2349,8 @@ static RPCHelpMan savemempool()
         throw JSONRPCError(RPC_MISC_ERROR, "The mempool was not loaded yet");
     }
 
-    if (!DumpMempool(mempool)) {
+    ChainstateManager& chainman = EnsureAnyChainman(request.context);
+    if (!DumpMempool(mempool, chainman.ActiveChainstate())) {
         throw JSONRPCError(RPC_MISC_ERROR, "Unable to dump mempool to disk");
     }
 
@@ -2665,6 +2671,117 @@ static RPCHelpMan getblockfilter()
     };
 }
 
+bool ParseAddressIndexScript(const std::string& str, CScript& script)
+{
+    const CTxDestination dest{DecodeDestination(str)};
+    if (IsValidDestination(dest)) {
+        script = GetScriptForDestination(dest);
+        return true;
+    }
+    if (!str.empty() && IsHex(str)) {
+        const std::vector<unsigned char> data{ParseHex(str)};
+        script = CScript(data.begin(), data.end());
+        return true;
+    }
+    return false;
+}
+
+UniValue AddressHistoryToJSON(const std::vector<AddressIndexEntry>& entries)
+{
+    UniValue result(UniValue::VARR);
+    for (const AddressIndexEntry& entry : entries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("height", entry.height);
+        obj.pushKV("txid", entry.txid.GetHex());
+        if (entry.spending) {
+            obj.pushKV("vin", static_cast<int>(entry.index));
+            obj.pushKV("prevout_txid", entry.prevout.hash.GetHex());
+            obj.pushKV("prevout_vout", static_cast<int>(entry.prevout.n));
+        } else {
+            obj.pushKV("vout", static_cast<int>(entry.index));
+        }
+        obj.pushKV("amount", ValueFromAmount(entry.amount));
+        if (!entry.name.empty()) {
+            AddEncodedNameToUniv(obj, "name", entry.name, ConfiguredNameEncoding());
+        }
+        result.push_back(obj);
+    }
+    return result;
+}
+
+static RPCHelpMan getaddresshistory()
+{
+    return RPCHelpMan{"getaddresshistory",
+                "\nReturn the outputs paying to an address or script and the inputs spending them, in block order.\n"
+                "Name operations count towards the address that holds the name.\n"
+                "Requires -addressindex.\n",
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address, or a hex-encoded scriptPubKey"},
+                    {"start_height", RPCArg::Type::NUM, RPCArg::Default{0}, "The first block height to return entries for"},
+                    {"end_height", RPCArg::Type::NUM, RPCArg::DefaultHint{"the chain tip"}, "The last block height to return entries for"},
+                    {"limit", RPCArg::Type::NUM, RPCArg::Default{DEFAULT_ADDRESS_HISTORY_LIMIT}, "Stop after the block height at which this many entries are reached"},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::ARR, "entries", "",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                {RPCResult::Type::NUM, "height", "The height of the block containing the transaction"},
+                                {RPCResult::Type::STR_HEX, "txid", "The transaction id"},
+                                {RPCResult::Type::NUM, "vout", /*optional=*/true, "The output index, for outputs paying to the address"},
+                                {RPCResult::Type::NUM, "vin", /*optional=*/true, "The input index, for inputs spending from the address"},
+                                {RPCResult::Type::STR_HEX, "prevout_txid", /*optional=*/true, "The transaction id of the spent output"},
+                                {RPCResult::Type::NUM, "prevout_vout", /*optional=*/true, "The output index of the spent output"},
+                                {RPCResult::Type::STR_AMOUNT, "amount", "The amount paid or spent"},
+                                {RPCResult::Type::STR, "name", /*optional=*/true, "The name, for name outputs"},
+                            }},
+                        }},
+                        {RPCResult::Type::NUM, "next_height", /*optional=*/true, "The start_height to continue from, if the limit was reached"},
+                    }},
+                RPCExamples{
+                    HelpExampleCli("getaddresshistory", "\"" + EXAMPLE_ADDRESS[0] + "\" 1000 2000") +
+                    HelpExampleRpc("getaddresshistory", "\"" + EXAMPLE_ADDRESS[0] + "\", 1000, 2000")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    if (!g_address_index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index is not enabled. Start with -addressindex");
+    }
+
+    CScript script;
+    if (!ParseAddressIndexScript(request.params[0].get_str(), script)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address or script");
+    }
+    const int start_height{request.params[1].isNull() ? 0 : request.params[1].get_int()};
+    const int end_height{request.params[2].isNull() ? std::numeric_limits<int>::max() : request.params[2].get_int()};
+    const int limit{request.params[3].isNull() ? DEFAULT_ADDRESS_HISTORY_LIMIT : request.params[3].get_int()};
+    if (start_height < 0 || end_height < start_height) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+    }
+    if (limit <= 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "limit must be positive");
+    }
+
+    if (!g_address_index->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index is still being built");
+    }
+
+    std::vector<AddressIndexEntry> entries;
+    if (!g_address_index->FindScriptHistory(script, start_height, end_height, limit, entries)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    const bool truncated{entries.size() >= static_cast<size_t>(limit) && entries.back().height < end_height};
+    if (truncated) ret.pushKV("next_height", entries.back().height + 1);
+    ret.pushKV("entries", AddressHistoryToJSON(entries));
+    return ret;
+},
+    };
+}
+
 /**
  * Serialize the UTXO set to a file for loading elsewhere.
  *
@@ -2828,6 +2945,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         &preciousblock,                      },
     { "blockchain",         &scantxoutset,                       },
     { "blockchain",         &getblockfilter,                     },
+    { "blockchain",         &getaddresshistory,                  },
 
     /* Not shown in help */
     { "hidden",              &invalidateblock,                   },
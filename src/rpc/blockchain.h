@@ -13,6 +13,7 @@
 
 #include <any>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 extern RecursiveMutex cs_main;
@@ -23,11 +24,16 @@ class CChainState;
 class CTxMemPool;
 class ChainstateManager;
 class JSONRPCRequest;
+class CScript;
 class UniValue;
+struct AddressIndexEntry;
 struct NodeContext;
 
 static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
 
+/** Default for the number of entries returned by one address history lookup */
+static constexpr int DEFAULT_ADDRESS_HISTORY_LIMIT{1000};
+
 /**
  * Get the difficulty of the net wrt to the given bits.
  *
@@ -54,6 +60,12 @@ UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
+/** Parse an address or hex-encoded script for address index lookups. */
+bool ParseAddressIndexScript(const std::string& str, CScript& script);
+
+/** Address index entries to JSON */
+UniValue AddressHistoryToJSON(const std::vector<AddressIndexEntry>& entries);
+
 /**
  * Helper to create UTXO snapshots given a chainstate and a file handle.
  * @return a UniValue map containing metadata about the snapshot.
@@ -134,6 +134,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "gettxout", 2, "include_mempool" },
     { "gettxoutproof", 0, "txids" },
     { "gettxoutsetinfo", 1, "hash_or_height" },
+    { "getaddresshistory", 1, "start_height" },
+    { "getaddresshistory", 2, "end_height" },
+    { "getaddresshistory", 3, "limit" },
     { "gettxoutsetinfo", 2, "use_index"},
     { "lockunspent", 0, "unlock" },
     { "lockunspent", 1, "transactions" },
@@ -177,6 +180,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "upgradewallet", 0, "version" },
 
     { "name_show", 1, "options" },
+    { "name_showmany", 0, "names" },
+    { "name_showmany", 1, "options" },
     { "name_history", 1, "options" },
     { "name_scan", 1, "count" },
     { "name_scan", 2, "options" },
@@ -5,8 +5,10 @@
 
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/addressindex.h>
 #include <index/coinstatsindex.h>
 #include <index/namehash.h>
+#include <index/namehistory.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <interfaces/echo.h>
@@ -749,6 +751,9 @@ static UniValue SummaryToJSON(const IndexSummary&& summary, std::string index_na
     UniValue entry(UniValue::VOBJ);
     entry.pushKV("synced", summary.synced);
     entry.pushKV("best_block_height", summary.best_block_height);
+    if (!summary.synced) {
+        entry.pushKV("blocks_per_second", summary.blocks_per_second);
+    }
     ret_summary.pushKV(summary.name, entry);
     return ret_summary;
 }
@@ -767,6 +772,7 @@ static RPCHelpMan getindexinfo()
                             {
                                 {RPCResult::Type::BOOL, "synced", "Whether the index is synced or not"},
                                 {RPCResult::Type::NUM, "best_block_height", "The block height to which the index is synced"},
+                                {RPCResult::Type::NUM, "blocks_per_second", /*optional=*/true, "While the index is catching up with the chain, the average number of blocks it indexed per second"},
                             }
                         },
                     },
@@ -788,11 +794,18 @@ static RPCHelpMan getindexinfo()
     if (g_name_hash_index) {
         result.pushKVs(SummaryToJSON(g_name_hash_index->GetSummary(), index_name));
     }
+    if (g_name_history_index) {
+        result.pushKVs(SummaryToJSON(g_name_history_index->GetSummary(), index_name));
+    }
 
     if (g_coin_stats_index) {
         result.pushKVs(SummaryToJSON(g_coin_stats_index->GetSummary(), index_name));
     }
 
+    if (g_address_index) {
+        result.pushKVs(SummaryToJSON(g_address_index->GetSummary(), index_name));
+    }
+
     ForEachBlockFilterIndex([&result, &index_name](const BlockFilterIndex& index) {
         result.pushKVs(SummaryToJSON(index.GetSummary(), index_name));
     });
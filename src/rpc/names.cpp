@@ -8,6 +8,7 @@
 #include <core_io.h>
 #include <init.h>
 #include <index/namehash.h>
+#include <index/namehistory.h>
 #include <key_io.h>
 #include <names/common.h>
 #include <names/main.h>
@@ -34,6 +35,7 @@
 #include <algorithm>
 #include <cassert>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 
 namespace
@@ -190,14 +192,12 @@ namespace
 {
 
 /**
- * Decodes the identifier for a name lookup according to the nameEncoding,
- * and also looks up the preimage if we look up by hash.
+ * Checks the byHash option of a name lookup.  Returns true if the names
+ * should be looked up by hash through the name-hash index.
  */
-valtype
-GetNameForLookup (const UniValue& val, const UniValue& opt)
+bool
+IsLookupByHash (const UniValue& opt)
 {
-  const valtype identifier = DecodeNameFromRPCOrThrow (val, opt);
-
   RPCTypeCheckObj (opt,
     {
       {"byHash", UniValueType (UniValue::VSTR)},
@@ -205,16 +205,14 @@ GetNameForLookup (const UniValue& val, const UniValue& opt)
     true, false);
 
   if (!opt.exists ("byHash"))
-    return identifier;
+    return false;
 
   const std::string byHashType = opt["byHash"].get_str ();
   if (byHashType == "direct")
-    return identifier;
+    return false;
 
   if (g_name_hash_index == nullptr)
     throw std::runtime_error ("-namehashindex is not enabled");
-  if (!g_name_hash_index->BlockUntilSyncedToCurrentChain ())
-    throw std::runtime_error ("The name-hash index is not caught up yet");
 
   if (byHashType != "sha256d")
     {
@@ -223,20 +221,75 @@ GetNameForLookup (const UniValue& val, const UniValue& opt)
       throw JSONRPCError (RPC_INVALID_PARAMETER, msg.str ());
     }
 
+  return true;
+}
+
+/**
+ * Converts a decoded identifier to the hash for a lookup by hash.
+ */
+uint256
+GetLookupHash (const valtype& identifier)
+{
   if (identifier.size () != 32)
     throw JSONRPCError (RPC_INVALID_PARAMETER,
                         "SHA-256d hash must be 32 bytes long");
 
-  const uint256 hash(identifier);
-  valtype name;
-  if (!g_name_hash_index->FindNamePreimage (hash, name))
+  return uint256 (identifier);
+}
+
+/**
+ * Looks up the preimages of name hashes in the name-hash index.
+ *
+ * Since the index is append-only, a preimage that is found is correct no
+ * matter how far the index is.  Only if some are missing do we need to wait
+ * for the index to catch up with the chain, and then look again for them.
+ */
+std::vector<std::optional<valtype>>
+LookupNamePreimages (const std::vector<uint256>& hashes)
+{
+  std::vector<std::optional<valtype>> names;
+  g_name_hash_index->FindNamePreimages (hashes, names);
+
+  std::vector<uint256> missing;
+  for (size_t i = 0; i < hashes.size (); ++i)
+    if (!names[i])
+      missing.push_back (hashes[i]);
+  if (missing.empty ())
+    return names;
+
+  if (!g_name_hash_index->BlockUntilSyncedToCurrentChain ())
+    throw std::runtime_error ("The name-hash index is not caught up yet");
+
+  std::vector<std::optional<valtype>> found;
+  g_name_hash_index->FindNamePreimages (missing, found);
+  for (size_t i = 0, j = 0; i < hashes.size (); ++i)
+    if (!names[i])
+      names[i] = std::move (found[j++]);
+
+  return names;
+}
+
+/**
+ * Decodes the identifier for a name lookup according to the nameEncoding,
+ * and also looks up the preimage if we look up by hash.
+ */
+valtype
+GetNameForLookup (const UniValue& val, const UniValue& opt)
+{
+  const valtype identifier = DecodeNameFromRPCOrThrow (val, opt);
+  if (!IsLookupByHash (opt))
+    return identifier;
+
+  const uint256 hash = GetLookupHash (identifier);
+  auto name = LookupNamePreimages ({hash}).front ();
+  if (!name)
     {
       std::ostringstream msg;
       msg << "name hash not found: " << hash.GetHex ();
       throw JSONRPCError (RPC_WALLET_ERROR, msg.str ());
     }
 
-  return name;
+  return std::move (*name);
 }
 
 /**
@@ -555,6 +608,125 @@ name_show ()
 
 /* ************************************************************************** */
 
+RPCHelpMan
+name_showmany ()
+{
+  NameOptionsHelp optHelp;
+  optHelp
+      .withNameEncoding ()
+      .withValueEncoding ()
+      .withByHash ()
+      .withArg ("allowExpired", RPCArg::Type::BOOL, "depends on -allowexpired",
+                "Whether to return expired names");
+
+  return RPCHelpMan ("name_showmany",
+      "\nLooks up the current data for many names at once, like name_show."
+      "\nThe names are all looked up at the same chain tip.\n",
+      {
+          {"names", RPCArg::Type::ARR, RPCArg::Optional::NO,
+           strprintf ("The names to query for (at most %u)",
+                      MAX_NAME_SHOW_MANY),
+              {
+                  {"name", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "A name"},
+              }},
+          optHelp.buildRpcArg (),
+      },
+      RPCResult {RPCResult::Type::ARR, "",
+          "The data of each name in the order they were given, or null for"
+          " names that do not exist (or are expired, unless allowExpired)",
+          {
+              NameInfoHelp ()
+                .withExpiration ()
+                .finish ()
+          }
+      },
+      RPCExamples {
+          HelpExampleCli ("name_showmany", R"('["myname", "othername"]')")
+        + HelpExampleRpc ("name_showmany", R"(["myname", "othername"])")
+      },
+      [&] (const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+  RPCTypeCheck (request.params, {UniValue::VARR, UniValue::VOBJ});
+  auto& chainman = EnsureChainman (EnsureAnyNodeContext (request));
+
+  if (chainman.ActiveChainstate ().IsInitialBlockDownload ())
+    throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD,
+                       "Doichain is downloading blocks...");
+
+  UniValue options(UniValue::VOBJ);
+  if (request.params.size () >= 2)
+    options = request.params[1].get_obj ();
+
+  RPCTypeCheckObj(options,
+    {
+      {"allowExpired", UniValueType(UniValue::VBOOL)},
+    },
+    true, false);
+
+  bool allow_expired = gArgs.GetBoolArg("-allowexpired", DEFAULT_ALLOWEXPIRED);
+  if (options.exists("allowExpired"))
+    allow_expired = options["allowExpired"].get_bool();
+
+  const UniValue& identifiers = request.params[0].get_array ();
+  if (identifiers.size () > MAX_NAME_SHOW_MANY)
+    throw JSONRPCError (RPC_INVALID_PARAMETER,
+                        strprintf ("At most %u names can be looked up at once",
+                                   MAX_NAME_SHOW_MANY));
+
+  /* Resolve all hashes with one batch lookup, so that the index is only
+     waited for once and the database is read in key order.  */
+  std::vector<std::optional<valtype>> names;
+  if (IsLookupByHash (options))
+    {
+      std::vector<uint256> hashes;
+      for (const auto& id : identifiers.getValues ())
+        hashes.push_back (GetLookupHash (DecodeNameFromRPCOrThrow (id, options)));
+      names = LookupNamePreimages (hashes);
+    }
+  else
+    for (const auto& id : identifiers.getValues ())
+      names.push_back (DecodeNameFromRPCOrThrow (id, options));
+
+  std::vector<std::optional<CNameData>> data(names.size ());
+  {
+    LOCK (cs_main);
+    const auto& coinsTip = chainman.ActiveChainstate ().CoinsTip ();
+    for (size_t i = 0; i < names.size (); ++i)
+      {
+        CNameData cur;
+        if (names[i] && coinsTip.GetName (*names[i], cur))
+          data[i] = std::move (cur);
+      }
+  }
+
+  MaybeWalletForRequest wallet(request);
+  LOCK2 (wallet.getLock (), cs_main);
+
+  UniValue res(UniValue::VARR);
+  for (size_t i = 0; i < names.size (); ++i)
+    {
+      if (!data[i])
+        {
+          res.push_back (NullUniValue);
+          continue;
+        }
+
+      UniValue name_object
+          = getNameInfo (chainman, options, *names[i], *data[i], wallet);
+      assert (!name_object["expired"].isNull ());
+      if (name_object["expired"].get_bool () && !allow_expired)
+        res.push_back (NullUniValue);
+      else
+        res.push_back (std::move (name_object));
+    }
+
+  return res;
+}
+  );
+}
+
+/* ************************************************************************** */
+
 RPCHelpMan
 name_history ()
 {
@@ -586,7 +758,7 @@ name_history ()
   RPCTypeCheck (request.params, {UniValue::VSTR, UniValue::VOBJ});
   auto& chainman = EnsureChainman (EnsureAnyNodeContext (request));
 
-  if (!fNameHistory)
+  if (!g_name_history_index)
     throw std::runtime_error ("-namehistory is not enabled");
 
   if (chainman.ActiveChainstate ().IsInitialBlockDownload ())
@@ -599,9 +771,11 @@ name_history ()
 
   const valtype name = GetNameForLookup (request.params[0], options);
 
-  CNameData data;
-  CNameHistory history;
+  if (!g_name_history_index->BlockUntilSyncedToCurrentChain ())
+    throw JSONRPCError (RPC_MISC_ERROR,
+                        "the name history is still being indexed");
 
+  CNameData data;
   {
     LOCK (cs_main);
 
@@ -612,17 +786,24 @@ name_history ()
         msg << "name not found: " << EncodeNameForMessage (name);
         throw JSONRPCError (RPC_WALLET_ERROR, msg.str ());
       }
-
-    if (!coinsTip.GetNameHistory (name, history))
-      assert (history.empty ());
   }
 
+  std::vector<CNameData> history;
+  if (!g_name_history_index->FindNameHistory (name, history))
+    throw JSONRPCError (RPC_DATABASE_ERROR, "failed to read the name history");
+
   MaybeWalletForRequest wallet(request);
   LOCK2 (wallet.getLock (), cs_main);
 
+  /* The index ends with the current data, unless a block has been connected
+     in the meantime.  Either way, stop there.  */
   UniValue res(UniValue::VARR);
-  for (const auto& entry : history.getData ())
-    res.push_back (getNameInfo (chainman, options, name, entry, wallet));
+  for (const auto& entry : history)
+    {
+      if (entry.getUpdateOutpoint () == data.getUpdateOutpoint ())
+        break;
+      res.push_back (getNameInfo (chainman, options, name, entry, wallet));
+    }
   res.push_back (getNameInfo (chainman, options, name, data, wallet));
 
   return res;
@@ -817,25 +998,38 @@ name_pending ()
 
   MaybeWalletForRequest wallet(request);
   auto& mempool = EnsureMemPool (EnsureAnyNodeContext (request));
-  LOCK2 (wallet.getLock (), mempool.cs);
 
   UniValue options(UniValue::VOBJ);
   if (request.params.size () >= 2)
     options = request.params[1].get_obj ();
 
-  std::vector<uint256> txHashes;
-  mempool.queryHashes (txHashes);
-
   const bool hasNameFilter = !request.params[0].isNull ();
   valtype nameFilter;
   if (hasNameFilter)
     nameFilter = DecodeNameFromRPCOrThrow (request.params[0], options);
 
+  /* Work on a snapshot, so that the mempool is not locked while the
+     result is built.  With a name filter, its name index gives the
+     transactions to look at directly.  */
+  const auto snapshot = mempool.GetSnapshot ();
+  std::vector<CTransactionRef> txns;
+  if (hasNameFilter)
+    {
+      const auto mit = snapshot->names.find (nameFilter);
+      if (mit != snapshot->names.end ())
+        for (const size_t pos : mit->second)
+          txns.push_back (snapshot->entries[pos].tx);
+    }
+  else
+    for (const auto& entry : snapshot->entries)
+      txns.push_back (entry.tx);
+
+  LOCK (wallet.getLock ());
+
   UniValue arr(UniValue::VARR);
-  for (const auto& txHash : txHashes)
+  for (const auto& tx : txns)
     {
-      std::shared_ptr<const CTransaction> tx = mempool.get (txHash);
-      if (!tx || !tx->IsDoichain ())
+      if (!tx->IsDoichain ())
         continue;
 
       for (size_t n = 0; n < tx->vout.size (); ++n)
@@ -1146,6 +1340,7 @@ static const CRPCCommand commands[] =
 { //  category               actor (function)
   //  ---------------------  -----------------------
     { "names",               &name_show,               },
+    { "names",               &name_showmany,           },
     { "names",               &name_history,            },
     { "names",               &name_scan,               },
     { "names",               &name_pending,            },
@@ -17,6 +17,9 @@
 /** Default value for the -allowexpired argument.  */
 static constexpr bool DEFAULT_ALLOWEXPIRED = false;
 
+/** Maximum number of names that can be looked up with name_showmany.  */
+static constexpr unsigned MAX_NAME_SHOW_MANY = 1000;
+
 class ChainstateManager;
 class CNameData;
 class COutPoint;
@@ -14,6 +14,7 @@
 #include <net_types.h> // For banmap_t
 #include <netbase.h>
 #include <node/context.h>
+#include <node/txprevalidation.h>
 #include <policy/settings.h>
 #include <rpc/blockchain.h>
 #include <rpc/protocol.h>
@@ -135,9 +136,29 @@ static RPCHelpMan getpeerinfo()
                     {
                         {RPCResult::Type::NUM, "n", "The heights of blocks we're currently asking from this peer"},
                     }},
+                    {RPCResult::Type::OBJ, "blockdownload", /*optional=*/true, "How fast this peer delivers the blocks we request",
+                    {
+                        {RPCResult::Type::NUM, "window", "The number of blocks we allow in flight from this peer"},
+                        {RPCResult::Type::NUM, "bytes_per_sec", "The smoothed download rate, in bytes per second"},
+                        {RPCResult::Type::NUM, "latency", "The smoothed time between requesting a block from this peer while it was idle and receiving it, in seconds"},
+                        {RPCResult::Type::NUM, "blocks_received", "The number of requested blocks received from this peer"},
+                        {RPCResult::Type::NUM, "blocks_rerequested", "The number of blocks requested from another peer because this one was too slow to deliver them"},
+                    }},
                     {RPCResult::Type::BOOL, "addr_relay_enabled", /*optional=*/true, "Whether we participate in address relay with this peer"},
                     {RPCResult::Type::NUM, "addr_processed", /*optional=*/true, "The total number of addresses processed, excluding those dropped due to rate limiting"},
                     {RPCResult::Type::NUM, "addr_rate_limited", /*optional=*/true, "The total number of addresses dropped due to rate limiting"},
+                    {RPCResult::Type::OBJ, "txreconciliation", /*optional=*/true, "Transaction reconciliation (BIP 330) with this peer, if negotiated",
+                    {
+                        {RPCResult::Type::BOOL, "initiator", "Whether we start the reconciliation rounds"},
+                        {RPCResult::Type::NUM, "set_size", "Transactions waiting for the next round"},
+                        {RPCResult::Type::NUM, "rounds", "The number of reconciliation rounds"},
+                        {RPCResult::Type::NUM, "failed_rounds", "Rounds after which the whole set was announced, because the difference could not be decoded"},
+                        {RPCResult::Type::NUM, "txs_announced", "Transactions announced to the peer as the result of a round"},
+                        {RPCResult::Type::NUM, "txs_requested", "Transactions asked from the peer as the result of a round"},
+                        {RPCResult::Type::NUM, "set_overflows", "Transactions announced by INV because the set was full"},
+                        {RPCResult::Type::NUM, "sketch_bytes_sent", "The total size of the sketches sent"},
+                        {RPCResult::Type::NUM, "sketch_bytes_recv", "The total size of the sketches received"},
+                    }},
                     {RPCResult::Type::ARR, "permissions", "Any special permissions that have been granted to this peer",
                     {
                         {RPCResult::Type::STR, "permission_type", Join(NET_PERMISSIONS_DOC, ",\n") + ".\n"},
@@ -230,9 +251,31 @@ static RPCHelpMan getpeerinfo()
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            const BlockDownloadStats& download{statestats.m_block_download};
+            UniValue blockdownload(UniValue::VOBJ);
+            blockdownload.pushKV("window", download.window);
+            blockdownload.pushKV("bytes_per_sec", download.bytes_per_sec);
+            blockdownload.pushKV("latency", CountSecondsDouble(download.latency));
+            blockdownload.pushKV("blocks_received", download.blocks_received);
+            blockdownload.pushKV("blocks_rerequested", download.blocks_rerequested);
+            obj.pushKV("blockdownload", blockdownload);
             obj.pushKV("addr_relay_enabled", statestats.m_addr_relay_enabled);
             obj.pushKV("addr_processed", statestats.m_addr_processed);
             obj.pushKV("addr_rate_limited", statestats.m_addr_rate_limited);
+            if (statestats.m_txrecon) {
+                const TxReconciliationStats& recon{*statestats.m_txrecon};
+                UniValue txrecon(UniValue::VOBJ);
+                txrecon.pushKV("initiator", recon.we_initiate);
+                txrecon.pushKV("set_size", (uint64_t)recon.set_size);
+                txrecon.pushKV("rounds", recon.rounds);
+                txrecon.pushKV("failed_rounds", recon.failed_rounds);
+                txrecon.pushKV("txs_announced", recon.txs_announced);
+                txrecon.pushKV("txs_requested", recon.txs_requested);
+                txrecon.pushKV("set_overflows", recon.set_overflows);
+                txrecon.pushKV("sketch_bytes_sent", recon.sketch_bytes_sent);
+                txrecon.pushKV("sketch_bytes_recv", recon.sketch_bytes_recv);
+                obj.pushKV("txreconciliation", txrecon);
+            }
         }
         UniValue permissions(UniValue::VARR);
         for (const auto& permission : NetPermissions::ToStrings(stats.m_permissionFlags)) {
@@ -609,6 +652,37 @@ static RPCHelpMan getnetworkinfo()
                                 {RPCResult::Type::NUM, "score", "relative score"},
                             }},
                         }},
+                        {RPCResult::Type::OBJ, "blockservecache", /*optional=*/true, "The cache of serialized blocks served to peers, if enabled with -blockservecachesize",
+                        {
+                            {RPCResult::Type::NUM, "entries", "The number of cached block messages"},
+                            {RPCResult::Type::NUM, "usage", "The total size of the cached block messages, in bytes"},
+                            {RPCResult::Type::NUM, "max_usage", "The maximum size of the cache, in bytes"},
+                            {RPCResult::Type::NUM, "hits", "Block requests served from the cache"},
+                            {RPCResult::Type::NUM, "misses", "Block requests for which the block had to be read from disk or serialized"},
+                        }},
+                        {RPCResult::Type::OBJ, "txprevalidation", /*optional=*/true, "Pre-validation of transactions from peers, if enabled with -txprevalidationthreads",
+                        {
+                            {RPCResult::Type::NUM, "threads", "The number of pre-validation threads"},
+                            {RPCResult::Type::NUM, "pending", "Transactions waiting for or being pre-validated"},
+                            {RPCResult::Type::NUM, "scripts_ok", "Transactions whose scripts passed pre-validation"},
+                            {RPCResult::Type::ARR, "bucket_bounds_us", "Inclusive upper bounds of the histogram buckets but the last, in microseconds",
+                            {
+                                {RPCResult::Type::NUM, "", ""},
+                            }},
+                            {RPCResult::Type::OBJ_DYN, "stages", "Latency of each stage, over all transactions since startup",
+                            {
+                                {RPCResult::Type::OBJ, "stage", "queue, deserialize, check, snapshot, scripts or accept",
+                                {
+                                    {RPCResult::Type::NUM, "count", "The number of transactions that went through this stage"},
+                                    {RPCResult::Type::NUM, "total_us", "The total time spent in this stage, in microseconds"},
+                                    {RPCResult::Type::NUM, "max_us", "The longest time spent in this stage, in microseconds"},
+                                    {RPCResult::Type::ARR, "histogram", "The number of transactions per bucket",
+                                    {
+                                        {RPCResult::Type::NUM, "", ""},
+                                    }},
+                                }},
+                            }},
+                        }},
                         {RPCResult::Type::STR, "warnings", "any network and blockchain warnings"},
                     }
                 },
@@ -655,6 +729,38 @@ static RPCHelpMan getnetworkinfo()
         }
     }
     obj.pushKV("localaddresses", localAddresses);
+    if (const auto cache_stats{node.peerman ? node.peerman->GetBlockServeCacheStats() : std::nullopt}) {
+        UniValue cache(UniValue::VOBJ);
+        cache.pushKV("entries", (uint64_t)cache_stats->entries);
+        cache.pushKV("usage", (uint64_t)cache_stats->usage);
+        cache.pushKV("max_usage", (uint64_t)cache_stats->max_usage);
+        cache.pushKV("hits", cache_stats->hits);
+        cache.pushKV("misses", cache_stats->misses);
+        obj.pushKV("blockservecache", cache);
+    }
+    if (const auto prevalidation_stats{node.peerman ? node.peerman->GetTxPreValidationStats() : std::nullopt}) {
+        UniValue prevalidation(UniValue::VOBJ);
+        prevalidation.pushKV("threads", prevalidation_stats->threads);
+        prevalidation.pushKV("pending", (uint64_t)prevalidation_stats->pending);
+        prevalidation.pushKV("scripts_ok", prevalidation_stats->scripts_ok);
+        UniValue bounds(UniValue::VARR);
+        for (const int64_t bound : LatencyHistogram::BUCKET_BOUNDS_US) bounds.push_back(bound);
+        prevalidation.pushKV("bucket_bounds_us", bounds);
+        UniValue stages(UniValue::VOBJ);
+        for (size_t i = 0; i < TXPREVALIDATION_STAGES; ++i) {
+            const LatencyHistogram& histogram{prevalidation_stats->stages[i]};
+            UniValue stage(UniValue::VOBJ);
+            stage.pushKV("count", histogram.m_count);
+            stage.pushKV("total_us", count_microseconds(histogram.m_total));
+            stage.pushKV("max_us", count_microseconds(histogram.m_max));
+            UniValue counts(UniValue::VARR);
+            for (const uint64_t count : histogram.m_counts) counts.push_back(count);
+            stage.pushKV("histogram", counts);
+            stages.pushKV(TxPreValidationStageName(static_cast<TxPreValidationStage>(i)), stage);
+        }
+        prevalidation.pushKV("stages", stages);
+        obj.pushKV("txprevalidation", prevalidation);
+    }
     obj.pushKV("warnings",       GetWarnings(false).original);
     return obj;
 },
@@ -211,6 +211,12 @@ public:
           nType{nTypeIn},
           nVersion{nVersionIn} {}
 
+    //! Take over the given buffer, e.g. one allocated ahead of time.
+    explicit CDataStream(vector_type&& vch_in, int nTypeIn, int nVersionIn)
+        : vch(std::move(vch_in)),
+          nType{nTypeIn},
+          nVersion{nVersionIn} {}
+
     template <typename... Args>
     CDataStream(int nTypeIn, int nVersionIn, Args&&... args)
         : nType{nTypeIn},
@@ -239,6 +245,8 @@ public:
     const_reference operator[](size_type pos) const  { return vch[pos + nReadPos]; }
     reference operator[](size_type pos)              { return vch[pos + nReadPos]; }
     void clear()                                     { vch.clear(); nReadPos = 0; }
+    //! Give up the underlying buffer, e.g. to reuse its allocation, leaving the stream empty.
+    vector_type TakeBuffer()                         { nReadPos = 0; return std::exchange(vch, {}); }
     iterator insert(iterator it, const value_type x) { return vch.insert(it, x); }
     void insert(iterator it, size_type n, const value_type x) { vch.insert(it, n, x); }
     value_type* data()                               { return vch.data() + nReadPos; }
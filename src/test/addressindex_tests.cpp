@@ -0,0 +1,110 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/addressindex.h>
+#include <script/names.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(addressindex_initial_sync, TestChain100Setup)
+{
+    AddressIndex address_index(1 << 20, true);
+    BOOST_REQUIRE(address_index.Start(m_node.chainman->ActiveChainstate()));
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!address_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    // Every block of the test chain pays its coinbase to the same script.
+    const CScript coinbase_script = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    std::vector<AddressIndexEntry> entries;
+    BOOST_REQUIRE(address_index.FindScriptHistory(coinbase_script, 0, 1000, 1000, entries));
+    BOOST_REQUIRE_EQUAL(entries.size(), m_coinbase_txns.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        BOOST_CHECK_EQUAL(entries[i].height, int(i) + 1);
+        BOOST_CHECK_EQUAL(entries[i].txid, m_coinbase_txns[i]->GetHash());
+        BOOST_CHECK(!entries[i].spending);
+        BOOST_CHECK_EQUAL(entries[i].index, 0U);
+        BOOST_CHECK_EQUAL(entries[i].amount, m_coinbase_txns[i]->vout[0].nValue);
+        BOOST_CHECK(entries[i].name.empty());
+    }
+
+    // Height ranges and limits.
+    entries.clear();
+    BOOST_REQUIRE(address_index.FindScriptHistory(coinbase_script, 10, 19, 1000, entries));
+    BOOST_REQUIRE_EQUAL(entries.size(), 10U);
+    BOOST_CHECK_EQUAL(entries.front().height, 10);
+    BOOST_CHECK_EQUAL(entries.back().height, 19);
+    entries.clear();
+    BOOST_REQUIRE(address_index.FindScriptHistory(coinbase_script, 0, 1000, 5, entries));
+    BOOST_CHECK_EQUAL(entries.size(), 5U);
+    entries.clear();
+    BOOST_CHECK(!address_index.FindScriptHistory(coinbase_script, 0, 1000, 0, entries));
+    BOOST_CHECK(entries.empty());
+
+    // Spend the first coinbase in a new block.
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript dest = GetScriptForDestination(PKHash(key.GetPubKey()));
+    const CMutableTransaction spend{CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 1, coinbaseKey, dest, 1 * COIN, /*submit=*/false)};
+    CreateAndProcessBlock({spend}, coinbase_script);
+    BOOST_CHECK(address_index.BlockUntilSyncedToCurrentChain());
+
+    entries.clear();
+    BOOST_REQUIRE(address_index.FindScriptHistory(coinbase_script, 101, 101, 1000, entries));
+    BOOST_REQUIRE_EQUAL(entries.size(), 2U);
+    const auto spent{std::find_if(entries.begin(), entries.end(), [](const auto& entry) { return entry.spending; })};
+    BOOST_REQUIRE(spent != entries.end());
+    BOOST_CHECK_EQUAL(spent->txid, spend.GetHash());
+    BOOST_CHECK_EQUAL(spent->index, 0U);
+    BOOST_CHECK(spent->prevout == COutPoint(m_coinbase_txns[0]->GetHash(), 0));
+    BOOST_CHECK_EQUAL(spent->amount, m_coinbase_txns[0]->vout[0].nValue);
+
+    entries.clear();
+    BOOST_REQUIRE(address_index.FindScriptHistory(dest, 0, 1000, 1000, entries));
+    BOOST_REQUIRE_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].amount, 1 * COIN);
+
+    // Name operations are indexed under the address holding the name.
+    const valtype name{'d', '/', 'x'};
+    const valtype value{'v'};
+    BOOST_CHECK_EQUAL(AddressIndex::GetScriptHash(CNameScript::buildNameUpdate(dest, name, value)),
+                      AddressIndex::GetScriptHash(dest));
+
+    // Replacing the block rewinds its entries.
+    {
+        BlockValidationState state;
+        CBlockIndex* tip{WITH_LOCK(::cs_main, return m_node.chainman->ActiveChain().Tip())};
+        BOOST_REQUIRE(m_node.chainman->ActiveChainstate().InvalidateBlock(state, tip));
+    }
+    CreateAndProcessBlock({}, coinbase_script);
+    BOOST_CHECK(address_index.BlockUntilSyncedToCurrentChain());
+    entries.clear();
+    BOOST_REQUIRE(address_index.FindScriptHistory(dest, 0, 1000, 1000, entries));
+    BOOST_CHECK(entries.empty());
+    entries.clear();
+    BOOST_REQUIRE(address_index.FindScriptHistory(coinbase_script, 101, 101, 1000, entries));
+    BOOST_REQUIRE_EQUAL(entries.size(), 1U);
+    BOOST_CHECK(!entries[0].spending);
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    address_index.Stop();
+
+    // Let scheduler events finish running to avoid accessing any memory related to the index after it is destructed
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -369,6 +369,28 @@ BOOST_AUTO_TEST_CASE(addrman_delete)
     BOOST_CHECK(info2 == nullptr);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_id_reuse)
+{
+    AddrManTest addrman;
+
+    CAddress addr1 = CAddress(ResolveService("250.1.2.1", 8333), NODE_NONE);
+    CAddress addr2 = CAddress(ResolveService("250.1.2.2", 8333), NODE_NONE);
+    CNetAddr source = ResolveIP("250.1.2.1");
+
+    int nId1;
+    addrman.Create(addr1, source, &nId1);
+    const size_t usage{addrman.DynamicMemoryUsage()};
+    addrman.Delete(nId1);
+
+    // Test: The slot of a deleted entry is used for the next one.
+    int nId2;
+    addrman.Create(addr2, source, &nId2);
+    BOOST_CHECK_EQUAL(nId2, nId1);
+    BOOST_CHECK(addrman.Find(addr1) == nullptr);
+    BOOST_CHECK_EQUAL(addrman.Find(addr2)->ToString(), "250.1.2.2:8333");
+    BOOST_CHECK_EQUAL(addrman.DynamicMemoryUsage(), usage);
+}
+
 BOOST_AUTO_TEST_CASE(addrman_getaddr)
 {
     AddrManTest addrman;
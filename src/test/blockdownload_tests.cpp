@@ -0,0 +1,67 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockdownload.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std::chrono_literals;
+
+BOOST_FIXTURE_TEST_SUITE(blockdownload_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(no_estimate)
+{
+    const BlockDownloadRate rate;
+    BOOST_CHECK(!rate.HasEstimate());
+    BOOST_CHECK_EQUAL(rate.Window(), DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER);
+    BOOST_CHECK(rate.ExpectedDelivery(0) == std::chrono::microseconds::max());
+}
+
+BOOST_AUTO_TEST_CASE(window_follows_speed)
+{
+    // A peer that answers after 100ms and then sends a 1 MB block every 50ms
+    // should be kept busy for 1.1s: 22 blocks.
+    BlockDownloadRate fast;
+    fast.BlockReceived(/*requested=*/1s, /*now=*/1100ms, 1'000'000);
+    for (int i = 1; i < 30; ++i) {
+        fast.BlockReceived(/*requested=*/1s, /*now=*/1100ms + i * 50ms, 1'000'000);
+    }
+    BOOST_CHECK(fast.HasEstimate());
+    BOOST_CHECK_EQUAL(fast.Window(), 22);
+    BlockDownloadStats stats{fast.GetStats()};
+    BOOST_CHECK_EQUAL(stats.window, 22);
+    BOOST_CHECK(stats.latency == 100ms);
+    BOOST_CHECK_EQUAL(stats.blocks_received, 30U);
+    BOOST_CHECK(stats.bytes_per_sec > 19'000'000 && stats.bytes_per_sec < 21'000'000);
+    BOOST_CHECK(fast.ExpectedDelivery(0) < fast.ExpectedDelivery(10));
+
+    // A peer taking 3 seconds per block gets the minimum.
+    BlockDownloadRate slow;
+    slow.BlockReceived(/*requested=*/1s, /*now=*/4s, 1'000'000);
+    slow.BlockReceived(/*requested=*/1s, /*now=*/7s, 1'000'000);
+    BOOST_CHECK_EQUAL(slow.Window(), MIN_BLOCKS_IN_TRANSIT_PER_PEER);
+
+    // Tiny blocks arriving back to back are capped at the maximum.
+    BlockDownloadRate tiny;
+    for (int i = 1; i <= 10; ++i) {
+        tiny.BlockReceived(/*requested=*/0s, /*now=*/i * 1ms, 300);
+    }
+    BOOST_CHECK_EQUAL(tiny.Window(), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+}
+
+BOOST_AUTO_TEST_CASE(rerequested_blocks_shrink_window)
+{
+    BlockDownloadRate rate;
+    rate.BlockReceived(/*requested=*/0s, /*now=*/100ms, 1'000'000);
+    rate.BlockReceived(/*requested=*/0s, /*now=*/200ms, 1'000'000);
+    const int window{rate.Window()};
+    for (int i = 0; i < 5; ++i) rate.BlockRerequested(5s);
+    BOOST_CHECK_LT(rate.Window(), window);
+    BOOST_CHECK_EQUAL(rate.GetStats().blocks_rerequested, 5U);
+    BOOST_CHECK_EQUAL(rate.GetStats().blocks_received, 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -303,4 +303,38 @@ BOOST_FIXTURE_TEST_CASE(blockfilter_index_init_destroy, BasicTestingSetup)
     BOOST_CHECK(filter_index == nullptr);
 }
 
+BOOST_FIXTURE_TEST_CASE(blockfilter_index_parallel_sync, TestChain100Setup)
+{
+    BlockFilterIndex filter_index(BlockFilterType::BASIC, 1 << 20, true);
+
+    // Blocks are prepared by several threads, but must be written in order
+    // for the filter headers to chain up.
+    BOOST_REQUIRE(filter_index.Start(m_node.chainman->ActiveChainstate(), /*sync_worker_threads=*/3));
+
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!filter_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    {
+        LOCK(cs_main);
+        uint256 last_header;
+        for (const CBlockIndex* block_index = m_node.chainman->ActiveChain().Genesis();
+             block_index != nullptr;
+             block_index = m_node.chainman->ActiveChain().Next(block_index)) {
+            CheckFilterLookups(filter_index, block_index, last_header);
+        }
+    }
+
+    const IndexSummary summary{filter_index.GetSummary()};
+    BOOST_CHECK(summary.synced);
+    BOOST_CHECK_EQUAL(summary.best_block_height, 100);
+    BOOST_CHECK_GT(summary.blocks_per_second, 0);
+
+    filter_index.Stop();
+    SyncWithValidationInterfaceQueue();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,72 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <auxpow.h>
+#include <node/blockstorage.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <version.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockmanager_tests, BasicTestingSetup)
+
+static CMutableTransaction MakeTx(int n_in, bool with_witness)
+{
+    CMutableTransaction mtx;
+    for (int i = 0; i < n_in; ++i) {
+        CTxIn txin{COutPoint{InsecureRand256(), uint32_t(i)}, CScript() << i << OP_TRUE};
+        if (with_witness) txin.scriptWitness.stack = {{1, 2, 3}, {}, std::vector<unsigned char>(300, 4)};
+        mtx.vin.push_back(txin);
+    }
+    mtx.vout.emplace_back(5 * COIN, CScript() << OP_TRUE);
+    mtx.vout.emplace_back(0, CScript() << OP_RETURN << std::vector<unsigned char>(80, 5));
+    mtx.nLockTime = 42;
+    return mtx;
+}
+
+static std::vector<uint8_t> SerializeBlock(const CBlock& block, int flags)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION | flags);
+    stream << block;
+    return {stream.begin(), stream.end()};
+}
+
+BOOST_AUTO_TEST_CASE(strip_raw_block_witness)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.vtx.push_back(MakeTransactionRef(MakeTx(1, /*with_witness=*/true)));
+    for (int i = 0; i < 20; ++i) {
+        block.vtx.push_back(MakeTransactionRef(MakeTx(1 + i % 3, /*with_witness=*/i % 2)));
+    }
+
+    for (const bool auxpow : {false, true}) {
+        if (auxpow) {
+            // The parent chain's coinbase can have witness data too.
+            block.SetAuxpow(std::make_unique<CAuxPow>(MakeTransactionRef(MakeTx(1, /*with_witness=*/true))));
+        }
+        const std::vector<uint8_t> raw{SerializeBlock(block, 0)};
+        const std::vector<uint8_t> expected{SerializeBlock(block, SERIALIZE_TRANSACTION_NO_WITNESS)};
+        BOOST_CHECK_LT(expected.size(), raw.size());
+
+        std::vector<uint8_t> stripped;
+        BOOST_REQUIRE(StripRawBlockWitness(raw, stripped));
+        BOOST_CHECK(stripped == expected);
+        // Blocks without witness data are copied as they are.
+        std::vector<uint8_t> stripped_again;
+        BOOST_REQUIRE(StripRawBlockWitness(stripped, stripped_again));
+        BOOST_CHECK(stripped_again == expected);
+
+        // Anything that doesn't deserialize as a block is rejected.
+        BOOST_CHECK(!StripRawBlockWitness(Span{raw}.first(raw.size() - 1), stripped));
+        std::vector<uint8_t> trailing{raw};
+        trailing.push_back(0);
+        BOOST_CHECK(!StripRawBlockWitness(trailing, stripped));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockservecache.h>
+
+#include <hash.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockservecache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(lookup_and_stats)
+{
+    BlockServeCache cache{1000};
+    const uint256 hash{InsecureRand256()};
+    BOOST_CHECK(!cache.Get(hash, BlockServeFormat::BLOCK_WITNESS));
+
+    const std::vector<unsigned char> data(100, 0x42);
+    const auto payload{cache.Insert(hash, BlockServeFormat::BLOCK_WITNESS, std::vector<unsigned char>{data})};
+    BOOST_CHECK(payload->data == data);
+    BOOST_CHECK_EQUAL(payload->hash, Hash(data));
+
+    // The payload is shared, not copied.
+    BOOST_CHECK_EQUAL(cache.Get(hash, BlockServeFormat::BLOCK_WITNESS), payload);
+    // Other formats of the same block are separate entries.
+    BOOST_CHECK(!cache.Get(hash, BlockServeFormat::BLOCK));
+    BOOST_CHECK(!cache.Get(hash, BlockServeFormat::CMPCTBLOCK_WITNESS));
+
+    // Inserting an entry again keeps the one already shared.
+    BOOST_CHECK_EQUAL(cache.Insert(hash, BlockServeFormat::BLOCK_WITNESS, std::vector<unsigned char>(100, 0x43)), payload);
+
+    const BlockServeCacheStats stats{cache.GetStats()};
+    BOOST_CHECK_EQUAL(stats.hits, 1U);
+    BOOST_CHECK_EQUAL(stats.misses, 3U);
+    BOOST_CHECK_EQUAL(stats.entries, 1U);
+    BOOST_CHECK_EQUAL(stats.usage, 100U);
+    BOOST_CHECK_EQUAL(stats.max_usage, 1000U);
+
+    BOOST_CHECK_EQUAL(BlockServeMsgType(BlockServeFormat::BLOCK), NetMsgType::BLOCK);
+    BOOST_CHECK_EQUAL(BlockServeMsgType(BlockServeFormat::CMPCTBLOCK_WITNESS), NetMsgType::CMPCTBLOCK);
+}
+
+BOOST_AUTO_TEST_CASE(eviction)
+{
+    BlockServeCache cache{1000};
+    std::vector<uint256> hashes;
+    for (int i = 0; i < 4; ++i) {
+        hashes.push_back(InsecureRand256());
+        cache.Insert(hashes.back(), BlockServeFormat::BLOCK, std::vector<unsigned char>(300));
+    }
+    // The first block made room for the fourth.
+    BOOST_CHECK(!cache.Get(hashes[0], BlockServeFormat::BLOCK));
+    BOOST_CHECK_EQUAL(cache.GetStats().usage, 900U);
+
+    // Looking up the second block makes the third the least recently used.
+    BOOST_CHECK(cache.Get(hashes[1], BlockServeFormat::BLOCK));
+    cache.Insert(InsecureRand256(), BlockServeFormat::BLOCK, std::vector<unsigned char>(300));
+    BOOST_CHECK(cache.Get(hashes[1], BlockServeFormat::BLOCK));
+    BOOST_CHECK(!cache.Get(hashes[2], BlockServeFormat::BLOCK));
+    BOOST_CHECK(cache.Get(hashes[3], BlockServeFormat::BLOCK));
+
+    // Blocks larger than the cache are not kept, and don't evict anything.
+    const auto large{cache.Insert(InsecureRand256(), BlockServeFormat::BLOCK, std::vector<unsigned char>(1001))};
+    BOOST_CHECK_EQUAL(large->data.size(), 1001U);
+    BOOST_CHECK_EQUAL(cache.GetStats().entries, 3U);
+    BOOST_CHECK_EQUAL(cache.GetStats().usage, 900U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -148,21 +148,27 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+typedef CWorkStealingCheckQueue<FakeCheckCheckCompletion> Correct_StealingQueue;
+typedef CWorkStealingCheckQueue<FailingCheck> Failing_StealingQueue;
+typedef CWorkStealingCheckQueue<UniqueCheck> Unique_StealingQueue;
+typedef CWorkStealingCheckQueue<MemoryCheck> Memory_StealingQueue;
+typedef CWorkStealingCheckQueue<FrozenCleanupCheck> FrozenCleanup_StealingQueue;
 
 
 /** This test case checks that the CCheckQueue works properly
  * with each specified size_t Checks pushed.
  */
-static void Correct_Queue_range(std::vector<size_t> range)
+template <typename Queue = Correct_Queue>
+static void Correct_Queue_range(std::vector<size_t> range, int threads_num = SCRIPT_CHECK_THREADS)
 {
-    auto small_queue = std::make_unique<Correct_Queue>(QUEUE_BATCH_SIZE);
-    small_queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
+    auto small_queue = std::make_unique<Queue>(QUEUE_BATCH_SIZE);
+    small_queue->StartWorkerThreads(threads_num);
     // Make vChecks here to save on malloc (this test can be slow...)
     std::vector<FakeCheckCheckCompletion> vChecks;
     for (const size_t i : range) {
         size_t total = i;
         FakeCheckCheckCompletion::n_calls = 0;
-        CCheckQueueControl<FakeCheckCheckCompletion> control(small_queue.get());
+        CCheckQueueControl<FakeCheckCheckCompletion, Queue> control(small_queue.get());
         while (total) {
             vChecks.resize(std::min(total, (size_t) InsecureRandRange(10)));
             total -= vChecks.size();
@@ -213,13 +219,14 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random)
 
 
 /** Test that failing checks are caught */
-BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure)
+template <typename Queue>
+static void Failing_Queue_range()
 {
-    auto fail_queue = std::make_unique<Failing_Queue>(QUEUE_BATCH_SIZE);
+    auto fail_queue = std::make_unique<Queue>(QUEUE_BATCH_SIZE);
     fail_queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
 
     for (size_t i = 0; i < 1001; ++i) {
-        CCheckQueueControl<FailingCheck> control(fail_queue.get());
+        CCheckQueueControl<FailingCheck, Queue> control(fail_queue.get());
         size_t remaining = i;
         while (remaining) {
             size_t r = InsecureRandRange(10);
@@ -239,16 +246,21 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure)
     }
     fail_queue->StopWorkerThreads();
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure)
+{
+    Failing_Queue_range<Failing_Queue>();
+}
 // Test that a block validation which fails does not interfere with
 // future blocks, ie, the bad state is cleared.
-BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure)
+template <typename Queue>
+static void Failing_Queue_recovery()
 {
-    auto fail_queue = std::make_unique<Failing_Queue>(QUEUE_BATCH_SIZE);
+    auto fail_queue = std::make_unique<Queue>(QUEUE_BATCH_SIZE);
     fail_queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
 
     for (auto times = 0; times < 10; ++times) {
         for (const bool end_fails : {true, false}) {
-            CCheckQueueControl<FailingCheck> control(fail_queue.get());
+            CCheckQueueControl<FailingCheck, Queue> control(fail_queue.get());
             {
                 std::vector<FailingCheck> vChecks;
                 vChecks.resize(100, false);
@@ -261,19 +273,28 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure)
     }
     fail_queue->StopWorkerThreads();
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure)
+{
+    Failing_Queue_recovery<Failing_Queue>();
+}
 
 // Test that unique checks are actually all called individually, rather than
 // just one check being called repeatedly. Test that checks are not called
 // more than once as well
-BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck)
+template <typename Queue>
+static void Unique_Queue_checks()
 {
-    auto queue = std::make_unique<Unique_Queue>(QUEUE_BATCH_SIZE);
+    auto queue = std::make_unique<Queue>(QUEUE_BATCH_SIZE);
     queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
 
     size_t COUNT = 100000;
     size_t total = COUNT;
     {
-        CCheckQueueControl<UniqueCheck> control(queue.get());
+        LOCK(UniqueCheck::m);
+        UniqueCheck::results.clear();
+    }
+    {
+        CCheckQueueControl<UniqueCheck, Queue> control(queue.get());
         while (total) {
             size_t r = InsecureRandRange(10);
             std::vector<UniqueCheck> vChecks;
@@ -293,6 +314,10 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck)
     }
     queue->StopWorkerThreads();
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck)
+{
+    Unique_Queue_checks<Unique_Queue>();
+}
 
 
 // Test that blocks which might allocate lots of memory free their memory aggressively.
@@ -300,14 +325,15 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck)
 // This test attempts to catch a pathological case where by lazily freeing
 // checks might mean leaving a check un-swapped out, and decreasing by 1 each
 // time could leave the data hanging across a sequence of blocks.
-BOOST_AUTO_TEST_CASE(test_CheckQueue_Memory)
+template <typename Queue>
+static void Memory_Queue_checks()
 {
-    auto queue = std::make_unique<Memory_Queue>(QUEUE_BATCH_SIZE);
+    auto queue = std::make_unique<Queue>(QUEUE_BATCH_SIZE);
     queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
     for (size_t i = 0; i < 1000; ++i) {
         size_t total = i;
         {
-            CCheckQueueControl<MemoryCheck> control(queue.get());
+            CCheckQueueControl<MemoryCheck, Queue> control(queue.get());
             while (total) {
                 size_t r = InsecureRandRange(10);
                 std::vector<MemoryCheck> vChecks;
@@ -324,16 +350,21 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Memory)
     }
     queue->StopWorkerThreads();
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Memory)
+{
+    Memory_Queue_checks<Memory_Queue>();
+}
 
 // Test that a new verification cannot occur until all checks
 // have been destructed
-BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup)
+template <typename Queue>
+static void FrozenCleanup_Queue_checks()
 {
-    auto queue = std::make_unique<FrozenCleanup_Queue>(QUEUE_BATCH_SIZE);
+    auto queue = std::make_unique<Queue>(QUEUE_BATCH_SIZE);
     bool fails = false;
     queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
     std::thread t0([&]() {
-        CCheckQueueControl<FrozenCleanupCheck> control(queue.get());
+        CCheckQueueControl<FrozenCleanupCheck, Queue> control(queue.get());
         std::vector<FrozenCleanupCheck> vChecks(1);
         // Freezing can't be the default initialized behavior given how the queue
         // swaps in default initialized Checks (otherwise freezing destructor
@@ -364,6 +395,29 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup)
     BOOST_REQUIRE(!fails);
     queue->StopWorkerThreads();
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup)
+{
+    FrozenCleanup_Queue_checks<FrozenCleanup_Queue>();
+}
+
+/** The work-stealing queue must give the same results as CCheckQueue, also
+ * when checks are spread over more slots than there are checks.
+ */
+BOOST_AUTO_TEST_CASE(test_WorkStealingCheckQueue)
+{
+    std::vector<size_t> range{0, 1, 2, 100000};
+    for (size_t i = 3; i < 10000; i += std::max((size_t)1, (size_t)InsecureRandRange(1000))) {
+        range.push_back(i);
+    }
+    for (const int threads_num : {0, 1, SCRIPT_CHECK_THREADS, 16}) {
+        Correct_Queue_range<Correct_StealingQueue>(range, threads_num);
+    }
+    Failing_Queue_range<Failing_StealingQueue>();
+    Failing_Queue_recovery<Failing_StealingQueue>();
+    Unique_Queue_checks<Unique_StealingQueue>();
+    Memory_Queue_checks<Memory_StealingQueue>();
+    FrozenCleanup_Queue_checks<FrozenCleanup_StealingQueue>();
+}
 
 
 /** Test that CCheckQueueControl is threadsafe */
@@ -398,6 +398,74 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_tuning_args)
+{
+    ArgsManager args;
+    args.AddArg("-dbtuning", "", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    const auto parse = [&](std::vector<const char*> argv) {
+        argv.insert(argv.begin(), "testbitcoin");
+        std::string error;
+        BOOST_REQUIRE(args.ParseParameters(argv.size(), argv.data(), error));
+    };
+    DBOptions options;
+    std::string error;
+
+    // Unprefixed settings apply to all databases, prefixed ones override them.
+    parse({"-dbtuning=bloombits=12", "-dbtuning=namehash:blocksize=65536", "-dbtuning=namehash:bloombits=0"});
+    BOOST_CHECK(ApplyDBTuning(args, "namehash", options, error));
+    BOOST_CHECK_EQUAL(options.block_size, 65536U);
+    BOOST_CHECK_EQUAL(options.bloom_bits, 0U);
+    options = DBOptions{};
+    BOOST_CHECK(ApplyDBTuning(args, "chainstate", options, error));
+    BOOST_CHECK_EQUAL(options.block_size, DBOptions{}.block_size);
+    BOOST_CHECK_EQUAL(options.bloom_bits, 12U);
+    BOOST_CHECK(!options.compression);
+
+    parse({"-dbtuning=writebuffer=1"});
+    BOOST_CHECK(!ApplyDBTuning(args, "chainstate", options, error));
+    parse({"-dbtuning=blocksize"});
+    BOOST_CHECK(!ApplyDBTuning(args, "chainstate", options, error));
+    parse({"-dbtuning=nosuchoption=1"});
+    BOOST_CHECK(!ApplyDBTuning(args, "chainstate", options, error));
+    parse({"-dbtuning=nosuchdb:bloombits=1"});
+    BOOST_CHECK(!ApplyDBTuning(args, "chainstate", options, error));
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_options_recorded)
+{
+    fs::path ph = m_args.GetDataDirBase() / "dbwrapper_options_recorded";
+    uint8_t key{'k'};
+    uint256 in = InsecureRand256();
+    uint256 res;
+
+    DBOptions tuned;
+    tuned.block_size = 16384;
+    tuned.bloom_bits = 0;
+    tuned.write_buffer_size = 1 << 20;
+
+    // Default options are not recorded.
+    {
+        CDBWrapper dbw(ph, (1 << 20), false, false, true);
+        BOOST_CHECK(dbw.Write(key, in));
+        BOOST_CHECK(dbwrapper_private::GetRecordedDBOptions(dbw) == DBOptions{});
+        BOOST_CHECK(!dbw.Exists(std::string("\000db_options", 11)));
+    }
+    // Non-default options are recorded and existing data stays readable.
+    {
+        CDBWrapper dbw(ph, (1 << 20), false, false, true, tuned);
+        BOOST_CHECK(dbwrapper_private::GetRecordedDBOptions(dbw) == tuned);
+        BOOST_CHECK(dbw.Read(key, res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+    }
+    // Switching back to the defaults drops the record again.
+    {
+        CDBWrapper dbw(ph, (1 << 20), false, false, true);
+        BOOST_CHECK(dbwrapper_private::GetRecordedDBOptions(dbw) == DBOptions{});
+        BOOST_CHECK(dbw.Read(key, res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(unicodepath)
 {
     // Attempt to create a database with a UTF8 character in the path.
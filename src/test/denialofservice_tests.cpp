@@ -23,6 +23,7 @@
 #include <validation.h>
 
 #include <array>
+#include <limits>
 #include <stdint.h>
 
 #include <boost/test/unit_test.hpp>
@@ -390,6 +391,11 @@ public:
             it = m_orphans.begin();
         return it->second.tx;
     }
+
+    size_t TotalUsage() const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
+    {
+        return m_total_usage;
+    }
 };
 
 static void MakeNewKeyWithFastRandomContext(CKey& key)
@@ -483,12 +489,78 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     }
 
     // Test LimitOrphanTxSize() function:
-    orphanage.LimitOrphans(40);
+    orphanage.LimitOrphans(40, std::numeric_limits<size_t>::max());
     BOOST_CHECK(orphanage.CountOrphans() <= 40);
-    orphanage.LimitOrphans(10);
+    orphanage.LimitOrphans(10, std::numeric_limits<size_t>::max());
     BOOST_CHECK(orphanage.CountOrphans() <= 10);
-    orphanage.LimitOrphans(0);
+    orphanage.LimitOrphans(0, std::numeric_limits<size_t>::max());
     BOOST_CHECK(orphanage.CountOrphans() == 0);
 }
 
+/** An orphan spending an unknown output, with a scriptSig of the given size. */
+static CTransactionRef MakeOrphan(size_t script_size, const uint256& parent = InsecureRand256())
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(parent, 0);
+    tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(script_size, 0x42);
+    tx.vout.resize(2);
+    tx.vout[0].nValue = 1 * CENT;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    tx.vout[1].nValue = 1 * CENT;
+    tx.vout[1].scriptPubKey = CScript() << OP_TRUE;
+    return MakeTransactionRef(tx);
+}
+
+BOOST_AUTO_TEST_CASE(DoS_orphan_memory)
+{
+    TxOrphanageTest orphanage;
+    LOCK(g_cs_orphans);
+
+    // A well-behaved peer with small orphans, and a flooding peer with big ones.
+    std::vector<CTransactionRef> small, big;
+    for (int i = 0; i < 20; ++i) {
+        small.push_back(MakeOrphan(10));
+        BOOST_CHECK(orphanage.AddTx(small.back(), /*peer=*/0));
+        big.push_back(MakeOrphan(5000));
+        BOOST_CHECK(orphanage.AddTx(big.back(), /*peer=*/1));
+    }
+    const size_t small_usage{orphanage.UsageByPeer(0)};
+    const size_t big_usage{orphanage.UsageByPeer(1)};
+    BOOST_CHECK_GT(small_usage, 20 * ::GetSerializeSize(*small[0], PROTOCOL_VERSION));
+    BOOST_CHECK_GT(big_usage, 20 * 5000);
+    BOOST_CHECK_EQUAL(orphanage.TotalUsage(), small_usage + big_usage);
+    BOOST_CHECK_GT(orphanage.DynamicMemoryUsage(), orphanage.TotalUsage());
+
+    // Going over the memory limit only evicts the flooding peer's orphans,
+    // oldest first.
+    orphanage.LimitOrphans(1000, orphanage.TotalUsage() / 2);
+    BOOST_CHECK_LE(orphanage.TotalUsage(), (small_usage + big_usage) / 2);
+    BOOST_CHECK_EQUAL(orphanage.UsageByPeer(0), small_usage);
+    BOOST_CHECK(!orphanage.HaveTx(GenTxid::Txid(big.front()->GetHash())));
+    BOOST_CHECK(orphanage.HaveTx(GenTxid::Wtxid(big.back()->GetWitnessHash())));
+
+    // So does going over the count limit.
+    orphanage.LimitOrphans(25, std::numeric_limits<size_t>::max());
+    BOOST_CHECK_EQUAL(orphanage.CountOrphans(), 25U);
+    BOOST_CHECK_EQUAL(orphanage.UsageByPeer(0), small_usage);
+
+    // The children of several accepted parents are found at once.
+    const CTransactionRef child0{MakeOrphan(10, small[0]->GetHash())};
+    const CTransactionRef child1{MakeOrphan(10, small[1]->GetHash())};
+    BOOST_CHECK(orphanage.AddTx(child0, /*peer=*/2));
+    BOOST_CHECK(orphanage.AddTx(child1, /*peer=*/2));
+    std::set<uint256> work_set;
+    orphanage.AddChildrenToWorkSet(std::vector<CTransactionRef>{small[0], small[1], small[2]}, work_set);
+    BOOST_CHECK(work_set == std::set<uint256>({child0->GetHash(), child1->GetHash()}));
+
+    // Disconnecting peers releases all of their memory.
+    for (NodeId peer = 0; peer < 3; ++peer) {
+        orphanage.EraseForPeer(peer);
+        BOOST_CHECK_EQUAL(orphanage.UsageByPeer(peer), 0U);
+    }
+    BOOST_CHECK_EQUAL(orphanage.CountOrphans(), 0U);
+    BOOST_CHECK_EQUAL(orphanage.TotalUsage(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
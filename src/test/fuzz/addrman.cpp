@@ -121,7 +121,7 @@ public:
     /**
      * Compare with another AddrMan.
      * This compares:
-     * - the values in `mapInfo` (the keys aka ids are ignored)
+     * - the values in `m_infos` (the keys aka ids are ignored)
      * - vvNew entries refer to the same addresses
      * - vvTried entries refer to the same addresses
      */
@@ -129,12 +129,12 @@ public:
     {
         LOCK2(m_impl->cs, other.m_impl->cs);
 
-        if (m_impl->mapInfo.size() != other.m_impl->mapInfo.size() || m_impl->nNew != other.m_impl->nNew ||
+        if (m_impl->m_infos.size() != other.m_impl->m_infos.size() || m_impl->nNew != other.m_impl->nNew ||
             m_impl->nTried != other.m_impl->nTried) {
             return false;
         }
 
-        // Check that all values in `mapInfo` are equal to all values in `other.mapInfo`.
+        // Check that all values in `m_infos` are equal to all values in `other.m_infos`.
         // Keys may be different.
 
         auto addrinfo_hasher = [](const AddrInfo& a) {
@@ -161,17 +161,13 @@ public:
 
         using Addresses = std::unordered_set<AddrInfo, decltype(addrinfo_hasher), decltype(addrinfo_eq)>;
 
-        const size_t num_addresses{m_impl->mapInfo.size()};
+        const size_t num_addresses{m_impl->m_infos.size()};
 
         Addresses addresses{num_addresses, addrinfo_hasher, addrinfo_eq};
-        for (const auto& [id, addr] : m_impl->mapInfo) {
-            addresses.insert(addr);
-        }
+        m_impl->m_infos.ForEach([&](int, const AddrInfo& addr) { addresses.insert(addr); });
 
         Addresses other_addresses{num_addresses, addrinfo_hasher, addrinfo_eq};
-        for (const auto& [id, addr] : other.m_impl->mapInfo) {
-            other_addresses.insert(addr);
-        }
+        other.m_impl->m_infos.ForEach([&](int, const AddrInfo& addr) { other_addresses.insert(addr); });
 
         if (addresses != other_addresses) {
             return false;
@@ -184,11 +180,11 @@ public:
             if ((id == -1 && other_id != -1) || (id != -1 && other_id == -1)) {
                 return false;
             }
-            return m_impl->mapInfo.at(id) == other.m_impl->mapInfo.at(other_id);
+            return m_impl->m_infos[id] == other.m_impl->m_infos[other_id];
         };
 
         // Check that `vvNew` contains the same addresses as `other.vvNew`. Notice - `vvNew[i][j]`
-        // contains just an id and the address is to be found in `mapInfo.at(id)`. The ids
+        // contains just an id and the address is to be found in `m_infos[id]`. The ids
         // themselves may differ between `vvNew` and `other.vvNew`.
         for (size_t i = 0; i < ADDRMAN_NEW_BUCKET_COUNT; ++i) {
             for (size_t j = 0; j < ADDRMAN_BUCKET_SIZE; ++j) {
@@ -56,7 +56,10 @@ void initialize_process_message()
 {
     Assert(GetNumMsgTypes() == getAllNetMessageTypes().size()); // If this fails, add or remove the message type below
 
-    static const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    // Transactions are validated synchronously, so that runs are deterministic.
+    static const auto testing_setup = MakeNoLogFileContext<const TestingSetup>(
+        /*chain_name=*/CBaseChainParams::REGTEST,
+        /*extra_args=*/{"-txprevalidationthreads=0"});
     g_setup = testing_setup.get();
     for (int i = 0; i < 2 * COINBASE_MATURITY; i++) {
         MineBlock(g_setup->m_node, CScript() << OP_TRUE);
@@ -124,16 +127,23 @@ FUZZ_TARGET_MSG(getcfheaders);
 FUZZ_TARGET_MSG(getcfilters);
 FUZZ_TARGET_MSG(getdata);
 FUZZ_TARGET_MSG(getheaders);
+FUZZ_TARGET_MSG(getpkgtxns);
 FUZZ_TARGET_MSG(headers);
 FUZZ_TARGET_MSG(inv);
 FUZZ_TARGET_MSG(mempool);
 FUZZ_TARGET_MSG(merkleblock);
 FUZZ_TARGET_MSG(notfound);
 FUZZ_TARGET_MSG(ping);
+FUZZ_TARGET_MSG(pkgtxns);
 FUZZ_TARGET_MSG(pong);
+FUZZ_TARGET_MSG(reconcildiff);
+FUZZ_TARGET_MSG(reqtxrcncl);
 FUZZ_TARGET_MSG(sendaddrv2);
 FUZZ_TARGET_MSG(sendcmpct);
 FUZZ_TARGET_MSG(sendheaders);
+FUZZ_TARGET_MSG(sendpackages);
+FUZZ_TARGET_MSG(sendtxrcncl);
+FUZZ_TARGET_MSG(sketch);
 FUZZ_TARGET_MSG(tx);
 FUZZ_TARGET_MSG(verack);
 FUZZ_TARGET_MSG(version);
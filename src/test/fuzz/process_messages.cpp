@@ -23,7 +23,10 @@ const TestingSetup* g_setup;
 
 void initialize_process_messages()
 {
-    static const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    // Transactions are validated synchronously, so that runs are deterministic.
+    static const auto testing_setup = MakeNoLogFileContext<const TestingSetup>(
+        /*chain_name=*/CBaseChainParams::REGTEST,
+        /*extra_args=*/{"-txprevalidationthreads=0"});
     g_setup = testing_setup.get();
     for (int i = 0; i < 2 * COINBASE_MATURITY; i++) {
         MineBlock(g_setup->m_node, CScript() << OP_TRUE);
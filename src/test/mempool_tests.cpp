@@ -2,8 +2,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <coins.h>
 #include <policy/policy.h>
 #include <txmempool.h>
+#include <util/rbf.h>
 #include <util/system.h>
 #include <util/time.h>
 
@@ -527,21 +529,21 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     pool.addUnchecked(entry.Fee(1100LL).FromTx(tx6));
     pool.addUnchecked(entry.Fee(9000LL).FromTx(tx7));
 
-    // we only require this to remove, at max, 2 txn, because it's not clear what we're really optimizing for aside from that
+    // tx7 pays for tx5 and tx6, but not enough to join tx4, so the three of
+    // them form the last chunk and are evicted together
     pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
     BOOST_CHECK(pool.exists(GenTxid::Txid(tx4.GetHash())));
-    BOOST_CHECK(pool.exists(GenTxid::Txid(tx6.GetHash())));
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(tx5.GetHash())));
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(tx6.GetHash())));
     BOOST_CHECK(!pool.exists(GenTxid::Txid(tx7.GetHash())));
 
-    if (!pool.exists(GenTxid::Txid(tx5.GetHash())))
-        pool.addUnchecked(entry.Fee(1000LL).FromTx(tx5));
-    pool.addUnchecked(entry.Fee(9000LL).FromTx(tx7));
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(tx5));
+    pool.addUnchecked(entry.Fee(1100LL).FromTx(tx6));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage() / 2); // should maximize mempool size by only removing 5/7
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1); // without tx7, tx5 is a chunk of its own
     BOOST_CHECK(pool.exists(GenTxid::Txid(tx4.GetHash())));
     BOOST_CHECK(!pool.exists(GenTxid::Txid(tx5.GetHash())));
     BOOST_CHECK(pool.exists(GenTxid::Txid(tx6.GetHash())));
-    BOOST_CHECK(!pool.exists(GenTxid::Txid(tx7.GetHash())));
 
     pool.addUnchecked(entry.Fee(1000LL).FromTx(tx5));
     pool.addUnchecked(entry.Fee(9000LL).FromTx(tx7));
@@ -786,4 +788,202 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 4ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolClusterTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // ta has two children: tb pays for it (CPFP), tc does not. tx_other is
+    // not connected to them.
+    CTransactionRef ta = make_tx(/*output_values=*/{10 * COIN, 10 * COIN});
+    CTransactionRef tb = make_tx(/*output_values=*/{5 * COIN}, /*inputs=*/{ta}, /*input_indices=*/{0});
+    CTransactionRef tc = make_tx(/*output_values=*/{4 * COIN}, /*inputs=*/{ta}, /*input_indices=*/{1});
+    CTransactionRef tx_other = make_tx(/*output_values=*/{3 * COIN});
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(ta));
+    pool.addUnchecked(entry.Fee(500LL).FromTx(tc));
+    pool.addUnchecked(entry.Fee(20000LL).FromTx(tb));
+    pool.addUnchecked(entry.Fee(5000LL).FromTx(tx_other));
+
+    std::vector<const CTxMemPoolCluster*> clusters = pool.GetClusters();
+    BOOST_REQUIRE_EQUAL(clusters.size(), 2U);
+    const CTxMemPoolCluster& cluster = *clusters[0];
+    BOOST_REQUIRE_EQUAL(cluster.txs.size(), 3U);
+    BOOST_CHECK(cluster.txs[0]->GetTx().GetHash() == ta->GetHash());
+    BOOST_CHECK(cluster.txs[1]->GetTx().GetHash() == tb->GetHash());
+    BOOST_CHECK(cluster.txs[2]->GetTx().GetHash() == tc->GetHash());
+    // The parent and the child paying for it form the first chunk.
+    BOOST_REQUIRE_EQUAL(cluster.chunks.size(), 2U);
+    BOOST_CHECK_EQUAL(cluster.chunks[0].end, 2U);
+    BOOST_CHECK_EQUAL(cluster.chunks[0].feerate.fee, 21000);
+    BOOST_CHECK_EQUAL(cluster.chunks[1].end, 3U);
+    BOOST_CHECK_EQUAL(cluster.chunks[1].feerate.fee, 500);
+    BOOST_CHECK_EQUAL(clusters[1]->txs.size(), 1U);
+
+    // Once the parent is mined, its children are no longer connected.
+    pool.removeForBlock({ta}, 1);
+    clusters = pool.GetClusters();
+    BOOST_CHECK_EQUAL(clusters.size(), 3U);
+    for (const CTxMemPoolCluster* c : clusters) {
+        BOOST_CHECK_EQUAL(c->txs.size(), 1U);
+        BOOST_CHECK_EQUAL(c->chunks.size(), 1U);
+    }
+
+    // Eviction starts with the lowest-feerate chunk...
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(tc->GetHash())));
+    BOOST_CHECK(pool.exists(GenTxid::Txid(tb->GetHash())));
+    BOOST_CHECK(pool.exists(GenTxid::Txid(tx_other->GetHash())));
+
+    // ... taking prioritisation into account.
+    pool.PrioritiseTransaction(tb->GetHash(), -19900);
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(tb->GetHash())));
+    BOOST_CHECK(pool.exists(GenTxid::Txid(tx_other->GetHash())));
+    BOOST_CHECK_EQUAL(pool.GetClusters().size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolTrimChunkTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // tb pays for ta, but not enough to reach tp, so the two of them form the
+    // last chunk of the cluster. tx_confirmed is not in the mempool.
+    CTransactionRef tx_confirmed = make_tx(/*output_values=*/{11 * COIN});
+    CTransactionRef tp = make_tx(/*output_values=*/{10 * COIN}, /*inputs=*/{tx_confirmed}, /*input_indices=*/{0});
+    CTransactionRef ta = make_tx(/*output_values=*/{9 * COIN}, /*inputs=*/{tp}, /*input_indices=*/{0});
+    CTransactionRef tb = make_tx(/*output_values=*/{8 * COIN}, /*inputs=*/{ta}, /*input_indices=*/{0});
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tp));
+    pool.addUnchecked(entry.Fee(100LL).FromTx(ta));
+    pool.addUnchecked(entry.Fee(2000LL).FromTx(tb));
+    std::vector<const CTxMemPoolCluster*> clusters = pool.GetClusters();
+    BOOST_REQUIRE_EQUAL(clusters.size(), 1U);
+    BOOST_REQUIRE_EQUAL(clusters[0]->chunks.size(), 2U);
+    BOOST_CHECK_EQUAL(clusters[0]->chunks[0].end, 1U);
+
+    // Evicting the chunk takes both transactions and leaves the rest of the
+    // cluster as it was linearized.
+    std::vector<COutPoint> no_spends;
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1, &no_spends);
+    BOOST_CHECK(pool.exists(GenTxid::Txid(tp->GetHash())));
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(ta->GetHash())));
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(tb->GetHash())));
+    BOOST_CHECK(no_spends.empty());
+    clusters = pool.GetClusters();
+    BOOST_REQUIRE_EQUAL(clusters.size(), 1U);
+    BOOST_CHECK_EQUAL(clusters[0]->txs.size(), 1U);
+    BOOST_CHECK_EQUAL(clusters[0]->chunks.size(), 1U);
+    BOOST_CHECK_EQUAL(clusters[0]->chunks[0].feerate.fee, 10000);
+
+    pool.TrimToSize(0, &no_spends);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    BOOST_CHECK(pool.GetClusters().empty());
+    BOOST_REQUIRE_EQUAL(no_spends.size(), 1U);
+    BOOST_CHECK(no_spends[0] == COutPoint(tx_confirmed->GetHash(), 0));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterCheckTest)
+{
+    CTxMemPool pool(/*estimator=*/nullptr, /*check_ratio=*/1);
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    CCoinsView base;
+    CCoinsViewCache coins(&base);
+    std::vector<CTransactionRef> funding;
+    for (int i = 0; i < 3; ++i) {
+        funding.push_back(make_tx(/*output_values=*/{10 * COIN}));
+        coins.AddCoin(COutPoint(funding.back()->GetHash(), 0), Coin(funding.back()->vout[0], 1, false), false);
+    }
+
+    CTransactionRef ta = make_tx(/*output_values=*/{4 * COIN, 4 * COIN}, /*inputs=*/{funding[0]});
+    CTransactionRef tb = make_tx(/*output_values=*/{3 * COIN}, /*inputs=*/{ta}, /*input_indices=*/{0});
+    CTransactionRef tc = make_tx(/*output_values=*/{3 * COIN}, /*inputs=*/{ta}, /*input_indices=*/{1});
+    CTransactionRef td = make_tx(/*output_values=*/{9 * COIN}, /*inputs=*/{funding[1]});
+    CTransactionRef te = make_tx(/*output_values=*/{9 * COIN}, /*inputs=*/{funding[2]});
+    pool.addUnchecked(entry.Fee(2 * COIN).FromTx(ta));
+    pool.addUnchecked(entry.Fee(COIN).FromTx(tb));
+    pool.addUnchecked(entry.Fee(COIN).FromTx(td));
+
+    // Linearize all clusters, then dirty one and create a new one, so that
+    // linearized and dirty clusters exist side by side.
+    BOOST_CHECK_EQUAL(pool.GetClusters().size(), 2U);
+    pool.addUnchecked(entry.Fee(COIN).FromTx(tc));
+    pool.addUnchecked(entry.Fee(COIN).FromTx(te));
+    pool.check(coins, /*spendheight=*/2);
+
+    // Likewise after a block removes some of the transactions.
+    BOOST_CHECK_EQUAL(pool.GetClusters().size(), 3U);
+    coins.SpendCoin(COutPoint(funding[1]->GetHash(), 0));
+    coins.AddCoin(COutPoint(td->GetHash(), 0), Coin(td->vout[0], 2, false), false);
+    pool.removeForBlock({td}, 2);
+    pool.addUnchecked(entry.Fee(COIN).FromTx(make_tx(/*output_values=*/{8 * COIN}, /*inputs=*/{td})));
+    pool.check(coins, /*spendheight=*/3);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSnapshotTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+
+    // ta signals replaceability, so its child tb is replaceable through it.
+    CMutableTransaction mta;
+    mta.vin.resize(1);
+    mta.vin[0].nSequence = MAX_BIP125_RBF_SEQUENCE;
+    mta.vout.resize(1);
+    mta.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    mta.vout[0].nValue = 10 * COIN;
+    CTransactionRef ta = MakeTransactionRef(mta);
+    CTransactionRef tb = make_tx(/*output_values=*/{5 * COIN}, /*inputs=*/{ta});
+    CTransactionRef tc = make_tx(/*output_values=*/{3 * COIN});
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.addUnchecked(entry.Fee(1000LL).FromTx(ta));
+        pool.addUnchecked(entry.Fee(2000LL).FromTx(tb));
+        pool.addUnchecked(entry.Fee(500LL).FromTx(tc));
+    }
+
+    const auto snapshot = pool.GetSnapshot();
+    BOOST_REQUIRE_EQUAL(snapshot->entries.size(), 3U);
+    std::vector<uint256> hashes;
+    pool.queryHashes(hashes);
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        BOOST_CHECK(snapshot->entries[i].tx->GetHash() == hashes[i]);
+    }
+    for (const MempoolSnapshot::Entry& e : snapshot->entries) {
+        if (e.tx == ta) {
+            BOOST_CHECK(e.bip125_replaceable);
+            BOOST_CHECK(e.children == std::vector<uint256>{tb->GetHash()});
+            BOOST_CHECK_EQUAL(e.mod_fees_with_descendants, 3000);
+        } else if (e.tx == tb) {
+            BOOST_CHECK(e.bip125_replaceable);
+            BOOST_CHECK(e.parents == std::vector<uint256>{ta->GetHash()});
+            BOOST_CHECK_EQUAL(e.count_with_ancestors, 2U);
+        } else {
+            BOOST_CHECK(!e.bip125_replaceable);
+            BOOST_CHECK(e.parents.empty() && e.children.empty());
+            BOOST_CHECK(!e.unbroadcast);
+        }
+    }
+
+    // Until the mempool changes, readers share the same snapshot.
+    BOOST_CHECK(pool.GetSnapshot() == snapshot);
+    pool.AddUnbroadcastTx(tc->GetHash());
+    const auto unbroadcast = pool.GetSnapshot();
+    BOOST_CHECK(unbroadcast != snapshot);
+    pool.PrioritiseTransaction(tb->GetHash(), 100);
+    BOOST_CHECK(pool.GetSnapshot() != unbroadcast);
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.removeRecursive(*ta, REMOVAL_REASON_DUMMY);
+    }
+
+    // Old snapshots stay valid for the readers holding them.
+    BOOST_CHECK_EQUAL(pool.GetSnapshot()->entries.size(), 1U);
+    BOOST_CHECK_EQUAL(snapshot->entries.size(), 3U);
+    BOOST_CHECK(pool.GetSnapshot()->entries[0].unbroadcast);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -439,6 +439,46 @@ BOOST_FIXTURE_TEST_CASE (unexpire_conflicts, NameMempoolTestSetup)
   BOOST_CHECK (mempool.mapTx.empty ());
 }
 
+BOOST_FIXTURE_TEST_CASE (package_conflicts, NameMempoolTestSetup)
+{
+  mempool.addUnchecked (Entry (Tx (FirstScript (ADDR, "reg", 'a'))));
+
+  /* A registration followed by updates of the name is a fine package.  */
+  CMutableTransaction mtx;
+  mtx.SetDoichain ();
+  mtx.vout.push_back (CTxOut (COIN, FirstScript (ADDR, "chain", 'a')));
+  const auto chain1 = MakeTransactionRef (mtx);
+  mtx.vout.clear ();
+  mtx.vin.push_back (CTxIn (COutPoint (chain1->GetHash (), 0)));
+  mtx.vout.push_back (CTxOut (COIN, UpdateScript (ADDR, "chain", "x")));
+  const auto chain2 = MakeTransactionRef (mtx);
+  mtx.vin[0].prevout = COutPoint (chain2->GetHash (), 0);
+  mtx.vout[0] = CTxOut (COIN, UpdateScript (ADDR, "chain", "y"));
+  const auto chain3 = MakeTransactionRef (mtx);
+
+  size_t failed;
+  BOOST_CHECK (mempool.checkPackageNameOps ({chain1, chain2, chain3}, failed));
+
+  /* Conflicts within the package are found, although each transaction
+     passes on its own.  */
+  const auto reg1 = MakeTransactionRef (Tx (FirstScript (ADDR, "foo", 'a')));
+  const auto reg2 = MakeTransactionRef (Tx (FirstScript (ADDR, "foo", 'b')));
+  BOOST_CHECK (mempool.checkNameOps (*reg1) && mempool.checkNameOps (*reg2));
+  BOOST_CHECK (!mempool.checkPackageNameOps ({chain1, reg1, reg2}, failed));
+  BOOST_CHECK_EQUAL (failed, 2U);
+
+  const auto new1 = MakeTransactionRef (Tx (NewScript (ADDR, "foo", 'a')));
+  const auto new2 = MakeTransactionRef (Tx (NewScript (OTHER_ADDR, "foo", 'a')));
+  BOOST_CHECK (!mempool.checkPackageNameOps ({new1, new2}, failed));
+  BOOST_CHECK_EQUAL (failed, 1U);
+  BOOST_CHECK (mempool.checkPackageNameOps ({new1, reg1}, failed));
+
+  /* So are conflicts with the mempool.  */
+  const auto reg3 = MakeTransactionRef (Tx (FirstScript (ADDR, "reg", 'b')));
+  BOOST_CHECK (!mempool.checkPackageNameOps ({chain1, chain2, reg3}, failed));
+  BOOST_CHECK_EQUAL (failed, 2U);
+}
+
 /* ************************************************************************** */
 
 BOOST_AUTO_TEST_SUITE_END ()
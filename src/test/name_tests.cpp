@@ -716,9 +716,6 @@ BOOST_AUTO_TEST_CASE (name_tx_verification)
 
 BOOST_AUTO_TEST_CASE (name_updates_undo)
 {
-  /* Enable name history to test this on the go.  */
-  fNameHistory = true;
-
   const valtype name = DecodeName ("db-test-name", NameEncoding::ASCII);
   const valtype value1 = DecodeName ("old-value", NameEncoding::ASCII);
   const valtype value2 = DecodeName ("new-value", NameEncoding::ASCII);
@@ -728,7 +725,6 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   CCoinsViewCache view(&dummyView);
   CBlockUndo undo;
   CNameData data;
-  CNameHistory history;
 
   const valtype rand(20, 'x');
 
@@ -746,7 +742,6 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   ApplyNameTransaction (CTransaction (mtx), 100, view, undo);
   BOOST_CHECK (!view.GetName (name, data));
   BOOST_CHECK (undo.vnameundo.empty ());
-  BOOST_CHECK (!view.GetNameHistory (name, history));
 
   mtx.vout.clear ();
   mtx.vout.push_back (CTxOut (COIN, scrFirst));
@@ -755,7 +750,6 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   BOOST_CHECK (data.getHeight () == 200);
   BOOST_CHECK (data.getValue () == value1);
   BOOST_CHECK (data.getAddress () == addr);
-  BOOST_CHECK (!view.GetNameHistory (name, history));
   BOOST_CHECK (undo.vnameundo.size () == 1);
   const CNameData firstData = data;
 
@@ -766,22 +760,17 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   BOOST_CHECK (data.getHeight () == 300);
   BOOST_CHECK (data.getValue () == value2);
   BOOST_CHECK (data.getAddress () == addr);
-  BOOST_CHECK (view.GetNameHistory (name, history));
-  BOOST_CHECK (history.getData ().size () == 1);
-  BOOST_CHECK (history.getData ().back () == firstData);
   BOOST_CHECK (undo.vnameundo.size () == 2);
 
   undo.vnameundo.back ().apply (view);
   BOOST_CHECK (view.GetName (name, data));
   BOOST_CHECK (data.getHeight () == 200);
   BOOST_CHECK (data.getValue () == value1);
-  BOOST_CHECK (data.getAddress () == addr);
-  BOOST_CHECK (!view.GetNameHistory (name, history) || history.empty ());
+  BOOST_CHECK (data == firstData);
   undo.vnameundo.pop_back ();
 
   undo.vnameundo.back ().apply (view);
   BOOST_CHECK (!view.GetName (name, data));
-  BOOST_CHECK (!view.GetNameHistory (name, history) || history.empty ());
   undo.vnameundo.pop_back ();
   BOOST_CHECK (undo.vnameundo.empty ());
 }
@@ -0,0 +1,126 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <hash.h>
+#include <index/namehash.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <script/names.h>
+#include <test/util/setup_common.h>
+#include <util/string.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Name-hash index that can be filled without a chain. */
+class TestNameHashIndex : public NameHashIndex
+{
+public:
+    using NameHashIndex::NameHashIndex;
+
+    void AddNames(const std::vector<valtype>& names)
+    {
+        CMutableTransaction mtx;
+        mtx.SetDoichain();
+        for (const auto& name : names) {
+            mtx.vout.emplace_back(COIN, CNameScript::buildNameFirstupdate(CScript() << OP_TRUE, name, {'v'}, valtype(20, 'x')));
+        }
+        CBlock block;
+        block.vtx.push_back(MakeTransactionRef(std::move(mtx)));
+        BOOST_REQUIRE(WritePreparedBlock(*PrepareBlock(block, nullptr), nullptr));
+    }
+};
+
+valtype MakeName(int i)
+{
+    const std::string str{"d/name-" + ToString(i)};
+    return valtype(str.begin(), str.end());
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(namehash_index_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(namehash_preimage_cache)
+{
+    TestNameHashIndex index(1 << 20, /*memory=*/true, /*wipe=*/true, /*preimage_cache_size=*/1 << 20);
+    std::vector<valtype> names;
+    for (int i = 0; i < 10; ++i) names.push_back(MakeName(i));
+    index.AddNames(names);
+
+    valtype name;
+    BOOST_CHECK(!index.FindNamePreimage(Hash(MakeName(100)), name));
+    BOOST_CHECK(index.FindNamePreimage(Hash(names[0]), name));
+    BOOST_CHECK(name == names[0]);
+    BOOST_CHECK(index.FindNamePreimage(Hash(names[0]), name));
+    BOOST_CHECK(name == names[0]);
+
+    auto stats{index.GetCacheStats()};
+    BOOST_CHECK_EQUAL(stats.hits, 1U);
+    BOOST_CHECK_EQUAL(stats.misses, 2U);
+    BOOST_CHECK_EQUAL(stats.entries, 1U);
+    BOOST_CHECK(stats.usage > 0 && stats.usage <= stats.maxUsage);
+
+    // Batch lookups return one entry per hash, in order.
+    const std::vector<uint256> hashes{Hash(names[0]), Hash(MakeName(100)), Hash(names[9]), Hash(names[3])};
+    std::vector<std::optional<valtype>> found;
+    index.FindNamePreimages(hashes, found);
+    BOOST_REQUIRE_EQUAL(found.size(), hashes.size());
+    BOOST_CHECK(found[0] == names[0]);
+    BOOST_CHECK(!found[1]);
+    BOOST_CHECK(found[2] == names[9]);
+    BOOST_CHECK(found[3] == names[3]);
+    stats = index.GetCacheStats();
+    BOOST_CHECK_EQUAL(stats.hits, 2U);
+    BOOST_CHECK_EQUAL(stats.entries, 3U);
+
+    // Names added later are found as well.
+    index.AddNames({MakeName(100)});
+    BOOST_CHECK(index.FindNamePreimage(Hash(MakeName(100)), name));
+    BOOST_CHECK(name == MakeName(100));
+}
+
+BOOST_AUTO_TEST_CASE(namehash_preimage_cache_eviction)
+{
+    std::vector<valtype> names;
+    for (int i = 0; i < 1000; ++i) names.push_back(MakeName(i));
+
+    // Without a cache, every lookup goes to the database.
+    {
+        TestNameHashIndex index(1 << 20, /*memory=*/true, /*wipe=*/true, /*preimage_cache_size=*/0);
+        index.AddNames(names);
+        valtype name;
+        for (const auto& n : names) {
+            BOOST_CHECK(index.FindNamePreimage(Hash(n), name));
+            BOOST_CHECK(name == n);
+        }
+        BOOST_CHECK_EQUAL(index.GetCacheStats().entries, 0U);
+        BOOST_CHECK_EQUAL(index.GetCacheStats().usage, 0U);
+    }
+
+    // A small cache keeps the most recently used names within its bound.
+    TestNameHashIndex index(1 << 20, /*memory=*/true, /*wipe=*/true, /*preimage_cache_size=*/16 << 10);
+    index.AddNames(names);
+    valtype name;
+    for (const auto& n : names) {
+        BOOST_CHECK(index.FindNamePreimage(Hash(n), name));
+        BOOST_CHECK(name == n);
+    }
+    const auto stats{index.GetCacheStats()};
+    BOOST_CHECK(stats.entries > 0 && stats.entries < names.size());
+    BOOST_CHECK(stats.usage <= stats.maxUsage);
+
+    const auto hits{stats.hits};
+    BOOST_CHECK(index.FindNamePreimage(Hash(names.back()), name));
+    BOOST_CHECK_EQUAL(index.GetCacheStats().hits, hits + 1);
+    BOOST_CHECK(index.FindNamePreimage(Hash(names.front()), name));
+    BOOST_CHECK_EQUAL(index.GetCacheStats().hits, hits + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
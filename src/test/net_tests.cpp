@@ -5,6 +5,7 @@
 #include <chainparams.h>
 #include <clientversion.h>
 #include <cstdint>
+#include <hash.h>
 #include <net.h>
 #include <netaddress.h>
 #include <netbase.h>
@@ -704,4 +705,86 @@ BOOST_AUTO_TEST_CASE(LocalAddress_BasicLifecycle)
     BOOST_CHECK(!IsLocal(addr));
 }
 
+BOOST_AUTO_TEST_CASE(recv_buffer_pool)
+{
+    RecvBufferPool pool{/*max_pooled_bytes=*/1 << 20};
+    SerializeData small{pool.Acquire(100)};
+    BOOST_CHECK_EQUAL(small.capacity(), RecvBufferPool::RECV_BUFFER_MIN_SIZE);
+    SerializeData large{pool.Acquire(300'000)};
+    BOOST_CHECK_EQUAL(large.capacity(), 512U * 1024);
+    large.resize(1000);
+
+    pool.Release(std::move(large));
+    pool.Release(std::move(small));
+    RecvBufferPoolStats stats{pool.GetStats()};
+    BOOST_CHECK_EQUAL(stats.allocations, 2U);
+    BOOST_CHECK_EQUAL(stats.pooled_bytes, 512U * 1024 + RecvBufferPool::RECV_BUFFER_MIN_SIZE);
+
+    // Buffers come back empty, and a larger free buffer is preferred if asked for.
+    SerializeData reused{pool.Acquire(100, /*preferred_size=*/400'000)};
+    BOOST_CHECK(reused.empty());
+    BOOST_CHECK_EQUAL(reused.capacity(), 512U * 1024);
+    BOOST_CHECK_EQUAL(pool.Acquire(4000).capacity(), RecvBufferPool::RECV_BUFFER_MIN_SIZE);
+    stats = pool.GetStats();
+    BOOST_CHECK_EQUAL(stats.reuses, 2U);
+    BOOST_CHECK_EQUAL(stats.pooled_bytes, 0U);
+
+    // Beyond the limit, buffers are freed.
+    SerializeData too_many{pool.Acquire(600'000)};
+    pool.Release(std::move(reused));
+    pool.Release(std::move(too_many));
+    BOOST_CHECK_EQUAL(pool.GetStats().pooled_bytes, 512U * 1024);
+}
+
+BOOST_AUTO_TEST_CASE(v1_transport_direct_read)
+{
+    const auto pool{std::make_shared<RecvBufferPool>()};
+    std::vector<uint8_t> payload(300'000);
+    for (size_t i = 0; i < payload.size(); ++i) payload[i] = i;
+    CMessageHeader hdr{Params().MessageStart(), NetMsgType::BLOCK, uint32_t(payload.size())};
+    const uint256 hash{Hash(payload)};
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    std::vector<uint8_t> wire;
+    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, wire, 0, hdr};
+    wire.insert(wire.end(), payload.begin(), payload.end());
+
+    for (int round = 0; round < 2; ++round) {
+        V1TransportDeserializer deserializer{Params(), /*node_id=*/0, SER_NETWORK, INIT_PROTO_VERSION, pool};
+        BOOST_CHECK(deserializer.GetDirectReadBuffer().empty());
+
+        // The header and the start of the payload arrive in a separate buffer.
+        Span<const uint8_t> received{Span{wire}.first(1000)};
+        BOOST_CHECK_EQUAL(deserializer.Read(received), CMessageHeader::HEADER_SIZE);
+        BOOST_CHECK_EQUAL(deserializer.Read(received), 1000 - CMessageHeader::HEADER_SIZE);
+        size_t pos{1000};
+
+        // The rest is received in place.
+        while (!deserializer.Complete()) {
+            const Span<uint8_t> direct{deserializer.GetDirectReadBuffer()};
+            const size_t size{direct.empty() ? std::min<size_t>(wire.size() - pos, 0x10000) : direct.size()};
+            std::vector<uint8_t> separate;
+            Span<uint8_t> buffer{direct};
+            if (direct.empty()) {
+                separate.resize(size);
+                buffer = separate;
+            }
+            std::copy_n(wire.begin() + pos, size, buffer.begin());
+            pos += size;
+            Span<const uint8_t> bytes{buffer};
+            BOOST_CHECK_EQUAL(deserializer.Read(bytes), int(size));
+        }
+        BOOST_CHECK_EQUAL(pos, wire.size());
+
+        bool reject{false};
+        CNetMessage msg{deserializer.GetMessage(std::chrono::microseconds{0}, reject)};
+        BOOST_CHECK(!reject);
+        BOOST_CHECK(std::equal(payload.begin(), payload.end(), UCharCast(msg.m_recv.data()), UCharCast(msg.m_recv.data() + msg.m_recv.size())));
+        // The 256 KiB allocated ahead after the first bytes were received in place. What
+        // arrived with the header and the remaining 36 KiB were copied.
+        BOOST_CHECK_EQUAL(msg.m_bytes_copied, payload.size() - 256 * 1024);
+    }
+    // The second message reused the buffer of the first.
+    BOOST_CHECK_GT(pool->GetStats().reuses, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,8 +2,11 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <clientversion.h>
+#include <fs.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
+#include <streams.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util/time.h>
@@ -178,6 +181,23 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     for (int i = 2; i < 9; i++) { // At 9, the original estimate was already at the bottom (b/c scale = 2)
         BOOST_CHECK(feeEst.estimateFee(i).GetFeePerK() < origFeeEst[i-1] - deltaFee);
     }
+
+    // The estimates survive a round trip through the estimates file
+    const fs::path est_path = m_args.GetDataDirBase() / "fee_estimates_test.dat";
+    {
+        CAutoFile est_file(fsbridge::fopen(est_path, "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(feeEst.Write(est_file));
+    }
+    CBlockPolicyEstimator readEst;
+    {
+        CAutoFile est_file(fsbridge::fopen(est_path, "rb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(readEst.Read(est_file));
+    }
+    for (const auto horizon : ALL_FEE_ESTIMATE_HORIZONS) {
+        for (unsigned int i = 1; i <= feeEst.HighestTargetTracked(horizon); i++) {
+            BOOST_CHECK(readEst.estimateRawFee(i, 0.85, horizon) == feeEst.estimateRawFee(i, 0.85, horizon));
+        }
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
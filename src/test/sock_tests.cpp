@@ -12,6 +12,7 @@
 
 #include <cassert>
 #include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -175,6 +176,76 @@ BOOST_AUTO_TEST_CASE(recv_until_terminator_limit)
     receiver.join();
 }
 
+#ifdef USE_EPOLL
+BOOST_AUTO_TEST_CASE(epoll_events)
+{
+    int s[2];
+    CreateSocketPair(s);
+    Sock sock0(s[0]);
+    Sock sock1(s[1]);
+
+    EpollEvents epoll;
+    BOOST_REQUIRE(epoll.IsValid());
+    BOOST_REQUIRE(epoll.Add(sock0.Get(), 42, Sock::RECV | Sock::SEND, /*edge_triggered=*/true));
+    std::vector<EpollEvents::Event> events;
+
+    // A fresh socket is writable.
+    BOOST_REQUIRE(epoll.Wait(0ms, events));
+    BOOST_REQUIRE_EQUAL(events.size(), 1U);
+    BOOST_CHECK_EQUAL(events[0].tag, 42U);
+    BOOST_CHECK(!events[0].recv && events[0].send && !events[0].error);
+
+    // Edge-triggered: nothing new, nothing reported.
+    BOOST_REQUIRE(epoll.Wait(0ms, events));
+    BOOST_CHECK(events.empty());
+
+    BOOST_REQUIRE_EQUAL(sock1.Send("ab", 2, 0), 2);
+    BOOST_REQUIRE(epoll.Wait(1min, events));
+    BOOST_REQUIRE_EQUAL(events.size(), 1U);
+    BOOST_CHECK(events[0].recv);
+
+    // Unread input isn't reported again until more arrives.
+    BOOST_REQUIRE(epoll.Wait(0ms, events));
+    BOOST_CHECK(events.empty());
+    BOOST_REQUIRE_EQUAL(sock1.Send("c", 1, 0), 1);
+    BOOST_REQUIRE(epoll.Wait(1min, events));
+    BOOST_REQUIRE_EQUAL(events.size(), 1U);
+    char buf[10];
+    BOOST_CHECK_EQUAL(sock0.Recv(buf, sizeof(buf), 0), 3);
+
+    // A wakeup ends a wait without reporting anything, also from another thread.
+    epoll.Wake();
+    BOOST_REQUIRE(epoll.Wait(1min, events));
+    BOOST_CHECK(events.empty());
+    std::thread waker([&epoll] { epoll.Wake(); });
+    BOOST_REQUIRE(epoll.Wait(1min, events));
+    BOOST_CHECK(events.empty());
+    waker.join();
+
+    // Hanging up is reported as readable (recv() returns 0).
+    sock1.Reset();
+    BOOST_REQUIRE(epoll.Wait(1min, events));
+    BOOST_REQUIRE_EQUAL(events.size(), 1U);
+    BOOST_CHECK(events[0].recv);
+    BOOST_CHECK_EQUAL(sock0.Recv(buf, sizeof(buf), 0), 0);
+
+    // Level-triggered sockets are reported for as long as they are ready.
+    int t[2];
+    CreateSocketPair(t);
+    Sock sock2(t[0]);
+    Sock sock3(t[1]);
+    epoll.Remove(sock0.Get());
+    BOOST_REQUIRE(epoll.Add(sock2.Get(), 7, Sock::RECV, /*edge_triggered=*/false));
+    BOOST_REQUIRE_EQUAL(sock3.Send("d", 1, 0), 1);
+    for (int i = 0; i < 2; ++i) {
+        BOOST_REQUIRE(epoll.Wait(1min, events));
+        BOOST_REQUIRE_EQUAL(events.size(), 1U);
+        BOOST_CHECK_EQUAL(events[0].tag, 7U);
+        BOOST_CHECK(events[0].recv && !events[0].send);
+    }
+}
+#endif // USE_EPOLL
+
 #endif /* WIN32 */
 
 BOOST_AUTO_TEST_SUITE_END()
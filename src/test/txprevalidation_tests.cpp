@@ -0,0 +1,113 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txprevalidation.h>
+
+#include <streams.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <util/time.h>
+#include <validation.h>
+#include <version.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+
+BOOST_FIXTURE_TEST_SUITE(txprevalidation_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(latency_histogram)
+{
+    LatencyHistogram histogram;
+    histogram.Add(std::chrono::microseconds{5});
+    histogram.Add(std::chrono::microseconds{10});
+    histogram.Add(std::chrono::microseconds{11});
+    histogram.Add(std::chrono::microseconds{5'000'000});
+    BOOST_CHECK_EQUAL(histogram.m_count, 4U);
+    BOOST_CHECK_EQUAL(histogram.m_counts[0], 2U);
+    BOOST_CHECK_EQUAL(histogram.m_counts[1], 1U);
+    BOOST_CHECK_EQUAL(histogram.m_counts.back(), 1U);
+    BOOST_CHECK_EQUAL(count_microseconds(histogram.m_total), 5'000'026);
+    BOOST_CHECK_EQUAL(count_microseconds(histogram.m_max), 5'000'000);
+}
+
+BOOST_AUTO_TEST_CASE(pre_verify_input_scripts)
+{
+    const CScript script_pub_key{CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG};
+    const CMutableTransaction spend{CreateValidMempoolTransaction(m_coinbase_txns[0], /*input_vout=*/0, /*input_height=*/0,
+                                                                  coinbaseKey, script_pub_key, /*output_amount=*/CAmount(1 * COIN),
+                                                                  /*submit=*/false)};
+
+    auto spent_outputs{GetSpentOutputsSnapshot(m_node.chainman->ActiveChainstate(), *m_node.mempool, CTransaction{spend})};
+    BOOST_REQUIRE(spent_outputs);
+    BOOST_REQUIRE_EQUAL(spent_outputs->size(), 1U);
+    BOOST_CHECK(spent_outputs->at(0) == m_coinbase_txns[0]->vout[0]);
+    BOOST_CHECK(PreVerifyInputScripts(CTransaction{spend}, std::move(*spent_outputs)));
+
+    // A tampered signature fails.
+    CMutableTransaction bad_spend{spend};
+    bad_spend.vin[0].scriptSig[10] ^= 0x01;
+    BOOST_CHECK(!PreVerifyInputScripts(CTransaction{bad_spend}, {m_coinbase_txns[0]->vout[0]}));
+
+    // Inputs that can't be found give no snapshot.
+    CMutableTransaction missing_input{spend};
+    missing_input.vin[0].prevout.n = 1'000;
+    BOOST_CHECK(!GetSpentOutputsSnapshot(m_node.chainman->ActiveChainstate(), *m_node.mempool, CTransaction{missing_input}));
+}
+
+BOOST_AUTO_TEST_CASE(pre_validator)
+{
+    const CScript script_pub_key{CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG};
+    const CMutableTransaction spend{CreateValidMempoolTransaction(m_coinbase_txns[1], /*input_vout=*/0, /*input_height=*/0,
+                                                                  coinbaseKey, script_pub_key, /*output_amount=*/CAmount(1 * COIN),
+                                                                  /*submit=*/false)};
+    // Mempool acceptance would skip this one, so its scripts are not verified.
+    const CMutableTransaction known{CreateValidMempoolTransaction(m_coinbase_txns[2], /*input_vout=*/0, /*input_height=*/0,
+                                                                  coinbaseKey, script_pub_key, /*output_amount=*/CAmount(1 * COIN),
+                                                                  /*submit=*/false)};
+    const uint256 known_wtxid{CTransaction{known}.GetWitnessHash()};
+
+    std::atomic<int> done{0};
+    TxPreValidator prevalidator(
+        *m_node.chainman, *m_node.mempool, /*threads=*/2,
+        [&](const CTransaction& tx) { return tx.GetWitnessHash() == known_wtxid; },
+        [&] { ++done; });
+
+    CDataStream payload(SER_NETWORK, PROTOCOL_VERSION);
+    payload << spend;
+    CDataStream truncated(Span{payload}.first(payload.size() / 2), SER_NETWORK, PROTOCOL_VERSION);
+    CDataStream known_payload(SER_NETWORK, PROTOCOL_VERSION);
+    known_payload << known;
+
+    const auto job{std::make_shared<TxPreValidationJob>(/*peer=*/0, std::move(payload))};
+    const auto bad_job{std::make_shared<TxPreValidationJob>(/*peer=*/1, std::move(truncated))};
+    const auto known_job{std::make_shared<TxPreValidationJob>(/*peer=*/2, std::move(known_payload))};
+    prevalidator.Submit(job);
+    prevalidator.Submit(bad_job);
+    prevalidator.Submit(known_job);
+    while (done < 3) UninterruptibleSleep(std::chrono::milliseconds{1});
+
+    BOOST_CHECK(job->m_done);
+    BOOST_REQUIRE(job->m_tx);
+    BOOST_CHECK_EQUAL(job->m_tx->GetWitnessHash(), CTransaction{spend}.GetWitnessHash());
+    BOOST_CHECK(job->m_error.empty());
+    BOOST_CHECK(bad_job->m_done);
+    BOOST_CHECK(!bad_job->m_tx);
+    BOOST_CHECK(!bad_job->m_error.empty());
+    BOOST_CHECK(known_job->m_done);
+    BOOST_REQUIRE(known_job->m_tx);
+    BOOST_CHECK_EQUAL(known_job->m_tx->GetWitnessHash(), known_wtxid);
+
+    prevalidator.FinishJob(*job);
+    const TxPreValidationStats stats{prevalidator.GetStats()};
+    BOOST_CHECK_EQUAL(stats.threads, 2);
+    BOOST_CHECK_EQUAL(stats.pending, 0U);
+    BOOST_CHECK_EQUAL(stats.scripts_ok, 1U);
+    BOOST_CHECK_EQUAL(stats.stages[size_t(TxPreValidationStage::DESERIALIZE)].m_count, 3U);
+    BOOST_CHECK_EQUAL(stats.stages[size_t(TxPreValidationStage::CHECK)].m_count, 2U);
+    BOOST_CHECK_EQUAL(stats.stages[size_t(TxPreValidationStage::SCRIPTS)].m_count, 1U);
+    BOOST_CHECK_EQUAL(stats.stages[size_t(TxPreValidationStage::ACCEPT)].m_count, 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,241 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txreconciliation.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+
+BOOST_FIXTURE_TEST_SUITE(txreconciliation_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(RegisterPeerTest)
+{
+    TxReconciliationTracker tracker(TXRECONCILIATION_VERSION);
+    const uint64_t salt = 0;
+
+    // Prepare a peer for reconciliation.
+    tracker.PreRegisterPeer(0);
+
+    // Invalid version.
+    BOOST_CHECK(tracker.RegisterPeer(/*peer_id=*/0, /*is_peer_inbound=*/true,
+                                     /*peer_recon_version=*/0, salt) == ReconciliationRegisterResult::PROTOCOL_VIOLATION);
+
+    // Valid registration (inbound and outbound peers).
+    BOOST_REQUIRE(!tracker.IsPeerRegistered(0));
+    BOOST_REQUIRE(tracker.RegisterPeer(0, true, 1, salt) == ReconciliationRegisterResult::SUCCESS);
+    BOOST_CHECK(tracker.IsPeerRegistered(0));
+    BOOST_CHECK(!tracker.GetPeerStats(0)->we_initiate);
+    BOOST_REQUIRE(!tracker.IsPeerRegistered(1));
+    tracker.PreRegisterPeer(1);
+    BOOST_REQUIRE(tracker.RegisterPeer(1, false, 1, salt) == ReconciliationRegisterResult::SUCCESS);
+    BOOST_CHECK(tracker.IsPeerRegistered(1));
+    BOOST_CHECK(tracker.GetPeerStats(1)->we_initiate);
+
+    // Reconciliation version is higher than ours, should be able to register.
+    BOOST_REQUIRE(!tracker.IsPeerRegistered(2));
+    tracker.PreRegisterPeer(2);
+    BOOST_REQUIRE(tracker.RegisterPeer(2, true, 2, salt) == ReconciliationRegisterResult::SUCCESS);
+    BOOST_CHECK(tracker.IsPeerRegistered(2));
+
+    // Try registering for the second time.
+    BOOST_REQUIRE(tracker.RegisterPeer(1, false, 1, salt) == ReconciliationRegisterResult::ALREADY_REGISTERED);
+
+    // Do not register if there were no pre-registration for the peer.
+    BOOST_REQUIRE(tracker.RegisterPeer(100, true, 1, salt) == ReconciliationRegisterResult::NOT_FOUND);
+    BOOST_CHECK(!tracker.IsPeerRegistered(100));
+}
+
+BOOST_AUTO_TEST_CASE(ForgetPeerTest)
+{
+    TxReconciliationTracker tracker(TXRECONCILIATION_VERSION);
+    NodeId peer_id0 = 0;
+
+    // Removing a peer after pre-registering it works and prevents registering it.
+    tracker.PreRegisterPeer(peer_id0);
+    tracker.ForgetPeer(peer_id0);
+    BOOST_CHECK(tracker.RegisterPeer(peer_id0, true, 1, 1) == ReconciliationRegisterResult::NOT_FOUND);
+
+    // Removing peer after it is registered works.
+    tracker.PreRegisterPeer(peer_id0);
+    BOOST_REQUIRE(!tracker.IsPeerRegistered(peer_id0));
+    BOOST_REQUIRE(tracker.RegisterPeer(peer_id0, true, 1, 1) == ReconciliationRegisterResult::SUCCESS);
+    BOOST_CHECK(tracker.IsPeerRegistered(peer_id0));
+    tracker.ForgetPeer(peer_id0);
+    BOOST_CHECK(!tracker.IsPeerRegistered(peer_id0));
+    BOOST_CHECK(!tracker.AddToSet(peer_id0, InsecureRand256()));
+}
+
+/** Two trackers connected to each other, as the two ends of one connection. */
+struct ReconciliationPair {
+    TxReconciliationTracker initiator{TXRECONCILIATION_VERSION};
+    TxReconciliationTracker responder{TXRECONCILIATION_VERSION};
+    // Each side's id of the other.
+    static constexpr NodeId PEER{0};
+
+    ReconciliationPair()
+    {
+        const uint64_t initiator_salt = initiator.PreRegisterPeer(PEER);
+        const uint64_t responder_salt = responder.PreRegisterPeer(PEER);
+        BOOST_REQUIRE(initiator.RegisterPeer(PEER, /*is_peer_inbound=*/false, 1, responder_salt) == ReconciliationRegisterResult::SUCCESS);
+        BOOST_REQUIRE(responder.RegisterPeer(PEER, /*is_peer_inbound=*/true, 1, initiator_salt) == ReconciliationRegisterResult::SUCCESS);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(ReconciliationRoundTest)
+{
+    ReconciliationPair pair;
+    const NodeId peer{ReconciliationPair::PEER};
+
+    // Both sides know the shared transactions, each also has some of its own.
+    std::vector<uint256> shared, initiator_only, responder_only;
+    for (int i = 0; i < 100; ++i) shared.push_back(InsecureRand256());
+    for (int i = 0; i < 5; ++i) initiator_only.push_back(InsecureRand256());
+    for (int i = 0; i < 7; ++i) responder_only.push_back(InsecureRand256());
+    for (const uint256& wtxid : shared) {
+        BOOST_CHECK(pair.initiator.AddToSet(peer, wtxid));
+        BOOST_CHECK(pair.responder.AddToSet(peer, wtxid));
+    }
+    for (const uint256& wtxid : initiator_only) BOOST_CHECK(pair.initiator.AddToSet(peer, wtxid));
+    for (const uint256& wtxid : responder_only) BOOST_CHECK(pair.responder.AddToSet(peer, wtxid));
+
+    // Only the side that made the connection requests rounds, and only once per interval.
+    const std::chrono::microseconds now{GetTime<std::chrono::microseconds>()};
+    BOOST_CHECK(!pair.responder.MaybeRequestReconciliation(peer, now));
+    const auto request{pair.initiator.MaybeRequestReconciliation(peer, now)};
+    BOOST_REQUIRE(request);
+    BOOST_CHECK_EQUAL(request->first, shared.size() + initiator_only.size());
+    BOOST_CHECK(!pair.initiator.MaybeRequestReconciliation(peer, now + RECON_REQUEST_INTERVAL));
+
+    std::vector<uint8_t> skdata;
+    BOOST_REQUIRE(pair.responder.HandleReconciliationRequest(peer, request->first, request->second, skdata, now));
+    BOOST_CHECK(!skdata.empty());
+    // A transaction arriving during the round waits for the next one.
+    BOOST_CHECK(pair.responder.AddToSet(peer, InsecureRand256()));
+
+    bool success{false};
+    std::vector<uint256> initiator_announces;
+    std::vector<uint32_t> ask_shortids;
+    BOOST_REQUIRE(pair.initiator.HandleSketch(peer, skdata, success, initiator_announces, ask_shortids));
+    BOOST_CHECK(success);
+    std::sort(initiator_announces.begin(), initiator_announces.end());
+    std::sort(initiator_only.begin(), initiator_only.end());
+    BOOST_CHECK(initiator_announces == initiator_only);
+    BOOST_CHECK_EQUAL(ask_shortids.size(), responder_only.size());
+
+    std::vector<uint256> responder_announces;
+    BOOST_REQUIRE(pair.responder.HandleReconciliationDifference(peer, success, ask_shortids, responder_announces));
+    std::sort(responder_announces.begin(), responder_announces.end());
+    std::sort(responder_only.begin(), responder_only.end());
+    BOOST_CHECK(responder_announces == responder_only);
+
+    const TxReconciliationStats initiator_stats{*pair.initiator.GetPeerStats(peer)};
+    BOOST_CHECK_EQUAL(initiator_stats.set_size, 0U);
+    BOOST_CHECK_EQUAL(initiator_stats.rounds, 1U);
+    BOOST_CHECK_EQUAL(initiator_stats.failed_rounds, 0U);
+    BOOST_CHECK_EQUAL(initiator_stats.sketch_bytes_recv, skdata.size());
+    const TxReconciliationStats responder_stats{*pair.responder.GetPeerStats(peer)};
+    BOOST_CHECK_EQUAL(responder_stats.set_size, 1U);
+    BOOST_CHECK_EQUAL(responder_stats.sketch_bytes_sent, skdata.size());
+
+    // Messages out of turn are protocol violations.
+    BOOST_CHECK(!pair.initiator.HandleSketch(peer, skdata, success, initiator_announces, ask_shortids));
+    BOOST_CHECK(!pair.responder.HandleReconciliationDifference(peer, true, {}, responder_announces));
+    BOOST_CHECK(!pair.initiator.HandleReconciliationRequest(peer, 0, RECON_Q, skdata, now));
+}
+
+BOOST_AUTO_TEST_CASE(ReconciliationFailureTest)
+{
+    ReconciliationPair pair;
+    const NodeId peer{ReconciliationPair::PEER};
+
+    // Sets of the same size with nothing in common: the sketch is sized for the
+    // expected difference, which is much smaller than the actual one.
+    std::vector<uint256> initiator_txs, responder_txs;
+    for (int i = 0; i < 40; ++i) {
+        initiator_txs.push_back(InsecureRand256());
+        BOOST_CHECK(pair.initiator.AddToSet(peer, initiator_txs.back()));
+        responder_txs.push_back(InsecureRand256());
+        BOOST_CHECK(pair.responder.AddToSet(peer, responder_txs.back()));
+    }
+
+    const std::chrono::microseconds now{GetTime<std::chrono::microseconds>()};
+    const auto request{pair.initiator.MaybeRequestReconciliation(peer, now)};
+    BOOST_REQUIRE(request);
+    std::vector<uint8_t> skdata;
+    BOOST_REQUIRE(pair.responder.HandleReconciliationRequest(peer, request->first, request->second, skdata, now));
+
+    bool success{true};
+    std::vector<uint256> initiator_announces;
+    std::vector<uint32_t> ask_shortids;
+    BOOST_REQUIRE(pair.initiator.HandleSketch(peer, skdata, success, initiator_announces, ask_shortids));
+    BOOST_CHECK(!success);
+    BOOST_CHECK(ask_shortids.empty());
+    BOOST_CHECK_EQUAL(initiator_announces.size(), initiator_txs.size());
+
+    // On failure both sides fall back to announcing their whole set.
+    std::vector<uint256> responder_announces;
+    BOOST_REQUIRE(pair.responder.HandleReconciliationDifference(peer, success, ask_shortids, responder_announces));
+    BOOST_CHECK_EQUAL(responder_announces.size(), responder_txs.size());
+    BOOST_CHECK_EQUAL(pair.initiator.GetPeerStats(peer)->failed_rounds, 1U);
+    BOOST_CHECK_EQUAL(pair.responder.GetPeerStats(peer)->failed_rounds, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(ReconciliationRequestWhileOpenTest)
+{
+    ReconciliationPair pair;
+    const NodeId peer{ReconciliationPair::PEER};
+
+    std::vector<uint256> responder_txs;
+    for (int i = 0; i < 10; ++i) {
+        responder_txs.push_back(InsecureRand256());
+        BOOST_CHECK(pair.responder.AddToSet(peer, responder_txs.back()));
+    }
+
+    const std::chrono::microseconds now{GetTime<std::chrono::microseconds>()};
+    std::vector<uint8_t> skdata;
+    BOOST_REQUIRE(pair.responder.HandleReconciliationRequest(peer, 0, RECON_Q, skdata, now));
+
+    // A new request before RECONCILDIFF is a protocol violation, unless the
+    // peer waited as long as it does before it gives up on a round.
+    BOOST_CHECK(!pair.responder.HandleReconciliationRequest(peer, 0, RECON_Q, skdata, now));
+    BOOST_CHECK(!pair.responder.HandleReconciliationRequest(peer, 0, RECON_Q, skdata, now + RECON_REQUEST_INTERVAL));
+    BOOST_CHECK_EQUAL(pair.responder.GetPeerStats(peer)->rounds, 1U);
+    BOOST_REQUIRE(pair.responder.HandleReconciliationRequest(peer, 0, RECON_Q, skdata, now + RECON_RESPONSE_TIMEOUT));
+    BOOST_CHECK_EQUAL(pair.responder.GetPeerStats(peer)->rounds, 2U);
+
+    // The abandoned round's transactions are part of the new one.
+    std::vector<uint256> responder_announces;
+    BOOST_REQUIRE(pair.responder.HandleReconciliationDifference(peer, /*success=*/false, {}, responder_announces));
+    BOOST_CHECK_EQUAL(responder_announces.size(), responder_txs.size());
+
+    // Once a round is finished, the next one may start right away.
+    BOOST_CHECK(pair.responder.HandleReconciliationRequest(peer, 0, RECON_Q, skdata, now + RECON_RESPONSE_TIMEOUT));
+}
+
+BOOST_AUTO_TEST_CASE(SetOverflowTest)
+{
+    TxReconciliationTracker tracker(TXRECONCILIATION_VERSION);
+    const NodeId peer{0};
+    tracker.PreRegisterPeer(peer);
+    BOOST_REQUIRE(tracker.RegisterPeer(peer, true, 1, 1) == ReconciliationRegisterResult::SUCCESS);
+
+    const uint256 first_wtxid{InsecureRand256()};
+    BOOST_CHECK(tracker.AddToSet(peer, first_wtxid));
+    for (size_t i = 1; i < MAX_RECONSET_SIZE; ++i) BOOST_CHECK(tracker.AddToSet(peer, InsecureRand256()));
+    // A full set makes the caller flood the transaction instead.
+    BOOST_CHECK(!tracker.AddToSet(peer, InsecureRand256()));
+    BOOST_CHECK_EQUAL(tracker.GetPeerStats(peer)->set_overflows, 1U);
+
+    // Transactions the peer announced to us are dropped from the set.
+    tracker.TryRemovingFromSet(peer, InsecureRand256());
+    BOOST_CHECK_EQUAL(tracker.GetPeerStats(peer)->set_size, MAX_RECONSET_SIZE);
+    tracker.TryRemovingFromSet(peer, first_wtxid);
+    BOOST_CHECK_EQUAL(tracker.GetPeerStats(peer)->set_size, MAX_RECONSET_SIZE - 1);
+    BOOST_CHECK(tracker.AddToSet(peer, InsecureRand256()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
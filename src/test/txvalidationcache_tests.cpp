@@ -18,6 +18,11 @@ struct Dersig100Setup : public TestChain100Setup {
         : TestChain100Setup{{"-testactivationheight=dersig@102"}} {}
 };
 
+struct WorkStealing100Setup : public TestChain100Setup {
+    WorkStealing100Setup()
+        : TestChain100Setup{{"-parworkstealing"}} {}
+};
+
 bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
                        const CCoinsViewCache& inputs, unsigned int flags, bool cacheSigStore,
                        bool cacheFullScriptStore, PrecomputedTransactionData& txdata,
@@ -383,4 +388,62 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, Dersig100Setup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(connect_block_work_stealing, WorkStealing100Setup)
+{
+    // ConnectBlock hands its script checks to the work-stealing queue. A block
+    // connects if all of them pass and is rejected if any one of them fails.
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CKey other_key;
+    other_key.MakeNewKey(true);
+
+    const auto Spend = [&](const COutPoint& prevout, const std::vector<CAmount>& values, const CKey& key) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        for (const CAmount value : values) {
+            tx.vout.emplace_back(value, scriptPubKey);
+        }
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(key.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig << vchSig;
+        return tx;
+    };
+
+    // Only the first coinbase is mature, so split it up for the blocks below.
+    const CMutableTransaction funding = Spend(COutPoint(m_coinbase_txns[0]->GetHash(), 0), std::vector<CAmount>(60, CENT), coinbaseKey);
+    CBlock block = CreateAndProcessBlock({funding}, scriptPubKey);
+    const auto MakeSpends = [&](uint32_t first, const CKey& key) {
+        std::vector<CMutableTransaction> spends;
+        for (uint32_t n = first; n < first + 20; ++n) {
+            spends.push_back(Spend(COutPoint(funding.GetHash(), n), {CENT / 2}, key));
+        }
+        return spends;
+    };
+
+    block = CreateAndProcessBlock(MakeSpends(0, coinbaseKey), scriptPubKey);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(m_node.chainman->ActiveChain().Tip()->GetBlockHash() == block.GetHash());
+    }
+
+    std::vector<CMutableTransaction> spends = MakeSpends(20, coinbaseKey);
+    spends[13] = Spend(spends[13].vin[0].prevout, {CENT / 2}, other_key);
+    block = CreateAndProcessBlock(spends, scriptPubKey);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(m_node.chainman->ActiveChain().Tip()->GetBlockHash() != block.GetHash());
+    }
+
+    // The queue is usable again after the failure.
+    block = CreateAndProcessBlock(MakeSpends(40, coinbaseKey), scriptPubKey);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(m_node.chainman->ActiveChain().Tip()->GetBlockHash() == block.GetHash());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -153,7 +153,7 @@ ChainTestingSetup::ChainTestingSetup(const std::string& chainName, const std::ve
 
     // Start script-checking threads. Set g_parallel_script_checks to true so they are used.
     constexpr int script_check_threads = 2;
-    StartScriptCheckWorkerThreads(script_check_threads);
+    StartScriptCheckWorkerThreads(script_check_threads, m_args.GetBoolArg("-parworkstealing", DEFAULT_SCRIPTCHECK_WORK_STEALING));
     g_parallel_script_checks = true;
 }
 
@@ -186,7 +186,6 @@ TestingSetup::TestingSetup(const std::string& chainName, const std::vector<const
                              *Assert(m_node.chainman.get()),
                              Assert(m_node.mempool.get()),
                              fPruneMode,
-                             m_args.GetBoolArg("-namehistory", false),
                              chainparams.GetConsensus(),
                              m_args.GetBoolArg("-reindex-chainstate", false),
                              m_cache_sizes.block_tree_db,
@@ -356,4 +356,39 @@ BOOST_AUTO_TEST_CASE(witness_commitment_index)
 
     BOOST_CHECK_EQUAL(GetWitnessCommitmentIndex(pblock), 2);
 }
+
+BOOST_AUTO_TEST_CASE(processnewblockheaders_invalid_pow)
+{
+    const Consensus::Params& consensus{Params().GetConsensus()};
+    std::vector<CBlockHeader> headers;
+    CBlockHeader prev{Params().GenesisBlock().GetBlockHeader()};
+    for (int i = 0; i < 20; ++i) {
+        CBlockHeader header;
+        header.SetBaseVersion(4, consensus.nAuxpowChainId);
+        header.hashPrevBlock = prev.GetHash();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = prev.nTime + 1;
+        header.nBits = prev.nBits;
+        auto& parent = CAuxPow::initAuxPow(header);
+        // The header at height 15 has a parent block that misses the target.
+        while (CheckProofOfWork(parent.GetHash(), header.nBits, consensus) == (i == 14)) {
+            ++parent.nNonce;
+        }
+        headers.push_back(header);
+        prev = header;
+    }
+
+    // The headers are checked in parallel, but those before the invalid one
+    // are still accepted, and the state names the failure.
+    BlockValidationState state;
+    const CBlockIndex* last{nullptr};
+    BOOST_CHECK(!m_node.chainman->ProcessNewBlockHeaders(headers, state, Params(), &last));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_REQUIRE(last);
+    BOOST_CHECK_EQUAL(last->GetBlockHash(), headers[13].GetHash());
+    LOCK(::cs_main);
+    BOOST_CHECK(!m_node.chainman->m_blockman.LookupBlockIndex(headers[14].GetHash()));
+    BOOST_CHECK_EQUAL(pindexBestHeader->GetBlockHash(), headers[13].GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,7 +6,10 @@
 #include <random.h>
 #include <uint256.h>
 #include <consensus/validation.h>
+#include <node/blockstorage.h>
+#include <streams.h>
 #include <sync.h>
+#include <undo.h>
 #include <rpc/blockchain.h>
 #include <test/util/chainstate.h>
 #include <test/util/setup_common.h>
@@ -150,4 +153,55 @@ BOOST_FIXTURE_TEST_CASE(chainstate_update_tip, TestChain100Setup)
     BOOST_CHECK_EQUAL(curr_tip, ::g_best_block);
 }
 
+//! Test that the disconnect readahead hands out the same block and undo data
+//! as reading them directly, and that callers straying from the run fall back.
+BOOST_FIXTURE_TEST_CASE(disconnect_readahead, TestChain100Setup)
+{
+    CChainState& chainstate = Assert(m_node.chainman)->ActiveChainstate();
+    const CChain& chain = chainstate.m_chain;
+    CBlockIndex* old_tip = WITH_LOCK(::cs_main, return chain.Tip());
+    BOOST_REQUIRE_EQUAL(old_tip->nHeight, 100);
+
+    {
+        LOCK(::cs_main);
+        // Runs of fewer than two blocks are not worth a thread.
+        BOOST_CHECK(!chainstate.StartDisconnectReadahead(chain.Tip(), chain.Tip()->pprev, /* warm= */ true));
+        BOOST_CHECK(!chainstate.StartDisconnectReadahead(chain[1], nullptr, /* warm= */ true));
+
+        auto readahead = chainstate.StartDisconnectReadahead(chain.Tip(), chain[60], /* warm= */ true);
+        BOOST_REQUIRE(readahead);
+        for (const CBlockIndex* pindex = chain.Tip(); pindex != chain[60]; pindex = pindex->pprev) {
+            auto block = std::make_shared<CBlock>();
+            CBlockUndo undo;
+            BOOST_REQUIRE(readahead->Take(pindex, block, undo));
+            BOOST_CHECK_EQUAL(block->GetHash(), pindex->GetBlockHash());
+
+            CBlockUndo expected;
+            BOOST_REQUIRE(UndoReadFromDisk(expected, pindex));
+            CDataStream got_ser{SER_DISK, PROTOCOL_VERSION}, expected_ser{SER_DISK, PROTOCOL_VERSION};
+            got_ser << undo;
+            expected_ser << expected;
+            BOOST_CHECK(got_ser.str() == expected_ser.str());
+        }
+        // The run is exhausted.
+        auto block = std::make_shared<CBlock>();
+        CBlockUndo undo;
+        BOOST_CHECK(!readahead->Take(chain[60], block, undo));
+
+        // Taking out of order stops the readahead for good.
+        readahead = chainstate.StartDisconnectReadahead(chain.Tip(), chain[90], /* warm= */ false);
+        BOOST_REQUIRE(readahead);
+        BOOST_CHECK(!readahead->Take(chain[99], block, undo));
+        BOOST_CHECK(!readahead->Take(chain.Tip(), block, undo));
+    }
+
+    // Deep invalidation and reconsideration go through the readahead.
+    BlockValidationState state;
+    BOOST_CHECK(chainstate.InvalidateBlock(state, old_tip->GetAncestor(50)));
+    BOOST_CHECK_EQUAL(WITH_LOCK(::cs_main, return chain.Height()), 49);
+    WITH_LOCK(::cs_main, chainstate.ResetBlockFailureFlags(old_tip->GetAncestor(50)));
+    BOOST_CHECK(chainstate.ActivateBestChain(state));
+    BOOST_CHECK_EQUAL(WITH_LOCK(::cs_main, return chain.Tip()), old_tip);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,9 +3,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <clientversion.h>
 #include <consensus/amount.h>
 #include <net.h>
 #include <signet.h>
+#include <streams.h>
+#include <txdb.h>
 #include <uint256.h>
 #include <validation.h>
 
@@ -144,4 +147,103 @@ BOOST_AUTO_TEST_CASE(test_assumeutxo)
     BOOST_CHECK_EQUAL(out210.nChainTx, 200U);
 }
 
+//! Load enough block index entries from disk to exercise the chunked,
+//! multi-threaded deserialization and the arena allocation.
+BOOST_AUTO_TEST_CASE(load_block_index)
+{
+    constexpr int num_entries{40000};
+
+    std::vector<std::unique_ptr<CBlockIndex>> entries;
+    std::vector<uint256> hashes(num_entries);
+    for (int i = 0; i < num_entries; ++i) {
+        auto pindex = std::make_unique<CBlockIndex>();
+        pindex->pprev = i > 0 ? entries.back().get() : nullptr;
+        pindex->nHeight = i;
+        pindex->nTime = 1600000000 + i;
+        pindex->nBits = 0x207fffff;
+        pindex->nNonce = i;
+        pindex->nStatus = BLOCK_VALID_TREE;
+        hashes[i] = CDiskBlockIndex(pindex.get()).GetBlockHash();
+        pindex->phashBlock = &hashes[i];
+        entries.push_back(std::move(pindex));
+    }
+
+    auto block_tree_db = std::make_unique<CBlockTreeDB>(1 << 20, /*fMemory=*/true);
+    std::vector<const CBlockIndex*> to_write;
+    for (const auto& pindex : entries) to_write.push_back(pindex.get());
+    BOOST_REQUIRE(block_tree_db->WriteBatchSync({}, 0, to_write));
+
+    CBlockIndex* const best_header = WITH_LOCK(::cs_main, return pindexBestHeader);
+    {
+        LOCK(::cs_main);
+        BlockManager blockman;
+        blockman.m_block_tree_db = std::move(block_tree_db);
+        std::set<CBlockIndex*, CBlockIndexWorkComparator> candidates;
+        BOOST_REQUIRE(blockman.LoadBlockIndex(Params().GetConsensus(), candidates));
+        BOOST_REQUIRE_EQUAL(blockman.m_block_index.size(), size_t{num_entries});
+
+        for (int i = 0; i < num_entries; ++i) {
+            const CBlockIndex* pindex = blockman.LookupBlockIndex(hashes[i]);
+            BOOST_REQUIRE(pindex);
+            BOOST_CHECK_EQUAL(pindex->nHeight, i);
+            BOOST_CHECK_EQUAL(pindex->nNonce, uint32_t(i));
+            if (i > 0) {
+                BOOST_CHECK(pindex->pprev && pindex->pprev->GetBlockHash() == hashes[i - 1]);
+                BOOST_CHECK(pindex->nChainWork > pindex->pprev->nChainWork);
+            }
+        }
+        BOOST_CHECK(pindexBestHeader->GetBlockHash() == hashes.back());
+
+        // Entries added after loading live outside the arena.
+        BOOST_CHECK(blockman.InsertBlockIndex(InsecureRand256()));
+        pindexBestHeader = best_header;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(scan_external_block_file)
+{
+    const CChainParams& params = Params();
+    CBlock block1 = params.GenesisBlock();
+    CBlock block2 = params.GenesisBlock();
+    block2.nNonce ^= 1;
+
+    // Two block records with garbage before, between and after them.
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << uint32_t{0xdeadbeef};
+    std::vector<uint64_t> positions;
+    for (const CBlock& block : {block1, block2}) {
+        stream << params.MessageStart();
+        stream << uint32_t(::GetSerializeSize(block, CLIENT_VERSION));
+        positions.push_back(stream.size());
+        stream << block << uint8_t{0x42};
+    }
+    stream << params.MessageStart();
+
+    const fs::path path = m_args.GetDataDirBase() / "blocks.dat";
+    FILE* file = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(stream.data(), 1, stream.size(), file), stream.size());
+    fclose(file);
+
+    std::vector<std::pair<uint256, uint64_t>> found;
+    ScanExternalBlockFile(fsbridge::fopen(path, "rb"), params, [&](std::shared_ptr<CBlock> pblock, uint64_t pos, unsigned int size) {
+        BOOST_CHECK_EQUAL(size, ::GetSerializeSize(*pblock, CLIENT_VERSION));
+        found.emplace_back(pblock->GetHash(), pos);
+        return true;
+    });
+    BOOST_REQUIRE_EQUAL(found.size(), 2U);
+    BOOST_CHECK(found[0].first == block1.GetHash());
+    BOOST_CHECK_EQUAL(found[0].second, positions[0]);
+    BOOST_CHECK(found[1].first == block2.GetHash());
+    BOOST_CHECK_EQUAL(found[1].second, positions[1]);
+
+    // Returning false stops the scan.
+    found.clear();
+    ScanExternalBlockFile(fsbridge::fopen(path, "rb"), params, [&](std::shared_ptr<CBlock> pblock, uint64_t pos, unsigned int) {
+        found.emplace_back(pblock->GetHash(), pos);
+        return false;
+    });
+    BOOST_CHECK_EQUAL(found.size(), 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
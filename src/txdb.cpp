@@ -14,18 +14,24 @@
 #include <shutdown.h>
 #include <uint256.h>
 #include <util/system.h>
+#include <util/time.h>
 #include <util/translation.h>
 #include <util/vector.h>
 #include <validation.h>
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 static constexpr uint8_t DB_COIN{'C'};
 static constexpr uint8_t DB_COINS{'c'};
 static constexpr uint8_t DB_BLOCK_FILES{'f'};
 static constexpr uint8_t DB_BLOCK_INDEX{'b'};
 
 static constexpr uint8_t DB_NAME{'n'};
+//! Name history kept in the chainstate before it moved to the name history index
 static constexpr uint8_t DB_NAME_HISTORY{'h'};
 static constexpr uint8_t DB_NAME_EXPIRY{'x'};
 
@@ -70,7 +76,7 @@ struct CoinEntry {
 }
 
 CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe) :
-    m_db(std::make_unique<CDBWrapper>(ldb_path, nCacheSize, fMemory, fWipe, true)),
+    m_db(std::make_unique<CDBWrapper>(ldb_path, nCacheSize, fMemory, fWipe, true, DBOptionsFromArgs("chainstate"))),
     m_ldb_path(ldb_path),
     m_is_memory(fMemory) { }
 
@@ -83,7 +89,7 @@ void CCoinsViewDB::ResizeCache(size_t new_cache_size)
         // filesystem lock.
         m_db.reset();
         m_db = std::make_unique<CDBWrapper>(
-            m_ldb_path, new_cache_size, m_is_memory, /*fWipe*/ false, /*obfuscate*/ true);
+            m_ldb_path, new_cache_size, m_is_memory, /*fWipe*/ false, /*obfuscate*/ true, DBOptionsFromArgs("chainstate"));
     }
 }
 
@@ -114,11 +120,6 @@ bool CCoinsViewDB::GetName(const valtype &name, CNameData& data) const {
     return m_db->Read(std::make_pair(DB_NAME, name), data);
 }
 
-bool CCoinsViewDB::GetNameHistory(const valtype &name, CNameHistory& data) const {
-    assert (fNameHistory);
-    return m_db->Read(std::make_pair(DB_NAME_HISTORY, name), data);
-}
-
 bool CCoinsViewDB::GetNamesForHeight(unsigned nHeight, std::set<valtype>& names) const {
     names.clear();
 
@@ -271,7 +272,7 @@ size_t CCoinsViewDB::EstimateSize() const
     return m_db->EstimateSize(DB_COIN, uint8_t(DB_COIN + 1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.GetDataDirNet() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.GetDataDirNet() / "blocks" / "index", nCacheSize, fMemory, fWipe, /*obfuscate=*/false, DBOptionsFromArgs("blockindex")) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -409,7 +410,6 @@ bool CCoinsViewDB::ValidateNameDB(const CChainState& chainState, const std::func
     std::map<valtype, unsigned> nameHeightsData;
     std::set<valtype> namesInDB;
     std::set<valtype> namesInUTXO;
-    std::set<valtype> namesWithHistory;
 
     for (; pcursor->Valid(); pcursor->Next())
     {
@@ -467,21 +467,6 @@ bool CCoinsViewDB::ValidateNameDB(const CChainState& chainState, const std::func
             break;
         }
 
-        case DB_NAME_HISTORY:
-        {
-            std::pair<char, valtype> key;
-            if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY)
-                return error("%s : failed to read DB_NAME_HISTORY key",
-                             __func__);
-            const valtype& name = key.second;
-
-            if (namesWithHistory.count(name) > 0)
-                return error("%s : name %s has duplicate history",
-                             __func__, EncodeNameForMessage(name));
-            namesWithHistory.insert(name);
-            break;
-        }
-
         case DB_NAME_EXPIRY:
         {
             std::pair<char, CNameCache::ExpireEntry> key;
@@ -520,19 +505,8 @@ bool CCoinsViewDB::ValidateNameDB(const CChainState& chainState, const std::func
             return error("%s : name '%s' in UTXO set but not DB",
                          __func__, EncodeNameForMessage(name));
 
-    if (fNameHistory)
-    {
-        for (const auto& name : namesWithHistory)
-            if (nameHeightsData.count(name) == 0)
-                return error("%s : history entry for name '%s' not in main DB",
-                             __func__, EncodeNameForMessage(name));
-    } else if (!namesWithHistory.empty ())
-        return error("%s : name_history entries in DB, but"
-                     " -namehistory not set", __func__);
-
     LogPrintf("Checked name database, %u unexpired names, %u total.\n",
               namesInDB.size(), nameHeightsData.size());
-    LogPrintf("Names with history: %u\n", namesWithHistory.size());
 
     return true;
 }
@@ -548,14 +522,6 @@ CNameCache::writeBatch (CDBBatch& batch) const
        i != deleted.end (); ++i)
     batch.Erase (std::make_pair (DB_NAME, *i));
 
-  assert (fNameHistory || history.empty ());
-  for (std::map<valtype, CNameHistory>::const_iterator i = history.begin ();
-       i != history.end (); ++i)
-    if (i->second.empty ())
-      batch.Erase (std::make_pair (DB_NAME_HISTORY, i->first));
-    else
-      batch.Write (std::make_pair (DB_NAME_HISTORY, i->first), i->second);
-
   for (std::map<ExpireEntry, bool>::const_iterator i = expireIndex.begin ();
        i != expireIndex.end (); ++i)
     if (i->second)
@@ -576,48 +542,107 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+namespace {
+/** Number of block index records deserialized per parallel round. */
+constexpr size_t BLOCK_INDEX_LOAD_CHUNK{16384};
+/** Upper bound on the threads used to deserialize the block index. */
+constexpr int MAX_BLOCK_INDEX_LOAD_THREADS{8};
+} // namespace
+
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
+                                      std::function<void(size_t)> reserve)
 {
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
+    const int64_t time_start = GetTimeMillis();
 
-    // Load m_block_index
-    while (pcursor->Valid()) {
+    // Copy the raw records into one contiguous buffer first. LevelDB iteration
+    // is sequential anyway, and this keeps the expensive part (deserializing
+    // and hashing the headers) free to run in parallel.
+    std::vector<unsigned char> raw;
+    std::vector<std::pair<size_t, size_t>> records;
+    {
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        for (pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256())); pcursor->Valid(); pcursor->Next()) {
+            if (ShutdownRequested()) return false;
+            std::pair<uint8_t, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) break;
+            const auto value = pcursor->GetRawValue();
+            records.emplace_back(raw.size(), value.size());
+            raw.insert(raw.end(), value.begin(), value.end());
+        }
+    }
+    if (reserve) reserve(records.size());
+    const int64_t time_read = GetTimeMillis();
+
+    const int n_threads = std::max(1, std::min({GetNumCores(), MAX_BLOCK_INDEX_LOAD_THREADS,
+                                                static_cast<int>(records.size() / 1024)}));
+    const std::vector<unsigned char>& obfuscate_key = dbwrapper_private::GetObfuscateKey(*this);
+    std::vector<CDiskBlockIndex> entries(std::min(records.size(), BLOCK_INDEX_LOAD_CHUNK));
+    std::vector<uint256> hashes(entries.size());
+    int64_t time_deserialize = 0;
+    int64_t time_link = 0;
+
+    for (size_t chunk_begin = 0; chunk_begin < records.size(); chunk_begin += BLOCK_INDEX_LOAD_CHUNK) {
         if (ShutdownRequested()) return false;
-        std::pair<uint8_t, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                /* Bitcoin checks the PoW here.  We don't do this because
-                   the CDiskBlockIndex does not contain the auxpow.
-                   This check isn't important, since the data on disk should
-                   already be valid and can be trusted.  */
-
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
+        const size_t chunk_size = std::min(BLOCK_INDEX_LOAD_CHUNK, records.size() - chunk_begin);
+        const int64_t time_chunk = GetTimeMillis();
+
+        std::atomic<bool> failed{false};
+        const auto deserialize = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end && !failed; ++i) {
+                const auto& [offset, size] = records[chunk_begin + i];
+                try {
+                    CDataStream ssValue(Span<const unsigned char>(raw.data() + offset, size), SER_DISK, CLIENT_VERSION);
+                    ssValue.Xor(obfuscate_key);
+                    entries[i] = CDiskBlockIndex();
+                    ssValue >> entries[i];
+                    hashes[i] = entries[i].GetBlockHash();
+                } catch (const std::exception&) {
+                    failed = true;
+                }
             }
-        } else {
-            break;
+        };
+        std::vector<std::thread> threads;
+        const size_t per_thread = (chunk_size + n_threads - 1) / n_threads;
+        for (int t = 1; t < n_threads; ++t) {
+            const size_t begin = std::min(chunk_size, t * per_thread);
+            threads.emplace_back(deserialize, begin, std::min(chunk_size, begin + per_thread));
         }
+        deserialize(0, std::min(chunk_size, per_thread));
+        for (std::thread& thread : threads) thread.join();
+        if (failed) {
+            return error("%s: failed to read value", __func__);
+        }
+        const int64_t time_deserialized = GetTimeMillis();
+        time_deserialize += time_deserialized - time_chunk;
+
+        for (size_t i = 0; i < chunk_size; ++i) {
+            const CDiskBlockIndex& diskindex = entries[i];
+            // Construct block index object
+            CBlockIndex* pindexNew = insertBlockIndex(hashes[i]);
+            pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight        = diskindex.nHeight;
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nTx            = diskindex.nTx;
+
+            /* Bitcoin checks the PoW here.  We don't do this because
+               the CDiskBlockIndex does not contain the auxpow.
+               This check isn't important, since the data on disk should
+               already be valid and can be trusted.  */
+        }
+        time_link += GetTimeMillis() - time_deserialized;
     }
 
+    LogPrintf("%s: %u entries (%.1fMiB) read in %dms, deserialized on %d threads in %dms, linked in %dms\n",
+              __func__, records.size(), raw.size() / 1024.0 / 1024.0, time_read - time_start,
+              n_threads, time_deserialize, time_link);
     return true;
 }
 
@@ -676,11 +701,45 @@ public:
 
 }
 
+/** Remove the name history entries written by versions that kept it in the chainstate. */
+static bool EraseLegacyNameHistory(CDBWrapper& db)
+{
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    const std::pair<uint8_t, valtype> first_key{DB_NAME_HISTORY, valtype()};
+    pcursor->Seek(first_key);
+    std::pair<uint8_t, valtype> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_NAME_HISTORY) {
+        return true;
+    }
+
+    LogPrintf("Removing name history from the chainstate database (it is kept by -namehistory in its own index now)...\n");
+    size_t count = 0;
+    CDBBatch batch(db);
+    for (; pcursor->Valid(); pcursor->Next()) {
+        if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY) break;
+        batch.Erase(key);
+        ++count;
+        if (batch.SizeEstimate() > (1 << 24)) {
+            if (!db.WriteBatch(batch)) return false;
+            batch.Clear();
+        }
+    }
+    if (!db.WriteBatch(batch)) return false;
+    db.CompactRange(first_key, key);
+    LogPrintf("Removed the history of %u names.\n", count);
+    return true;
+}
+
 /** Upgrade the database from older formats.
  *
- * Currently implemented: from the per-tx utxo model (0.8..0.14.x) to per-txout.
+ * Currently implemented: from the per-tx utxo model (0.8..0.14.x) to per-txout,
+ * and removal of the name history.
  */
 bool CCoinsViewDB::Upgrade() {
+    if (!EraseLegacyNameHistory(*m_db)) {
+        return error("%s: cannot remove the name history", __func__);
+    }
+
     std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
     pcursor->Seek(std::make_pair(DB_COINS, uint256()));
     if (!pcursor->Valid()) {
@@ -15,12 +15,14 @@
 #include <policy/settings.h>
 #include <reverse_iterator.h>
 #include <util/moneystr.h>
+#include <util/rbf.h>
 #include <util/system.h>
 #include <util/time.h>
 #include <validationinterface.h>
 
 #include <cmath>
 #include <optional>
+#include <unordered_map>
 
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
 struct update_descendant_state
@@ -124,6 +126,7 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendan
 void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashesToUpdate)
 {
     AssertLockHeld(cs);
+    m_snapshot.reset();
     // For each entry in vHashesToUpdate, store the set of in-mempool, but not
     // in-vHashesToUpdate transactions, so that we don't have to recalculate
     // descendants when we come across a previously seen entry.
@@ -435,6 +438,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
     // Used by AcceptToMemoryPool(), which DOES do
     // all the appropriate checks.
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
+    m_snapshot.reset();
 
     // Update transaction for any feeDelta created by PrioritiseTransaction
     // TODO: refactor so that the fee delta is calculated before inserting
@@ -450,6 +454,13 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
     // further updated.)
     cachedInnerUsage += entry.DynamicMemoryUsage();
 
+    // Start out in a cluster of its own; connecting to the parents below
+    // merges it with theirs.
+    CTxMemPoolCluster& cluster = CreateCluster();
+    newit->m_cluster = &cluster;
+    newit->m_cluster_pos = 0;
+    cluster.txs.push_back(&*newit);
+
     const CTransaction& tx = newit->GetTx();
     std::set<uint256> setParentTransactions;
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
@@ -486,6 +497,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 {
     names.remove (*it);
+    m_snapshot.reset();
 
     // We increment mempool sequence value no matter removal reason
     // even if not directly reported below.
@@ -518,6 +530,7 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     m_total_fee -= it->GetFee();
     cachedInnerUsage -= it->DynamicMemoryUsage();
     cachedInnerUsage -= memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst());
+    RemoveFromCluster(it);
     mapTx.erase(it);
     nTransactionsUpdated++;
     if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
@@ -663,6 +676,10 @@ void CTxMemPool::_clear()
     mapTx.clear();
     mapNextTx.clear();
     names.clear();
+    m_clusters.clear();
+    m_dirty_clusters.clear();
+    m_clusters_by_worst_chunk.clear();
+    m_snapshot.reset();
     totalTxSize = 0;
     m_total_fee = 0;
     cachedInnerUsage = 0;
@@ -725,6 +742,12 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
         };
         assert(setParentCheck.size() == it->GetMemPoolParentsConst().size());
         assert(std::equal(setParentCheck.begin(), setParentCheck.end(), it->GetMemPoolParentsConst().begin(), comp));
+        // Check that the transaction is in its cluster, and its parents are as well.
+        assert(it->m_cluster != nullptr);
+        assert(it->m_cluster_pos < it->m_cluster->txs.size() && it->m_cluster->txs[it->m_cluster_pos] == &*it);
+        for (const CTxMemPoolEntry& parent : it->GetMemPoolParentsConst()) {
+            assert(parent.m_cluster == it->m_cluster);
+        }
         // Verify ancestor state is correct.
         setEntries setAncestors;
         uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -785,6 +808,24 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
     assert(m_total_fee == check_total_fee);
     assert(innerUsage == cachedInnerUsage);
 
+    size_t cluster_txs{0};
+    size_t linearized_clusters{0};
+    for (const auto& [id, cluster] : m_clusters) {
+        assert(cluster->id == id && !cluster->txs.empty());
+        assert(cluster->dirty == (m_dirty_clusters.count(id) > 0));
+        if (!cluster->dirty) {
+            // Only linearized clusters can be compared by worst chunk, so
+            // the others are accounted for through the sizes below.
+            assert(cluster->chunks.back().end == cluster->txs.size());
+            assert(m_clusters_by_worst_chunk.count(cluster.get()) > 0);
+            ++linearized_clusters;
+        }
+        cluster_txs += cluster->txs.size();
+    }
+    assert(cluster_txs == mapTx.size());
+    assert(linearized_clusters == m_clusters_by_worst_chunk.size());
+    assert(m_dirty_clusters.size() + m_clusters_by_worst_chunk.size() == m_clusters.size());
+
     checkNames(active_coins_tip, spendheight);
 }
 
@@ -869,6 +910,90 @@ std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
     return ret;
 }
 
+/** Whether an entry signals BIP125 replaceability itself or through one of
+ *  its ancestors, as IsRBFOptIn finds it. Memoized, as snapshots ask this for
+ *  every entry and ancestors are shared. */
+static bool SignalsOptInRBFWithAncestors(const CTxMemPoolEntry& entry, std::unordered_map<const CTxMemPoolEntry*, bool>& memo)
+{
+    const auto it = memo.find(&entry);
+    if (it != memo.end()) return it->second;
+    bool replaceable{SignalsOptInRBF(entry.GetTx())};
+    for (const CTxMemPoolEntry& parent : entry.GetMemPoolParentsConst()) {
+        if (replaceable) break;
+        replaceable = SignalsOptInRBFWithAncestors(parent, memo);
+    }
+    memo.emplace(&entry, replaceable);
+    return replaceable;
+}
+
+static MempoolSnapshot::Entry MakeSnapshotEntry(const CTxMemPoolEntry& e, bool unbroadcast, std::unordered_map<const CTxMemPoolEntry*, bool>& rbf_memo)
+{
+    MempoolSnapshot::Entry entry;
+    entry.tx = e.GetSharedTx();
+    entry.vsize = e.GetTxSize();
+    entry.weight = e.GetTxWeight();
+    entry.fee = e.GetFee();
+    entry.modified_fee = e.GetModifiedFee();
+    entry.time = e.GetTime();
+    entry.height = e.GetHeight();
+    entry.count_with_descendants = e.GetCountWithDescendants();
+    entry.size_with_descendants = e.GetSizeWithDescendants();
+    entry.mod_fees_with_descendants = e.GetModFeesWithDescendants();
+    entry.count_with_ancestors = e.GetCountWithAncestors();
+    entry.size_with_ancestors = e.GetSizeWithAncestors();
+    entry.mod_fees_with_ancestors = e.GetModFeesWithAncestors();
+    entry.bip125_replaceable = SignalsOptInRBFWithAncestors(e, rbf_memo);
+    entry.unbroadcast = unbroadcast;
+    entry.parents.reserve(e.GetMemPoolParentsConst().size());
+    for (const CTxMemPoolEntry& parent : e.GetMemPoolParentsConst()) {
+        entry.parents.push_back(parent.GetTx().GetHash());
+    }
+    entry.children.reserve(e.GetMemPoolChildrenConst().size());
+    for (const CTxMemPoolEntry& child : e.GetMemPoolChildrenConst()) {
+        entry.children.push_back(child.GetTx().GetHash());
+    }
+    return entry;
+}
+
+std::shared_ptr<const MempoolSnapshot> CTxMemPool::GetCurrentSnapshot() const
+{
+    AssertLockHeld(cs);
+    // Changes reset m_snapshot; the sequence check is a safety net.
+    if (m_snapshot && m_snapshot->sequence == m_sequence_number) return m_snapshot;
+    return nullptr;
+}
+
+std::shared_ptr<const MempoolSnapshot> CTxMemPool::GetSnapshot() const
+{
+    LOCK(cs);
+    if (auto snapshot = GetCurrentSnapshot()) return snapshot;
+
+    // Only copy here; all the formatting is left to the readers, outside cs.
+    auto snapshot = std::make_shared<MempoolSnapshot>();
+    snapshot->sequence = m_sequence_number;
+    const auto iters = GetSortedDepthAndScore();
+    snapshot->entries.reserve(iters.size());
+    std::unordered_map<const CTxMemPoolEntry*, bool> rbf_memo;
+    rbf_memo.reserve(iters.size());
+    for (const auto& it : iters) {
+        const bool unbroadcast{m_unbroadcast_txids.count(it->GetTx().GetHash()) != 0};
+        snapshot->entries.push_back(MakeSnapshotEntry(*it, unbroadcast, rbf_memo));
+        if (it->isNameRegistration() || it->isNameUpdate() || it->isNameDoi()) {
+            snapshot->names[it->getName()].push_back(snapshot->entries.size() - 1);
+        }
+    }
+
+    m_snapshot = std::move(snapshot);
+    return m_snapshot;
+}
+
+MempoolSnapshot::Entry CTxMemPool::GetSnapshotEntry(txiter it) const
+{
+    AssertLockHeld(cs);
+    std::unordered_map<const CTxMemPoolEntry*, bool> rbf_memo;
+    return MakeSnapshotEntry(*it, IsUnbroadcastTx(it->GetTx().GetHash()), rbf_memo);
+}
+
 CTransactionRef CTxMemPool::get(const uint256& hash) const
 {
     LOCK(cs);
@@ -911,6 +1036,8 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
             for (txiter descendantIt : setDescendants) {
                 mapTx.modify(descendantIt, update_ancestor_state(0, nFeeDelta, 0, 0));
             }
+            MarkClusterDirty(*it->m_cluster);
+            m_snapshot.reset();
             ++nTransactionsUpdated;
         }
     }
@@ -999,7 +1126,10 @@ void CCoinsViewMemPool::PackageAddTransaction(const CTransactionRef& tx)
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    // Clusters take an allocation each, and a transaction and (at most) a chunk entry per transaction.
+    const size_t cluster_usage{memusage::DynamicUsage(m_clusters) + memusage::MallocUsage(sizeof(CTxMemPoolCluster)) * m_clusters.size() +
+                               (sizeof(const CTxMemPoolEntry*) + sizeof(CTxMemPoolCluster::Chunk)) * mapTx.size()};
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + cluster_usage + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveUnbroadcastTx(const uint256& txid, const bool unchecked) {
@@ -1007,6 +1137,7 @@ void CTxMemPool::RemoveUnbroadcastTx(const uint256& txid, const bool unchecked)
 
     if (m_unbroadcast_txids.erase(txid))
     {
+        m_snapshot.reset();
         LogPrint(BCLog::MEMPOOL, "Removed %i from set of unbroadcast txns%s\n", txid.GetHex(), (unchecked ? " before confirmation that txn was sent out" : ""));
     }
 }
@@ -1062,6 +1193,7 @@ void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
     CTxMemPoolEntry::Parents s;
     if (add && entry->GetMemPoolParents().insert(*parent).second) {
         cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
+        MergeClusters(entry, parent);
     } else if (!add && entry->GetMemPoolParents().erase(*parent)) {
         cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
     }
@@ -1105,41 +1237,277 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
     while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
-
-        // We set the new mempool min fee to the feerate of the removed set, plus the
-        // "minimum reasonable fee rate" (ie some value under which we consider txn
-        // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
-        // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+        UpdateClusters();
+        CTxMemPoolCluster& cluster = *m_clusters.at((*m_clusters_by_worst_chunk.begin())->id);
+
+        // We set the new mempool min fee to the feerate of the chunk removed,
+        // plus the "minimum reasonable fee rate" (ie some value under which we
+        // consider txn to have 0 fee). This way, we don't allow txn to enter mempool
+        // with feerate equal to txn which were removed with no block in between.
+        const FeeFrac chunk_feerate{cluster.chunks.back().feerate};
+        CFeeRate removed(chunk_feerate.fee, chunk_feerate.size);
         removed += incrementalRelayFee;
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
+        // The last chunk of a linearization holds all in-mempool descendants
+        // of its transactions, so it can be removed as a whole.
         setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
+        std::vector<COutPoint> prevouts;
+        for (const CTxMemPoolEntry* entry : PopWorstChunk(cluster)) {
+            txiter it = mapTx.iterator_to(*entry);
+            stage.insert(it);
+            if (pvNoSpendsRemaining) {
+                for (const CTxIn& txin : it->GetTx().vin) prevouts.push_back(txin.prevout);
+            }
+        }
         nTxnRemoved += stage.size();
+        RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
+        for (const COutPoint& prevout : prevouts) {
+            if (exists(GenTxid::Txid(prevout.hash))) continue;
+            pvNoSpendsRemaining->push_back(prevout);
+        }
+    }
 
-        std::vector<CTransaction> txn;
-        if (pvNoSpendsRemaining) {
-            txn.reserve(stage.size());
-            for (txiter iter : stage)
-                txn.push_back(iter->GetTx());
+    if (maxFeeRateRemoved > CFeeRate(0)) {
+        LogPrint(BCLog::MEMPOOL, "Removed %u txn, rolling minimum fee bumped to %s\n", nTxnRemoved, maxFeeRateRemoved.ToString());
+    }
+}
+
+bool FeeFrac::HigherFeerateThan(const FeeFrac& other) const
+{
+    // Avoid division by rewriting (a/b > c/d) as (a*d > c*b), which needs more
+    // than 64 bits.
+#ifdef __SIZEOF_INT128__
+    return static_cast<__int128>(fee) * other.size > static_cast<__int128>(other.fee) * size;
+#else
+    return static_cast<long double>(fee) * other.size > static_cast<long double>(other.fee) * size;
+#endif
+}
+
+namespace {
+
+/** Clusters with more transactions are linearized by ancestor count only. */
+constexpr size_t MAX_CLUSTER_ANCESTOR_SEARCH{128};
+
+FeeFrac EntryFeerate(const CTxMemPoolEntry& entry)
+{
+    return {entry.GetModifiedFee(), static_cast<int64_t>(entry.GetTxSize())};
+}
+
+/**
+ * Linearize a cluster by repeatedly taking the highest-feerate ancestor set
+ * of what is left, as block assembly used to do for the whole mempool, and
+ * split the result into chunks.
+ */
+void LinearizeCluster(CTxMemPoolCluster& cluster)
+{
+    std::vector<const CTxMemPoolEntry*>& txs = cluster.txs;
+    const size_t count = txs.size();
+    // A transaction has more ancestors than any of its parents, so this order
+    // is topological, and it is where the search below starts from.
+    std::sort(txs.begin(), txs.end(), [](const CTxMemPoolEntry* a, const CTxMemPoolEntry* b) {
+        if (a->GetCountWithAncestors() != b->GetCountWithAncestors()) {
+            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
         }
-        RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
-        if (pvNoSpendsRemaining) {
-            for (const CTransaction& tx : txn) {
-                for (const CTxIn& txin : tx.vin) {
-                    if (exists(GenTxid::Txid(txin.prevout.hash))) continue;
-                    pvNoSpendsRemaining->push_back(txin.prevout);
+        return a->GetTx().GetHash() < b->GetTx().GetHash();
+    });
+    for (size_t i = 0; i < count; ++i) txs[i]->m_cluster_pos = i;
+
+    if (count > 1 && count <= MAX_CLUSTER_ANCESTOR_SEARCH) {
+        // ancestors[i * count + j] tells whether txs[j] is an ancestor of
+        // txs[i], or txs[i] itself; ancestors always come first.
+        std::vector<bool> ancestors(count * count, false);
+        for (size_t i = 0; i < count; ++i) {
+            ancestors[i * count + i] = true;
+            for (const CTxMemPoolEntry& parent : txs[i]->GetMemPoolParentsConst()) {
+                for (size_t j = 0; j <= parent.m_cluster_pos; ++j) {
+                    if (ancestors[parent.m_cluster_pos * count + j]) ancestors[i * count + j] = true;
                 }
             }
         }
+        std::vector<bool> left(count, true);
+
+        std::vector<const CTxMemPoolEntry*> order;
+        order.reserve(count);
+        while (order.size() < count) {
+            size_t best{count};
+            FeeFrac best_feerate;
+            for (size_t i = 0; i < count; ++i) {
+                if (!left[i]) continue;
+                FeeFrac feerate;
+                for (size_t j = 0; j <= i; ++j) {
+                    if (left[j] && ancestors[i * count + j]) feerate += EntryFeerate(*txs[j]);
+                }
+                if (best == count || feerate.HigherFeerateThan(best_feerate)) {
+                    best = i;
+                    best_feerate = feerate;
+                }
+            }
+            for (size_t j = 0; j <= best; ++j) {
+                if (left[j] && ancestors[best * count + j]) {
+                    order.push_back(txs[j]);
+                    left[j] = false;
+                }
+            }
+        }
+        txs = std::move(order);
+        for (size_t i = 0; i < count; ++i) txs[i]->m_cluster_pos = i;
     }
 
-    if (maxFeeRateRemoved > CFeeRate(0)) {
-        LogPrint(BCLog::MEMPOOL, "Removed %u txn, rolling minimum fee bumped to %s\n", nTxnRemoved, maxFeeRateRemoved.ToString());
+    // Merge each transaction into the chunks before it for as long as that
+    // raises their feerate, which leaves the feerates non-increasing.
+    cluster.chunks.clear();
+    for (size_t i = 0; i < count; ++i) {
+        cluster.chunks.push_back({i + 1, EntryFeerate(*txs[i])});
+        while (cluster.chunks.size() > 1 && cluster.chunks.back().feerate.HigherFeerateThan(cluster.chunks[cluster.chunks.size() - 2].feerate)) {
+            CTxMemPoolCluster::Chunk& prev = cluster.chunks[cluster.chunks.size() - 2];
+            prev.end = cluster.chunks.back().end;
+            prev.feerate += cluster.chunks.back().feerate;
+            cluster.chunks.pop_back();
+        }
+    }
+    cluster.dirty = false;
+}
+
+} // namespace
+
+CTxMemPoolCluster& CTxMemPool::CreateCluster() const
+{
+    AssertLockHeld(cs);
+    const uint64_t id{m_next_cluster_id++};
+    auto& cluster = m_clusters.emplace(id, std::make_unique<CTxMemPoolCluster>(id)).first->second;
+    m_dirty_clusters.insert(id);
+    return *cluster;
+}
+
+void CTxMemPool::DeleteCluster(const CTxMemPoolCluster& cluster) const
+{
+    AssertLockHeld(cs);
+    if (cluster.dirty) {
+        m_dirty_clusters.erase(cluster.id);
+    } else {
+        m_clusters_by_worst_chunk.erase(&cluster);
+    }
+    m_clusters.erase(cluster.id);
+}
+
+void CTxMemPool::MarkClusterDirty(CTxMemPoolCluster& cluster) const
+{
+    AssertLockHeld(cs);
+    if (cluster.dirty) return;
+    // Erase it while its chunks still match its position in the set.
+    m_clusters_by_worst_chunk.erase(&cluster);
+    cluster.dirty = true;
+    cluster.chunks.clear();
+    m_dirty_clusters.insert(cluster.id);
+}
+
+void CTxMemPool::MergeClusters(txiter a, txiter b)
+{
+    AssertLockHeld(cs);
+    CTxMemPoolCluster* to = a->m_cluster;
+    CTxMemPoolCluster* from = b->m_cluster;
+    if (to == from) return;
+    if (to->txs.size() < from->txs.size()) std::swap(to, from);
+    MarkClusterDirty(*to);
+    for (const CTxMemPoolEntry* entry : from->txs) {
+        entry->m_cluster = to;
+        entry->m_cluster_pos = to->txs.size();
+        to->txs.push_back(entry);
+    }
+    DeleteCluster(*from);
+}
+
+std::vector<const CTxMemPoolEntry*> CTxMemPool::PopWorstChunk(CTxMemPoolCluster& cluster)
+{
+    AssertLockHeld(cs);
+    assert(!cluster.dirty);
+    // Erase it while its chunks still match its position in the set.
+    m_clusters_by_worst_chunk.erase(&cluster);
+    const size_t begin{cluster.ChunkBegin(cluster.chunks.size() - 1)};
+    std::vector<const CTxMemPoolEntry*> chunk(cluster.txs.begin() + begin, cluster.txs.end());
+    for (const CTxMemPoolEntry* entry : chunk) entry->m_cluster = nullptr;
+    cluster.txs.resize(begin);
+    cluster.chunks.pop_back();
+    if (cluster.txs.empty()) {
+        m_clusters.erase(cluster.id);
+    } else {
+        // A prefix of a linearization is a linearization of what it holds,
+        // with the same chunks, so the rest is not linearized again.
+        m_clusters_by_worst_chunk.insert(&cluster);
     }
+    return chunk;
+}
+
+void CTxMemPool::RemoveFromCluster(txiter it)
+{
+    AssertLockHeld(cs);
+    // Transactions evicted with their chunk were already taken out.
+    if (it->m_cluster == nullptr) return;
+    CTxMemPoolCluster& cluster = *it->m_cluster;
+    MarkClusterDirty(cluster);
+    // The order does not matter until the cluster is linearized again.
+    cluster.txs[it->m_cluster_pos] = cluster.txs.back();
+    cluster.txs[it->m_cluster_pos]->m_cluster_pos = it->m_cluster_pos;
+    cluster.txs.pop_back();
+    it->m_cluster = nullptr;
+    if (cluster.txs.empty()) DeleteCluster(cluster);
+}
+
+void CTxMemPool::UpdateClusters() const
+{
+    AssertLockHeld(cs);
+    // Clusters created while splitting are marked dirty as well, and are
+    // linearized right away.
+    const std::set<uint64_t> dirty{std::move(m_dirty_clusters)};
+    m_dirty_clusters.clear();
+    for (const uint64_t id : dirty) {
+        CTxMemPoolCluster& cluster = *m_clusters.at(id);
+        std::vector<CTxMemPoolCluster*> parts;
+        {
+            // Removals may have split the cluster: flood-fill it from each
+            // transaction not reached yet, keeping the first part in place.
+            WITH_FRESH_EPOCH(m_epoch);
+            std::vector<const CTxMemPoolEntry*> txs;
+            txs.swap(cluster.txs);
+            std::vector<const CTxMemPoolEntry*> stack;
+            for (const CTxMemPoolEntry* start : txs) {
+                if (m_epoch.visited(start->m_epoch_marker)) continue;
+                CTxMemPoolCluster& part = parts.empty() ? cluster : CreateCluster();
+                parts.push_back(&part);
+                stack.push_back(start);
+                while (!stack.empty()) {
+                    const CTxMemPoolEntry* entry = stack.back();
+                    stack.pop_back();
+                    entry->m_cluster = &part;
+                    entry->m_cluster_pos = part.txs.size();
+                    part.txs.push_back(entry);
+                    for (const CTxMemPoolEntry& parent : entry->GetMemPoolParentsConst()) {
+                        if (!m_epoch.visited(parent.m_epoch_marker)) stack.push_back(&parent);
+                    }
+                    for (const CTxMemPoolEntry& child : entry->GetMemPoolChildrenConst()) {
+                        if (!m_epoch.visited(child.m_epoch_marker)) stack.push_back(&child);
+                    }
+                }
+            }
+        }
+        for (CTxMemPoolCluster* part : parts) {
+            LinearizeCluster(*part);
+            m_clusters_by_worst_chunk.insert(part);
+        }
+    }
+    m_dirty_clusters.clear();
+}
+
+std::vector<const CTxMemPoolCluster*> CTxMemPool::GetClusters() const
+{
+    AssertLockHeld(cs);
+    UpdateClusters();
+    std::vector<const CTxMemPoolCluster*> clusters;
+    clusters.reserve(m_clusters.size());
+    for (const auto& [id, cluster] : m_clusters) clusters.push_back(cluster.get());
+    return clusters;
 }
 
 uint64_t CTxMemPool::CalculateDescendantMaximum(txiter entry) const {
@@ -8,6 +8,7 @@
 
 #include <atomic>
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
 #include <string>
@@ -35,6 +36,7 @@
 class CBlockIndex;
 class CChain;
 class CChainState;
+struct CTxMemPoolCluster;
 extern RecursiveMutex cs_main;
 
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
@@ -199,6 +201,85 @@ public:
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
     mutable Epoch::Marker m_epoch_marker; //!< epoch when last touched, useful for graph algorithms
+    mutable CTxMemPoolCluster* m_cluster{nullptr}; //!< Cluster this transaction is in
+    mutable size_t m_cluster_pos{0}; //!< Index in m_cluster's txs
+};
+
+/**
+ * Total fee and size of a set of transactions, compared by feerate. Unlike
+ * CFeeRate, nothing is rounded, so sets that differ in feerate never compare
+ * equal.
+ */
+struct FeeFrac
+{
+    CAmount fee{0};
+    int64_t size{0};
+
+    FeeFrac() = default;
+    FeeFrac(CAmount fee_in, int64_t size_in) : fee{fee_in}, size{size_in} {}
+
+    FeeFrac& operator+=(const FeeFrac& other)
+    {
+        fee += other.fee;
+        size += other.size;
+        return *this;
+    }
+
+    /** Whether this has a strictly higher feerate than other; both must be non-empty. */
+    bool HigherFeerateThan(const FeeFrac& other) const;
+};
+
+/**
+ * A cluster is a set of mempool transactions connected to each other through
+ * spends, in either direction: a transaction is always in the same cluster
+ * as its in-mempool parents and children.
+ *
+ * Each cluster is linearized: its transactions are ordered so that parents
+ * come before their children, taking the highest-feerate set of ancestors
+ * that is left first, and this order is split into chunks of non-increasing
+ * feerate. Block assembly merges the chunk sequences of all clusters, and
+ * eviction removes the worst last chunk, so neither has to look at more than
+ * one chunk per cluster at a time.
+ *
+ * Eviction keeps what is left of a cluster as it is, even if that is no
+ * longer connected; it is split up the next time it changes.
+ */
+struct CTxMemPoolCluster
+{
+    struct Chunk
+    {
+        //! One past the position in txs of the chunk's last transaction
+        size_t end;
+        //! Total modified fee and virtual size of the chunk
+        FeeFrac feerate;
+    };
+
+    //! Increases with every cluster created; breaks ties between clusters
+    const uint64_t id;
+    //! The transactions, in linearization order unless dirty
+    std::vector<const CTxMemPoolEntry*> txs;
+    //! The chunks of the linearization, best first; empty while dirty
+    std::vector<Chunk> chunks;
+    //! Whether txs changed since the cluster was linearized
+    bool dirty{true};
+
+    explicit CTxMemPoolCluster(uint64_t id_in) : id{id_in} {}
+
+    /** Position in txs of the first transaction of a chunk. */
+    size_t ChunkBegin(size_t chunk) const { return chunk == 0 ? 0 : chunks[chunk - 1].end; }
+};
+
+/** Orders linearized clusters by the feerate of their last chunk, worst (and then newest) first. */
+struct CompareClusterByWorstChunk
+{
+    bool operator()(const CTxMemPoolCluster* a, const CTxMemPoolCluster* b) const
+    {
+        const FeeFrac& a_rate = a->chunks.back().feerate;
+        const FeeFrac& b_rate = b->chunks.back().feerate;
+        if (b_rate.HigherFeerateThan(a_rate)) return true;
+        if (a_rate.HigherFeerateThan(b_rate)) return false;
+        return a->id > b->id;
+    }
 };
 
 // extracts a transaction hash from CTxMemPoolEntry or CTransactionRef
@@ -377,6 +458,47 @@ struct TxMempoolInfo
     int64_t nFeeDelta;
 };
 
+/**
+ * An immutable copy of the mempool's entries and name index. It is built at
+ * most once per change of the mempool and shared by all readers, which can
+ * then iterate it without holding the mempool lock.
+ */
+struct MempoolSnapshot
+{
+    /** The data of one mempool entry, as shown by getrawmempool. */
+    struct Entry
+    {
+        CTransactionRef tx;
+        size_t vsize;
+        size_t weight;
+        CAmount fee;
+        CAmount modified_fee;
+        std::chrono::seconds time;
+        unsigned int height;
+        uint64_t count_with_descendants;
+        uint64_t size_with_descendants;
+        CAmount mod_fees_with_descendants;
+        uint64_t count_with_ancestors;
+        uint64_t size_with_ancestors;
+        CAmount mod_fees_with_ancestors;
+        /** Txids of the in-mempool parents and children */
+        std::vector<uint256> parents;
+        std::vector<uint256> children;
+        /** Whether the tx or one of its ancestors signals BIP125 replaceability */
+        bool bip125_replaceable;
+        bool unbroadcast;
+    };
+
+    /** Mempool sequence number at the time of the snapshot */
+    uint64_t sequence;
+
+    /** The entries, sorted by depth and score as queryHashes does */
+    std::vector<Entry> entries;
+
+    /** Positions in entries of the pending registrations, updates and DOIs of each name */
+    std::map<valtype, std::vector<size_t>> names;
+};
+
 /** Reason why a transaction was removed from the mempool,
  * this is passed to the notification signal.
  */
@@ -484,9 +606,24 @@ protected:
     // is added or removed from the mempool for any reason.
     mutable uint64_t m_sequence_number GUARDED_BY(cs){1};
 
+    /** Snapshot of the current state, if one was taken since the last change */
+    mutable std::shared_ptr<const MempoolSnapshot> m_snapshot GUARDED_BY(cs);
+
     /** Name-related mempool data.  */
     CNameMemPool names;
 
+    /**
+     * Clusters of connected transactions, by id. They are a cache of the
+     * structure of mapTx, linearized when needed, so even const methods
+     * update them.
+     */
+    mutable std::map<uint64_t, std::unique_ptr<CTxMemPoolCluster>> m_clusters GUARDED_BY(cs);
+    mutable uint64_t m_next_cluster_id GUARDED_BY(cs){0};
+    //! Ids of the clusters that changed since they were last linearized
+    mutable std::set<uint64_t> m_dirty_clusters GUARDED_BY(cs);
+    //! The linearized clusters, for eviction
+    mutable std::set<const CTxMemPoolCluster*, CompareClusterByWorstChunk> m_clusters_by_worst_chunk GUARDED_BY(cs);
+
     void trackPackageRemoved(const CFeeRate& rate) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     bool m_is_loaded GUARDED_BY(cs){false};
@@ -570,6 +707,19 @@ private:
     void UpdateParent(txiter entry, txiter parent, bool add) EXCLUSIVE_LOCKS_REQUIRED(cs);
     void UpdateChild(txiter entry, txiter child, bool add) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Create an empty cluster, marked as changed. */
+    CTxMemPoolCluster& CreateCluster() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void DeleteCluster(const CTxMemPoolCluster& cluster) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Note that a cluster changed, so it is linearized again before it is used. */
+    void MarkClusterDirty(CTxMemPoolCluster& cluster) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Merge the clusters of two transactions that were just connected. */
+    void MergeClusters(txiter a, txiter b) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void RemoveFromCluster(txiter it) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Take the last chunk off a linearized cluster, leaving the rest linearized, and return its transactions. */
+    std::vector<const CTxMemPoolEntry*> PopWorstChunk(CTxMemPoolCluster& cluster) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Split changed clusters that are no longer connected, and linearize them. */
+    void UpdateClusters() const EXCLUSIVE_LOCKS_REQUIRED(cs) LOCKS_EXCLUDED(m_epoch);
+
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /**
@@ -746,11 +896,18 @@ public:
     CFeeRate GetMinFee(size_t sizelimit) const;
 
     /** Remove transactions from the mempool until its dynamic size is <= sizelimit.
+      *  Each step evicts the lowest-feerate last chunk of any cluster as a whole;
+      *  it holds all in-mempool descendants of its transactions. The rest of that
+      *  cluster stays linearized as it was, and may no longer be connected until
+      *  the cluster next changes.
       *  pvNoSpendsRemaining, if set, will be populated with the list of outpoints
       *  which are not in mempool which no longer have any spends in this mempool.
       */
     void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Return all clusters, linearized, oldest first. */
+    std::vector<const CTxMemPoolCluster*> GetClusters() const EXCLUSIVE_LOCKS_REQUIRED(cs) LOCKS_EXCLUDED(m_epoch);
+
     /** Expire all transaction (and their dependencies) in the mempool older than time. Return the number of removed transactions. */
     int Expire(std::chrono::seconds time) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -843,6 +1000,20 @@ public:
         return names.checkTx (tx);
     }
 
+    /**
+     * Check if a package of txs can be added together according to name
+     * criteria, including conflicts between the txs of the package.
+     * @param txns The package, parents before children.
+     * @param failed Set to the index of the first conflicting tx.
+     * @return True if none of them conflicts.
+     */
+    inline bool
+    checkPackageNameOps (const std::vector<CTransactionRef>& txns, size_t& failed) const EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        AssertLockHeld(cs);
+        return names.checkPackage (txns, failed);
+    }
+
     CTransactionRef get(const uint256& hash) const;
     txiter get_iter_from_wtxid(const uint256& wtxid) const EXCLUSIVE_LOCKS_REQUIRED(cs)
     {
@@ -852,6 +1023,17 @@ public:
     TxMempoolInfo info(const GenTxid& gtxid) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
+    /** Return a snapshot of all entries. It is only rebuilt if the mempool
+     *  changed since the last one, so readers take it cheaply and then
+     *  iterate it without holding cs. */
+    std::shared_ptr<const MempoolSnapshot> GetSnapshot() const;
+
+    /** Return the last snapshot if the mempool hasn't changed since, nullptr otherwise */
+    std::shared_ptr<const MempoolSnapshot> GetCurrentSnapshot() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** Return the snapshot data of a single entry */
+    MempoolSnapshot::Entry GetSnapshotEntry(txiter it) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     size_t DynamicMemoryUsage() const;
 
     /** Adds a transaction to the unbroadcast set */
@@ -860,7 +1042,7 @@ public:
         LOCK(cs);
         // Sanity check the transaction is in the mempool & insert into
         // unbroadcast set.
-        if (exists(GenTxid::Txid(txid))) m_unbroadcast_txids.insert(txid);
+        if (exists(GenTxid::Txid(txid)) && m_unbroadcast_txids.insert(txid).second) m_snapshot.reset();
     };
 
     /** Removes a transaction from the unbroadcast set */
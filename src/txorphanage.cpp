@@ -5,9 +5,12 @@
 #include <txorphanage.h>
 
 #include <consensus/validation.h>
+#include <core_memusage.h>
 #include <logging.h>
+#include <memusage.h>
 #include <policy/policy.h>
 
+#include <algorithm>
 #include <cassert>
 
 /** Expiration time for orphan transactions in seconds */
@@ -39,17 +42,34 @@ bool TxOrphanage::AddTx(const CTransactionRef& tx, NodeId peer)
         return false;
     }
 
-    auto ret = m_orphans.emplace(hash, OrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, m_orphan_list.size()});
+    // Account for the transaction, its entries in m_orphans and in the wtxid
+    // and per-peer indexes, and one outpoint index entry per input. Outpoint
+    // entries shared by several orphans are counted for each of them, which
+    // errs on the safe side.
+    const size_t usage{RecursiveDynamicUsage(tx) +
+        memusage::MallocUsage(sizeof(memusage::stl_tree_node<OrphanMap::value_type>)) +
+        memusage::MallocUsage(sizeof(memusage::unordered_node<decltype(m_wtxid_to_orphan_it)::value_type>)) +
+        memusage::MallocUsage(sizeof(memusage::stl_tree_node<std::pair<const uint64_t, OrphanMap::iterator>>)) +
+        tx->vin.size() * (memusage::MallocUsage(sizeof(memusage::unordered_node<decltype(m_outpoint_to_orphan_it)::value_type>)) + sizeof(OrphanMap::iterator))};
+    auto ret = m_orphans.emplace(hash, OrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, m_sequence++, usage});
     assert(ret.second);
-    m_orphan_list.push_back(ret.first);
     // Allow for lookups in the orphan pool by wtxid, as well as txid
     m_wtxid_to_orphan_it.emplace(tx->GetWitnessHash(), ret.first);
     for (const CTxIn& txin : tx->vin) {
-        m_outpoint_to_orphan_it[txin.prevout].insert(ret.first);
+        auto& spenders = m_outpoint_to_orphan_it[txin.prevout];
+        // An orphan may spend the same outpoint twice; it is invalid, but
+        // must only be indexed once.
+        if (std::find(spenders.begin(), spenders.end(), ret.first) == spenders.end()) {
+            spenders.push_back(ret.first);
+        }
     }
+    PeerOrphans& peer_orphans = m_peer_orphans[peer];
+    peer_orphans.by_sequence.emplace(ret.first->second.sequence, ret.first);
+    peer_orphans.usage += usage;
+    m_total_usage += usage;
 
-    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
-             m_orphans.size(), m_outpoint_to_orphan_it.size());
+    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u usage %u)\n", hash.ToString(),
+             m_orphans.size(), m_outpoint_to_orphan_it.size(), m_total_usage);
     return true;
 }
 
@@ -64,21 +84,21 @@ int TxOrphanage::EraseTx(const uint256& txid)
         auto itPrev = m_outpoint_to_orphan_it.find(txin.prevout);
         if (itPrev == m_outpoint_to_orphan_it.end())
             continue;
-        itPrev->second.erase(it);
-        if (itPrev->second.empty())
+        auto& spenders = itPrev->second;
+        spenders.erase(std::remove(spenders.begin(), spenders.end(), it), spenders.end());
+        if (spenders.empty())
             m_outpoint_to_orphan_it.erase(itPrev);
     }
 
-    size_t old_pos = it->second.list_pos;
-    assert(m_orphan_list[old_pos] == it);
-    if (old_pos + 1 != m_orphan_list.size()) {
-        // Unless we're deleting the last entry in m_orphan_list, move the last
-        // entry to the position we're deleting.
-        auto it_last = m_orphan_list.back();
-        m_orphan_list[old_pos] = it_last;
-        it_last->second.list_pos = old_pos;
+    auto peer_it = m_peer_orphans.find(it->second.fromPeer);
+    assert(peer_it != m_peer_orphans.end());
+    peer_it->second.by_sequence.erase(it->second.sequence);
+    peer_it->second.usage -= it->second.usage;
+    if (peer_it->second.by_sequence.empty()) {
+        assert(peer_it->second.usage == 0);
+        m_peer_orphans.erase(peer_it);
     }
-    m_orphan_list.pop_back();
+    m_total_usage -= it->second.usage;
     m_wtxid_to_orphan_it.erase(it->second.tx->GetWitnessHash());
 
     m_orphans.erase(it);
@@ -89,20 +109,23 @@ void TxOrphanage::EraseForPeer(NodeId peer)
 {
     AssertLockHeld(g_cs_orphans);
 
+    const auto peer_it = m_peer_orphans.find(peer);
+    if (peer_it == m_peer_orphans.end()) return;
+
+    // EraseTx drops the peer's entry along with its last orphan.
+    std::vector<uint256> to_erase;
+    to_erase.reserve(peer_it->second.by_sequence.size());
+    for (const auto& [_, orphan_it] : peer_it->second.by_sequence) {
+        to_erase.push_back(orphan_it->first);
+    }
     int nErased = 0;
-    std::map<uint256, OrphanTx>::iterator iter = m_orphans.begin();
-    while (iter != m_orphans.end())
-    {
-        std::map<uint256, OrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer)
-        {
-            nErased += EraseTx(maybeErase->second.tx->GetHash());
-        }
+    for (const uint256& txid : to_erase) {
+        nErased += EraseTx(txid);
     }
     if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx from peer=%d\n", nErased, peer);
 }
 
-unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans)
+unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans, size_t max_usage)
 {
     AssertLockHeld(g_cs_orphans);
 
@@ -127,12 +150,17 @@ unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans)
         nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
         if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx due to expiration\n", nErased);
     }
-    FastRandomContext rng;
-    while (m_orphans.size() > max_orphans)
+    while (m_orphans.size() > max_orphans || m_total_usage > max_usage)
     {
-        // Evict a random orphan:
-        size_t randompos = rng.randrange(m_orphan_list.size());
-        EraseTx(m_orphan_list[randompos]->first);
+        // Evict the oldest orphan of the peer using the most memory. There
+        // are only as many entries as peers with orphans, so a linear scan
+        // is cheap.
+        auto heaviest = m_peer_orphans.begin();
+        for (auto peer_it = m_peer_orphans.begin(); peer_it != m_peer_orphans.end(); ++peer_it) {
+            if (peer_it->second.usage > heaviest->second.usage) heaviest = peer_it;
+        }
+        assert(heaviest != m_peer_orphans.end());
+        EraseTx(heaviest->second.by_sequence.begin()->second->first);
         ++nEvicted;
     }
     return nEvicted;
@@ -141,6 +169,7 @@ unsigned int TxOrphanage::LimitOrphans(unsigned int max_orphans)
 void TxOrphanage::AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const
 {
     AssertLockHeld(g_cs_orphans);
+    if (m_outpoint_to_orphan_it.empty()) return;
     for (unsigned int i = 0; i < tx.vout.size(); i++) {
         const auto it_by_prev = m_outpoint_to_orphan_it.find(COutPoint(tx.GetHash(), i));
         if (it_by_prev != m_outpoint_to_orphan_it.end()) {
@@ -151,6 +180,31 @@ void TxOrphanage::AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>
     }
 }
 
+void TxOrphanage::AddChildrenToWorkSet(Span<const CTransactionRef> txs, std::set<uint256>& orphan_work_set) const
+{
+    AssertLockHeld(g_cs_orphans);
+    for (const CTransactionRef& tx : txs) {
+        AddChildrenToWorkSet(*tx, orphan_work_set);
+    }
+}
+
+size_t TxOrphanage::DynamicMemoryUsage() const
+{
+    AssertLockHeld(g_cs_orphans);
+    // The per-orphan usage covers all nodes; add the hash tables' bucket arrays.
+    return m_total_usage +
+           memusage::MallocUsage(sizeof(void*) * m_outpoint_to_orphan_it.bucket_count()) +
+           memusage::MallocUsage(sizeof(void*) * m_wtxid_to_orphan_it.bucket_count()) +
+           memusage::DynamicUsage(m_peer_orphans);
+}
+
+size_t TxOrphanage::UsageByPeer(NodeId peer) const
+{
+    AssertLockHeld(g_cs_orphans);
+    const auto it = m_peer_orphans.find(peer);
+    return it == m_peer_orphans.end() ? 0 : it->second.usage;
+}
+
 bool TxOrphanage::HaveTx(const GenTxid& gtxid) const
 {
     LOCK(g_cs_orphans);
@@ -183,10 +237,8 @@ void TxOrphanage::EraseForBlock(const CBlock& block)
         for (const auto& txin : tx.vin) {
             auto itByPrev = m_outpoint_to_orphan_it.find(txin.prevout);
             if (itByPrev == m_outpoint_to_orphan_it.end()) continue;
-            for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
-                const CTransaction& orphanTx = *(*mi)->second.tx;
-                const uint256& orphanHash = orphanTx.GetHash();
-                vOrphanErase.push_back(orphanHash);
+            for (const auto& mi : itByPrev->second) {
+                vOrphanErase.push_back(mi->first);
             }
         }
     }
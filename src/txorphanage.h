@@ -8,7 +8,14 @@
 #include <net.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <span.h>
 #include <sync.h>
+#include <util/hasher.h>
+
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
 
 /** Guards orphan transactions and extra txs for compact blocks */
 extern RecursiveMutex g_cs_orphans;
@@ -16,7 +23,7 @@ extern RecursiveMutex g_cs_orphans;
 /** A class to track orphan transactions (failed on TX_MISSING_INPUTS)
  * Since we cannot distinguish orphans from bad transactions with
  * non-existent inputs, we heavily limit the number of orphans
- * we keep and the duration we keep them for.
+ * we keep, the memory they use and the duration we keep them for.
  */
 class TxOrphanage {
 public:
@@ -40,13 +47,19 @@ public:
     /** Erase all orphans included in or invalidated by a new block */
     void EraseForBlock(const CBlock& block) LOCKS_EXCLUDED(::g_cs_orphans);
 
-    /** Limit the orphanage to the given maximum */
-    unsigned int LimitOrphans(unsigned int max_orphans) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+    /** Limit the orphanage to the given number of transactions and bytes of
+     *  memory. Orphans are evicted oldest first from the peer that uses the
+     *  most memory, so that a peer flooding us only evicts its own orphans.
+     *  Returns the number of evicted orphans. */
+    unsigned int LimitOrphans(unsigned int max_orphans, size_t max_usage) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
 
     /** Add any orphans that list a particular tx as a parent into a peer's work set
      * (ie orphans that may have found their final missing parent, and so should be reconsidered for the mempool) */
     void AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
 
+    /** Add the orphans spending any of several newly accepted txs into a peer's work set */
+    void AddChildrenToWorkSet(Span<const CTransactionRef> txs, std::set<uint256>& orphan_work_set) const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+
     /** Return how many entries exist in the orphange */
     size_t Size() LOCKS_EXCLUDED(::g_cs_orphans)
     {
@@ -54,39 +67,53 @@ public:
         return m_orphans.size();
     }
 
+    /** Return the memory used by the orphans and their indexes, in bytes */
+    size_t DynamicMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+
+    /** Return the memory accounted to the orphans of one peer, in bytes */
+    size_t UsageByPeer(NodeId peer) const EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans);
+
 protected:
     struct OrphanTx {
         CTransactionRef tx;
         NodeId fromPeer;
         int64_t nTimeExpire;
-        size_t list_pos;
+        /** Order of arrival, used to evict a peer's oldest orphans first */
+        uint64_t sequence;
+        /** Memory accounted to this orphan: the transaction and its index entries */
+        size_t usage;
     };
 
     /** Map from txid to orphan transaction record. Limited by
-     *  -maxorphantx/DEFAULT_MAX_ORPHAN_TRANSACTIONS */
+     *  -maxorphantx/DEFAULT_MAX_ORPHAN_TRANSACTIONS and
+     *  -maxorphanmemory/DEFAULT_MAX_ORPHAN_MEMORY */
     std::map<uint256, OrphanTx> m_orphans GUARDED_BY(g_cs_orphans);
 
     using OrphanMap = decltype(m_orphans);
 
-    struct IteratorComparator
-    {
-        template<typename I>
-        bool operator()(const I& a, const I& b) const
-        {
-            return &(*a) < &(*b);
-        }
-    };
-
     /** Index from the parents' COutPoint into the m_orphans. Used
-     *  to remove orphan transactions from the m_orphans */
-    std::map<COutPoint, std::set<OrphanMap::iterator, IteratorComparator>> m_outpoint_to_orphan_it GUARDED_BY(g_cs_orphans);
-
-    /** Orphan transactions in vector for quick random eviction */
-    std::vector<OrphanMap::iterator> m_orphan_list GUARDED_BY(g_cs_orphans);
+     *  to remove orphan transactions from the m_orphans. Few orphans
+     *  spend the same outpoint, so a vector is enough for each. */
+    std::unordered_map<COutPoint, std::vector<OrphanMap::iterator>, SaltedOutpointHasher> m_outpoint_to_orphan_it GUARDED_BY(g_cs_orphans);
 
     /** Index from wtxid into the m_orphans to lookup orphan
      *  transactions using their witness ids. */
-    std::map<uint256, OrphanMap::iterator> m_wtxid_to_orphan_it GUARDED_BY(g_cs_orphans);
+    std::unordered_map<uint256, OrphanMap::iterator, SaltedTxidHasher> m_wtxid_to_orphan_it GUARDED_BY(g_cs_orphans);
+
+    /** The orphans announced by one peer, oldest first, and their memory usage */
+    struct PeerOrphans {
+        size_t usage{0};
+        std::map<uint64_t, OrphanMap::iterator> by_sequence;
+    };
+
+    /** Per-peer accounting, for quick EraseForPeer and fair eviction */
+    std::map<NodeId, PeerOrphans> m_peer_orphans GUARDED_BY(g_cs_orphans);
+
+    /** Sum of the usage of all orphans */
+    size_t m_total_usage GUARDED_BY(g_cs_orphans){0};
+
+    /** Sequence number for the next orphan */
+    uint64_t m_sequence GUARDED_BY(g_cs_orphans){0};
 };
 
 #endif // BITCOIN_TXORPHANAGE_H
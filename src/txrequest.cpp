@@ -9,11 +9,14 @@
 #include <primitives/transaction.h>
 #include <random.h>
 #include <uint256.h>
+#include <util/hasher.h>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 
+#include <array>
 #include <chrono>
+#include <limits>
 #include <unordered_map>
 #include <utility>
 
@@ -53,14 +56,27 @@ enum class State : uint8_t {
 //! Type alias for sequence numbers.
 using SequenceNumber = uint64_t;
 
+//! Type alias for priorities.
+using Priority = uint64_t;
+
+/** Number of announcements for each txhash tracked. Announcements point into this map instead of each holding a
+ *  copy of the txhash, so that a txhash announced by many peers is stored once, and two announcements are for the
+ *  same txhash iff they point to the same entry. */
+using TxHashMap = std::unordered_map<uint256, size_t, SaltedTxidHasher>;
+using TxHashEntry = TxHashMap::value_type;
+
 /** An announcement. This is the data we track for each txid or wtxid that is announced to us by each peer. */
 struct Announcement {
-    /** Txid or wtxid that was announced. */
-    const uint256 m_txhash;
+    /** Txid or wtxid that was announced, and the number of announcements for it. */
+    TxHashEntry* const m_txhash_entry;
     /** For CANDIDATE_{DELAYED,BEST,READY} the reqtime; for REQUESTED the expiry. */
     std::chrono::microseconds m_time;
     /** What peer the request was from. */
     const NodeId m_peer;
+    /** The priority of the announcement among those for its txhash (see PriorityComputer). It only depends on
+     *  the txhash, peer and preferredness, so it is computed once rather than every time the announcement is
+     *  compared with another in the ByTxHash index. */
+    const Priority m_priority;
     /** What sequence number this announcement has. */
     const SequenceNumber m_sequence : 59;
     /** Whether the request is preferred. */
@@ -73,6 +89,9 @@ struct Announcement {
      *  See https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61414 */
     uint8_t m_state : 3;
 
+    /** The txid or wtxid that was announced. */
+    const uint256& TxHash() const { return m_txhash_entry->first; }
+
     /** Convert m_state to a State enum. */
     State GetState() const { return static_cast<State>(m_state); }
 
@@ -98,15 +117,13 @@ struct Announcement {
     }
 
     /** Construct a new announcement from scratch, initially in CANDIDATE_DELAYED state. */
-    Announcement(const GenTxid& gtxid, NodeId peer, bool preferred, std::chrono::microseconds reqtime,
-        SequenceNumber sequence) :
-        m_txhash(gtxid.GetHash()), m_time(reqtime), m_peer(peer), m_sequence(sequence), m_preferred(preferred),
+    Announcement(TxHashEntry& txhash_entry, const GenTxid& gtxid, NodeId peer, bool preferred, Priority priority,
+        std::chrono::microseconds reqtime, SequenceNumber sequence) :
+        m_txhash_entry(&txhash_entry), m_time(reqtime), m_peer(peer), m_priority(priority), m_sequence(sequence),
+        m_preferred(preferred),
         m_is_wtxid(gtxid.IsWtxid()), m_state(static_cast<uint8_t>(State::CANDIDATE_DELAYED)) {}
 };
 
-//! Type alias for priorities.
-using Priority = uint64_t;
-
 /** A functor with embedded salt that computes priority of an announcement.
  *
  * Higher priorities are selected first.
@@ -126,7 +143,7 @@ public:
 
     Priority operator()(const Announcement& ann) const
     {
-        return operator()(ann.m_txhash, ann.m_peer, ann.m_preferred);
+        return operator()(ann.TxHash(), ann.m_peer, ann.m_preferred);
     }
 };
 
@@ -150,11 +167,12 @@ struct ByPeerViewExtractor
     using result_type = ByPeerView;
     result_type operator()(const Announcement& ann) const
     {
-        return ByPeerView{ann.m_peer, ann.GetState() == State::CANDIDATE_BEST, ann.m_txhash};
+        return ByPeerView{ann.m_peer, ann.GetState() == State::CANDIDATE_BEST, ann.TxHash()};
     }
 };
 
-// The ByTxHash index is sorted by (txhash, state, priority).
+// The ByTxHash index is sorted by (txhash entry, state, priority). Announcements for the same txhash share their
+// entry, so they are grouped together as if sorted by txhash, but comparing them doesn't involve the txhash itself.
 //
 // Note: priority == 0 whenever state != CANDIDATE_READY.
 //
@@ -165,16 +183,14 @@ struct ByPeerViewExtractor
 // * Determining when no more non-COMPLETED announcements for a given txhash exist, so the COMPLETED ones can be
 //   deleted.
 struct ByTxHash {};
-using ByTxHashView = std::tuple<const uint256&, State, Priority>;
-class ByTxHashViewExtractor {
-    const PriorityComputer& m_computer;
-public:
-    explicit ByTxHashViewExtractor(const PriorityComputer& computer) : m_computer(computer) {}
+using ByTxHashView = std::tuple<const TxHashEntry*, State, Priority>;
+struct ByTxHashViewExtractor
+{
     using result_type = ByTxHashView;
     result_type operator()(const Announcement& ann) const
     {
-        const Priority prio = (ann.GetState() == State::CANDIDATE_READY) ? m_computer(ann) : 0;
-        return ByTxHashView{ann.m_txhash, ann.GetState(), prio};
+        const Priority prio = (ann.GetState() == State::CANDIDATE_READY) ? ann.m_priority : 0;
+        return ByTxHashView{ann.m_txhash_entry, ann.GetState(), prio};
     }
 };
 
@@ -261,17 +277,15 @@ bool operator==(const PeerInfo& a, const PeerInfo& b)
            std::tie(b.m_total, b.m_completed, b.m_requested);
 };
 
-/** (Re)compute the PeerInfo map from the index. Only used for sanity checking. */
-std::unordered_map<NodeId, PeerInfo> RecomputePeerInfo(const Index& index)
+/** Add the announcements of an index to a PeerInfo map. Only used for sanity checking. */
+void RecomputePeerInfo(const Index& index, std::unordered_map<NodeId, PeerInfo>& ret)
 {
-    std::unordered_map<NodeId, PeerInfo> ret;
     for (const Announcement& ann : index) {
         PeerInfo& info = ret[ann.m_peer];
         ++info.m_total;
         info.m_requested += (ann.GetState() == State::REQUESTED);
         info.m_completed += (ann.GetState() == State::COMPLETED);
     }
-    return ret;
 }
 
 /** Compute the TxHashInfo map. Only used for sanity checking. */
@@ -279,18 +293,20 @@ std::map<uint256, TxHashInfo> ComputeTxHashInfo(const Index& index, const Priori
 {
     std::map<uint256, TxHashInfo> ret;
     for (const Announcement& ann : index) {
-        TxHashInfo& info = ret[ann.m_txhash];
+        TxHashInfo& info = ret[ann.TxHash()];
         // Classify how many announcements of each state we have for this txhash.
         info.m_candidate_delayed += (ann.GetState() == State::CANDIDATE_DELAYED);
         info.m_candidate_ready += (ann.GetState() == State::CANDIDATE_READY);
         info.m_candidate_best += (ann.GetState() == State::CANDIDATE_BEST);
         info.m_requested += (ann.GetState() == State::REQUESTED);
         // And track the priority of the best CANDIDATE_READY/CANDIDATE_BEST announcements.
+        // The cached priority must match a fresh computation.
+        assert(ann.m_priority == computer(ann));
         if (ann.GetState() == State::CANDIDATE_BEST) {
-            info.m_priority_candidate_best = computer(ann);
+            info.m_priority_candidate_best = ann.m_priority;
         }
         if (ann.GetState() == State::CANDIDATE_READY) {
-            info.m_priority_best_candidate_ready = std::max(info.m_priority_best_candidate_ready, computer(ann));
+            info.m_priority_best_candidate_ready = std::max(info.m_priority_best_candidate_ready, ann.m_priority);
         }
         // Also keep track of which peers this txhash has an announcement for (so we can detect duplicates).
         info.m_peers.push_back(ann.m_peer);
@@ -300,9 +316,29 @@ std::map<uint256, TxHashInfo> ComputeTxHashInfo(const Index& index, const Priori
 
 GenTxid ToGenTxid(const Announcement& ann)
 {
-    return ann.m_is_wtxid ? GenTxid::Wtxid(ann.m_txhash) : GenTxid::Txid(ann.m_txhash);
+    return ann.m_is_wtxid ? GenTxid::Wtxid(ann.TxHash()) : GenTxid::Txid(ann.TxHash());
 }
 
+/** Number of bits of the txhash's salted hash that select its shard. */
+constexpr int SHARD_BITS{4};
+constexpr size_t SHARD_COUNT{size_t{1} << SHARD_BITS};
+
+/** The announcements for the txhashes whose salted hash falls in a given range. All announcements for a txhash are
+ *  in the same shard, so the operations that only involve one txhash work on a single, smaller index. */
+struct Shard {
+    //! The txhashes announced, with their number of announcements.
+    TxHashMap m_txhashes;
+    //! The announcements. See SanityCheck() for the invariants that apply to it.
+    Index m_index;
+
+    //! Find the entry for a txhash, or nullptr if it has no announcements.
+    const TxHashEntry* FindTxHash(const uint256& txhash) const
+    {
+        auto it = m_txhashes.find(txhash);
+        return it == m_txhashes.end() ? nullptr : &*it;
+    }
+};
+
 }  // namespace
 
 /** Actual implementation for TxRequestTracker's data structure. */
@@ -314,82 +350,112 @@ class TxRequestTracker::Impl {
     //! This tracker's priority computer.
     const PriorityComputer m_computer;
 
-    //! This tracker's main data structure. See SanityCheck() for the invariants that apply to it.
-    Index m_index;
+    //! Salted hasher that assigns txhashes to shards, so peers can't choose which shard their announcements go to.
+    const SaltedTxidHasher m_shard_hasher;
+
+    //! This tracker's main data structure, split by txhash.
+    std::array<Shard, SHARD_COUNT> m_shards;
 
     //! Map with this tracker's per-peer statistics.
     std::unordered_map<NodeId, PeerInfo> m_peerinfo;
 
+    size_t ShardIndex(const uint256& txhash) const
+    {
+        return m_shard_hasher(txhash) >> (std::numeric_limits<size_t>::digits - SHARD_BITS);
+    }
+
+    Shard& GetShard(const uint256& txhash) { return m_shards[ShardIndex(txhash)]; }
+
 public:
     void SanityCheck() const
     {
-        // Recompute m_peerdata from m_index. This verifies the data in it as it should just be caching statistics
-        // on m_index. It also verifies the invariant that no PeerInfo announcements with m_total==0 exist.
-        assert(m_peerinfo == RecomputePeerInfo(m_index));
+        // Recompute m_peerdata from the indexes. This verifies the data in it as it should just be caching
+        // statistics on them. It also verifies the invariant that no PeerInfo announcements with m_total==0 exist.
+        std::unordered_map<NodeId, PeerInfo> peerinfo;
+        for (const Shard& shard : m_shards) RecomputePeerInfo(shard.m_index, peerinfo);
+        assert(m_peerinfo == peerinfo);
+
+        for (const Shard& shard : m_shards) {
+            // Every announcement is in its txhash's shard, and m_txhashes holds exactly the announced txhashes,
+            // with their number of announcements.
+            std::unordered_map<const TxHashEntry*, size_t> counts;
+            for (const Announcement& ann : shard.m_index) {
+                assert(&m_shards[ShardIndex(ann.TxHash())] == &shard);
+                assert(shard.FindTxHash(ann.TxHash()) == ann.m_txhash_entry);
+                ++counts[ann.m_txhash_entry];
+            }
+            assert(counts.size() == shard.m_txhashes.size());
+            for (const auto& [entry, count] : counts) assert(entry->second == count);
 
-        // Calculate per-txhash statistics from m_index, and validate invariants.
-        for (auto& item : ComputeTxHashInfo(m_index, m_computer)) {
-            TxHashInfo& info = item.second;
+            // Calculate per-txhash statistics from the index, and validate invariants.
+            for (auto& item : ComputeTxHashInfo(shard.m_index, m_computer)) {
+                TxHashInfo& info = item.second;
 
-            // Cannot have only COMPLETED peer (txhash should have been forgotten already)
-            assert(info.m_candidate_delayed + info.m_candidate_ready + info.m_candidate_best + info.m_requested > 0);
+                // Cannot have only COMPLETED peer (txhash should have been forgotten already)
+                assert(info.m_candidate_delayed + info.m_candidate_ready + info.m_candidate_best + info.m_requested > 0);
 
-            // Can have at most 1 CANDIDATE_BEST/REQUESTED peer
-            assert(info.m_candidate_best + info.m_requested <= 1);
+                // Can have at most 1 CANDIDATE_BEST/REQUESTED peer
+                assert(info.m_candidate_best + info.m_requested <= 1);
 
-            // If there are any CANDIDATE_READY announcements, there must be exactly one CANDIDATE_BEST or REQUESTED
-            // announcement.
-            if (info.m_candidate_ready > 0) {
-                assert(info.m_candidate_best + info.m_requested == 1);
-            }
+                // If there are any CANDIDATE_READY announcements, there must be exactly one CANDIDATE_BEST or REQUESTED
+                // announcement.
+                if (info.m_candidate_ready > 0) {
+                    assert(info.m_candidate_best + info.m_requested == 1);
+                }
 
-            // If there is both a CANDIDATE_READY and a CANDIDATE_BEST announcement, the CANDIDATE_BEST one must be
-            // at least as good (equal or higher priority) as the best CANDIDATE_READY.
-            if (info.m_candidate_ready && info.m_candidate_best) {
-                assert(info.m_priority_candidate_best >= info.m_priority_best_candidate_ready);
-            }
+                // If there is both a CANDIDATE_READY and a CANDIDATE_BEST announcement, the CANDIDATE_BEST one must be
+                // at least as good (equal or higher priority) as the best CANDIDATE_READY.
+                if (info.m_candidate_ready && info.m_candidate_best) {
+                    assert(info.m_priority_candidate_best >= info.m_priority_best_candidate_ready);
+                }
 
-            // No txhash can have been announced by the same peer twice.
-            std::sort(info.m_peers.begin(), info.m_peers.end());
-            assert(std::adjacent_find(info.m_peers.begin(), info.m_peers.end()) == info.m_peers.end());
+                // No txhash can have been announced by the same peer twice.
+                std::sort(info.m_peers.begin(), info.m_peers.end());
+                assert(std::adjacent_find(info.m_peers.begin(), info.m_peers.end()) == info.m_peers.end());
+            }
         }
     }
 
     void PostGetRequestableSanityCheck(std::chrono::microseconds now) const
     {
-        for (const Announcement& ann : m_index) {
-            if (ann.IsWaiting()) {
-                // REQUESTED and CANDIDATE_DELAYED must have a time in the future (they should have been converted
-                // to COMPLETED/CANDIDATE_READY respectively).
-                assert(ann.m_time > now);
-            } else if (ann.IsSelectable()) {
-                // CANDIDATE_READY and CANDIDATE_BEST cannot have a time in the future (they should have remained
-                // CANDIDATE_DELAYED, or should have been converted back to it if time went backwards).
-                assert(ann.m_time <= now);
+        for (const Shard& shard : m_shards) {
+            for (const Announcement& ann : shard.m_index) {
+                if (ann.IsWaiting()) {
+                    // REQUESTED and CANDIDATE_DELAYED must have a time in the future (they should have been converted
+                    // to COMPLETED/CANDIDATE_READY respectively).
+                    assert(ann.m_time > now);
+                } else if (ann.IsSelectable()) {
+                    // CANDIDATE_READY and CANDIDATE_BEST cannot have a time in the future (they should have remained
+                    // CANDIDATE_DELAYED, or should have been converted back to it if time went backwards).
+                    assert(ann.m_time <= now);
+                }
             }
         }
     }
 
 private:
-    //! Wrapper around Index::...::erase that keeps m_peerinfo up to date.
+    //! Wrapper around Index::...::erase that keeps m_peerinfo and the shard's m_txhashes up to date.
     template<typename Tag>
-    Iter<Tag> Erase(Iter<Tag> it)
+    Iter<Tag> Erase(Shard& shard, Iter<Tag> it)
     {
         auto peerit = m_peerinfo.find(it->m_peer);
         peerit->second.m_completed -= it->GetState() == State::COMPLETED;
         peerit->second.m_requested -= it->GetState() == State::REQUESTED;
         if (--peerit->second.m_total == 0) m_peerinfo.erase(peerit);
-        return m_index.get<Tag>().erase(it);
+        TxHashEntry& entry = *it->m_txhash_entry;
+        auto it_next = shard.m_index.get<Tag>().erase(it);
+        if (--entry.second == 0) shard.m_txhashes.erase(uint256{entry.first});
+        return it_next;
     }
 
     //! Wrapper around Index::...::modify that keeps m_peerinfo up to date.
     template<typename Tag, typename Modifier>
-    void Modify(Iter<Tag> it, Modifier modifier)
+    void Modify(Shard& shard, Iter<Tag> it, Modifier modifier)
     {
         auto peerit = m_peerinfo.find(it->m_peer);
         peerit->second.m_completed -= it->GetState() == State::COMPLETED;
         peerit->second.m_requested -= it->GetState() == State::REQUESTED;
-        m_index.get<Tag>().modify(it, std::move(modifier));
+        shard.m_index.get<Tag>().modify(it, std::move(modifier));
         peerit->second.m_completed += it->GetState() == State::COMPLETED;
         peerit->second.m_requested += it->GetState() == State::REQUESTED;
     }
@@ -397,63 +463,66 @@ private:
     //! Convert a CANDIDATE_DELAYED announcement into a CANDIDATE_READY. If this makes it the new best
     //! CANDIDATE_READY (and no REQUESTED exists) and better than the CANDIDATE_BEST (if any), it becomes the new
     //! CANDIDATE_BEST.
-    void PromoteCandidateReady(Iter<ByTxHash> it)
+    void PromoteCandidateReady(Shard& shard, Iter<ByTxHash> it)
     {
-        assert(it != m_index.get<ByTxHash>().end());
+        auto& index = shard.m_index.get<ByTxHash>();
+        assert(it != index.end());
         assert(it->GetState() == State::CANDIDATE_DELAYED);
         // Convert CANDIDATE_DELAYED to CANDIDATE_READY first.
-        Modify<ByTxHash>(it, [](Announcement& ann){ ann.SetState(State::CANDIDATE_READY); });
+        Modify<ByTxHash>(shard, it, [](Announcement& ann){ ann.SetState(State::CANDIDATE_READY); });
         // The following code relies on the fact that the ByTxHash is sorted by txhash, and then by state (first
         // _DELAYED, then _READY, then _BEST/REQUESTED). Within the _READY announcements, the best one (highest
         // priority) comes last. Thus, if an existing _BEST exists for the same txhash that this announcement may
         // be preferred over, it must immediately follow the newly created _READY.
         auto it_next = std::next(it);
-        if (it_next == m_index.get<ByTxHash>().end() || it_next->m_txhash != it->m_txhash ||
+        if (it_next == index.end() || it_next->m_txhash_entry != it->m_txhash_entry ||
             it_next->GetState() == State::COMPLETED) {
             // This is the new best CANDIDATE_READY, and there is no IsSelected() announcement for this txhash
             // already.
-            Modify<ByTxHash>(it, [](Announcement& ann){ ann.SetState(State::CANDIDATE_BEST); });
+            Modify<ByTxHash>(shard, it, [](Announcement& ann){ ann.SetState(State::CANDIDATE_BEST); });
         } else if (it_next->GetState() == State::CANDIDATE_BEST) {
-            Priority priority_old = m_computer(*it_next);
-            Priority priority_new = m_computer(*it);
+            Priority priority_old = it_next->m_priority;
+            Priority priority_new = it->m_priority;
             if (priority_new > priority_old) {
                 // There is a CANDIDATE_BEST announcement already, but this one is better.
-                Modify<ByTxHash>(it_next, [](Announcement& ann){ ann.SetState(State::CANDIDATE_READY); });
-                Modify<ByTxHash>(it, [](Announcement& ann){ ann.SetState(State::CANDIDATE_BEST); });
+                Modify<ByTxHash>(shard, it_next, [](Announcement& ann){ ann.SetState(State::CANDIDATE_READY); });
+                Modify<ByTxHash>(shard, it, [](Announcement& ann){ ann.SetState(State::CANDIDATE_BEST); });
             }
         }
     }
 
     //! Change the state of an announcement to something non-IsSelected(). If it was IsSelected(), the next best
     //! announcement will be marked CANDIDATE_BEST.
-    void ChangeAndReselect(Iter<ByTxHash> it, State new_state)
+    void ChangeAndReselect(Shard& shard, Iter<ByTxHash> it, State new_state)
     {
+        auto& index = shard.m_index.get<ByTxHash>();
         assert(new_state == State::COMPLETED || new_state == State::CANDIDATE_DELAYED);
-        assert(it != m_index.get<ByTxHash>().end());
-        if (it->IsSelected() && it != m_index.get<ByTxHash>().begin()) {
+        assert(it != index.end());
+        if (it->IsSelected() && it != index.begin()) {
             auto it_prev = std::prev(it);
             // The next best CANDIDATE_READY, if any, immediately precedes the REQUESTED or CANDIDATE_BEST
             // announcement in the ByTxHash index.
-            if (it_prev->m_txhash == it->m_txhash && it_prev->GetState() == State::CANDIDATE_READY) {
+            if (it_prev->m_txhash_entry == it->m_txhash_entry && it_prev->GetState() == State::CANDIDATE_READY) {
                 // If one such CANDIDATE_READY exists (for this txhash), convert it to CANDIDATE_BEST.
-                Modify<ByTxHash>(it_prev, [](Announcement& ann){ ann.SetState(State::CANDIDATE_BEST); });
+                Modify<ByTxHash>(shard, it_prev, [](Announcement& ann){ ann.SetState(State::CANDIDATE_BEST); });
             }
         }
-        Modify<ByTxHash>(it, [new_state](Announcement& ann){ ann.SetState(new_state); });
+        Modify<ByTxHash>(shard, it, [new_state](Announcement& ann){ ann.SetState(new_state); });
     }
 
     //! Check if 'it' is the only announcement for a given txhash that isn't COMPLETED.
-    bool IsOnlyNonCompleted(Iter<ByTxHash> it)
+    bool IsOnlyNonCompleted(const Shard& shard, Iter<ByTxHash> it)
     {
-        assert(it != m_index.get<ByTxHash>().end());
+        const auto& index = shard.m_index.get<ByTxHash>();
+        assert(it != index.end());
         assert(it->GetState() != State::COMPLETED); // Not allowed to call this on COMPLETED announcements.
 
         // This announcement has a predecessor that belongs to the same txhash. Due to ordering, and the
         // fact that 'it' is not COMPLETED, its predecessor cannot be COMPLETED here.
-        if (it != m_index.get<ByTxHash>().begin() && std::prev(it)->m_txhash == it->m_txhash) return false;
+        if (it != index.begin() && std::prev(it)->m_txhash_entry == it->m_txhash_entry) return false;
 
         // This announcement has a successor that belongs to the same txhash, and is not COMPLETED.
-        if (std::next(it) != m_index.get<ByTxHash>().end() && std::next(it)->m_txhash == it->m_txhash &&
+        if (std::next(it) != index.end() && std::next(it)->m_txhash_entry == it->m_txhash_entry &&
             std::next(it)->GetState() != State::COMPLETED) return false;
 
         return true;
@@ -462,132 +531,144 @@ private:
     /** Convert any announcement to a COMPLETED one. If there are no non-COMPLETED announcements left for this
      *  txhash, they are deleted. If this was a REQUESTED announcement, and there are other CANDIDATEs left, the
      *  best one is made CANDIDATE_BEST. Returns whether the announcement still exists. */
-    bool MakeCompleted(Iter<ByTxHash> it)
+    bool MakeCompleted(Shard& shard, Iter<ByTxHash> it)
     {
-        assert(it != m_index.get<ByTxHash>().end());
+        assert(it != shard.m_index.get<ByTxHash>().end());
 
         // Nothing to be done if it's already COMPLETED.
         if (it->GetState() == State::COMPLETED) return true;
 
-        if (IsOnlyNonCompleted(it)) {
-            // This is the last non-COMPLETED announcement for this txhash. Delete all.
-            uint256 txhash = it->m_txhash;
-            do {
-                it = Erase<ByTxHash>(it);
-            } while (it != m_index.get<ByTxHash>().end() && it->m_txhash == txhash);
+        if (IsOnlyNonCompleted(shard, it)) {
+            // This is the last non-COMPLETED announcement for this txhash. Delete all. The entry is freed along
+            // with the last of them, so count them beforehand.
+            for (size_t left = it->m_txhash_entry->second; left > 0; --left) {
+                it = Erase<ByTxHash>(shard, it);
+            }
             return false;
         }
 
         // Mark the announcement COMPLETED, and select the next best announcement (the first CANDIDATE_READY) if
         // needed.
-        ChangeAndReselect(it, State::COMPLETED);
+        ChangeAndReselect(shard, it, State::COMPLETED);
 
         return true;
     }
 
-    //! Make the data structure consistent with a given point in time:
+    //! Make a shard consistent with a given point in time:
     //! - REQUESTED announcements with expiry <= now are turned into COMPLETED.
     //! - CANDIDATE_DELAYED announcements with reqtime <= now are turned into CANDIDATE_{READY,BEST}.
     //! - CANDIDATE_{READY,BEST} announcements with reqtime > now are turned into CANDIDATE_DELAYED.
-    void SetTimePoint(std::chrono::microseconds now, std::vector<std::pair<NodeId, GenTxid>>* expired)
+    void SetTimePoint(Shard& shard, std::chrono::microseconds now, std::vector<std::pair<NodeId, GenTxid>>* expired)
     {
-        if (expired) expired->clear();
+        Index& index = shard.m_index;
 
         // Iterate over all CANDIDATE_DELAYED and REQUESTED from old to new, as long as they're in the past,
         // and convert them to CANDIDATE_READY and COMPLETED respectively.
-        while (!m_index.empty()) {
-            auto it = m_index.get<ByTime>().begin();
+        while (!index.empty()) {
+            auto it = index.get<ByTime>().begin();
             if (it->GetState() == State::CANDIDATE_DELAYED && it->m_time <= now) {
-                PromoteCandidateReady(m_index.project<ByTxHash>(it));
+                PromoteCandidateReady(shard, index.project<ByTxHash>(it));
             } else if (it->GetState() == State::REQUESTED && it->m_time <= now) {
                 if (expired) expired->emplace_back(it->m_peer, ToGenTxid(*it));
-                MakeCompleted(m_index.project<ByTxHash>(it));
+                MakeCompleted(shard, index.project<ByTxHash>(it));
             } else {
                 break;
             }
         }
 
-        while (!m_index.empty()) {
+        while (!index.empty()) {
             // If time went backwards, we may need to demote CANDIDATE_BEST and CANDIDATE_READY announcements back
             // to CANDIDATE_DELAYED. This is an unusual edge case, and unlikely to matter in production. However,
             // it makes it much easier to specify and test TxRequestTracker::Impl's behaviour.
-            auto it = std::prev(m_index.get<ByTime>().end());
+            auto it = std::prev(index.get<ByTime>().end());
             if (it->IsSelectable() && it->m_time > now) {
-                ChangeAndReselect(m_index.project<ByTxHash>(it), State::CANDIDATE_DELAYED);
+                ChangeAndReselect(shard, index.project<ByTxHash>(it), State::CANDIDATE_DELAYED);
             } else {
                 break;
             }
         }
     }
 
+    //! Find the announcement for a (peer, txhash) combination, or end() of the shard's ByPeer index.
+    Iter<ByPeer> FindAnnouncement(Shard& shard, NodeId peer, const uint256& txhash)
+    {
+        // We need to search the ByPeer index for both (peer, false, txhash) and (peer, true, txhash).
+        auto& index = shard.m_index.get<ByPeer>();
+        auto it = index.find(ByPeerView{peer, false, txhash});
+        if (it == index.end()) it = index.find(ByPeerView{peer, true, txhash});
+        return it;
+    }
+
 public:
     explicit Impl(bool deterministic) :
-        m_computer(deterministic),
-        // Explicitly initialize m_index as we need to pass a reference to m_computer to ByTxHashViewExtractor.
-        m_index(boost::make_tuple(
-            boost::make_tuple(ByPeerViewExtractor(), std::less<ByPeerView>()),
-            boost::make_tuple(ByTxHashViewExtractor(m_computer), std::less<ByTxHashView>()),
-            boost::make_tuple(ByTimeViewExtractor(), std::less<ByTimeView>())
-        )) {}
-
-    // Disable copying and assigning (a default copy won't work due the stateful ByTxHashViewExtractor).
+        m_computer(deterministic) {}
+
+    // Disable copying and assigning (a copy of the announcements would point into the original's txhash maps).
     Impl(const Impl&) = delete;
     Impl& operator=(const Impl&) = delete;
 
     void DisconnectedPeer(NodeId peer)
     {
-        auto& index = m_index.get<ByPeer>();
-        auto it = index.lower_bound(ByPeerView{peer, false, uint256::ZERO});
-        while (it != index.end() && it->m_peer == peer) {
-            // Check what to continue with after this iteration. 'it' will be deleted in what follows, so we need to
-            // decide what to continue with afterwards. There are a number of cases to consider:
-            // - std::next(it) is end() or belongs to a different peer. In that case, this is the last iteration
-            //   of the loop (denote this by setting it_next to end()).
-            // - 'it' is not the only non-COMPLETED announcement for its txhash. This means it will be deleted, but
-            //   no other Announcement objects will be modified. Continue with std::next(it) if it belongs to the
-            //   same peer, but decide this ahead of time (as 'it' may change position in what follows).
-            // - 'it' is the only non-COMPLETED announcement for its txhash. This means it will be deleted along
-            //   with all other announcements for the same txhash - which may include std::next(it). However, other
-            //   than 'it', no announcements for the same peer can be affected (due to (peer, txhash) uniqueness).
-            //   In other words, the situation where std::next(it) is deleted can only occur if std::next(it)
-            //   belongs to a different peer but the same txhash as 'it'. This is covered by the first bulletpoint
-            //   already, and we'll have set it_next to end().
-            auto it_next = (std::next(it) == index.end() || std::next(it)->m_peer != peer) ? index.end() :
-                std::next(it);
-            // If the announcement isn't already COMPLETED, first make it COMPLETED (which will mark other
-            // CANDIDATEs as CANDIDATE_BEST, or delete all of a txhash's announcements if no non-COMPLETED ones are
-            // left).
-            if (MakeCompleted(m_index.project<ByTxHash>(it))) {
-                // Then actually delete the announcement (unless it was already deleted by MakeCompleted).
-                Erase<ByPeer>(it);
+        if (!m_peerinfo.count(peer)) return;
+        for (Shard& shard : m_shards) {
+            auto& index = shard.m_index.get<ByPeer>();
+            auto it = index.lower_bound(ByPeerView{peer, false, uint256::ZERO});
+            while (it != index.end() && it->m_peer == peer) {
+                // Check what to continue with after this iteration. 'it' will be deleted in what follows, so we need
+                // to decide what to continue with afterwards. There are a number of cases to consider:
+                // - std::next(it) is end() or belongs to a different peer. In that case, this is the last iteration
+                //   of the loop (denote this by setting it_next to end()).
+                // - 'it' is not the only non-COMPLETED announcement for its txhash. This means it will be deleted, but
+                //   no other Announcement objects will be modified. Continue with std::next(it) if it belongs to the
+                //   same peer, but decide this ahead of time (as 'it' may change position in what follows).
+                // - 'it' is the only non-COMPLETED announcement for its txhash. This means it will be deleted along
+                //   with all other announcements for the same txhash - which may include std::next(it). However,
+                //   other than 'it', no announcements for the same peer can be affected (due to (peer, txhash)
+                //   uniqueness). In other words, the situation where std::next(it) is deleted can only occur if
+                //   std::next(it) belongs to a different peer but the same txhash as 'it'. This is covered by the
+                //   first bulletpoint already, and we'll have set it_next to end().
+                auto it_next = (std::next(it) == index.end() || std::next(it)->m_peer != peer) ? index.end() :
+                    std::next(it);
+                // If the announcement isn't already COMPLETED, first make it COMPLETED (which will mark other
+                // CANDIDATEs as CANDIDATE_BEST, or delete all of a txhash's announcements if no non-COMPLETED ones
+                // are left).
+                if (MakeCompleted(shard, shard.m_index.project<ByTxHash>(it))) {
+                    // Then actually delete the announcement (unless it was already deleted by MakeCompleted).
+                    Erase<ByPeer>(shard, it);
+                }
+                it = it_next;
             }
-            it = it_next;
         }
     }
 
     void ForgetTxHash(const uint256& txhash)
     {
-        auto it = m_index.get<ByTxHash>().lower_bound(ByTxHashView{txhash, State::CANDIDATE_DELAYED, 0});
-        while (it != m_index.get<ByTxHash>().end() && it->m_txhash == txhash) {
-            it = Erase<ByTxHash>(it);
+        Shard& shard = GetShard(txhash);
+        const TxHashEntry* entry = shard.FindTxHash(txhash);
+        if (!entry) return;
+        auto it = shard.m_index.get<ByTxHash>().lower_bound(ByTxHashView{entry, State::CANDIDATE_DELAYED, 0});
+        // The entry is freed along with the last announcement, so count them beforehand.
+        for (size_t left = entry->second; left > 0; --left) {
+            it = Erase<ByTxHash>(shard, it);
         }
     }
 
     void ReceivedInv(NodeId peer, const GenTxid& gtxid, bool preferred,
         std::chrono::microseconds reqtime)
     {
-        // Bail out if we already have a CANDIDATE_BEST announcement for this (txhash, peer) combination. The case
-        // where there is a non-CANDIDATE_BEST announcement already will be caught by the uniqueness property of the
-        // ByPeer index when we try to emplace the new object below.
-        if (m_index.get<ByPeer>().count(ByPeerView{peer, true, gtxid.GetHash()})) return;
+        Shard& shard = GetShard(gtxid.GetHash());
 
-        // Try creating the announcement with CANDIDATE_DELAYED state (which will fail due to the uniqueness
-        // of the ByPeer index if a non-CANDIDATE_BEST announcement already exists with the same txhash and peer).
-        // Bail out in that case.
-        auto ret = m_index.get<ByPeer>().emplace(gtxid, peer, preferred, reqtime, m_current_sequence);
-        if (!ret.second) return;
+        // Bail out if we already have an announcement for this (txhash, peer) combination.
+        if (FindAnnouncement(shard, peer, gtxid.GetHash()) != shard.m_index.get<ByPeer>().end()) return;
+
+        // Create the announcement with CANDIDATE_DELAYED state.
+        TxHashEntry& entry = *shard.m_txhashes.try_emplace(gtxid.GetHash(), 0).first;
+        auto ret = shard.m_index.get<ByPeer>().emplace(entry, gtxid, peer, preferred,
+            m_computer(gtxid.GetHash(), peer, preferred), reqtime, m_current_sequence);
+        assert(ret.second);
 
         // Update accounting metadata.
+        ++entry.second;
         ++m_peerinfo[peer].m_total;
         ++m_current_sequence;
     }
@@ -597,15 +678,21 @@ public:
         std::vector<std::pair<NodeId, GenTxid>>* expired)
     {
         // Move time.
-        SetTimePoint(now, expired);
+        if (expired) expired->clear();
+        for (Shard& shard : m_shards) SetTimePoint(shard, now, expired);
 
         // Find all CANDIDATE_BEST announcements for this peer.
         std::vector<const Announcement*> selected;
-        auto it_peer = m_index.get<ByPeer>().lower_bound(ByPeerView{peer, true, uint256::ZERO});
-        while (it_peer != m_index.get<ByPeer>().end() && it_peer->m_peer == peer &&
-            it_peer->GetState() == State::CANDIDATE_BEST) {
-            selected.emplace_back(&*it_peer);
-            ++it_peer;
+        if (m_peerinfo.count(peer)) {
+            for (const Shard& shard : m_shards) {
+                const auto& index = shard.m_index.get<ByPeer>();
+                auto it_peer = index.lower_bound(ByPeerView{peer, true, uint256::ZERO});
+                while (it_peer != index.end() && it_peer->m_peer == peer &&
+                    it_peer->GetState() == State::CANDIDATE_BEST) {
+                    selected.emplace_back(&*it_peer);
+                    ++it_peer;
+                }
+            }
         }
 
         // Sort by sequence number.
@@ -624,16 +711,18 @@ public:
 
     void RequestedTx(NodeId peer, const uint256& txhash, std::chrono::microseconds expiry)
     {
-        auto it = m_index.get<ByPeer>().find(ByPeerView{peer, true, txhash});
-        if (it == m_index.get<ByPeer>().end()) {
+        Shard& shard = GetShard(txhash);
+        auto& index = shard.m_index.get<ByPeer>();
+        auto it = index.find(ByPeerView{peer, true, txhash});
+        if (it == index.end()) {
             // There is no CANDIDATE_BEST announcement, look for a _READY or _DELAYED instead. If the caller only
             // ever invokes RequestedTx with the values returned by GetRequestable, and no other non-const functions
             // other than ForgetTxHash and GetRequestable in between, this branch will never execute (as txhashes
             // returned by GetRequestable always correspond to CANDIDATE_BEST announcements).
 
-            it = m_index.get<ByPeer>().find(ByPeerView{peer, false, txhash});
-            if (it == m_index.get<ByPeer>().end() || (it->GetState() != State::CANDIDATE_DELAYED &&
-                                                      it->GetState() != State::CANDIDATE_READY)) {
+            it = index.find(ByPeerView{peer, false, txhash});
+            if (it == index.end() || (it->GetState() != State::CANDIDATE_DELAYED &&
+                                      it->GetState() != State::CANDIDATE_READY)) {
                 // There is no CANDIDATE announcement tracked for this peer, so we have nothing to do. Either this
                 // txhash wasn't tracked at all (and the caller should have called ReceivedInv), or it was already
                 // requested and/or completed for other reasons and this is just a superfluous RequestedTx call.
@@ -643,8 +732,9 @@ public:
             // Look for an existing CANDIDATE_BEST or REQUESTED with the same txhash. We only need to do this if the
             // found announcement had a different state than CANDIDATE_BEST. If it did, invariants guarantee that no
             // other CANDIDATE_BEST or REQUESTED can exist.
-            auto it_old = m_index.get<ByTxHash>().lower_bound(ByTxHashView{txhash, State::CANDIDATE_BEST, 0});
-            if (it_old != m_index.get<ByTxHash>().end() && it_old->m_txhash == txhash) {
+            const TxHashEntry* entry = it->m_txhash_entry;
+            auto it_old = shard.m_index.get<ByTxHash>().lower_bound(ByTxHashView{entry, State::CANDIDATE_BEST, 0});
+            if (it_old != shard.m_index.get<ByTxHash>().end() && it_old->m_txhash_entry == entry) {
                 if (it_old->GetState() == State::CANDIDATE_BEST) {
                     // The data structure's invariants require that there can be at most one CANDIDATE_BEST or one
                     // REQUESTED announcement per txhash (but not both simultaneously), so we have to convert any
@@ -652,16 +742,16 @@ public:
                     // It doesn't matter whether we pick CANDIDATE_READY or _DELAYED here, as SetTimePoint()
                     // will correct it at GetRequestable() time. If time only goes forward, it will always be
                     // _READY, so pick that to avoid extra work in SetTimePoint().
-                    Modify<ByTxHash>(it_old, [](Announcement& ann) { ann.SetState(State::CANDIDATE_READY); });
+                    Modify<ByTxHash>(shard, it_old, [](Announcement& ann) { ann.SetState(State::CANDIDATE_READY); });
                 } else if (it_old->GetState() == State::REQUESTED) {
                     // As we're no longer waiting for a response to the previous REQUESTED announcement, convert it
                     // to COMPLETED. This also helps guaranteeing progress.
-                    Modify<ByTxHash>(it_old, [](Announcement& ann) { ann.SetState(State::COMPLETED); });
+                    Modify<ByTxHash>(shard, it_old, [](Announcement& ann) { ann.SetState(State::COMPLETED); });
                 }
             }
         }
 
-        Modify<ByPeer>(it, [expiry](Announcement& ann) {
+        Modify<ByPeer>(shard, it, [expiry](Announcement& ann) {
             ann.SetState(State::REQUESTED);
             ann.m_time = expiry;
         });
@@ -669,12 +759,9 @@ public:
 
     void ReceivedResponse(NodeId peer, const uint256& txhash)
     {
-        // We need to search the ByPeer index for both (peer, false, txhash) and (peer, true, txhash).
-        auto it = m_index.get<ByPeer>().find(ByPeerView{peer, false, txhash});
-        if (it == m_index.get<ByPeer>().end()) {
-            it = m_index.get<ByPeer>().find(ByPeerView{peer, true, txhash});
-        }
-        if (it != m_index.get<ByPeer>().end()) MakeCompleted(m_index.project<ByTxHash>(it));
+        Shard& shard = GetShard(txhash);
+        auto it = FindAnnouncement(shard, peer, txhash);
+        if (it != shard.m_index.get<ByPeer>().end()) MakeCompleted(shard, shard.m_index.project<ByTxHash>(it));
     }
 
     size_t CountInFlight(NodeId peer) const
@@ -699,7 +786,12 @@ public:
     }
 
     //! Count how many announcements are being tracked in total across all peers and transactions.
-    size_t Size() const { return m_index.size(); }
+    size_t Size() const
+    {
+        size_t size{0};
+        for (const Shard& shard : m_shards) size += shard.m_index.size();
+        return size;
+    }
 
     uint64_t ComputePriority(const uint256& txhash, NodeId peer, bool preferred) const
     {
@@ -10,6 +10,7 @@
 #include <util/system.h>
 #include <util/time.h>
 
+#include <cassert>
 #include <stdexcept>
 #include <string>
 
@@ -22,6 +23,14 @@
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <array>
+#endif
+
 static inline bool IOErrorIsPermanent(int err)
 {
     return err != WSAEAGAIN && err != WSAEINTR && err != WSAEWOULDBLOCK && err != WSAEINPROGRESS;
@@ -293,6 +302,88 @@ bool Sock::IsConnected(std::string& errmsg) const
     }
 }
 
+#ifdef USE_EPOLL
+/** Maximum number of events returned by one epoll_wait() call. */
+static constexpr int EPOLL_MAX_EVENTS{256};
+
+EpollEvents::EpollEvents()
+    : m_epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+      m_wake_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+    if (!IsValid()) return;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKE_TAG;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &ev) != 0) {
+        LogPrintf("Failed to watch the epoll wakeup descriptor: %s\n", NetworkErrorString(errno));
+        close(m_wake_fd);
+        m_wake_fd = -1;
+    }
+}
+
+EpollEvents::~EpollEvents()
+{
+    if (m_wake_fd >= 0) close(m_wake_fd);
+    if (m_epoll_fd >= 0) close(m_epoll_fd);
+}
+
+bool EpollEvents::IsValid() const
+{
+    return m_epoll_fd >= 0 && m_wake_fd >= 0;
+}
+
+bool EpollEvents::Add(SOCKET socket, uint64_t tag, Sock::Event requested, bool edge_triggered)
+{
+    assert(tag != WAKE_TAG);
+    epoll_event ev{};
+    if (requested & Sock::RECV) {
+        ev.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (requested & Sock::SEND) {
+        ev.events |= EPOLLOUT;
+    }
+    if (edge_triggered) {
+        ev.events |= EPOLLET;
+    }
+    ev.data.u64 = tag;
+    return epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, socket, &ev) == 0;
+}
+
+void EpollEvents::Remove(SOCKET socket)
+{
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, socket, nullptr);
+}
+
+bool EpollEvents::Wait(std::chrono::milliseconds timeout, std::vector<Event>& events)
+{
+    events.clear();
+    std::array<epoll_event, EPOLL_MAX_EVENTS> ready;
+    const int count{epoll_wait(m_epoll_fd, ready.data(), ready.size(), count_milliseconds(timeout))};
+    if (count < 0) return errno == EINTR;
+
+    for (int i = 0; i < count; ++i) {
+        const epoll_event& ev = ready[i];
+        if (ev.data.u64 == WAKE_TAG) {
+            // Reset the counter; it is non-blocking, so this can't hang.
+            uint64_t value;
+            [[maybe_unused]] const ssize_t n{read(m_wake_fd, &value, sizeof(value))};
+            continue;
+        }
+        events.push_back({ev.data.u64,
+                          (ev.events & (EPOLLIN | EPOLLRDHUP)) != 0,
+                          (ev.events & EPOLLOUT) != 0,
+                          (ev.events & (EPOLLERR | EPOLLHUP)) != 0});
+    }
+    return true;
+}
+
+void EpollEvents::Wake()
+{
+    const uint64_t one{1};
+    [[maybe_unused]] const ssize_t n{write(m_wake_fd, &one, sizeof(one))};
+}
+#endif // USE_EPOLL
+
 #ifdef WIN32
 std::string NetworkErrorString(int err)
 {
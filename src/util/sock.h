@@ -10,7 +10,9 @@
 #include <util/time.h>
 
 #include <chrono>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 /**
  * Maximum time to wait for I/O readiness.
@@ -176,6 +178,71 @@ protected:
     SOCKET m_socket;
 };
 
+#ifdef USE_EPOLL
+/**
+ * A persistent set of sockets to wait on, backed by epoll(7). Sockets stay
+ * registered across waits (until they are removed or closed), so a wait costs
+ * O(ready sockets) rather than O(registered sockets). Each socket is registered
+ * with a tag that is reported back with its events.
+ */
+class EpollEvents
+{
+public:
+    struct Event {
+        uint64_t tag;
+        //! Ready for recv() (data available or end of stream)
+        bool recv;
+        //! Ready for send()
+        bool send;
+        //! The socket is in error or has been hung up on
+        bool error;
+    };
+
+    //! Tag used internally for the wakeup descriptor, not available to callers
+    static constexpr uint64_t WAKE_TAG{UINT64_MAX};
+
+    EpollEvents();
+    ~EpollEvents();
+
+    EpollEvents(const EpollEvents&) = delete;
+    EpollEvents& operator=(const EpollEvents&) = delete;
+
+    /** Whether the epoll instance and its wakeup descriptor could be created. */
+    bool IsValid() const;
+
+    /**
+     * Start watching a socket.
+     * @param[in] socket The socket to watch.
+     * @param[in] tag Reported back with the socket's events.
+     * @param[in] requested Watch for these events, bitwise-or of `Sock::RECV` and `Sock::SEND`.
+     * @param[in] edge_triggered Only report the socket again after its state
+     * changed. The caller then has to keep receiving (or sending) until the
+     * call would block before it can rely on a new event.
+     * @return false if the socket could not be registered
+     */
+    bool Add(SOCKET socket, uint64_t tag, Sock::Event requested, bool edge_triggered);
+
+    /** Stop watching a socket. Closing it has the same effect. */
+    void Remove(SOCKET socket);
+
+    /**
+     * Wait for events on the registered sockets.
+     * @param[in] timeout Wait at most this long for the first event.
+     * @param[out] events Replaced by the events that occurred; empty after a
+     * timeout or a Wake().
+     * @return false on error
+     */
+    bool Wait(std::chrono::milliseconds timeout, std::vector<Event>& events);
+
+    /** Make a concurrent (or else the next) Wait() return early. Thread safe. */
+    void Wake();
+
+private:
+    int m_epoll_fd;
+    int m_wake_fd;
+};
+#endif // USE_EPOLL
+
 /** Return readable error string for a network error code */
 std::string NetworkErrorString(int err);
 
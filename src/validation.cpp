@@ -27,6 +27,7 @@
 #include <names/mempool.h>
 #include <node/blockstorage.h>
 #include <node/coinstats.h>
+#include <node/mempool_persist.h>
 #include <node/ui_interface.h>
 #include <node/utxo_snapshot.h>
 #include <policy/policy.h>
@@ -58,6 +59,7 @@
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <algorithm>
 #include <numeric>
 #include <optional>
 #include <string>
@@ -75,6 +77,8 @@
 static const unsigned int EXTRA_DESCENDANT_TX_SIZE_LIMIT = 10000;
 /** Maximum kilobytes for transactions to store for processing during reorg */
 static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
+/** Number of blocks (with undo data) read ahead when disconnecting several blocks */
+static constexpr size_t DISCONNECT_READAHEAD_BLOCKS{16};
 /** Time to wait between writing blocks/block index to disk. */
 static constexpr std::chrono::hours DATABASE_WRITE_INTERVAL{1};
 /** Time to wait between flushing chainstate to disk. */
@@ -467,6 +471,11 @@ public:
          * any transaction spending the same inputs as a transaction in the mempool is considered
          * a conflict. */
         const bool m_allow_bip125_replacement;
+        /** Whether the transactions are validated together as a package. Their name operations
+         * are then checked in one pass over the package rather than one transaction at a time
+         * in PreChecks(), and when submitted, the mempool is only trimmed once all of them are
+         * in. */
+        const bool m_package;
 
         /** Parameters for single transaction mempool validation. */
         static ATMPArgs SingleAccept(const CChainParams& chainparams, int64_t accept_time,
@@ -478,6 +487,7 @@ public:
                             /* m_coins_to_uncache */ coins_to_uncache,
                             /* m_test_accept */ test_accept,
                             /* m_allow_bip125_replacement */ true,
+                            /* m_package */ false,
             };
         }
 
@@ -490,6 +500,20 @@ public:
                             /* m_coins_to_uncache */ coins_to_uncache,
                             /* m_test_accept */ true,
                             /* m_allow_bip125_replacement */ false,
+                            /* m_package */ true,
+            };
+        }
+
+        /** Parameters for submitting a package to the mempool, e.g. one received by package relay. */
+        static ATMPArgs PackageSubmit(const CChainParams& chainparams, int64_t accept_time,
+                                      std::vector<COutPoint>& coins_to_uncache) {
+            return ATMPArgs{/* m_chainparams */ chainparams,
+                            /* m_accept_time */ accept_time,
+                            /* m_bypass_limits */ false,
+                            /* m_coins_to_uncache */ coins_to_uncache,
+                            /* m_test_accept */ false,
+                            /* m_allow_bip125_replacement */ false,
+                            /* m_package */ true,
             };
         }
 
@@ -580,6 +604,14 @@ private:
     // limiting is performed, false otherwise.
     bool Finalize(const ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Submit all transactions of a package that passed PolicyScriptChecks() to the mempool,
+    // parents first, and trim the mempool once they are all in. Returns true if all of them
+    // are in the mempool afterwards.
+    bool SubmitPackage(const ATMPArgs& args, std::vector<Workspace>& workspaces,
+                       PackageValidationState& package_state,
+                       std::map<const uint256, const MempoolAcceptResult>& results)
+         EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Compare a package's feerate against minimum allowed.
     bool CheckFeeRate(size_t package_size, CAmount package_fee, TxValidationState& state) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs)
     {
@@ -691,7 +723,7 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
         }
     }
 
-    if (!m_pool.checkNameOps(tx))
+    if (!args.m_package && !m_pool.checkNameOps(tx))
         return state.Invalid(TxValidationResult::TX_CONFLICT,
                              "txn-mempool-name-error");
 
@@ -1022,8 +1054,9 @@ bool MemPoolAccept::Finalize(const ATMPArgs& args, Workspace& ws)
     // Store transaction in memory
     m_pool.addUnchecked(*entry, ws.m_ancestors, validForFeeEstimation);
 
-    // trim mempool and check if tx was trimmed
-    if (!bypass_limits) {
+    // trim mempool and check if tx was trimmed; packages are trimmed once all their
+    // transactions are in, see SubmitPackage()
+    if (!bypass_limits && !args.m_package) {
         LimitMempoolSize(m_pool, m_active_chainstate.CoinsTip(), gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, std::chrono::hours{gArgs.GetIntArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY)});
         if (!m_pool.exists(GenTxid::Txid(hash)))
             return state.Invalid(TxValidationResult::TX_MEMPOOL_POLICY, "mempool full");
@@ -1031,6 +1064,76 @@ bool MemPoolAccept::Finalize(const ATMPArgs& args, Workspace& ws)
     return true;
 }
 
+bool MemPoolAccept::SubmitPackage(const ATMPArgs& args, std::vector<Workspace>& workspaces,
+                                  PackageValidationState& package_state,
+                                  std::map<const uint256, const MempoolAcceptResult>& results)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+
+    // ConsensusScriptChecks() needs the inputs of each transaction in the mempool or the UTXO
+    // set, so each transaction goes in right after its checks, making its outputs available to
+    // the transactions after it. A transaction that fails is recorded and skipped, along with
+    // the transactions spending it; those before it stay in the mempool.
+    bool tx_failed{false};
+    std::set<uint256> failed_txids;
+    const auto fail = [&](Workspace& ws) {
+        results.emplace(ws.m_ptx->GetWitnessHash(), MempoolAcceptResult::Failure(ws.m_state));
+        failed_txids.insert(ws.m_hash);
+        tx_failed = true;
+    };
+    for (Workspace& ws : workspaces) {
+        if (std::any_of(ws.m_ptx->vin.cbegin(), ws.m_ptx->vin.cend(),
+                        [&](const CTxIn& txin) { return failed_txids.count(txin.prevout.hash) > 0; })) {
+            ws.m_state.Invalid(TxValidationResult::TX_MISSING_INPUTS, "bad-txns-inputs-missingorspent");
+            fail(ws);
+            continue;
+        }
+        // Since PolicyScriptChecks() passed for all of them, none of this should fail.
+        if (!ConsensusScriptChecks(args, ws)) {
+            Assume(false);
+            fail(ws);
+            continue;
+        }
+        // The ancestors found in PreChecks() miss those in the package, which are in the
+        // mempool by now.
+        std::string unused_err_string;
+        ws.m_ancestors.clear();
+        if (!m_pool.CalculateMemPoolAncestors(*ws.m_entry, ws.m_ancestors, m_limit_ancestors, m_limit_ancestor_size,
+                                              m_limit_descendants, m_limit_descendant_size, unused_err_string)) {
+            ws.m_state.Invalid(TxValidationResult::TX_MEMPOOL_POLICY, "too-long-mempool-chain", unused_err_string);
+            fail(ws);
+            continue;
+        }
+        if (!Finalize(args, ws)) fail(ws);
+    }
+
+    // Trimming after each transaction could evict a parent before the child paying for it is in.
+    // Whatever made it in is trimmed once, and reported below if it survived.
+    LimitMempoolSize(m_pool, m_active_chainstate.CoinsTip(), gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, std::chrono::hours{gArgs.GetIntArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY)});
+
+    bool all_submitted{!tx_failed};
+    for (Workspace& ws : workspaces) {
+        if (results.count(ws.m_ptx->GetWitnessHash())) continue;
+        if (m_pool.exists(GenTxid::Wtxid(ws.m_ptx->GetWitnessHash()))) {
+            results.emplace(ws.m_ptx->GetWitnessHash(),
+                            MempoolAcceptResult::Success(std::move(ws.m_replaced_transactions),
+                                                         ws.m_vsize, ws.m_base_fees));
+            GetMainSignals().TransactionAddedToMempool(ws.m_ptx, m_pool.GetAndIncrementSequence());
+        } else {
+            ws.m_state.Invalid(TxValidationResult::TX_MEMPOOL_POLICY, "mempool full");
+            results.emplace(ws.m_ptx->GetWitnessHash(), MempoolAcceptResult::Failure(ws.m_state));
+            all_submitted = false;
+        }
+    }
+    if (tx_failed) {
+        package_state.Invalid(PackageValidationResult::PCKG_TX, "transaction failed");
+    } else if (!all_submitted) {
+        package_state.Invalid(PackageValidationResult::PCKG_POLICY, "mempool full");
+    }
+    return all_submitted;
+}
+
 MempoolAcceptResult MemPoolAccept::AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs& args)
 {
     AssertLockHeld(cs_main);
@@ -1092,6 +1195,17 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(const std::
         m_viewmempool.PackageAddTransaction(ws.m_ptx);
     }
 
+    // Check the name operations of the whole package at once, against the mempool and against
+    // each other, so that e.g. a name_update may follow the name_doi it spends.
+    size_t name_failed;
+    if (!m_pool.checkPackageNameOps(txns, name_failed)) {
+        Workspace& ws = workspaces[name_failed];
+        ws.m_state.Invalid(TxValidationResult::TX_CONFLICT, "txn-mempool-name-error");
+        package_state.Invalid(PackageValidationResult::PCKG_TX, "transaction failed");
+        results.emplace(ws.m_ptx->GetWitnessHash(), MempoolAcceptResult::Failure(ws.m_state));
+        return PackageMempoolAcceptResult(package_state, std::move(results));
+    }
+
     // Apply package mempool ancestor/descendant limits. Skip if there is only one transaction,
     // because it's unnecessary. Also, CPFP carve out can increase the limit for individual
     // transactions, but this exemption is not extended to packages in CheckPackageLimits().
@@ -1116,6 +1230,8 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(const std::
         }
     }
 
+    if (!args.m_test_accept) SubmitPackage(args, workspaces, package_state, results);
+
     return PackageMempoolAcceptResult(package_state, std::move(results));
 }
 
@@ -1151,19 +1267,38 @@ PackageMempoolAcceptResult ProcessNewPackage(CChainState& active_chainstate, CTx
                                                    const Package& package, bool test_accept)
 {
     AssertLockHeld(cs_main);
-    assert(test_accept); // Only allow package accept dry-runs (testmempoolaccept RPC).
     assert(!package.empty());
     assert(std::all_of(package.cbegin(), package.cend(), [](const auto& tx){return tx != nullptr;}));
 
     std::vector<COutPoint> coins_to_uncache;
     const CChainParams& chainparams = Params();
-    auto args = MemPoolAccept::ATMPArgs::PackageTestAccept(chainparams, GetTime(), coins_to_uncache);
-    const PackageMempoolAcceptResult result = MemPoolAccept(pool, active_chainstate).AcceptMultipleTransactions(package, args);
+    if (test_accept) {
+        auto args = MemPoolAccept::ATMPArgs::PackageTestAccept(chainparams, GetTime(), coins_to_uncache);
+        const PackageMempoolAcceptResult result = MemPoolAccept(pool, active_chainstate).AcceptMultipleTransactions(package, args);
 
-    // Uncache coins pertaining to transactions that were not submitted to the mempool.
-    for (const COutPoint& hashTx : coins_to_uncache) {
-        active_chainstate.CoinsTip().Uncache(hashTx);
+        // Uncache coins pertaining to transactions that were not submitted to the mempool.
+        for (const COutPoint& hashTx : coins_to_uncache) {
+            active_chainstate.CoinsTip().Uncache(hashTx);
+        }
+        return result;
+    }
+
+    // Parents relayed on their own may already be in the mempool; only the rest needs validation.
+    Package txns;
+    std::copy_if(package.cbegin(), package.cend(), std::back_inserter(txns),
+                 [&pool](const auto& tx) { return !pool.exists(GenTxid::Wtxid(tx->GetWitnessHash())); });
+    if (txns.empty()) return PackageMempoolAcceptResult(PackageValidationState{}, {});
+
+    auto args = MemPoolAccept::ATMPArgs::PackageSubmit(chainparams, GetTime(), coins_to_uncache);
+    const PackageMempoolAcceptResult result = MemPoolAccept(pool, active_chainstate).AcceptMultipleTransactions(txns, args);
+    if (!result.m_state.IsValid()) {
+        // As in AcceptToMemoryPool(), don't let invalid packages fill the coins cache.
+        for (const COutPoint& hashTx : coins_to_uncache) {
+            active_chainstate.CoinsTip().Uncache(hashTx);
+        }
     }
+    BlockValidationState state_dummy;
+    active_chainstate.FlushStateToDisk(state_dummy, FlushStateMode::PERIODIC);
     return result;
 }
 
@@ -1566,7 +1701,6 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, std::set<valtype>& unexpiredNames)
 {
     AssertLockHeld(::cs_main);
-    bool fClean = true;
 
     CBlockUndo blockUndo;
     if (!UndoReadFromDisk(blockUndo, pindex)) {
@@ -1574,6 +1708,14 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         return DISCONNECT_FAILED;
     }
 
+    return DisconnectBlock(block, pindex, view, unexpiredNames, blockUndo);
+}
+
+DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, std::set<valtype>& unexpiredNames, CBlockUndo& blockUndo)
+{
+    AssertLockHeld(::cs_main);
+    bool fClean = true;
+
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size()) {
         error("DisconnectBlock(): block and undo data inconsistent");
         return DISCONNECT_FAILED;
@@ -1638,15 +1780,94 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
 }
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CWorkStealingCheckQueue<CScriptCheck> scriptcheckqueue_work_stealing(128);
+//! Which of the two script check queues has worker threads (set at startup)
+static bool g_script_check_work_stealing{false};
 
-void StartScriptCheckWorkerThreads(int threads_num)
+/**
+ * Proof of work check of a block header, including its auxpow, for the header
+ * check queue. The header must outlive the check.
+ */
+class CHeaderCheck
 {
-    scriptcheckqueue.StartWorkerThreads(threads_num);
+private:
+    const CBlockHeader* m_header{nullptr};
+    const Consensus::Params* m_params{nullptr};
+
+public:
+    CHeaderCheck() = default;
+    CHeaderCheck(const CBlockHeader& header, const Consensus::Params& params) : m_header{&header}, m_params{&params} {}
+
+    bool operator()() const { return CheckProofOfWork(*m_header, *m_params); }
+
+    void swap(CHeaderCheck& check)
+    {
+        std::swap(m_header, check.m_header);
+        std::swap(m_params, check.m_params);
+    }
+};
+
+static CCheckQueue<CHeaderCheck> headercheckqueue(16);
+
+void StartScriptCheckWorkerThreads(int threads_num, bool work_stealing)
+{
+    g_script_check_work_stealing = work_stealing;
+    if (work_stealing) {
+        scriptcheckqueue_work_stealing.StartWorkerThreads(threads_num);
+    } else {
+        scriptcheckqueue.StartWorkerThreads(threads_num);
+    }
+    headercheckqueue.StartWorkerThreads(threads_num, "headerch");
 }
 
 void StopScriptCheckWorkerThreads()
 {
     scriptcheckqueue.StopWorkerThreads();
+    scriptcheckqueue_work_stealing.StopWorkerThreads();
+    headercheckqueue.StopWorkerThreads();
+}
+
+std::optional<std::vector<CTxOut>> GetSpentOutputsSnapshot(CChainState& active_chainstate, const CTxMemPool& pool,
+                                                           const CTransaction& tx)
+{
+    if (tx.IsCoinBase()) return std::nullopt;
+
+    std::vector<CTxOut> spent_outputs;
+    spent_outputs.reserve(tx.vin.size());
+    LOCK2(cs_main, pool.cs);
+    CCoinsViewMemPool view_mempool(&active_chainstate.CoinsTip(), pool);
+    CCoinsViewCache view(&view_mempool);
+    for (const CTxIn& txin : tx.vin) {
+        const Coin& coin{view.AccessCoin(txin.prevout)};
+        if (coin.IsSpent()) return std::nullopt;
+        spent_outputs.push_back(coin.out);
+    }
+    // The same standardness checks as MemPoolAccept::PreChecks, which
+    // rejects the transaction before it gets to its scripts otherwise.
+    if (fRequireStandard && !AreInputsStandard(tx, view)) return std::nullopt;
+    if (tx.HasWitness() && fRequireStandard && !IsWitnessStandard(tx, view)) return std::nullopt;
+    return spent_outputs;
+}
+
+bool PreVerifyInputScripts(const CTransaction& tx, std::vector<CTxOut>&& spent_outputs)
+{
+    if (tx.IsCoinBase() || spent_outputs.size() != tx.vin.size()) return false;
+
+    // The same flags as MemPoolAccept::PolicyScriptChecks, so that the
+    // signatures cached here are the ones it looks up.
+    constexpr unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS | SCRIPT_VERIFY_NAMES_MEMPOOL;
+    PrecomputedTransactionData txdata;
+    txdata.Init(tx, std::move(spent_outputs));
+
+    std::vector<CScriptCheck> checks;
+    checks.reserve(tx.vin.size());
+    for (unsigned int i = 0; i < tx.vin.size(); ++i) {
+        checks.emplace_back(txdata.m_spent_outputs[i], tx, i, flags, /*cacheIn=*/true, &txdata);
+    }
+
+    // This runs on threads of its own, so the script check queue stays
+    // free for block validation.
+    return std::all_of(checks.begin(), checks.end(), [](CScriptCheck& check) { return check(); });
 }
 
 /**
@@ -1848,7 +2069,12 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     // in multiple threads). Preallocate the vector size so a new allocation
     // doesn't invalidate pointers into the vector, and keep txsdata in scope
     // for as long as `control`.
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && g_parallel_script_checks ? &scriptcheckqueue : nullptr);
+    // Only one of the two controls gets a queue, the other passes everything
+    // through as a no-op.
+    const bool parallel_script_checks{fScriptChecks && g_parallel_script_checks};
+    CCheckQueueControl<CScriptCheck> control(parallel_script_checks && !g_script_check_work_stealing ? &scriptcheckqueue : nullptr);
+    CCheckQueueControl<CScriptCheck, CWorkStealingCheckQueue<CScriptCheck>> control_work_stealing(
+        parallel_script_checks && g_script_check_work_stealing ? &scriptcheckqueue_work_stealing : nullptr);
     std::vector<PrecomputedTransactionData> txsdata(block.vtx.size());
 
     std::vector<int> prevheights;
@@ -1915,6 +2141,7 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
                     tx.GetHash().ToString(), state.ToString());
             }
             control.Add(vChecks);
+            control_work_stealing.Add(vChecks);
         }
 
         CTxUndo undoDummy;
@@ -1933,7 +2160,7 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-cb-amount");
     }
 
-    if (!control.Wait()) {
+    if (!control.Wait() || !control_work_stealing.Wait()) {
         LogPrintf("ERROR: %s: CheckQueue failed\n", __func__);
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "block-validation-failed");
     }
@@ -2263,7 +2490,7 @@ void CChainState::UpdateTip(const CBlockIndex* pindexNew)
   * disconnectpool (note that the caller is responsible for mempool consistency
   * in any case).
   */
-bool CChainState::DisconnectTip(BlockValidationState& state, DisconnectedBlockTransactions* disconnectpool)
+bool CChainState::DisconnectTip(BlockValidationState& state, DisconnectedBlockTransactions* disconnectpool, BlockUndoReadahead* readahead)
 {
     AssertLockHeld(cs_main);
     if (m_mempool) AssertLockHeld(m_mempool->cs);
@@ -2271,10 +2498,12 @@ bool CChainState::DisconnectTip(BlockValidationState& state, DisconnectedBlockTr
     CBlockIndex *pindexDelete = m_chain.Tip();
     assert(pindexDelete);
     CheckNameDB (*this, true);
-    // Read block from disk.
+    // Read block from disk, unless the readahead already has it (and its undo data).
     std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    CBlockUndo blockUndo;
+    const bool fReadAhead = readahead && readahead->Take(pindexDelete, pblock, blockUndo);
     CBlock& block = *pblock;
-    if (!ReadBlockFromDisk(block, pindexDelete, m_params.GetConsensus())) {
+    if (!fReadAhead && !ReadBlockFromDisk(block, pindexDelete, m_params.GetConsensus())) {
         return error("DisconnectTip(): Failed to read block");
     }
     // Apply the block atomically to the chain state.
@@ -2283,7 +2512,9 @@ bool CChainState::DisconnectTip(BlockValidationState& state, DisconnectedBlockTr
     {
         CCoinsViewCache view(&CoinsTip());
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
-        if (DisconnectBlock(block, pindexDelete, view, unexpiredNames) != DISCONNECT_OK)
+        const DisconnectResult res = fReadAhead ? DisconnectBlock(block, pindexDelete, view, unexpiredNames, blockUndo)
+                                                : DisconnectBlock(block, pindexDelete, view, unexpiredNames);
+        if (res != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
@@ -2321,6 +2552,39 @@ bool CChainState::DisconnectTip(BlockValidationState& state, DisconnectedBlockTr
     return true;
 }
 
+/** Look up the coins and names that disconnecting a block will touch, so that
+ *  the database has them cached by the time DisconnectBlock runs. */
+static void WarmDisconnectBlock(const CCoinsView& db, const CBlock& block, const CBlockUndo& blockUndo)
+{
+    PrefetchNameUndo(blockUndo, db);
+    for (const auto& tx : block.vtx) {
+        for (size_t o = 0; o < tx->vout.size(); ++o) {
+            if (!tx->vout[o].scriptPubKey.IsUnspendable()) db.HaveCoin(COutPoint(tx->GetHash(), o));
+        }
+        if (tx->IsCoinBase()) continue;
+        for (const CTxIn& txin : tx->vin) db.HaveCoin(txin.prevout);
+    }
+}
+
+std::unique_ptr<BlockUndoReadahead> CChainState::StartDisconnectReadahead(const CBlockIndex* pindex_tip, const CBlockIndex* pindex_stop, bool warm)
+{
+    AssertLockHeld(cs_main);
+
+    std::vector<const CBlockIndex*> run;
+    for (const CBlockIndex* pindex = pindex_tip; pindex && pindex != pindex_stop && pindex->nHeight > 0; pindex = pindex->pprev) {
+        run.push_back(pindex);
+    }
+    if (run.size() < 2) return nullptr;
+
+    BlockUndoReadahead::WarmFn warm_fn;
+    if (warm) {
+        const CCoinsView& db = CoinsDB();
+        warm_fn = [&db](const CBlock& block, const CBlockUndo& blockUndo) { WarmDisconnectBlock(db, block, blockUndo); };
+    }
+    LogPrint(BCLog::VALIDATION, "%s: reading ahead %u blocks to disconnect\n", __func__, run.size());
+    return std::make_unique<BlockUndoReadahead>(run, m_params.GetConsensus(), DISCONNECT_READAHEAD_BLOCKS, std::move(warm_fn));
+}
+
 static int64_t nTimeReadFromDisk = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
@@ -2528,8 +2792,9 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, CBlockIndex
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
+    auto readahead{StartDisconnectReadahead(m_chain.Tip(), pindexFork, /* warm= */ true)};
     while (m_chain.Tip() && m_chain.Tip() != pindexFork) {
-        if (!DisconnectTip(state, &disconnectpool)) {
+        if (!DisconnectTip(state, &disconnectpool, readahead.get())) {
             // This is likely a fatal error, but keep the mempool consistent,
             // just in case. Only remove from the mempool in this case.
             MaybeUpdateMempoolForReorg(disconnectpool, false);
@@ -2542,6 +2807,7 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, CBlockIndex
         }
         fBlocksDisconnected = true;
     }
+    readahead.reset();
 
     // Build list of new blocks to connect (in descending height order).
     std::vector<CBlockIndex*> vpindexToConnect;
@@ -2791,9 +3057,15 @@ bool CChainState::InvalidateBlock(BlockValidationState& state, CBlockIndex* pind
     // build a map once so that we can look up candidate blocks by chain
     // work as we go.
     std::multimap<const arith_uint256, CBlockIndex *> candidate_blocks_by_work;
+    // cs_main is released between the disconnects below, so the readahead
+    // must not touch the chainstate database.
+    std::unique_ptr<BlockUndoReadahead> readahead;
 
     {
         LOCK(cs_main);
+        if (m_chain.Contains(pindex)) {
+            readahead = StartDisconnectReadahead(m_chain.Tip(), pindex->pprev, /* warm= */ false);
+        }
         for (const auto& entry : m_blockman.m_block_index) {
             CBlockIndex *candidate = entry.second;
             // We don't need to put anything in our active chain into the
@@ -2828,7 +3100,7 @@ bool CChainState::InvalidateBlock(BlockValidationState& state, CBlockIndex* pind
         // ActivateBestChain considers blocks already in m_chain
         // unconditionally valid already, so force disconnect away from it.
         DisconnectedBlockTransactions disconnectpool;
-        bool ret = DisconnectTip(state, &disconnectpool);
+        bool ret = DisconnectTip(state, &disconnectpool, readahead.get());
         // DisconnectTip will add transactions to disconnectpool.
         // Adjust the mempool to be consistent with the new tip, adding
         // transactions back to the mempool if disconnecting was successful,
@@ -3342,7 +3614,7 @@ static bool ContextualCheckBlock(const CBlock& block, BlockValidationState& stat
     return true;
 }
 
-bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool check_pow)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3361,7 +3633,7 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationS
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus())) {
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), check_pow)) {
             LogPrint(BCLog::VALIDATION, "%s: Consensus::CheckBlockHeader: %s, %s\n", __func__, hash.ToString(), state.ToString());
             return false;
         }
@@ -3434,12 +3706,31 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationS
 bool ChainstateManager::ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, BlockValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
     AssertLockNotHeld(cs_main);
+
+    // Checking the proof of work, and the auxpow of merge-mined headers, is
+    // most of the cost of accepting headers and needs no chain state. Do it
+    // for the whole batch on the header check threads before taking cs_main.
+    // If any header fails, they are checked again one by one below, so that
+    // the headers before the invalid one are still accepted and the state
+    // describes the failure as before.
+    bool pow_checked{false};
+    if (headers.size() > 1) {
+        std::vector<CHeaderCheck> checks;
+        checks.reserve(headers.size());
+        for (const CBlockHeader& header : headers) {
+            checks.emplace_back(header, chainparams.GetConsensus());
+        }
+        CCheckQueueControl<CHeaderCheck> control(&headercheckqueue);
+        control.Add(checks);
+        pow_checked = control.Wait();
+    }
+
     {
         LOCK(cs_main);
         for (const CBlockHeader& header : headers) {
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
             bool accepted = m_blockman.AcceptBlockHeader(
-                header, state, chainparams, &pindex);
+                header, state, chainparams, &pindex, /*check_pow=*/!pow_checked);
             ActiveChainstate().CheckBlockIndex();
 
             if (!accepted) {
@@ -3770,34 +4061,60 @@ CBlockIndex * BlockManager::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = m_block_index_arena_used < m_block_index_arena_size ?
+                                 &m_block_index_arena[m_block_index_arena_used++] :
+                                 new CBlockIndex();
     mi = m_block_index.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
+void BlockManager::ReserveBlockIndex(size_t count)
+{
+    AssertLockHeld(cs_main);
+
+    m_block_index.reserve(m_block_index.size() + count);
+    if (m_block_index_arena_size == 0) {
+        m_block_index_arena = std::make_unique<CBlockIndex[]>(count);
+        m_block_index_arena_size = count;
+        m_block_index_arena_used = 0;
+    }
+}
+
 bool BlockManager::LoadBlockIndex(
     const Consensus::Params& consensus_params,
     std::set<CBlockIndex*, CBlockIndexWorkComparator>& block_index_candidates)
 {
-    if (!m_block_tree_db->LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); })) {
+    const int64_t time_start = GetTimeMillis();
+    if (!m_block_tree_db->LoadBlockIndexGuts(
+            consensus_params,
+            [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); },
+            [this](size_t count) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { this->ReserveBlockIndex(count); })) {
         return false;
     }
+    const int64_t time_loaded = GetTimeMillis();
 
-    // Calculate nChainWork
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(m_block_index.size());
-    for (const std::pair<const uint256, CBlockIndex*>& item : m_block_index)
-    {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+    // Calculate nChainWork. Heights are dense, so a counting sort orders the
+    // entries in linear time.
+    int max_height = -1;
+    for (const std::pair<const uint256, CBlockIndex*>& item : m_block_index) {
+        max_height = std::max(max_height, item.second->nHeight);
+    }
+    std::vector<size_t> height_offsets(max_height + 2, 0);
+    for (const std::pair<const uint256, CBlockIndex*>& item : m_block_index) {
+        ++height_offsets[item.second->nHeight + 1];
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
+    std::partial_sum(height_offsets.begin(), height_offsets.end(), height_offsets.begin());
+    std::vector<CBlockIndex*> vSortedByHeight(m_block_index.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : m_block_index) {
+        vSortedByHeight[height_offsets[item.second->nHeight]++] = item.second;
+    }
+    const int64_t time_sorted = GetTimeMillis();
+
+    for (CBlockIndex* pindex : vSortedByHeight)
     {
         if (ShutdownRequested()) return false;
-        CBlockIndex* pindex = item.second;
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         // We can link the chain of blocks for which we've received transactions at some point.
@@ -3831,6 +4148,9 @@ bool BlockManager::LoadBlockIndex(
             pindexBestHeader = pindex;
     }
 
+    LogPrintf("%s: %u entries loaded in %dms, sorted by height in %dms, chain work computed in %dms\n",
+              __func__, m_block_index.size(), time_loaded - time_start, time_sorted - time_loaded,
+              GetTimeMillis() - time_sorted);
     return true;
 }
 
@@ -3838,11 +4158,18 @@ void BlockManager::Unload() {
     m_failed_blocks.clear();
     m_blocks_unlinked.clear();
 
+    const CBlockIndex* const arena_begin = m_block_index_arena.get();
+    const CBlockIndex* const arena_end = arena_begin + m_block_index_arena_size;
     for (const BlockMap::value_type& entry : m_block_index) {
-        delete entry.second;
+        const bool in_arena = !std::less<const CBlockIndex*>{}(entry.second, arena_begin) &&
+                              std::less<const CBlockIndex*>{}(entry.second, arena_end);
+        if (!in_arena) delete entry.second;
     }
 
     m_block_index.clear();
+    m_block_index_arena.reset();
+    m_block_index_arena_size = 0;
+    m_block_index_arena_used = 0;
 }
 
 bool BlockManager::LoadBlockIndexDB(std::set<CBlockIndex*, CBlockIndexWorkComparator>& setBlockIndexCandidates)
@@ -3897,10 +4224,6 @@ bool BlockManager::LoadBlockIndexDB(std::set<CBlockIndex*, CBlockIndexWorkCompar
     m_block_tree_db->ReadReindexing(fReindexing);
     if(fReindexing) fReindex = true;
 
-    // Check whether we have the name history
-    m_block_tree_db->ReadFlag("namehistory", fNameHistory);
-    LogPrintf("LoadBlockIndexDB(): name history %s\n", fNameHistory ? "enabled" : "disabled");
-
     return true;
 }
 
@@ -4116,15 +4439,19 @@ bool CChainState::ReplayBlocks()
     }
 
     // Rollback along the old branch.
+    const auto readahead{StartDisconnectReadahead(pindexOld, pindexFork, /* warm= */ true)};
     while (pindexOld != pindexFork) {
         if (pindexOld->nHeight > 0) { // Never disconnect the genesis block.
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindexOld, m_params.GetConsensus())) {
+            auto pblock = std::make_shared<CBlock>();
+            CBlockUndo blockUndo;
+            const bool fReadAhead = readahead && readahead->Take(pindexOld, pblock, blockUndo);
+            if (!fReadAhead && !ReadBlockFromDisk(*pblock, pindexOld, m_params.GetConsensus())) {
                 return error("RollbackBlock(): ReadBlockFromDisk() failed at %d, hash=%s", pindexOld->nHeight, pindexOld->GetBlockHash().ToString());
             }
             LogPrintf("Rolling back %s (%i)\n", pindexOld->GetBlockHash().ToString(), pindexOld->nHeight);
             std::set<valtype> dummyNames;
-            DisconnectResult res = DisconnectBlock(block, pindexOld, cache, dummyNames);
+            DisconnectResult res = fReadAhead ? DisconnectBlock(*pblock, pindexOld, cache, dummyNames, blockUndo)
+                                              : DisconnectBlock(*pblock, pindexOld, cache, dummyNames);
             if (res == DISCONNECT_FAILED) {
                 return error("RollbackBlock(): DisconnectBlock failed at %d, hash=%s", pindexOld->nHeight, pindexOld->GetBlockHash().ToString());
             }
@@ -4214,8 +4541,6 @@ bool ChainstateManager::LoadBlockIndex()
         // needs_init.
 
         LogPrintf("Initializing databases...\n");
-        fNameHistory = gArgs.GetBoolArg("-namehistory", false);
-        m_blockman.m_block_tree_db->WriteFlag("namehistory", fNameHistory);
     }
     return true;
 }
@@ -4245,122 +4570,133 @@ bool CChainState::LoadGenesisBlock()
     return true;
 }
 
+void ScanExternalBlockFile(FILE* fileIn, const CChainParams& params, const std::function<bool(std::shared_ptr<CBlock>, uint64_t, unsigned int)>& fn)
+{
+    // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+    CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
+    uint64_t nRewind = blkdat.GetPos();
+    while (!blkdat.eof()) {
+        if (ShutdownRequested()) return;
+
+        blkdat.SetPos(nRewind);
+        nRewind++; // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+            blkdat.FindByte(params.MessageStart()[0]);
+            nRewind = blkdat.GetPos()+1;
+            blkdat >> buf;
+            if (memcmp(buf, params.MessageStart(), CMessageHeader::MESSAGE_START_SIZE)) {
+                continue;
+            }
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            break;
+        }
+        try {
+            // read block
+            uint64_t nBlockPos = blkdat.GetPos();
+            blkdat.SetLimit(nBlockPos + nSize);
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            blkdat >> *pblock;
+            nRewind = blkdat.GetPos();
+
+            if (!fn(std::move(pblock), nBlockPos, nSize)) break;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+        }
+    }
+}
+
 void CChainState::LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, FlatFilePos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            if (ShutdownRequested()) return;
-
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(m_params.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> buf;
-                if (memcmp(buf, m_params.MessageStart(), CMessageHeader::MESSAGE_START_SIZE)) {
-                    continue;
-                }
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                uint256 hash = block.GetHash();
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    if (hash != m_params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(block.hashPrevBlock)) {
-                        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                                block.hashPrevBlock.ToString());
-                        if (dbp)
-                            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                        continue;
-                    }
+        ScanExternalBlockFile(fileIn, m_params, [&](std::shared_ptr<CBlock> pblock, uint64_t nBlockPos, unsigned int) {
+            if (dbp)
+                dbp->nPos = nBlockPos;
+            return LoadExternalBlock(pblock, dbp, nLoaded);
+        });
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+    LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+}
 
-                    // process in case the block isn't known yet
-                    CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                      BlockValidationState state;
-                      if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr)) {
-                          nLoaded++;
-                      }
-                      if (state.IsError()) {
-                          break;
-                      }
-                    } else if (hash != m_params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
-                }
+bool CChainState::LoadExternalBlock(const std::shared_ptr<CBlock>& pblock, FlatFilePos* dbp, int& nLoaded)
+{
+    const CBlock& block = *pblock;
+    uint256 hash = block.GetHash();
+    {
+        LOCK(cs_main);
+        // detect out of order blocks, and store them for later
+        if (hash != m_params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(block.hashPrevBlock)) {
+            LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                    block.hashPrevBlock.ToString());
+            if (dbp)
+                m_blocks_unknown_parent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+            return true;
+        }
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == m_params.GetConsensus().hashGenesisBlock) {
-                    BlockValidationState state;
-                    if (!ActivateBestChain(state, nullptr)) {
-                        break;
-                    }
-                }
+        // process in case the block isn't known yet
+        CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
+        if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+          BlockValidationState state;
+          if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr)) {
+              nLoaded++;
+          }
+          if (state.IsError()) {
+              return false;
+          }
+        } else if (hash != m_params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+            LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
+        }
+    }
 
-                NotifyHeaderTip(*this);
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, FlatFilePos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, m_params.GetConsensus())) {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            BlockValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr)) {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip(*this);
-                    }
+    // Activate the genesis block so normal node progress can continue
+    if (hash == m_params.GetConsensus().hashGenesisBlock) {
+        BlockValidationState state;
+        if (!ActivateBestChain(state, nullptr)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip(*this);
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = m_blocks_unknown_parent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, FlatFilePos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, m_params.GetConsensus())) {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                BlockValidationState dummy;
+                if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr)) {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
+            range.first++;
+            m_blocks_unknown_parent.erase(it);
+            NotifyHeaderTip(*this);
         }
-    } catch (const std::runtime_error& e) {
-        AbortNode(std::string("System error: ") + e.what());
     }
-    LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    return true;
 }
 
 void CChainState::CheckBlockIndex()
@@ -4624,8 +4960,6 @@ bool CChainState::ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
     return ret;
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
-
 bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mockable_fopen_function)
 {
     int64_t nExpiryTimeout = gArgs.GetIntArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
@@ -4642,91 +4976,173 @@ bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mocka
     int64_t already_there = 0;
     int64_t unbroadcast = 0;
     int64_t nNow = GetTime();
+    const auto start{std::chrono::steady_clock::now()};
 
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION && version != MEMPOOL_DUMP_VERSION_NO_METADATA) {
             return false;
         }
         uint64_t num;
         file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
+
+        // Everything up to mempool acceptance happens on the worker threads,
+        // while this thread reads ahead and adds the transactions in order.
+        const int threads{std::clamp(GetNumCores() - 1, 0, MAX_MEMPOOL_LOAD_THREADS)};
+        MempoolReloader reloader{active_chainstate, pool, num > 1 ? threads : 0, file.GetVersion(), nNow - nExpiryTimeout};
+        const auto accept_next = [&]() {
+            const auto job{reloader.Next()};
+            if (!job->entry) {
+                throw std::ios_base::failure("Corrupt mempool entry");
+            }
+            const CTransactionRef& tx{job->entry->tx};
+            CAmount amountdelta = job->entry->fee_delta;
             if (amountdelta) {
                 pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
-            if (nTime > nNow - nExpiryTimeout) {
-                LOCK(cs_main);
-                const auto& accepted = AcceptToMemoryPool(active_chainstate, tx, nTime, /*bypass_limits=*/false, /*test_accept=*/false);
-                if (accepted.m_result_type == MempoolAcceptResult::ResultType::VALID) {
-                    ++count;
+            if (job->expired) {
+                ++expired;
+                return;
+            }
+            LOCK(cs_main);
+            const auto& accepted = AcceptToMemoryPool(active_chainstate, tx, job->entry->time, /*bypass_limits=*/false, /*test_accept=*/false);
+            if (accepted.m_result_type == MempoolAcceptResult::ResultType::VALID) {
+                ++count;
+            } else {
+                // mempool may contain the transaction already, e.g. from
+                // wallet(s) having loaded it while we were processing
+                // mempool transactions; consider these as valid, instead of
+                // failed, but mark them as 'already there'
+                if (pool.exists(GenTxid::Txid(tx->GetHash()))) {
+                    ++already_there;
                 } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (pool.exists(GenTxid::Txid(tx->GetHash()))) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
+                    ++failed;
                 }
+            }
+        };
+
+        while (num--) {
+            if (version == MEMPOOL_DUMP_VERSION) {
+                MempoolRecord record;
+                file >> record;
+                reloader.Add(std::move(record));
             } else {
-                ++expired;
+                MempoolDumpEntry entry;
+                file >> entry.tx;
+                file >> entry.time;
+                file >> entry.fee_delta;
+                reloader.Add(std::move(entry));
             }
+            while (reloader.Pending() >= MEMPOOL_LOAD_WINDOW) {
+                accept_next();
+            }
+            if (ShutdownRequested())
+                return false;
+        }
+        while (reloader.Pending() > 0) {
+            accept_next();
             if (ShutdownRequested())
                 return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
 
-        for (const auto& i : mapDeltas) {
+        MempoolDumpTrailer trailer;
+        if (version == MEMPOOL_DUMP_VERSION) {
+            MempoolRecord record;
+            file >> record;
+            if (!record.Parse(trailer, file.GetVersion())) {
+                throw std::ios_base::failure("Corrupt mempool trailer");
+            }
+        } else {
+            file >> trailer.deltas;
+            file >> trailer.unbroadcast_txids;
+        }
+
+        for (const auto& i : trailer.deltas) {
             pool.PrioritiseTransaction(i.first, i.second);
         }
 
-        std::set<uint256> unbroadcast_txids;
-        file >> unbroadcast_txids;
-        unbroadcast = unbroadcast_txids.size();
-        for (const auto& txid : unbroadcast_txids) {
+        unbroadcast = trailer.unbroadcast_txids.size();
+        for (const auto& txid : trailer.unbroadcast_txids) {
             // Ensure transactions were accepted to mempool then add to
             // unbroadcast set.
             if (pool.get(txid) != nullptr) pool.AddUnbroadcastTx(txid);
         }
+
+        const auto elapsed{std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start)};
+        const int64_t total{count + failed + expired + already_there};
+        LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i waiting for initial broadcast\n", count, failed, expired, already_there, unbroadcast);
+        LogPrintf("Loaded mempool in %.2fs (%.0f tx/s) with %d pre-validation threads, %u scripts pre-verified\n",
+                  elapsed.count(), elapsed.count() > 0 ? total / elapsed.count() : 0.0, reloader.Threads(), reloader.ScriptsOk());
     } catch (const std::exception& e) {
         LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i waiting for initial broadcast\n", count, failed, expired, already_there, unbroadcast);
     return true;
 }
 
-bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function, bool skip_file_commit)
+bool DumpMempool(const CTxMemPool& pool, CChainState& active_chainstate, FopenFn mockable_fopen_function, bool skip_file_commit)
 {
     int64_t start = GetTimeMicros();
 
-    std::map<uint256, CAmount> mapDeltas;
-    std::vector<TxMempoolInfo> vinfo;
-    std::set<uint256> unbroadcast_txids;
+    std::vector<MempoolDumpEntry> entries;
+    MempoolDumpTrailer trailer;
 
     static Mutex dump_mutex;
     LOCK(dump_mutex);
 
+    const bool v1{gArgs.GetBoolArg("-persistmempoolv1", DEFAULT_PERSIST_V1_DAT)};
+    //! Entry and input index of the inputs that spend confirmed outputs
+    std::vector<std::pair<size_t, uint32_t>> confirmed_inputs;
+
     {
         LOCK(pool.cs);
         for (const auto &i : pool.mapDeltas) {
-            mapDeltas[i.first] = i.second;
+            trailer.deltas[i.first] = i.second;
+        }
+        // infoAll() returns the transactions in topological order. Unless
+        // the old format is written, the outputs they spend are recorded so
+        // that a reload can check their scripts before the parents are back
+        // in the mempool. Those of mempool parents are copied right away,
+        // and the confirmed ones looked up below.
+        for (const auto& info : pool.infoAll()) {
+            MempoolDumpEntry& entry{entries.emplace_back()};
+            entry.tx = info.tx;
+            entry.time = count_seconds(info.m_time);
+            entry.fee_delta = info.nFeeDelta;
+            if (!v1) {
+                entry.spent_outputs.resize(info.tx->vin.size());
+                for (uint32_t i = 0; i < info.tx->vin.size(); ++i) {
+                    const COutPoint& prevout{info.tx->vin[i].prevout};
+                    if (const CTransactionRef parent{pool.get(prevout.hash)}) {
+                        entry.spent_outputs[i] = parent->vout[prevout.n];
+                    } else {
+                        confirmed_inputs.emplace_back(entries.size() - 1, i);
+                    }
+                }
+            }
+            trailer.deltas.erase(info.tx->GetHash());
+        }
+        trailer.unbroadcast_txids = pool.GetUnbroadcastTxs();
+    }
+
+    if (!confirmed_inputs.empty()) {
+        LOCK(cs_main);
+        CCoinsViewCache& coins_tip{active_chainstate.CoinsTip()};
+        for (const auto& [entry_index, input_index] : confirmed_inputs) {
+            MempoolDumpEntry& entry{entries[entry_index]};
+            if (entry.spent_outputs.empty()) continue;
+            // A block connected since the mempool was copied may have spent
+            // the output. The entry is then dumped without spent outputs,
+            // like one from an older version.
+            Coin coin;
+            if (!coins_tip.GetCoin(entry.tx->vin[input_index].prevout, coin)) {
+                entry.spent_outputs.clear();
+                continue;
+            }
+            entry.spent_outputs[input_index] = std::move(coin.out);
         }
-        vinfo = pool.infoAll();
-        unbroadcast_txids = pool.GetUnbroadcastTxs();
     }
 
     int64_t mid = GetTimeMicros();
@@ -4739,21 +5155,27 @@ bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function, bool s
 
         CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
 
-        uint64_t version = MEMPOOL_DUMP_VERSION;
+        uint64_t version = v1 ? MEMPOOL_DUMP_VERSION_NO_METADATA : MEMPOOL_DUMP_VERSION;
         file << version;
 
-        file << (uint64_t)vinfo.size();
-        for (const auto& i : vinfo) {
-            file << *(i.tx);
-            file << int64_t{count_seconds(i.m_time)};
-            file << int64_t{i.nFeeDelta};
-            mapDeltas.erase(i.tx->GetHash());
+        file << (uint64_t)entries.size();
+        for (const auto& entry : entries) {
+            if (v1) {
+                file << *entry.tx;
+                file << entry.time;
+                file << entry.fee_delta;
+            } else {
+                WriteMempoolRecord(file, entry);
+            }
         }
 
-        file << mapDeltas;
-
-        LogPrintf("Writing %d unbroadcast transactions to disk.\n", unbroadcast_txids.size());
-        file << unbroadcast_txids;
+        LogPrintf("Writing %d unbroadcast transactions to disk.\n", trailer.unbroadcast_txids.size());
+        if (v1) {
+            file << trailer.deltas;
+            file << trailer.unbroadcast_txids;
+        } else {
+            WriteMempoolRecord(file, trailer);
+        }
 
         if (!skip_file_commit && !FileCommit(file.Get()))
             throw std::runtime_error("FileCommit failed");
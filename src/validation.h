@@ -27,6 +27,7 @@
 #include <util/translation.h>
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
@@ -37,6 +38,8 @@
 #include <utility>
 #include <vector>
 
+class BlockUndoReadahead;
+class CBlockUndo;
 class CChainState;
 class CBlockTreeDB;
 class CChainParams;
@@ -66,6 +69,8 @@ static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
 static const int MAX_SCRIPTCHECK_THREADS = 15;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -parworkstealing default (script checks use per-thread queues with work stealing) */
+static constexpr bool DEFAULT_SCRIPTCHECK_WORK_STEALING{false};
 static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
@@ -73,6 +78,8 @@ static constexpr bool DEFAULT_COINSTATSINDEX{false};
 static const char* const DEFAULT_BLOCKFILTERINDEX = "0";
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -persistmempoolv1 */
+static const bool DEFAULT_PERSIST_V1_DAT = false;
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of ActiveChain().Tip() will not be pruned. */
@@ -128,9 +135,10 @@ extern const std::vector<std::string> CHECKLEVEL_DOC;
 
 /** Unload database information */
 void UnloadBlockIndex(CTxMemPool* mempool, ChainstateManager& chainman);
-/** Run instances of script checking worker threads */
-void StartScriptCheckWorkerThreads(int threads_num);
-/** Stop all of the script checking worker threads */
+/** Run instances of script checking worker threads, and as many header checking ones.
+ *  With work_stealing, ConnectBlock hands its script checks to a CWorkStealingCheckQueue. */
+void StartScriptCheckWorkerThreads(int threads_num, bool work_stealing = DEFAULT_SCRIPTCHECK_WORK_STEALING);
+/** Stop all of the script and header checking worker threads */
 void StopScriptCheckWorkerThreads();
 
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams);
@@ -225,21 +233,50 @@ MempoolAcceptResult AcceptToMemoryPool(CChainState& active_chainstate, const CTr
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 /**
-* Atomically test acceptance of a package. If the package only contains one tx, package rules still
-* apply. Package validation does not allow BIP125 replacements, so the transaction(s) cannot spend
-* the same inputs as any transaction in the mempool.
+* Validate a package, with one coins view and one pass over the name operations of all its
+* transactions, and optionally submit it to the mempool. If the package only contains one tx,
+* package rules still apply. Package validation does not allow BIP125 replacements, so the
+* transaction(s) cannot spend the same inputs as any transaction in the mempool.
 * @param[in]    txns                Group of transactions which may be independent or contain
 *                                   parent-child dependencies. The transactions must not conflict
 *                                   with each other, i.e., must not spend the same inputs. If any
 *                                   dependencies exist, parents must appear anywhere in the list
 *                                   before their children.
-* @returns a PackageMempoolAcceptResult which includes a MempoolAcceptResult for each transaction.
-* If a transaction fails, validation will exit early and some results may be missing.
+* @param[in]    test_accept         When true, run validation checks but don't submit to mempool.
+*                                   Otherwise, transactions already in the mempool are skipped,
+*                                   and the others submitted together if all of them are valid.
+* @returns a PackageMempoolAcceptResult which includes a MempoolAcceptResult for each transaction
+* validated. If a transaction fails, validation will exit early and some results may be missing.
 */
 PackageMempoolAcceptResult ProcessNewPackage(CChainState& active_chainstate, CTxMemPool& pool,
                                                    const Package& txns, bool test_accept)
                                                    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Look up the outputs spent by a transaction in the mempool and the UTXO set,
+ * as a snapshot that its scripts can be checked against without holding
+ * cs_main (see PreVerifyInputScripts).
+ *
+ * @returns the spent outputs in input order, or std::nullopt if an input is
+ * missing (the transaction is an orphan, or spends something already spent)
+ * or non-standard, so that mempool acceptance would not check its scripts
+ */
+std::optional<std::vector<CTxOut>> GetSpentOutputsSnapshot(CChainState& active_chainstate, const CTxMemPool& pool,
+                                                           const CTransaction& tx) LOCKS_EXCLUDED(cs_main);
+
+/**
+ * Verify the input scripts of a transaction against a snapshot of the outputs
+ * it spends, with the script flags of mempool acceptance, on the calling
+ * thread. Needs no locks.
+ *
+ * Nothing is decided by this: it runs ahead of AcceptToMemoryPool so that the
+ * signatures it verifies are in the signature cache by the time acceptance
+ * checks them again under cs_main.
+ *
+ * @returns whether all scripts passed
+ */
+bool PreVerifyInputScripts(const CTransaction& tx, std::vector<CTxOut>&& spent_outputs);
+
 /** Transaction validation functions */
 
 /**
@@ -321,6 +358,16 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out);
 // TODO: Remove when this check is no longer necessary.
 bool CheckDbLockLimit(const std::vector<CTransactionRef>& vtx);
 
+/**
+ * Scan a file of serialized blocks (a blk?????.dat file or a -loadblock file)
+ * for block records and deserialize them.  fn is called with each block, its
+ * position in the file and its size, in file order; scanning stops when it
+ * returns false, at the end of the file or on shutdown.  Nothing but fn
+ * touches chain state, so several files may be scanned in parallel.  This
+ * takes over fileIn and closes it.
+ */
+void ScanExternalBlockFile(FILE* fileIn, const CChainParams& params, const std::function<bool(std::shared_ptr<CBlock>, uint64_t, unsigned int)>& fn);
+
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
 
@@ -414,6 +461,18 @@ private:
      */
     void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight, int chain_tip_height, int prune_height, bool is_ibd);
 
+    /**
+     * Contiguous storage for the entries created while loading the block index
+     * from disk. Entries added later are allocated individually, so Unload()
+     * must only delete entries outside of this range.
+     */
+    std::unique_ptr<CBlockIndex[]> m_block_index_arena;
+    size_t m_block_index_arena_size{0};
+    size_t m_block_index_arena_used{0};
+
+    /** Prepare m_block_index and the arena for loading @p count entries. */
+    void ReserveBlockIndex(size_t count) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 public:
     BlockMap m_block_index GUARDED_BY(cs_main);
 
@@ -473,12 +532,14 @@ public:
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to m_block_index.
+     * The proof of work check can be skipped with check_pow if the caller already did it.
      */
     bool AcceptBlockHeader(
         const CBlockHeader& block,
         BlockValidationState& state,
         const CChainParams& chainparams,
-        CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+        CBlockIndex** ppindex,
+        bool check_pow = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     CBlockIndex* LookupBlockIndex(const uint256& hash) const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -586,6 +647,10 @@ protected:
     //! Manages the UTXO set, which is a reflection of the contents of `m_chain`.
     std::unique_ptr<CoinsViews> m_coins_views;
 
+    //! Disk positions of blocks with unknown parent, by parent hash (only
+    //! used for reindex, from the importing thread)
+    std::multimap<uint256, FlatFilePos> m_blocks_unknown_parent;
+
 public:
     //! Reference to a BlockManager instance which itself is shared across all
     //! CChainState instances.
@@ -689,6 +754,15 @@ public:
     /** Import blocks from an external file */
     void LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp = nullptr);
 
+    /**
+     * Import one block read from an external file (see ScanExternalBlockFile),
+     * together with any earlier blocks from the file that were waiting for it
+     * as their parent.  dbp is the block's position if it is already stored
+     * in a block file (-reindex), or nullptr to store it.
+     * @returns false if importing from this file should stop
+     */
+    bool LoadExternalBlock(const std::shared_ptr<CBlock>& pblock, FlatFilePos* dbp, int& nLoaded);
+
     /**
      * Update the on-disk chain state.
      * The caches and indexes are flushed depending on the mode we're called with
@@ -736,13 +810,25 @@ public:
     // Block (dis)connection on a given view:
     DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, std::set<valtype>& unexpiredNames)
         EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+    /** As above, with the block's undo data already read from disk. */
+    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, std::set<valtype>& unexpiredNames, CBlockUndo& blockUndo)
+        EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
     bool ConnectBlock(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex,
                       CCoinsViewCache& view,
                       std::set<valtype>& expiredNames,
                       bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Apply the effects of a block disconnection on the UTXO set.
-    bool DisconnectTip(BlockValidationState& state, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool->cs);
+    bool DisconnectTip(BlockValidationState& state, DisconnectedBlockTransactions* disconnectpool, BlockUndoReadahead* readahead = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool->cs);
+
+    /**
+     * Start reading ahead the block and undo data for disconnecting pindex_tip
+     * and its ancestors down to (excluding) pindex_stop.  Returns nullptr if
+     * that is fewer than two blocks.  With warm set, the reader also looks up
+     * the coins and names the disconnects will touch in the chainstate
+     * database; only do that if cs_main is held for the readahead's lifetime.
+     */
+    std::unique_ptr<BlockUndoReadahead> StartDisconnectReadahead(const CBlockIndex* pindex_tip, const CBlockIndex* pindex_stop, bool warm) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Manual block validity manipulation:
     /** Mark a block as precious and reorganize.
@@ -1008,6 +1094,9 @@ public:
      * May not be called in a
      * validationinterface callback.
      *
+     * The proof of work (including auxpow) of all headers is checked on the
+     * header check threads before cs_main is taken.
+     *
      * @param[in]  block The block headers themselves
      * @param[out] state This may be set to an Error state if any error occurred processing them
      * @param[in]  chainparams The params for the chain we want to connect to
@@ -1047,7 +1136,7 @@ public:
 using FopenFn = std::function<FILE*(const fs::path&, const char*)>;
 
 /** Dump the mempool to disk. */
-bool DumpMempool(const CTxMemPool& pool, FopenFn mockable_fopen_function = fsbridge::fopen, bool skip_file_commit = false);
+bool DumpMempool(const CTxMemPool& pool, CChainState& active_chainstate, FopenFn mockable_fopen_function = fsbridge::fopen, bool skip_file_commit = false);
 
 /** Load the mempool from disk. */
 bool LoadMempool(CTxMemPool& pool, CChainState& active_chainstate, FopenFn mockable_fopen_function = fsbridge::fopen);
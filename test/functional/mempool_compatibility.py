@@ -62,7 +62,8 @@ class MempoolCompatibilityTest(BitcoinTestFramework):
         os.rename(old_node_mempool, new_node_mempool)
 
         self.log.info("Start new node and verify mempool contains the tx")
-        self.start_node(1)
+        # Write the format the old node can read when shutting down.
+        self.start_node(1, ["-persistmempoolv1"])
         assert old_tx_hash in new_node.getrawmempool()
 
         self.log.info("Add unbroadcasted tx to mempool on new node and shutdown")
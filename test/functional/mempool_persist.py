@@ -33,6 +33,8 @@ Test is as follows:
     mempool.
   - Verify that savemempool throws when the RPC is called if
     node1 can't write to disk.
+  - Verify that node1 writes and loads the previous mempool.dat format
+    with -persistmempoolv1, and that it detects a corrupt mempool.dat.
 
 """
 from decimal import Decimal
@@ -168,6 +170,35 @@ class MempoolPersistTest(BitcoinTestFramework):
         assert_raises_rpc_error(-1, "Unable to dump mempool to disk", self.nodes[1].savemempool)
         os.rmdir(mempooldotnew1)
 
+        def dump_version():
+            with open(mempooldat1, 'rb') as f:
+                return int.from_bytes(f.read(8), 'little')
+
+        self.log.debug("Write the previous format with -persistmempoolv1. Verify it is loaded as well")
+        self.restart_node(1, extra_args=["-persistmempool", "-persistmempoolv1"])
+        assert_equal(len(self.nodes[1].getrawmempool()), 6)
+        self.nodes[1].savemempool()
+        assert_equal(dump_version(), 1)
+        with self.nodes[1].assert_debug_log(["Imported mempool transactions from disk: 6 succeeded", "Loaded mempool in"]):
+            self.restart_node(1, extra_args=["-persistmempool"])
+        assert_equal(len(self.nodes[1].getrawmempool()), 6)
+        self.nodes[1].savemempool()
+        assert_equal(dump_version(), 2)
+
+        self.log.debug("Corrupt mempool.dat. Verify that the corruption is detected and the entries before it are loaded")
+        self.stop_node(1)
+        middle = os.path.getsize(mempooldat1) // 2
+        with open(mempooldat1, 'r+b') as f:
+            f.seek(middle)
+            byte = f.read(1)
+            f.seek(middle)
+            f.write(bytes([byte[0] ^ 0xff]))
+        with self.nodes[1].assert_debug_log(["Failed to deserialize mempool data on disk"]):
+            self.start_node(1, extra_args=["-persistmempool"])
+        assert self.nodes[1].getmempoolinfo()["loaded"]
+        assert_greater_than_or_equal(5, len(self.nodes[1].getrawmempool()))
+        self.stop_node(1)
+
         self.test_persist_unbroadcast()
 
     def test_persist_unbroadcast(self):
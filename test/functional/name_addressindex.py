@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The Bitcoin Core developers
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+# Test the address index (-addressindex) and its RPC and REST lookups,
+# including name operations.
+
+from test_framework.names import NameTestFramework
+from test_framework.util import *
+
+import http.client
+import json
+import urllib.parse
+
+
+class NameAddressIndexTest (NameTestFramework):
+
+  def set_test_params (self):
+    self.setup_name_test ([["-addressindex", "-rest"]])
+    self.setup_clean_chain = True
+
+  def rest_history (self, startHeight, addr):
+    url = urllib.parse.urlparse (self.nodes[0].url)
+    conn = http.client.HTTPConnection (url.hostname, url.port)
+    conn.request ("GET", "/rest/addresshistory/%d/%s.json" % (startHeight, addr))
+    resp = conn.getresponse ()
+    assert_equal (resp.status, 200)
+    return json.loads (resp.read ().decode ("utf-8"))
+
+  def run_test (self):
+    node = self.nodes[0]
+    minerAddr = node.getnewaddress ()
+    self.generatetoaddress (node, 3, minerAddr)
+    self.generate (node, 150)
+
+    self.log.info ("Registering a name...")
+    nameAddr = node.getnewaddress ()
+    new = node.name_new ("test-name")
+    self.generate (node, 12)
+    txid = self.firstupdateName (0, "test-name", new, "value",
+                                 {"destAddress": nameAddr})
+    self.generate (node, 1)
+    height = node.getblockcount ()
+
+    self.wait_until (
+        lambda: all (i["synced"] for i in node.getindexinfo ().values ()))
+    assert_equal (node.getindexinfo ("addressindex"), {
+      "addressindex": {
+        "synced": True,
+        "best_block_height": height,
+      }
+    })
+
+    self.log.info ("Name outputs count for the address holding the name...")
+    res = node.getaddresshistory (nameAddr)
+    assert_equal (len (res["entries"]), 1)
+    entry = res["entries"][0]
+    assert_equal (entry["height"], height)
+    assert_equal (entry["txid"], txid)
+    assert_equal (entry["name"], "test-name")
+    assert "vout" in entry
+    assert "next_height" not in res
+    assert_equal (self.rest_history (0, nameAddr), res)
+
+    self.log.info ("Spending the name output...")
+    newAddr = node.getnewaddress ()
+    updTxid = node.name_update ("test-name", "updated",
+                                {"destAddress": newAddr})
+    self.generate (node, 1)
+    res = node.getaddresshistory (nameAddr)
+    assert_equal (len (res["entries"]), 2)
+    spent = res["entries"][1]
+    assert_equal (spent["height"], height + 1)
+    assert_equal (spent["txid"], updTxid)
+    assert_equal (spent["prevout_txid"], txid)
+    assert_equal (spent["prevout_vout"], entry["vout"])
+    assert_equal (spent["amount"], entry["amount"])
+    assert_equal (spent["name"], "test-name")
+    res = node.getaddresshistory (newAddr)
+    assert_equal (len (res["entries"]), 1)
+    assert_equal (res["entries"][0]["txid"], updTxid)
+
+    self.log.info ("Height ranges and limits...")
+    # The wallet may have spent the coinbases later on, so only look at
+    # the blocks that paid to minerAddr.
+    res = node.getaddresshistory (minerAddr, 0, 3)
+    assert_equal ([e["height"] for e in res["entries"]], [1, 2, 3])
+    res = node.getaddresshistory (minerAddr, 2, 2)
+    assert_equal ([e["height"] for e in res["entries"]], [2])
+    res = node.getaddresshistory (minerAddr, 0, 3, 2)
+    assert_equal ([e["height"] for e in res["entries"]], [1, 2])
+    assert_equal (res["next_height"], 3)
+    res = node.getaddresshistory (minerAddr, res["next_height"], 3)
+    assert_equal ([e["height"] for e in res["entries"]], [3])
+
+    self.log.info ("Lookup by script...")
+    script = node.getaddressinfo (minerAddr)["scriptPubKey"]
+    assert_equal (node.getaddresshistory (script),
+                  node.getaddresshistory (minerAddr))
+
+    self.log.info ("Invalid parameters...")
+    assert_raises_rpc_error (-5, "Invalid address or script",
+                             node.getaddresshistory, "foo")
+    assert_raises_rpc_error (-8, "Invalid height range",
+                             node.getaddresshistory, minerAddr, 5, 4)
+    assert_raises_rpc_error (-8, "limit must be positive",
+                             node.getaddresshistory, minerAddr, 0, 5, 0)
+
+    self.log.info ("Without -addressindex...")
+    self.restart_node (0, extra_args=[])
+    assert_raises_rpc_error (-1, "Address index is not enabled",
+                             self.nodes[0].getaddresshistory, minerAddr)
+    assert_equal (self.nodes[0].getindexinfo ("addressindex"), {})
+
+
+if __name__ == '__main__':
+  NameAddressIndexTest ().main ()
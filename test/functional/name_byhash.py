@@ -68,6 +68,23 @@ class NameByHashTest (NameTestFramework):
     assert_raises_rpc_error (-4, "name hash not found",
                              node.name_show, "42" * 32, byHashOptions)
 
+    # Batched lookups, with unknown names returned as null.
+    res = node.name_showmany ([doubleHashHex, "42" * 32, doubleHashHex],
+                              byHashOptions)
+    assert_equal (len (res), 3)
+    assert_equal (res[0]["name"], nameHex)
+    assert_equal (res[0]["value"], "value")
+    assert_equal (res[1], None)
+    assert_equal (res[2], res[0])
+    res = node.name_showmany ([name, "d/unknown"])
+    assert_equal (res[0]["name"], name)
+    assert_equal (res[1], None)
+    assert_equal (node.name_showmany ([]), [])
+    assert_raises_rpc_error (-8, "must be 32 bytes long",
+                             node.name_showmany, ["abcd"], byHashOptions)
+    assert_raises_rpc_error (-8, "At most 1000 names",
+                             node.name_showmany, [name] * 1001)
+
     # General errors with the parameters.
     assert_raises_rpc_error (-8, "Invalid value for byHash",
                              node.name_show, doubleHashHex, {"byHash": "foo"})
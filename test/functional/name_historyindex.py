@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The Bitcoin Core developers
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+# Test that the name-history index (-namehistory) can be turned on and off
+# without a reindex, and that it follows reorgs.
+
+from test_framework.names import NameTestFramework
+from test_framework.util import *
+
+
+class NameHistoryIndexTest (NameTestFramework):
+
+  def set_test_params (self):
+    self.setup_clean_chain = True
+    self.setup_name_test ([[]])
+
+  def run_test (self):
+    node = self.nodes[0]
+    self.generate (node, 200)
+
+    self.log.info ("Updating a name without the index...")
+    new = node.name_new ("test-name")
+    self.generate (node, 12)
+    self.firstupdateName (0, "test-name", new, "first")
+    self.generate (node, 1)
+    node.name_update ("test-name", "second")
+    self.generate (node, 1)
+    assert_raises_rpc_error (-1, "-namehistory is not enabled",
+                             node.name_history, "test-name")
+    assert_equal (node.getindexinfo ("namehistory"), {})
+
+    self.log.info ("Building the index in the background...")
+    self.restart_node (0, extra_args=["-namehistory"])
+    node = self.nodes[0]
+    self.checkNameHistory (0, "test-name", ["first", "second"])
+    assert_equal (node.getindexinfo ("namehistory"), {
+      "namehistory": {
+        "synced": True,
+        "best_block_height": node.getblockcount (),
+      }
+    })
+
+    self.log.info ("Following new blocks and reorgs...")
+    node.name_update ("test-name", "third")
+    self.generate (node, 1)
+    self.checkNameHistory (0, "test-name", ["first", "second", "third"])
+    blk = node.getbestblockhash ()
+    node.invalidateblock (blk)
+    self.checkNameHistory (0, "test-name", ["first", "second"])
+    node.reconsiderblock (blk)
+    self.checkNameHistory (0, "test-name", ["first", "second", "third"])
+
+    self.log.info ("Disabling the index again...")
+    self.restart_node (0, extra_args=[])
+    assert_raises_rpc_error (-1, "-namehistory is not enabled",
+                             self.nodes[0].name_history, "test-name")
+
+
+if __name__ == '__main__':
+  NameHistoryIndexTest ().main ()
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test package relay: negotiation, and the relay of unconfirmed chains in one round trip."""
+
+import time
+
+from decimal import Decimal
+
+from test_framework.blocktools import COINBASE_MATURITY
+from test_framework.messages import (
+    COIN,
+    msg_getpkgtxns,
+    msg_pkgtxns,
+    msg_sendpackages,
+    msg_tx,
+    msg_verack,
+    msg_wtxidrelay,
+)
+from test_framework.p2p import P2PInterface
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.wallet import MiniWallet
+
+
+class PackagePeer(P2PInterface):
+    """Records the order of the handshake messages and optionally offers package relay."""
+    def __init__(self, *, offer_packages=True):
+        super().__init__()
+        self.offer_packages = offer_packages
+        self.handshake_msgs = []
+
+    def on_message(self, message):
+        if not self.handshake_msgs or self.handshake_msgs[-1] != b"verack":
+            self.handshake_msgs.append(message.msgtype)
+        super().on_message(message)
+
+    def on_version(self, message):
+        # Like P2PInterface.on_version, with sendpackages before verack.
+        self.send_message(msg_wtxidrelay())
+        if self.offer_packages:
+            self.send_message(msg_sendpackages(version=1))
+        self.send_message(msg_verack())
+        self.nServices = message.nServices
+
+
+class PackageRelayTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.extra_args = [["-packagerelay"]]
+
+    def create_chain(self, length):
+        """Create a chain of transactions, each spending the one before, without sending them."""
+        chain = []
+        utxo = None
+        for _ in range(length):
+            tx = self.wallet.create_self_transfer(from_node=self.nodes[0], utxo_to_spend=utxo, mempool_valid=not chain)
+            chain.append(tx)
+            utxo = {'txid': tx['txid'], 'vout': 0, 'value': Decimal(tx['tx'].vout[0].nValue) / COIN}
+        return chain
+
+    def test_negotiation(self):
+        node = self.nodes[0]
+
+        self.log.info("Check that sendpackages is sent between version and verack")
+        peer = node.add_p2p_connection(PackagePeer())
+        assert b"sendpackages" in peer.handshake_msgs
+        assert peer.handshake_msgs.index(b"sendpackages") < peer.handshake_msgs.index(b"verack")
+        peer.peer_disconnect()
+        peer.wait_for_disconnect()
+
+        self.log.info("Check that sendpackages after verack is a protocol violation")
+        peer = node.add_p2p_connection(PackagePeer())
+        with node.assert_debug_log(["sendpackages received after verack"]):
+            peer.send_message(msg_sendpackages(version=1))
+            peer.wait_for_disconnect()
+
+        self.log.info("Check that a node without -packagerelay doesn't offer it")
+        self.restart_node(0, extra_args=[])
+        peer = self.nodes[0].add_p2p_connection(PackagePeer())
+        assert b"sendpackages" not in peer.handshake_msgs
+        self.nodes[0].disconnect_p2ps()
+        self.restart_node(0, extra_args=self.extra_args[0])
+
+    def test_receive_package(self):
+        node = self.nodes[0]
+
+        self.log.info("Check that an orphan from a package relay peer is fetched with its ancestors")
+        chain = self.create_chain(3)
+        peer = node.add_p2p_connection(PackagePeer())
+        child = chain[-1]
+        peer.send_and_ping(msg_tx(child['tx']))
+        peer.wait_until(lambda: "getpkgtxns" in peer.last_message)
+        assert_equal(peer.last_message["getpkgtxns"].wtxid, int(child['wtxid'], 16))
+
+        with node.assert_debug_log(["ProcessNewPackage: peer=%d: accepted 3 txs" % node.getpeerinfo()[-1]['id']]):
+            peer.send_and_ping(msg_pkgtxns(int(child['wtxid'], 16), [tx['tx'] for tx in chain]))
+        mempool = node.getrawmempool()
+        assert all(tx['txid'] in mempool for tx in chain)
+        for tx in chain:
+            self.wallet.scan_tx(node.decoderawtransaction(tx['hex']))
+
+        self.log.info("Check that unrequested packages are ignored")
+        chain = self.create_chain(2)
+        with node.assert_debug_log(["unrequested pkgtxns"]):
+            peer.send_and_ping(msg_pkgtxns(int(chain[-1]['wtxid'], 16), [tx['tx'] for tx in chain]))
+        assert chain[0]['txid'] not in node.getrawmempool()
+
+        self.log.info("Check that peers without package relay get their orphans' parents requested one by one")
+        plain_peer = node.add_p2p_connection(PackagePeer(offer_packages=False))
+        plain_peer.send_and_ping(msg_tx(chain[-1]['tx']))
+        self.mocktime = int(time.time()) + 60
+        node.setmocktime(self.mocktime)
+        plain_peer.wait_until(lambda: "getdata" in plain_peer.last_message)
+        assert "getpkgtxns" not in plain_peer.last_message
+        node.disconnect_p2ps()
+
+    def test_serve_package(self):
+        node = self.nodes[0]
+
+        self.log.info("Check that a package is served with its ancestors, parents first")
+        chain = self.create_chain(3)
+        for tx in chain:
+            self.wallet.sendrawtransaction(from_node=node, tx_hex=tx['hex'])
+        # Let the transactions be old enough to be served to anyone.
+        self.mocktime += 3 * 60
+        node.setmocktime(self.mocktime)
+
+        peer = node.add_p2p_connection(PackagePeer())
+        peer.send_and_ping(msg_getpkgtxns(int(chain[-1]['wtxid'], 16)))
+        reply = peer.last_message["pkgtxns"]
+        assert_equal(reply.wtxid, int(chain[-1]['wtxid'], 16))
+        assert_equal([tx.getwtxid() for tx in reply.txs], [tx['wtxid'] for tx in chain])
+
+        self.log.info("Check that an unknown transaction gets an empty package")
+        peer.send_and_ping(msg_getpkgtxns(0x1234))
+        reply = peer.last_message["pkgtxns"]
+        assert_equal(reply.wtxid, 0x1234)
+        assert_equal(reply.txs, [])
+
+        self.log.info("Check that peers without package relay are not served packages")
+        plain_peer = node.add_p2p_connection(PackagePeer(offer_packages=False))
+        with node.assert_debug_log(["getpkgtxns from peer=", "ignored"]):
+            plain_peer.send_and_ping(msg_getpkgtxns(int(chain[-1]['wtxid'], 16)))
+        assert "pkgtxns" not in plain_peer.last_message
+        node.disconnect_p2ps()
+
+    def run_test(self):
+        self.wallet = MiniWallet(self.nodes[0])
+        self.generate(self.wallet, 10)
+        self.generate(self.nodes[0], COINBASE_MATURITY)
+
+        self.test_negotiation()
+        self.test_receive_package()
+        self.test_serve_package()
+
+
+if __name__ == '__main__':
+    PackageRelayTest().main()
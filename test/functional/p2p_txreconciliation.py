@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test transaction reconciliation (BIP330) negotiation and relay."""
+
+import time
+
+from test_framework.blocktools import COINBASE_MATURITY
+from test_framework.messages import (
+    msg_reqtxrcncl,
+    msg_sendtxrcncl,
+    msg_verack,
+    msg_wtxidrelay,
+)
+from test_framework.p2p import P2PInterface
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.wallet import MiniWallet
+
+
+class ReconciliationPeer(P2PInterface):
+    """Records the order of the handshake messages and optionally offers reconciliation."""
+    def __init__(self, *, offer_reconciliation=True):
+        super().__init__()
+        self.offer_reconciliation = offer_reconciliation
+        self.handshake_msgs = []
+
+    def on_message(self, message):
+        if not self.handshake_msgs or self.handshake_msgs[-1] != b"verack":
+            self.handshake_msgs.append(message.msgtype)
+        super().on_message(message)
+
+    def on_version(self, message):
+        # Like P2PInterface.on_version, with sendtxrcncl before verack.
+        self.send_message(msg_wtxidrelay())
+        if self.offer_reconciliation:
+            self.send_message(msg_sendtxrcncl(version=1, salt=2))
+        self.send_message(msg_verack())
+        self.nServices = message.nServices
+
+
+class TxReconciliationTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.extra_args = [["-txreconciliation"], ["-txreconciliation"]]
+
+    def test_negotiation(self):
+        node = self.nodes[0]
+
+        self.log.info("Check that sendtxrcncl is sent between version and verack")
+        peer = node.add_p2p_connection(ReconciliationPeer())
+        assert b"sendtxrcncl" in peer.handshake_msgs
+        assert peer.handshake_msgs.index(b"sendtxrcncl") < peer.handshake_msgs.index(b"verack")
+        recon = node.getpeerinfo()[-1]["txreconciliation"]
+        # We accepted the connection, so the peer starts the rounds.
+        assert_equal(recon["initiator"], False)
+        assert_equal(recon["rounds"], 0)
+        peer.peer_disconnect()
+        peer.wait_for_disconnect()
+
+        self.log.info("Check that peers that don't offer reconciliation keep using INV")
+        peer = node.add_p2p_connection(ReconciliationPeer(offer_reconciliation=False))
+        assert "txreconciliation" not in node.getpeerinfo()[-1]
+        peer.peer_disconnect()
+        peer.wait_for_disconnect()
+
+        self.log.info("Check that sendtxrcncl after verack is a protocol violation")
+        peer = node.add_p2p_connection(ReconciliationPeer())
+        with node.assert_debug_log(["sendtxrcncl received after verack"]):
+            peer.send_message(msg_sendtxrcncl(version=1, salt=3))
+            peer.wait_for_disconnect()
+
+        self.log.info("Check that a new reqtxrcncl before reconcildiff is a protocol violation")
+        peer = node.add_p2p_connection(ReconciliationPeer())
+        peer.send_message(msg_reqtxrcncl(set_size=0, q=0))
+        peer.wait_until(lambda: "sketch" in peer.last_message)
+        with node.assert_debug_log(["unexpected reqtxrcncl"]):
+            peer.send_message(msg_reqtxrcncl(set_size=0, q=0))
+            peer.wait_for_disconnect()
+
+        self.log.info("Check that a node without -txreconciliation doesn't offer it")
+        self.restart_node(0, extra_args=[])
+        peer = self.nodes[0].add_p2p_connection(ReconciliationPeer())
+        assert b"sendtxrcncl" not in peer.handshake_msgs
+        assert "txreconciliation" not in self.nodes[0].getpeerinfo()[-1]
+        self.nodes[0].disconnect_p2ps()
+        self.restart_node(0, extra_args=self.extra_args[0])
+        self.connect_nodes(0, 1)
+
+    def relay_and_wait(self, wallet, sender, receiver):
+        """Send a transaction from one node and advance time until the other one has it."""
+        wtxid = wallet.send_self_transfer(from_node=sender)["wtxid"]
+        # A round needs the responder's trickle and the initiator's next
+        # request; stay well below the peer timeouts.
+        for _ in range(60):
+            self.mocktime += 5
+            for n in self.nodes:
+                n.setmocktime(self.mocktime)
+            time.sleep(0.2)
+            if wtxid in [tx["wtxid"] for tx in receiver.getrawmempool(verbose=True).values()]:
+                return
+        raise AssertionError(f"transaction {wtxid} was not relayed")
+
+    def test_relay(self):
+        self.log.info("Check that transactions are relayed through reconciliation in both directions")
+        wallet = MiniWallet(self.nodes[0])
+        self.generate(wallet, 1)
+        self.generate(self.nodes[0], COINBASE_MATURITY)
+
+        self.mocktime = int(time.time())
+        for n in self.nodes:
+            n.setmocktime(self.mocktime)
+
+        # node0 made the connection, so it requests the sketches; node1
+        # answers them.
+        self.relay_and_wait(wallet, self.nodes[1], self.nodes[0])
+        self.relay_and_wait(wallet, self.nodes[0], self.nodes[1])
+
+        initiator = self.nodes[0].getpeerinfo()[0]
+        responder = self.nodes[1].getpeerinfo()[0]
+        assert_equal(initiator["txreconciliation"]["initiator"], True)
+        assert_equal(responder["txreconciliation"]["initiator"], False)
+        assert initiator["txreconciliation"]["rounds"] > 0
+        assert initiator["txreconciliation"]["txs_requested"] >= 1
+        assert initiator["txreconciliation"]["txs_announced"] >= 1
+        assert_equal(initiator["txreconciliation"]["failed_rounds"], 0)
+        assert_equal(initiator["txreconciliation"]["sketch_bytes_recv"], responder["txreconciliation"]["sketch_bytes_sent"])
+
+        self.log.info("Check the bandwidth used by reconciliation messages")
+        assert initiator["bytessent_per_msg"]["reqtxrcncl"] > 0
+        assert initiator["bytessent_per_msg"]["reconcildiff"] > 0
+        assert responder["bytessent_per_msg"]["sketch"] > 0
+        # The set never filled up, so nothing fell back to flooding.
+        assert_equal(initiator["txreconciliation"]["set_overflows"], 0)
+
+    def run_test(self):
+        self.test_negotiation()
+        self.test_relay()
+
+
+if __name__ == '__main__':
+    TxReconciliationTest().main()
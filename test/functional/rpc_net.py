@@ -93,6 +93,10 @@ class NetTest(BitcoinTestFramework):
         assert_equal(peer_info[0][0]['addrbind'], peer_info[1][0]['addr'])
         assert_equal(peer_info[1][0]['addrbind'], peer_info[0][0]['addr'])
         assert_equal(peer_info[0][0]['minfeefilter'], Decimal("0.00000500"))
+        # Node 1 has not requested any blocks, so it knows nothing of the speed of node 0.
+        assert_equal(peer_info[1][0]['blockdownload']['window'], 16)
+        assert_equal(peer_info[1][0]['blockdownload']['blocks_rerequested'], 0)
+        assert 'bytes_per_sec' in peer_info[0][0]['blockdownload']
         assert_equal(peer_info[1][0]['minfeefilter'], Decimal("0.00001000"))
         # check the `servicesnames` field
         for info in peer_info:
@@ -1336,6 +1336,147 @@ class msg_wtxidrelay:
         return "msg_wtxidrelay()"
 
 
+class msg_sendtxrcncl:
+    __slots__ = ("version", "salt")
+    msgtype = b"sendtxrcncl"
+
+    def __init__(self, version=1, salt=0):
+        self.version = version
+        self.salt = salt
+
+    def deserialize(self, f):
+        self.version = struct.unpack("<I", f.read(4))[0]
+        self.salt = struct.unpack("<Q", f.read(8))[0]
+
+    def serialize(self):
+        r = b""
+        r += struct.pack("<I", self.version)
+        r += struct.pack("<Q", self.salt)
+        return r
+
+    def __repr__(self):
+        return "msg_sendtxrcncl(version=%lu, salt=%lu)" % (self.version, self.salt)
+
+
+class msg_reqtxrcncl:
+    __slots__ = ("set_size", "q")
+    msgtype = b"reqtxrcncl"
+
+    def __init__(self, set_size=0, q=0):
+        self.set_size = set_size
+        self.q = q
+
+    def deserialize(self, f):
+        self.set_size = struct.unpack("<H", f.read(2))[0]
+        self.q = struct.unpack("<H", f.read(2))[0]
+
+    def serialize(self):
+        r = b""
+        r += struct.pack("<H", self.set_size)
+        r += struct.pack("<H", self.q)
+        return r
+
+    def __repr__(self):
+        return "msg_reqtxrcncl(set_size=%d, q=%d)" % (self.set_size, self.q)
+
+
+class msg_sketch:
+    __slots__ = ("skdata",)
+    msgtype = b"sketch"
+
+    def __init__(self, skdata=b""):
+        self.skdata = skdata
+
+    def deserialize(self, f):
+        self.skdata = deser_string(f)
+
+    def serialize(self):
+        return ser_string(self.skdata)
+
+    def __repr__(self):
+        return "msg_sketch(skdata=%s)" % self.skdata.hex()
+
+
+class msg_reconcildiff:
+    __slots__ = ("success", "ask_shortids")
+    msgtype = b"reconcildiff"
+
+    def __init__(self, success=True, ask_shortids=None):
+        self.success = success
+        self.ask_shortids = ask_shortids if ask_shortids is not None else []
+
+    def deserialize(self, f):
+        self.success = struct.unpack("<B", f.read(1))[0] != 0
+        self.ask_shortids = [struct.unpack("<I", f.read(4))[0] for _ in range(deser_compact_size(f))]
+
+    def serialize(self):
+        r = b""
+        r += struct.pack("<B", self.success)
+        r += ser_compact_size(len(self.ask_shortids))
+        for shortid in self.ask_shortids:
+            r += struct.pack("<I", shortid)
+        return r
+
+    def __repr__(self):
+        return "msg_reconcildiff(success=%s, ask_shortids=%s)" % (self.success, self.ask_shortids)
+
+
+class msg_sendpackages:
+    __slots__ = ("version",)
+    msgtype = b"sendpackages"
+
+    def __init__(self, version=1):
+        self.version = version
+
+    def deserialize(self, f):
+        self.version = struct.unpack("<I", f.read(4))[0]
+
+    def serialize(self):
+        return struct.pack("<I", self.version)
+
+    def __repr__(self):
+        return "msg_sendpackages(version=%d)" % self.version
+
+
+class msg_getpkgtxns:
+    __slots__ = ("wtxid",)
+    msgtype = b"getpkgtxns"
+
+    def __init__(self, wtxid=0):
+        self.wtxid = wtxid
+
+    def deserialize(self, f):
+        self.wtxid = deser_uint256(f)
+
+    def serialize(self):
+        return ser_uint256(self.wtxid)
+
+    def __repr__(self):
+        return "msg_getpkgtxns(wtxid=%064x)" % self.wtxid
+
+
+class msg_pkgtxns:
+    __slots__ = ("wtxid", "txs")
+    msgtype = b"pkgtxns"
+
+    def __init__(self, wtxid=0, txs=None):
+        self.wtxid = wtxid
+        self.txs = txs if txs is not None else []
+
+    def deserialize(self, f):
+        self.wtxid = deser_uint256(f)
+        self.txs = deser_vector(f, CTransaction)
+
+    def serialize(self):
+        r = b""
+        r += ser_uint256(self.wtxid)
+        r += ser_vector(self.txs, "serialize_with_witness")
+        return r
+
+    def __repr__(self):
+        return "msg_pkgtxns(wtxid=%064x, txs=%s)" % (self.wtxid, repr(self.txs))
+
+
 class msg_no_witness_tx(msg_tx):
     __slots__ = ()
 
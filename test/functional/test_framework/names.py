@@ -74,7 +74,10 @@ class NameTestFramework (BitcoinTestFramework):
     values, in order of increasing height, are the ones in 'values'.
     """
 
-    data = self.nodes[ind].name_history (name)
+    node = self.nodes[ind]
+    self.wait_until (
+        lambda: node.getindexinfo ("namehistory")["namehistory"]["synced"])
+    data = node.name_history (name)
 
     valuesFound = []
     for e in data:
@@ -49,16 +49,23 @@ from test_framework.messages import (
     msg_getblocktxn,
     msg_getdata,
     msg_getheaders,
+    msg_getpkgtxns,
     msg_headers,
     msg_inv,
     msg_mempool,
     msg_merkleblock,
     msg_notfound,
     msg_ping,
+    msg_pkgtxns,
     msg_pong,
+    msg_reconcildiff,
+    msg_reqtxrcncl,
     msg_sendaddrv2,
     msg_sendcmpct,
     msg_sendheaders,
+    msg_sendpackages,
+    msg_sendtxrcncl,
+    msg_sketch,
     msg_tx,
     MSG_TX,
     MSG_TYPE_MASK,
@@ -110,16 +117,23 @@ MESSAGEMAP = {
     b"getblocktxn": msg_getblocktxn,
     b"getdata": msg_getdata,
     b"getheaders": msg_getheaders,
+    b"getpkgtxns": msg_getpkgtxns,
     b"headers": msg_headers,
     b"inv": msg_inv,
     b"mempool": msg_mempool,
     b"merkleblock": msg_merkleblock,
     b"notfound": msg_notfound,
     b"ping": msg_ping,
+    b"pkgtxns": msg_pkgtxns,
     b"pong": msg_pong,
+    b"reconcildiff": msg_reconcildiff,
+    b"reqtxrcncl": msg_reqtxrcncl,
     b"sendaddrv2": msg_sendaddrv2,
     b"sendcmpct": msg_sendcmpct,
     b"sendheaders": msg_sendheaders,
+    b"sendpackages": msg_sendpackages,
+    b"sendtxrcncl": msg_sendtxrcncl,
+    b"sketch": msg_sketch,
     b"tx": msg_tx,
     b"verack": msg_verack,
     b"version": msg_version,
@@ -407,14 +421,21 @@ class P2PInterface(P2PConnection):
     def on_getblocktxn(self, message): pass
     def on_getdata(self, message): pass
     def on_getheaders(self, message): pass
+    def on_getpkgtxns(self, message): pass
     def on_headers(self, message): pass
     def on_mempool(self, message): pass
     def on_merkleblock(self, message): pass
     def on_notfound(self, message): pass
+    def on_pkgtxns(self, message): pass
     def on_pong(self, message): pass
+    def on_reconcildiff(self, message): pass
+    def on_reqtxrcncl(self, message): pass
     def on_sendaddrv2(self, message): pass
     def on_sendcmpct(self, message): pass
     def on_sendheaders(self, message): pass
+    def on_sendpackages(self, message): pass
+    def on_sendtxrcncl(self, message): pass
+    def on_sketch(self, message): pass
     def on_tx(self, message): pass
     def on_wtxidrelay(self, message): pass
 
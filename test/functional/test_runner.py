@@ -193,6 +193,8 @@ BASE_SCRIPTS = [
     'p2p_addr_relay.py',
     'p2p_getaddr_caching.py',
     'p2p_getdata.py',
+    'p2p_txreconciliation.py',
+    'p2p_package_relay.py',
     'p2p_addrfetch.py',
     'rpc_net.py',
     'wallet_keypool.py --legacy-wallet',
@@ -333,12 +335,14 @@ BASE_SCRIPTS = [
     'auxpow_zerohash.py',
 
     # name tests
+    'name_addressindex.py',
     'name_allowexpired.py',
     'name_ant_workflow.py',
     'name_byhash.py',
     'name_deterministic_salt.py',
     'name_encodings.py',
     'name_expiration.py',
+    'name_historyindex.py',
     'name_immature_inputs.py',
     'name_ismine.py',
     'name_list.py',
@@ -22,6 +22,7 @@ EXPECTED_CIRCULAR_DEPENDENCIES=(
     "wallet/fees -> wallet/wallet -> wallet/fees"
     "wallet/wallet -> wallet/walletdb -> wallet/wallet"
     "node/coinstats -> validation -> node/coinstats"
+    "node/mempool_persist -> validation -> node/mempool_persist"
 
     # Circular dependencies from auxpow.
     "auxpow -> primitives/block -> auxpow"